@@ -0,0 +1,85 @@
+#include "ButtonInput.h"
+
+// Wrap-safe "t has been reached at now" for millisecond timestamps
+static bool reached(uint32_t now, uint32_t t) { return (int32_t)(now - t) >= 0; }
+
+ButtonInput::ButtonInput(const ButtonTiming &timing, uint8_t count)
+    : timing_(timing), count_(count < MAX_BUTTONS ? count : MAX_BUTTONS) {}
+
+void ButtonInput::setRepeat(uint8_t button, bool enabled) {
+  if (button < count_)
+    state_[button].repeat = enabled;
+}
+
+void ButtonInput::onEdge(const ButtonEdge &e) {
+  if (e.button >= count_)
+    return;
+  State &s = state_[e.button];
+  // Every edge (also bounces) restarts the settle time
+  s.pending = true;
+  s.pendingDown = e.down;
+  s.edgeAt = e.atMs;
+  s.settleAt = e.atMs + timing_.debounceMs;
+}
+
+size_t ButtonInput::poll(uint32_t now, ButtonEvent *out, size_t maxOut) {
+  size_t n = 0;
+  for (uint8_t i = 0; i < count_; i++) {
+    State &s = state_[i];
+
+    if (s.pending && reached(now, s.settleAt)) {
+      if (s.pendingDown != s.down) {
+        if (n == maxOut)
+          return n;
+        s.down = s.pendingDown;
+        ButtonEvent &ev = out[n++];
+        ev.button = i;
+        ev.kind = s.down ? BTN_PRESS : BTN_RELEASE;
+        ev.edgeAtMs = s.edgeAt;
+        ev.atMs = s.settleAt;
+        if (s.down) {
+          s.pressEdgeAt = s.edgeAt;
+          s.nextRepeatAt = s.settleAt + timing_.longpressStartMs;
+        }
+      }
+      s.pending = false;
+    }
+
+    if (s.down && s.repeat && reached(now, s.nextRepeatAt)) {
+      if (n == maxOut)
+        return n;
+      ButtonEvent &ev = out[n++];
+      ev.button = i;
+      ev.kind = BTN_REPEAT;
+      ev.edgeAtMs = s.pressEdgeAt;
+      ev.atMs = s.nextRepeatAt;
+      // Keep the cadence, but do not burst after a stall
+      s.nextRepeatAt += timing_.longpressRepeatMs;
+      if (reached(now, s.nextRepeatAt))
+        s.nextRepeatAt = now + timing_.longpressRepeatMs;
+    }
+  }
+  return n;
+}
+
+uint32_t ButtonInput::msUntilNext(uint32_t now) const {
+  uint32_t best = NO_DEADLINE;
+  for (uint8_t i = 0; i < count_; i++) {
+    const State &s = state_[i];
+    if (s.pending) {
+      uint32_t d = reached(now, s.settleAt) ? 0 : s.settleAt - now;
+      if (d < best)
+        best = d;
+    }
+    if (s.down && s.repeat) {
+      uint32_t d = reached(now, s.nextRepeatAt) ? 0 : s.nextRepeatAt - now;
+      if (d < best)
+        best = d;
+    }
+  }
+  return best;
+}
+
+bool ButtonInput::isDown(uint8_t button) const {
+  return button < count_ && state_[button].down;
+}
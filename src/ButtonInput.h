@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Debounce + long-press repeat for push buttons, driven by timestamped level
+// changes instead of polling. No hardware access: the firmware feeds it from
+// GPIO edge interrupts, a simulator can feed it from a script.
+//
+// A level counts once it has been stable for debounceMs after the last edge
+// (same rule as the old pollButtons). Buttons with repeat enabled emit
+// BTN_REPEAT longpressStartMs after the press was accepted, then every
+// longpressRepeatMs while held.
+
+enum ButtonEventKind : uint8_t { BTN_PRESS, BTN_REPEAT, BTN_RELEASE };
+
+struct ButtonEdge {
+  uint8_t button;
+  bool down; // level after the edge, true = pushed
+  uint32_t atMs;
+};
+
+struct ButtonEvent {
+  uint8_t button;
+  ButtonEventKind kind;
+  uint32_t edgeAtMs; // edge that started the press (also for repeats)
+  uint32_t atMs;     // when the event became due
+};
+
+struct ButtonTiming {
+  uint32_t debounceMs;
+  uint32_t longpressStartMs;
+  uint32_t longpressRepeatMs;
+};
+
+class ButtonInput {
+public:
+  static constexpr uint8_t MAX_BUTTONS = 8;
+  static constexpr uint32_t NO_DEADLINE = UINT32_MAX;
+
+  ButtonInput(const ButtonTiming &timing, uint8_t count);
+
+  void setRepeat(uint8_t button, bool enabled);
+
+  // Feed one edge; edges of one button must arrive in time order
+  void onEdge(const ButtonEdge &e);
+
+  // Writes the events due at now to out (at most maxOut) and returns how
+  // many were written. Events that did not fit stay due for the next call.
+  size_t poll(uint32_t now, ButtonEvent *out, size_t maxOut);
+
+  // ms until poll() has something to do, NO_DEADLINE when all is settled
+  uint32_t msUntilNext(uint32_t now) const;
+
+  bool isDown(uint8_t button) const;
+
+private:
+  struct State {
+    bool down = false;       // debounced level
+    bool pending = false;    // an edge is waiting to settle
+    bool pendingDown = false;
+    bool repeat = false;
+    uint32_t settleAt = 0;
+    uint32_t edgeAt = 0;     // last raw edge
+    uint32_t pressEdgeAt = 0;
+    uint32_t nextRepeatAt = 0;
+  };
+
+  ButtonTiming timing_;
+  uint8_t count_;
+  State state_[MAX_BUTTONS];
+};
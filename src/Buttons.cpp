@@ -0,0 +1,35 @@
+#include "Buttons.h"
+
+#include <string.h>
+
+// This press has repeated (hold action): no short push on release
+static bool buttonHeld[BUTTON_COUNT];
+
+int buttonByName(const char *name) {
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    if (strcmp(BUTTONS[i].name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+bool buttonEventWanted(const ButtonEvent &ev) {
+  const ButtonDef &b = BUTTONS[ev.button];
+  return ev.kind != BTN_RELEASE || b.holdAction != b.action;
+}
+
+void buttonHandleEvent(const ButtonEvent &ev) {
+  // Short push = 1 step (also for VOL), repeat = volume-step
+  const ButtonDef &b = BUTTONS[ev.button];
+  if (b.holdAction == b.action) {
+    if (ev.kind != BTN_RELEASE)
+      handleAction(b.action);
+  } else if (ev.kind == BTN_PRESS) {
+    buttonHeld[ev.button] = false;
+  } else if (ev.kind == BTN_REPEAT) {
+    buttonHeld[ev.button] = true;
+    handleAction(b.holdAction);
+  } else if (!buttonHeld[ev.button]) {
+    handleAction(b.action); // short push, on release
+  }
+}
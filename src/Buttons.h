@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ButtonInput.h"
+#include "Player.h"
+
+// The player's buttons and what they do, shared by the firmware (GPIO edges
+// in main.cpp, pins in BUTTON_PINS there, same order) and the simulator
+// (names in its script). A button with a holdAction of its own acts on
+// release when short, and runs holdAction on every repeat while held
+// (NEXT/PREV: seek). Otherwise repeats run action again (volume).
+struct ButtonDef {
+  const char *name; // simulator script
+  Action action;
+  bool repeat; // long-press repeat
+  Action holdAction;
+};
+
+static constexpr ButtonDef BUTTONS[] = {
+    {"next", ACT_NEXT, true, ACT_SEEK_FWD},
+    {"play", ACT_PLAY_PAUSE, false, ACT_PLAY_PAUSE},
+    {"prev", ACT_PREV, true, ACT_SEEK_BACK},
+    {"volup", ACT_VOL_UP, true, ACT_VOL_UP},
+    {"voldown", ACT_VOL_DOWN, true, ACT_VOL_DOWN},
+    {"music", ACT_MODE_MUSIC, false, ACT_MODE_MUSIC},
+};
+
+static constexpr uint8_t BUTTON_COUNT = sizeof(BUTTONS) / sizeof(BUTTONS[0]);
+static_assert(BUTTON_COUNT <= ButtonInput::MAX_BUTTONS, "too many buttons");
+
+static constexpr uint32_t DEBOUNCE_MS = 30;
+static constexpr uint32_t LONGPRESS_START_MS = 350; // When repeat starts
+static constexpr uint32_t LONGPRESS_REPEAT_MS = 80; // repeat-interval
+static constexpr ButtonTiming BUTTON_TIMING = {DEBOUNCE_MS, LONGPRESS_START_MS,
+                                               LONGPRESS_REPEAT_MS};
+
+// Index in BUTTONS, -1 if there is no such button
+int buttonByName(const char *name);
+// False for events the actions ignore (a release of a button without a
+// hold action), so they need not be queued
+bool buttonEventWanted(const ButtonEvent &ev);
+// Loop: run the action of one event from ButtonInput
+void buttonHandleEvent(const ButtonEvent &ev);
@@ -0,0 +1,491 @@
+#include "Catalog.h"
+
+#include <ArduinoJson.h>
+
+#include "hal/Hal.h"
+
+static constexpr size_t CATALOG_TEXT_CHUNK = 16 * 1024;
+
+TextPool catalogText(MEM_CATALOG, CATALOG_TEXT_CHUNK);
+
+CatalogMap<TrackMeta> trackMetaByPath;
+CatalogMap<const char *> albumTitleByFolder;
+
+CatalogVec<TrackItem> trackPool;
+
+CatalogVec<CardEntry> cards;
+static CatalogMap<uint32_t> cardIndexByUid; // uid -> cards[]
+
+UiMessages uiMessages;
+RfidSettings rfidSettings;
+AntiRepeatSettings antiRepeatSettings;
+
+// ---------------- Staging ----------------
+// catalogStage() builds the next catalog here, next to the live tables the
+// loop reads, and catalogCommit() swaps the two sets: every table is a
+// pointer swap, so a scan sees the whole old or the whole new catalog. What
+// the commit replaced is freed by catalogStageFree(), off the loop.
+// Unlike the games, unchanged cards are not carried over: their texts and
+// tracks live in the pool and track pool of the old catalog, which the
+// commit frees, so they would be copied anyway. A reload therefore costs a
+// full parse (as long as the one at boot) and, until the commit, a second
+// catalog in PSRAM next to the live one; the reload log prints both.
+struct CatalogStage {
+  TextPool text{MEM_CATALOG, CATALOG_TEXT_CHUNK};
+  CatalogMap<TrackMeta> trackMetaByPath;
+  CatalogMap<const char *> albumTitleByFolder;
+  CatalogVec<TrackItem> trackPool;
+  CatalogVec<CardEntry> cards;
+  CatalogMap<uint32_t> cardIndexByUid;
+  UiMessages uiMessages;
+  RfidSettings rfidSettings;
+  AntiRepeatSettings antiRepeatSettings;
+  uint32_t settingsHash = 0; // "messages", "rfid" and "anti_repeat"
+};
+
+static CatalogStage stage;
+static uint32_t liveSettingsHash = 0;
+
+String normalizeFolder(String f) {
+  f.trim();
+  if (!f.startsWith("/"))
+    f = "/" + f;
+  while (f.indexOf("//") >= 0)
+    f.replace("//", "/");
+  if (f.length() > 1 && f.endsWith("/"))
+    f.remove(f.length() - 1);
+  return f;
+}
+
+String dirnameOf(const String &fullPath) {
+  int slash = fullPath.lastIndexOf('/');
+  if (slash <= 0)
+    return "/";
+  return fullPath.substring(0, slash);
+}
+
+String lookupAlbumTitleForTrackPath(const String &trackPath) {
+  String folder = normalizeFolder(dirnameOf(trackPath));
+  auto it = albumTitleByFolder.find(keyOfPath(folder));
+  if (it != albumTitleByFolder.end())
+    return it->second;
+  return "";
+}
+
+// Copy into the staged text pool; "" when PSRAM and heap are full
+static const char *keepText(const char *s) {
+  const char *p = stage.text.add(s);
+  return p ? p : "";
+}
+
+static const char *keepText(const String &s) {
+  const char *p = stage.text.add(s);
+  return p ? p : "";
+}
+
+// FNV-1a over the serialized JSON, so reload can tell which cards and games
+// changed without comparing every field
+class JsonHashWriter {
+public:
+  size_t write(uint8_t c) {
+    hash = (hash ^ c) * 16777619u;
+    return 1;
+  }
+  size_t write(const uint8_t *s, size_t n) {
+    for (size_t i = 0; i < n; i++)
+      write(s[i]);
+    return n;
+  }
+  uint32_t hash = 2166136261u;
+};
+
+uint32_t jsonHash(JsonVariantConst v, uint32_t seed) {
+  JsonHashWriter w;
+  w.hash ^= seed;
+  serializeJson(v, w);
+  return w.hash;
+}
+
+static SameCardPolicy parseSameCardPolicy(const char *s, SameCardPolicy def) {
+  if (!s)
+    return def;
+  if (strcmp(s, "restart") == 0)
+    return SAME_CARD_RESTART;
+  if (strcmp(s, "resume") == 0)
+    return SAME_CARD_RESUME;
+  if (strcmp(s, "ignore") == 0)
+    return SAME_CARD_IGNORE;
+  return def;
+}
+
+const CardEntry *findCardByUid(const String &uid) {
+  auto it = cardIndexByUid.find(keyOfPath(uid));
+  return it != cardIndexByUid.end() ? &cards[it->second] : nullptr;
+}
+
+void catalogForEachPath(
+    const std::function<void(const char *path, bool folder)> &fn) {
+  for (const CardEntry &c : cards) {
+    if (c.kind == PK_SINGLE && *c.file) {
+      // Played with the rest of its folder (next/prev), see Player.cpp
+      String path = c.file;
+      if (!path.startsWith("/"))
+        path = "/" + path;
+      fn(path.c_str(), false);
+      fn(dirnameOf(path).c_str(), true);
+    } else if (c.kind == PK_ALBUM_FOLDER && *c.folder) {
+      String folder = c.folder;
+      if (!folder.startsWith("/"))
+        folder = "/" + folder;
+      fn(folder.c_str(), true);
+    }
+  }
+  for (const TrackItem &t : trackPool)
+    fn(t.file, false);
+}
+
+void catalogStageFree() {
+  MemScope memScope(MEM_CATALOG);
+  stage.trackMetaByPath = CatalogMap<TrackMeta>();
+  stage.albumTitleByFolder = CatalogMap<const char *>();
+  stage.cardIndexByUid = CatalogMap<uint32_t>();
+  stage.trackPool = CatalogVec<TrackItem>();
+  stage.cards = CatalogVec<CardEntry>();
+  stage.text.clear();
+  // Sections missing from settings.json get the defaults
+  stage.uiMessages = UiMessages();
+  stage.rfidSettings = RfidSettings();
+  stage.antiRepeatSettings = AntiRepeatSettings();
+}
+
+void catalogCommit() {
+  std::swap(trackMetaByPath, stage.trackMetaByPath);
+  std::swap(albumTitleByFolder, stage.albumTitleByFolder);
+  std::swap(cardIndexByUid, stage.cardIndexByUid);
+  std::swap(trackPool, stage.trackPool);
+  std::swap(cards, stage.cards);
+  catalogText.swap(stage.text);
+  std::swap(uiMessages, stage.uiMessages);
+  std::swap(rfidSettings, stage.rfidSettings);
+  std::swap(antiRepeatSettings, stage.antiRepeatSettings);
+  liveSettingsHash = stage.settingsHash;
+}
+
+// Compares the staged cards with the live ones by uid and hash. Reads the
+// live tables, which only catalogCommit() changes.
+static void catalogDiff(CatalogDiff &d) {
+  d = CatalogDiff{};
+  for (const CardEntry &c : stage.cards) {
+    auto it = cardIndexByUid.find(keyOfPath(c.uid));
+    if (it == cardIndexByUid.end())
+      d.added++;
+    else if (cards[it->second].srcHash != c.srcHash)
+      d.changed++;
+    else
+      d.unchanged++;
+  }
+  d.removed = (uint32_t)cards.size() - d.changed - d.unchanged;
+  d.settingsChanged = stage.settingsHash != liveSettingsHash;
+}
+
+// Size the tables once up front, so loading never regrows them
+static void reserveCatalog(JsonArray arr) {
+  size_t tracks = 0;
+  for (JsonObject c : arr) {
+    JsonArray t = c["play"]["tracks"].as<JsonArray>();
+    if (!t.isNull())
+      tracks += t.size();
+  }
+  stage.cards.reserve(arr.size());
+  stage.cardIndexByUid.reserve(arr.size());
+  stage.trackPool.reserve(tracks);
+  stage.trackMetaByPath.reserve(tracks + arr.size());
+}
+
+static bool catalogParse(const char *jsonPath, CatalogDiff &diff);
+
+bool loadCardsJson(const char *jsonPath) {
+  CatalogDiff diff;
+  bool ok = catalogStage(jsonPath, diff);
+  if (ok)
+    catalogCommit();
+  catalogStageFree();
+  return ok;
+}
+
+bool catalogStage(const char *jsonPath, CatalogDiff &diff) {
+  catalogStageFree();
+  try {
+    return catalogParse(jsonPath, diff);
+  } catch (const std::bad_alloc &) {
+    Serial.println("ERROR: out of memory for the catalog, settings not loaded");
+    catalogStageFree();
+    return false;
+  }
+}
+
+static bool catalogParse(const char *jsonPath, CatalogDiff &diff) {
+  MemScope memScope(MEM_CATALOG);
+
+  Serial.println("****** loadCardsJson **********");
+
+  std::unique_ptr<HalFile> f = hal.fs->open(jsonPath, FileMode::READ);
+  if (!f) {
+    Serial.print("Could not open JSON: ");
+    Serial.println(jsonPath);
+    return false;
+  }
+
+  // "games" is loaded by loadGamesJson()
+  StaticJsonDocument<96> filter;
+  filter["messages"] = true;
+  filter["rfid"] = true;
+  filter["anti_repeat"] = true;
+  filter["cards"] = true;
+
+  //DynamicJsonDocument doc(16384);
+  BasicJsonDocument<MemJsonAllocator<MEM_JSON>> doc(docSizeFor(f->size()));
+
+  DeserializationError err =
+      deserializeJson(doc, *f, DeserializationOption::Filter(filter));
+  f.reset();
+   Serial.println("loadCardsJson");
+  Serial.print("JSON capacity: ");
+  Serial.println(doc.capacity());
+
+  Serial.print("JSON memoryUsage: ");
+  Serial.println(doc.memoryUsage());
+
+  if (err) {
+    Serial.print("JSON parse error: ");
+    Serial.println(err.c_str());
+    return false;
+  }
+
+  JsonObject msgs = doc["messages"].as<JsonObject>();
+  if (!msgs.isNull()) {
+    UiMessages &m = stage.uiMessages;
+    m.antiRepeatWarning = String((const char *)(msgs["anti_repeat_warning"] | ""));
+    m.antiRepeatEnabled = String((const char *)(msgs["anti_repeat_enabled"] | ""));
+    m.antiRepeatDisabled = String((const char *)(msgs["anti_repeat_disabled"] | ""));
+
+    m.volumeLockOn  = String((const char*)(msgs["volume_lock_on"]  | ""));
+    m.volumeLockOff = String((const char*)(msgs["volume_lock_off"] | ""));
+
+    m.shuffleOn  = String((const char*)(msgs["shuffle_on"]  | ""));
+    m.shuffleOff = String((const char*)(msgs["shuffle_off"] | ""));
+
+    m.mastercard_used = String((const char*)(msgs["mastercard_used"] | ""));
+
+    m.musicModeInfo =   String((const char*)(msgs["music_mode_info"] | ""));
+
+  }
+
+  JsonObject rfid = doc["rfid"].as<JsonObject>();
+  if (!rfid.isNull()) {
+    RfidSettings &rs = stage.rfidSettings;
+    rs.presenceCheckMs =
+        (uint32_t)(rfid["presence_check_ms"] | RFID_PRESENCE_DEFAULT_MS);
+    rs.pauseOnRemoval = (bool)(rfid["pause_on_removal"] | false);
+    rs.dedupMs = (uint32_t)(rfid["dedup_ms"] | SCAN_DEDUP_DEFAULT_MS);
+
+    JsonObject same = rfid["same_card"].as<JsonObject>();
+    if (!same.isNull()) {
+      rs.sameCardMusic = parseSameCardPolicy(
+          same["music"] | "resume", SAME_CARD_RESUME);
+      rs.sameCardSelector = parseSameCardPolicy(
+          same["game_selector"] | "ignore", SAME_CARD_IGNORE);
+    }
+  }
+
+  JsonObject repeat = doc["anti_repeat"].as<JsonObject>();
+  if (!repeat.isNull()) {
+    AntiRepeatSettings &ar = stage.antiRepeatSettings;
+    ar.maxStarts = (uint8_t)(repeat["max_starts"] | ANTI_REPEAT_DEFAULT_MAX);
+    if (ar.maxStarts == 0)
+      ar.maxStarts = 1; // 0 would block every track
+    ar.windowStarts =
+        (uint8_t)(repeat["window_starts"] | ANTI_REPEAT_DEFAULT_STARTS);
+    ar.windowMinutes =
+        (uint32_t)(repeat["window_minutes"] | ANTI_REPEAT_DEFAULT_MINUTES);
+  }
+  stage.settingsHash = jsonHash(repeat, jsonHash(rfid, jsonHash(msgs, 0)));
+
+  JsonArray arr = doc["cards"].as<JsonArray>();
+  if (arr.isNull()) {
+    Serial.println("JSON missing 'cards' array");
+    return false;
+  }
+
+  reserveCatalog(arr);
+
+  for (JsonObject c : arr) {
+    const char *uid = c["uid"] | "";
+    const char *role = c["role"] | "";
+    const char *title = c["title"] | "";
+    const char *artist = c["artist"] | "---";
+    const char* action = c["action"] | "";
+
+    String suid(uid);
+    suid.toUpperCase();
+    if (suid.length() == 0)
+      continue;
+
+    if (stage.cardIndexByUid.count(keyOfPath(suid))) {
+      Serial.print("WARNING: duplicate card uid ignored: ");
+      Serial.println(suid);
+      continue;
+    }
+
+    // -------- common fields (the rest keeps its defaults) --------
+    stage.cards.emplace_back();
+    CardEntry &ce = stage.cards.back();
+    ce.uid = suid;
+    ce.role = String(role);
+    ce.title = keepText(title);
+    ce.artist = keepText(artist);
+    ce.action = String(action);
+    ce.srcHash = jsonHash(c, 0);
+    stage.cardIndexByUid[std::string_view(keepText(suid))] =
+        (uint32_t)(stage.cards.size() - 1);
+
+    // -------- role-specific parsing --------
+    if (ce.role == "game_selector") {
+      Serial.println("***** game_selector *****");
+      const char *gid = c["gameId"] | "";
+      ce.gameId = String(gid);
+
+
+    } else if (ce.role == "answer") {
+      // tags[]
+      JsonArray tags = c["tags"].as<JsonArray>();
+      if (!tags.isNull()) {
+        for (JsonVariant tv : tags) {
+          if (ce.tagCount >= MAX_CARD_TAGS)
+            break;
+          if (tv.is<const char *>()) {
+            ce.tags[ce.tagCount++] = String(tv.as<const char *>());
+          }
+        }
+      }
+
+      // optional value (for sum games)
+      if (c.containsKey("value")) {
+        ce.value = (int)(c["value"] | -1);
+      }
+    }
+    // music (and any other roles that have play object)
+    // we only parse play for music cards to avoid accidental parsing on other
+    // roles
+    if (ce.role == "music") {
+      JsonObject play = c["play"].as<JsonObject>();
+      if (!play.isNull()) {
+        const char *kind = play["kind"] | "";
+
+        if (strcmp(kind, "single") == 0) {
+          const char *file = play["file"] | "";
+          if (strlen(file) > 0) {
+            ce.kind = PK_SINGLE;
+
+            // --- normaliser path (samme format overalt) ---
+            String path(file);
+            if (!path.startsWith("/"))
+              path = "/" + path;
+
+            ce.file = keepText(path);
+
+            // --- metadata-opslag: path -> {title, artist} ---
+            stage.trackMetaByPath[std::string_view(ce.file)] =
+                TrackMeta{ce.title, ce.artist};
+          }
+        } else if (strcmp(kind, "album") == 0 ||
+                   strcmp(kind, "playlist") == 0) {
+          const char *folder = play["folder"] | "";
+          JsonArray tracks = play["tracks"].as<JsonArray>();
+
+          if (strlen(folder) > 0) {
+            ce.kind = PK_ALBUM_FOLDER;
+
+            // normaliser og gem folder
+            ce.folder = keepText(normalizeFolder(String(folder)));
+
+            // album lookup: folder -> album title (fra card)
+            // (kun for "album", ikke "playlist")
+            if (strcmp(kind, "album") == 0 || strcmp(kind, "playlist") == 0) {
+              stage.albumTitleByFolder[std::string_view(ce.folder)] = ce.title;
+            }
+          } else if (!tracks.isNull()) {
+            // tracks[] playlist/album
+            uint32_t start = (uint32_t)stage.trackPool.size();
+            uint32_t cnt = 0;
+
+            for (JsonVariant tv : tracks) {
+              const char *ttitle = "";
+              const char *tartist = "";
+              String tfile = "";
+
+              if (tv.is<const char *>()) {
+                tfile = String(tv.as<const char *>());
+              } else if (tv.is<JsonObject>()) {
+                JsonObject to = tv.as<JsonObject>();
+                ttitle = to["title"] | "";
+                tartist = to["artist"] | "---";
+                tfile = String((const char *)(to["file"] | ""));
+              }
+
+              if (tfile.length() == 0)
+                continue;
+              if (!tfile.startsWith("/"))
+                tfile = "/" + tfile;
+              // Map folder -> title for playlists too (even when play.folder is
+              // missing)
+              if (strcmp(kind, "playlist") == 0) {
+                String fldr = normalizeFolder(dirnameOf(tfile));
+                auto it = stage.albumTitleByFolder.find(keyOfPath(fldr));
+                if (it != stage.albumTitleByFolder.end())
+                  it->second = ce.title;
+                else
+                  stage.albumTitleByFolder[std::string_view(keepText(fldr))] =
+                      ce.title; // "/audio/mix" -> "mix"
+              }
+
+              TrackItem item{keepText(ttitle), keepText(tartist),
+                             keepText(tfile)};
+              if (item.title[0] || item.artist[0]) {
+                stage.trackMetaByPath[std::string_view(item.file)] =
+                    TrackMeta{item.title, item.artist};
+              }
+
+              stage.trackPool.push_back(item);
+              cnt++;
+            }
+
+            if (cnt > 0) {
+              ce.kind = PK_ALBUM_TRACKS;
+              ce.trackStart = start;
+              ce.trackCount = cnt;
+            }
+          }
+        }
+      }
+    }
+
+  }
+
+  Serial.printf("Loaded cards: %u, tracks: %u, text: %u bytes\n",
+                (unsigned)stage.cards.size(), (unsigned)stage.trackPool.size(),
+                (unsigned)stage.text.bytes());
+
+  // Optional: quick sanity print for selectors
+  for (size_t i = 0; i < stage.cards.size(); i++) {
+    if (stage.cards[i].role == "game_selector") {
+      Serial.print("Selector UID ");
+      Serial.print(stage.cards[i].uid);
+      Serial.print(" -> gameId=");
+      Serial.println(stage.cards[i].gameId);
+    }
+  }
+
+  catalogDiff(diff);
+  return true;
+}
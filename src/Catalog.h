@@ -0,0 +1,212 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MemTrack.h"
+#include "TextPool.h"
+
+// Cards, tracks and texts from settings.json ("cards", "messages", "rfid").
+// Games are loaded separately by loadGamesJson() (GameEngine.h).
+
+// ArduinoJson document size for settings.json: DOC_SIZE at least, twice
+// the file for bigger ones (docSizeFor). Big documents end up in PSRAM.
+constexpr size_t DOC_SIZE = 120 * 1024;
+constexpr size_t DOC_BYTES_PER_JSON_BYTE = 2;
+
+static inline size_t docSizeFor(size_t jsonBytes) {
+  size_t n = jsonBytes * DOC_BYTES_PER_JSON_BYTE;
+  return n > DOC_SIZE ? n : DOC_SIZE;
+}
+
+// The catalog grows with settings.json; there are no fixed table sizes.
+// Texts (paths, titles, map keys) are kept in catalogText, tables and maps
+// use PSRAM (MemPsramAllocator). Everything is rebuilt by loadCardsJson().
+extern TextPool catalogText;
+
+template <class T>
+using CatalogVec = std::vector<T, MemPsramAllocator<T, MEM_CATALOG>>;
+
+// Keys point into catalogText
+template <class V>
+using CatalogMap =
+    std::unordered_map<std::string_view, V, std::hash<std::string_view>,
+                       std::equal_to<std::string_view>,
+                       MemPsramAllocator<std::pair<const std::string_view, V>,
+                                         MEM_CATALOG>>;
+
+// Save meta data for
+struct TrackMeta {
+  const char *title;
+  const char *artist;
+};
+
+extern CatalogMap<TrackMeta> trackMetaByPath;
+
+extern CatalogMap<const char *> albumTitleByFolder;
+
+// Lookup key, valid as long as p
+static inline std::string_view keyOfPath(const String &p) {
+  return std::string_view(p.c_str(), p.length());
+}
+
+String normalizeFolder(String f);
+String dirnameOf(const String &fullPath);
+String lookupAlbumTitleForTrackPath(const String &trackPath);
+
+// Card tracking
+enum PlayKind : uint8_t {
+  PK_NONE = 0,
+  PK_SINGLE,
+  PK_ALBUM_FOLDER,
+  PK_ALBUM_TRACKS
+};
+
+// Texts in catalogText
+struct TrackItem {
+  const char *title;  // optional
+  const char *artist; // optional
+  const char *file;   // absolute path
+};
+
+// A “pool” with all track-items from all album(track-lists)
+extern CatalogVec<TrackItem> trackPool;
+
+// Tune these to your needs / memory budget
+static constexpr uint8_t MAX_CARD_TAGS = 8;
+
+struct CardEntry {
+  // Common
+  String uid;  // uppercase hex
+  String role; // "music", "answer", "game_selector"
+  const char *title = "";  // catalogText, like file and folder
+  const char *artist = "";
+
+  // ---------------- MUSIC ----------------
+  PlayKind kind = PK_NONE;
+
+  // single
+  const char *file = "";
+
+  // album-folder
+  const char *folder = "";
+
+  // album/playlist tracks refer into trackPool
+  uint32_t trackStart = 0;
+  uint32_t trackCount = 0;
+
+  // ---------------- GAME SELECTOR ----------------
+  // Used when role == "game_selector"
+  String gameId;
+
+  // ---------------- ANSWER CARD ----------------
+  // Used when role == "answer"
+  String tags[MAX_CARD_TAGS];
+  uint8_t tagCount = 0;
+
+  // Optional numeric value for sum games (role=="answer" with tag "tal" etc.)
+  // Use -1 when not present.
+  int value = -1;
+
+  // ---------------- PARENT / ACTION ----------------
+  String action;
+
+  uint32_t srcHash = 0; // of the card's JSON, for reload diffs
+};
+
+extern CatalogVec<CardEntry> cards;
+
+// End of Card tracking
+
+// Parent Control
+struct UiMessages {
+  String antiRepeatWarning;
+  String antiRepeatEnabled;
+  String antiRepeatDisabled;
+
+  String volumeLockOn;
+  String volumeLockOff;
+
+  String shuffleOn;
+  String shuffleOff;
+
+  String mastercard_used;
+
+  String musicModeInfo;
+};
+
+extern UiMessages uiMessages;
+
+// ---- Reader behaviour ("rfid" object) ----
+// Scanning the card whose content is already running follows the per-role
+// same-card policy ("same_card": {"music", "game_selector"}).
+enum SameCardPolicy : uint8_t {
+  SAME_CARD_RESTART, // old behaviour: rebuild playlist / restart game
+  SAME_CARD_RESUME,  // resume if paused, otherwise ignore
+  SAME_CARD_IGNORE
+};
+
+static constexpr uint32_t RFID_PRESENCE_DEFAULT_MS = 500;
+static constexpr uint32_t SCAN_DEDUP_DEFAULT_MS = 1500;
+
+struct RfidSettings {
+  uint32_t presenceCheckMs = RFID_PRESENCE_DEFAULT_MS; // with pauseOnRemoval
+  bool pauseOnRemoval = false;
+  uint32_t dedupMs = SCAN_DEDUP_DEFAULT_MS;
+  SameCardPolicy sameCardMusic = SAME_CARD_RESUME;
+  SameCardPolicy sameCardSelector = SAME_CARD_IGNORE;
+};
+
+extern RfidSettings rfidSettings;
+
+// ---- Anti-repeat policy ("anti_repeat" object) ----
+// With the parent toggle on, a track is not started when it already started
+// maxStarts times in the last windowStarts starts that are younger than
+// windowMinutes (0 = no age limit). Two favourite cards taken in turn count
+// the same as one card scanned again and again.
+static constexpr uint8_t ANTI_REPEAT_DEFAULT_MAX = 2;
+static constexpr uint8_t ANTI_REPEAT_DEFAULT_STARTS = 8;
+static constexpr uint32_t ANTI_REPEAT_DEFAULT_MINUTES = 30;
+
+struct AntiRepeatSettings {
+  uint8_t maxStarts = ANTI_REPEAT_DEFAULT_MAX;
+  uint8_t windowStarts = ANTI_REPEAT_DEFAULT_STARTS; // at most 32
+  uint32_t windowMinutes = ANTI_REPEAT_DEFAULT_MINUTES;
+};
+
+extern AntiRepeatSettings antiRepeatSettings;
+
+const CardEntry *findCardByUid(const String &uid);
+// Every file and folder the cards play, as the player opens them, for the
+// path cache (PathCache.h). Not while a reload commits.
+void catalogForEachPath(
+    const std::function<void(const char *path, bool folder)> &fn);
+// Stage + commit in one go (boot)
+bool loadCardsJson(const char *jsonPath);
+
+// ---- Reload (SettingsReload.h) ----
+// Cards compared by uid and the hash of their JSON
+struct CatalogDiff {
+  uint32_t added;
+  uint32_t changed;
+  uint32_t removed;
+  uint32_t unchanged;
+  bool settingsChanged; // "messages", "rfid" or "anti_repeat"
+};
+
+// Builds the next catalog next to the live one, from any task: the live
+// tables are only read. False on a parse error (nothing to commit).
+bool catalogStage(const char *jsonPath, CatalogDiff &diff);
+// Loop only: the staged catalog becomes the live one (pointer swaps)
+void catalogCommit();
+// Frees what the last commit replaced (or a failed stage); any task, not
+// while a stage is waiting for its commit
+void catalogStageFree();
+
+// FNV-1a of the serialized JSON value, chained from seed
+uint32_t jsonHash(JsonVariantConst v, uint32_t seed);
@@ -0,0 +1,1535 @@
+#include "GameEngine.h"
+
+#include <ArduinoJson.h>
+
+#include <mutex>
+
+#include "Catalog.h"
+#include "PathCache.h"
+#include "Playlist.h"
+#include "UiModel.h"
+#include "hal/Hal.h"
+
+// ================= GAME ENGINE START =================
+
+// ---- Game data limits ----
+static constexpr size_t MAX_GAMES = 10;
+static constexpr size_t MAX_QUESTIONS = 40;
+static constexpr size_t MAX_RULE_TAGS = 6; // max tags in a rule
+static constexpr size_t MAX_PENDING = 2;   // you want 1 or 2 cards
+// static constexpr size_t MAX_CARD_TAGS = 8;      // max tags on an answer card
+static uint32_t nextCardDueAt = 0;
+static uint8_t repeatCount =
+    0; // antal gange vi har gentaget spørgsmålet pga. inaktivitet
+static uint8_t nextCardRepeatCount =
+    0; // antal nextCard reminders i nuværende forsøg
+
+static bool doneAnnounced = false;
+
+enum class RuleType : uint8_t { REQUIRE_TAGS, SUM };
+
+enum class MatchMode : uint8_t { ANY, ALL };
+
+struct GameAudio {
+  String intro;
+  String correct;
+  String wrong;
+  String done;
+  String nextCardForAnswer;
+  String musicHint;
+  String idleStop;
+};
+
+struct QuestionAudioOverride {
+  String correct; // optional
+  String wrong;   // optional
+};
+
+struct AnswerRule {
+  RuleType type = RuleType::REQUIRE_TAGS;
+
+  // requireTags
+  MatchMode mode = MatchMode::ANY;
+  String tags[MAX_RULE_TAGS];
+  uint8_t tagCount = 0;
+
+  // sum
+  int equals = 0;                    // target
+  uint8_t cards = 1;                 // required cards (default 1)
+  String requireTags[MAX_RULE_TAGS]; // e.g. ["tal"]
+  uint8_t requireTagCount = 0;
+};
+
+struct Question {
+  uint8_t srcIdx = 0; // position in settings.json (questions get shuffled)
+  String prompt;
+  QuestionAudioOverride audio; // optional overrides
+  AnswerRule rule;
+};
+
+struct GameTiming {
+  uint32_t nextCardRepeatMs = 8000;
+  uint32_t answerTimeoutMs = 25000;
+  uint32_t maxRepeat = 3;
+};
+
+struct GameDef {
+  String id;
+  String titel;
+  GameAudio audio;
+  GameTiming timing;
+  Question questions[MAX_QUESTIONS];
+  uint8_t questionCount = 0;
+};
+
+// ---- Loaded games ----
+static GameDef games[MAX_GAMES];
+static uint8_t gameCount = 0;
+static uint32_t gameHash[MAX_GAMES]; // of each game's JSON, for reload diffs
+// A reload changes games[] and gameStats[], a game start shuffles its
+// questions; analyticsSave() and gamesForEachPath() read them from other
+// tasks
+static std::mutex gamesLock;
+
+// ---- Runtime state ----
+volatile bool gameModeActive = false;
+static int activeGameIdx = -1;
+GameState gameState = GameState::IDLE;
+static uint8_t questionIdx = 0;
+
+// pending answer cards (store minimal extracted data)
+struct PendingCard {
+  String uid;
+  String tags[MAX_CARD_TAGS];
+  uint8_t tagCount = 0;
+  int value = -1;
+};
+
+static PendingCard pending[MAX_PENDING];
+static uint8_t pendingCount = 0;
+
+// ================= GAME ANALYTICS =================
+//
+// Per game and per question counters, updated in RAM from the state machine
+// actions (fixed arrays, no allocation) and flushed to ANALYTICS_PATH by a
+// low priority task when dirty and no audio is streaming from SD.
+// Counters are cumulative across boots (loaded again in setup) and saturate
+// at 65535. tools/analytics_to_csv.py turns the file into CSV.
+//
+// File layout (little endian):
+//   "TGA1" u8 version, u8 bucketCount, u8 gameCount, u8 reserved,
+//   u16 bucketEdgesMs[bucketCount - 1]
+//   per game: u8 idLen, char id[idLen], u8 questionCount, GameStatsHead,
+//             QuestionStats[questionCount] (in settings.json order)
+
+static constexpr const char *ANALYTICS_TMP_PATH = "/analytics.tmp";
+static constexpr uint8_t ANALYTICS_VERSION = 1;
+
+// Prompt end -> first scan histogram; last bucket is ">= last edge"
+static constexpr uint16_t SCAN_LATENCY_EDGES_MS[] = {1000, 2000,  3000, 5000,
+                                                     8000, 12000, 20000};
+static constexpr size_t SCAN_LATENCY_BUCKETS =
+    sizeof(SCAN_LATENCY_EDGES_MS) / sizeof(SCAN_LATENCY_EDGES_MS[0]) + 1;
+
+struct QuestionStats {
+  uint16_t attempts; // answers evaluated (correct + wrong + master)
+  uint16_t correct;
+  uint16_t wrong;
+  uint16_t master;
+  uint16_t timeouts;
+  uint16_t idleStops;
+  uint16_t firstScanHist[SCAN_LATENCY_BUCKETS];
+};
+
+struct GameStatsHead {
+  uint16_t starts;
+  uint16_t completions;
+  uint16_t idleStops;
+};
+
+struct GameStats {
+  GameStatsHead head;
+  QuestionStats q[MAX_QUESTIONS];
+};
+
+static GameStats gameStats[MAX_GAMES];
+volatile bool analyticsDirty = false;
+
+// Per prompt round: waiting for the first scan after the prompt ended
+static bool statsAwaitFirstScan = false;
+static uint32_t statsCollectStartedAt = 0;
+
+static inline void statInc(uint16_t &c) {
+  if (c != 0xFFFF)
+    c++;
+  analyticsDirty = true;
+}
+
+static QuestionStats *statsCurQuestion() {
+  if (activeGameIdx < 0 || questionIdx >= games[activeGameIdx].questionCount)
+    return nullptr;
+  uint8_t src = games[activeGameIdx].questions[questionIdx].srcIdx;
+  return &gameStats[activeGameIdx].q[src];
+}
+
+static void statsOnGameStart() {
+  if (activeGameIdx < 0)
+    return;
+  statsAwaitFirstScan = false;
+  statInc(gameStats[activeGameIdx].head.starts);
+}
+
+static void statsOnGameCompleted() {
+  if (activeGameIdx >= 0)
+    statInc(gameStats[activeGameIdx].head.completions);
+}
+
+static void statsOnIdleStop() {
+  if (activeGameIdx < 0)
+    return;
+  statInc(gameStats[activeGameIdx].head.idleStops);
+  if (QuestionStats *qs = statsCurQuestion())
+    statInc(qs->idleStops);
+}
+
+static void statsOnCollectStart(uint32_t now) {
+  statsAwaitFirstScan = true;
+  statsCollectStartedAt = now;
+}
+
+static void statsOnScan(uint32_t now) {
+  if (!statsAwaitFirstScan)
+    return;
+  statsAwaitFirstScan = false;
+
+  QuestionStats *qs = statsCurQuestion();
+  if (!qs)
+    return;
+  // Buffered scans (made while the prompt played) count as 0 ms
+  int32_t dt = (int32_t)(now - statsCollectStartedAt);
+  uint32_t ms = dt > 0 ? (uint32_t)dt : 0;
+  size_t b = 0;
+  while (b < SCAN_LATENCY_BUCKETS - 1 && ms >= SCAN_LATENCY_EDGES_MS[b])
+    b++;
+  statInc(qs->firstScanHist[b]);
+}
+
+static void statsOnAnswer(bool correct, bool master) {
+  QuestionStats *qs = statsCurQuestion();
+  if (!qs)
+    return;
+  statInc(qs->attempts);
+  if (master)
+    statInc(qs->master);
+  else if (correct)
+    statInc(qs->correct);
+  else
+    statInc(qs->wrong);
+}
+
+static void statsOnTimeout() {
+  if (QuestionStats *qs = statsCurQuestion())
+    statInc(qs->timeouts);
+}
+
+// The file as bytes; out = nullptr only measures. Under gamesLock.
+static size_t analyticsImage(uint8_t *out) {
+  size_t n = 0;
+  auto put = [&](const void *p, size_t len) {
+    if (out)
+      memcpy(out + n, p, len);
+    n += len;
+  };
+  uint8_t hdr[8] = {'T', 'G', 'A', '1', ANALYTICS_VERSION,
+                    (uint8_t)SCAN_LATENCY_BUCKETS, gameCount, 0};
+  put(hdr, sizeof(hdr));
+  put(SCAN_LATENCY_EDGES_MS, sizeof(SCAN_LATENCY_EDGES_MS));
+
+  for (uint8_t i = 0; i < gameCount; i++) {
+    const GameDef &g = games[i];
+    uint8_t idLen = g.id.length() > 255 ? 255 : (uint8_t)g.id.length();
+    put(&idLen, 1);
+    put(g.id.c_str(), idLen);
+    put(&g.questionCount, 1);
+    put(&gameStats[i].head, sizeof(GameStatsHead));
+    put(gameStats[i].q, sizeof(QuestionStats) * g.questionCount);
+  }
+  return n;
+}
+
+bool analyticsSave(const char *path) {
+  // Copied under the lock, written after: a game start (shuffleQuestions())
+  // never waits for the SD card
+  size_t len;
+  uint8_t *img;
+  {
+    std::lock_guard<std::mutex> lock(gamesLock);
+    len = analyticsImage(nullptr);
+    img = (uint8_t *)memAllocLarge(MEM_GAMES, len);
+    if (!img) {
+      Serial.println("Analytics: out of memory");
+      return false;
+    }
+    analyticsImage(img);
+  }
+
+  std::unique_ptr<HalFile> f =
+      hal.fs->open(ANALYTICS_TMP_PATH, FileMode::WRITE);
+  bool written = f && f->write(img, len) == len;
+  f.reset();
+  memFreeLarge(MEM_GAMES, img);
+  if (!written) {
+    Serial.println("Analytics: could not write temp file");
+    return false;
+  }
+
+  hal.fs->remove(path);
+  if (!hal.fs->rename(ANALYTICS_TMP_PATH, path)) {
+    Serial.println("Analytics: rename failed");
+    return false;
+  }
+  return true;
+}
+
+// Restore cumulative counters; games are matched by id so settings.json may
+// reorder or add games between boots.
+void analyticsLoad(const char *path) {
+  memset(gameStats, 0, sizeof(gameStats));
+
+  std::unique_ptr<HalFile> f = hal.fs->open(path, FileMode::READ);
+  if (!f)
+    return;
+
+  uint8_t hdr[8];
+  uint16_t edges[SCAN_LATENCY_BUCKETS - 1];
+  if (f->read(hdr, sizeof(hdr)) != sizeof(hdr) ||
+      memcmp(hdr, "TGA1", 4) != 0 || hdr[4] != ANALYTICS_VERSION ||
+      hdr[5] != SCAN_LATENCY_BUCKETS ||
+      f->read((uint8_t *)edges, sizeof(edges)) != sizeof(edges) ||
+      memcmp(edges, SCAN_LATENCY_EDGES_MS, sizeof(edges)) != 0) {
+    Serial.println("Analytics: file format changed, starting from zero");
+    return;
+  }
+
+  uint8_t fileGames = hdr[6];
+  uint8_t restored = 0;
+  for (uint8_t n = 0; n < fileGames; n++) {
+    uint8_t idLen = 0, qCount = 0;
+    char id[256];
+    GameStatsHead head;
+    if (f->read(&idLen, 1) != 1 || f->read((uint8_t *)id, idLen) != idLen ||
+        f->read(&qCount, 1) != 1 ||
+        f->read((uint8_t *)&head, sizeof(head)) != sizeof(head))
+      break;
+    id[idLen] = '\0';
+
+    int gi = -1;
+    for (uint8_t i = 0; i < gameCount; i++) {
+      if (games[i].id == id) {
+        gi = i;
+        break;
+      }
+    }
+
+    QuestionStats qs;
+    for (uint8_t q = 0; q < qCount; q++) {
+      if (f->read((uint8_t *)&qs, sizeof(qs)) != sizeof(qs))
+        break;
+      if (gi >= 0 && q < MAX_QUESTIONS)
+        gameStats[gi].q[q] = qs;
+    }
+    if (gi >= 0) {
+      gameStats[gi].head = head;
+      restored++;
+    }
+  }
+  f.reset();
+
+  Serial.print("Analytics restored for games: ");
+  Serial.println(restored);
+}
+
+// ================= GAME ANALYTICS END =================
+
+/// @brief Randomize question ordr
+/// @param g Array to sort
+static void shuffleQuestions(GameDef &g) {
+  if (g.questionCount <= 1)
+    return;
+
+  std::lock_guard<std::mutex> lock(gamesLock);
+  for (int i = g.questionCount - 1; i > 0; i--) {
+    int j = random(i + 1); // 0..i
+    if (i != j) {
+      Question tmp = g.questions[i];
+      g.questions[i] = g.questions[j];
+      g.questions[j] = tmp;
+    }
+  }
+}
+
+static void uiSetGameProgress(int qIndex0, int total) {
+  if (total <= 0) {
+    uiSet(ui.line2, "Spil klar");
+    return;
+  }
+  uiSetf(ui.line3, "Spg %d/%d", qIndex0 + 1, total);
+}
+
+// ---- Utility ----
+static MatchMode parseMode(const char *s) {
+  if (!s)
+    return MatchMode::ANY;
+  if (strcmp(s, "all") == 0)
+    return MatchMode::ALL;
+  return MatchMode::ANY;
+}
+
+static bool hasTag(const PendingCard &c, const String &tag) {
+  for (uint8_t i = 0; i < c.tagCount; i++) {
+    if (c.tags[i] == tag)
+      return true;
+  }
+  return false;
+}
+
+static bool hasTag(const CardEntry &c, const String &tag) {
+  for (uint8_t i = 0; i < c.tagCount; i++) {
+    if (c.tags[i] == tag)
+      return true;
+  }
+  return false;
+}
+
+static bool unionHasTag(const String &unionTags, const String &tag) {
+  // simple contains with delimiters; we use "|tag|" encoding in buildUnionTags
+  String needle = "|" + tag + "|";
+  return unionTags.indexOf(needle) >= 0;
+}
+
+static String buildUnionTags() {
+  // Encode as |tag1||tag2|... to avoid partial matches
+  String u = "";
+  for (uint8_t i = 0; i < pendingCount; i++) {
+    for (uint8_t t = 0; t < pending[i].tagCount; t++) {
+      String enc = "|" + pending[i].tags[t] + "|";
+      if (u.indexOf(enc) < 0)
+        u += enc;
+    }
+  }
+  return u;
+}
+
+static bool allPendingHaveRequiredTags(const AnswerRule &r) {
+  if (r.requireTagCount == 0)
+    return true;
+  for (uint8_t i = 0; i < pendingCount; i++) {
+    for (uint8_t k = 0; k < r.requireTagCount; k++) {
+      if (!hasTag(pending[i], r.requireTags[k]))
+        return false;
+    }
+  }
+  return true;
+}
+
+static bool evalRule(const AnswerRule &r) {
+  if (pendingCount == 0)
+    return false;
+
+  if (r.type == RuleType::REQUIRE_TAGS) {
+    // cards default 1
+    uint8_t need = r.cards ? r.cards : 1;
+    if (pendingCount < need)
+      return false;
+
+    String ut = buildUnionTags();
+
+    if (r.mode == MatchMode::ANY) {
+      for (uint8_t i = 0; i < r.tagCount; i++) {
+        if (unionHasTag(ut, r.tags[i]))
+          return true;
+      }
+      return false;
+    } else { // ALL
+      for (uint8_t i = 0; i < r.tagCount; i++) {
+        if (!unionHasTag(ut, r.tags[i]))
+          return false;
+      }
+      return true;
+    }
+  }
+
+  if (r.type == RuleType::SUM) {
+    uint8_t need = r.cards ? r.cards : 1;
+    if (pendingCount < need)
+      return false;
+
+    if (!allPendingHaveRequiredTags(r))
+      return false;
+
+    int s = 0;
+    for (uint8_t i = 0; i < need; i++) {
+      if (pending[i].value < 0)
+        return false;
+      s += pending[i].value;
+    }
+    return s == r.equals;
+  }
+
+  return false;
+}
+
+static const String &selectCorrectAudio(const GameDef &g, const Question &q) {
+  if (q.audio.correct.length() > 0)
+    return q.audio.correct;
+  return g.audio.correct;
+}
+
+static const String &selectWrongAudio(const GameDef &g, const Question &q) {
+  if (q.audio.wrong.length() > 0)
+    return q.audio.wrong;
+  return g.audio.wrong;
+}
+
+static void clearPending() {
+  pendingCount = 0;
+  nextCardDueAt = 0;
+  nextCardRepeatCount = 0;
+  for (uint8_t i = 0; i < MAX_PENDING; i++) {
+    pending[i].uid = "";
+    pending[i].tagCount = 0;
+    pending[i].value = -1;
+  }
+}
+
+void gameEnterIdle() {
+  gameModeActive = false;
+  activeGameIdx = -1;
+  gameState = GameState::IDLE;
+  questionIdx = 0;
+  doneAnnounced = false;
+  nextCardDueAt = 0; // clearPending() will do this
+  clearPending();
+}
+
+static void uiSetGameLine3(const GameDef &g, int qIdx, const char *suffix) {
+  uiSetf(ui.line3, "Spg %d/%d %s", qIdx + 1, g.questionCount, suffix);
+}
+
+static void uiSetCollectLine3(const GameDef &g, int qIdx, int pending,
+                              int needed) {
+  if (needed <= 1) {
+    uiSetf(ui.line3, "Spg %d/%d - venter", qIdx + 1, g.questionCount);
+  } else {
+    uiSetf(ui.line3, "Spg %d/%d - %d/%d kort", qIdx + 1, g.questionCount,
+           pending, needed);
+  }
+}
+
+void gameStartById(const String &id, const String gameTitel) {
+
+  uiSet(ui.line2, gameTitel.c_str());
+  uiSet(ui.line3, "");
+  // ---------- Stop music / playlist state ----------
+  autoAdvance = false;
+  playlistEnded = false;
+  clearActivePlaylist();
+
+  repeatCount = 0;
+  nextCardRepeatCount = 0;
+  nextCardDueAt = 0;
+
+  // ---------- Hard reset of game runtime ----------
+  doneAnnounced = false; // if you use it
+  nextCardDueAt = 0;
+  clearPending();
+
+  gameModeActive = false;
+  activeGameIdx = -1;
+  questionIdx = 0;
+  gameState = GameState::IDLE;
+
+  // ---------- Find game ----------
+  int idx = -1;
+  for (uint8_t i = 0; i < gameCount; i++) {
+    if (games[i].id == id) {
+      idx = (int)i;
+      break;
+    }
+  }
+
+  if (idx < 0) {
+    Serial.print("Game not found: ");
+    Serial.println(id);
+    return;
+  }
+
+  // ---------- Activate selected game ----------
+  gameModeActive = true;
+  activeGameIdx = idx;
+  statsOnGameStart();
+  shuffleQuestions(games[activeGameIdx]);
+  questionIdx = 0;
+  clearPending();
+
+  const GameDef &g = games[activeGameIdx];
+  uiSetGameLine3(g, questionIdx, ""); // <-- viser "Spg 1/X"
+
+  // ---------- No questions? ----------
+  if (g.questionCount == 0) {
+    Serial.print("Game has no questions: ");
+    Serial.println(g.id);
+    gameState = GameState::DONE;
+    if (g.audio.done.length() > 0) {
+      playPath(g.audio.done);
+    }
+    return;
+  }
+
+  // ---------- Start intro or first prompt ----------
+  if (g.audio.intro.length() > 0) {
+    gameState = GameState::INTRO;
+    Serial.print("Game start (intro): ");
+    Serial.println(g.id);
+    playPath(g.audio.intro);
+  } else {
+    gameState = GameState::PROMPT;
+    Serial.print("Game start (no intro): ");
+    Serial.println(g.id);
+    playPath(g.questions[0].prompt);
+  }
+}
+
+// ---- Answer buffering (scan arrives while a prompt/feedback is playing) ----
+static bool hasBufferedAnswerUid = false;
+static String bufferedAnswerUid = "";
+static uint32_t bufferedAnswerAt = 0;
+static const uint32_t BUFFER_TTL_MS = 5000; // discard efter 5s
+
+static bool lastAnswerWasCorrect = false;
+
+// ================= GAME STATE MACHINE =================
+//
+// Every game transition lives in gameTransitions[] below as a row of
+// {state, event, guard, action, next state}. Rows for the same state/event
+// pair are tried in order, and the first row whose guard passes (or has no
+// guard) wins. The table is checked at compile time: every state must handle
+// every event, and every state/event pair must end with an unguarded row.
+//
+// gameStartById() is the only way into the machine from IDLE (it resets the
+// runtime and picks INTRO/PROMPT/DONE). Everything after that is dispatched.
+// States and events are declared in GameEngine.h.
+
+static constexpr size_t GAME_STATE_COUNT = (size_t)GameState::IDLE_STOP + 1;
+static constexpr size_t GAME_EVENT_COUNT = (size_t)GameEvent::MUSIC_BUTTON + 1;
+
+struct GameEventData {
+  GameEvent type;
+  const CardEntry *card; // only for ANSWER_SCANNED
+  uint32_t now;
+};
+
+typedef bool (*GameGuard)(const GameEventData &e);
+typedef void (*GameAction)(const GameEventData &e);
+
+struct GameTransition {
+  GameState from;
+  GameEvent event;
+  GameGuard guard;   // nullptr = always
+  GameAction action; // nullptr = no side effect
+  GameState to;
+};
+
+// ---- Context helpers (only valid while a game is active) ----
+static GameDef &curGame() { return games[activeGameIdx]; }
+
+static const Question &curQuestion() {
+  return games[activeGameIdx].questions[questionIdx];
+}
+
+static uint8_t curNeed() {
+  uint8_t need = curQuestion().rule.cards ? curQuestion().rule.cards : 1;
+  return need > MAX_PENDING ? (uint8_t)MAX_PENDING : need;
+}
+
+static uint8_t curMaxRepeat() {
+  uint8_t maxRepeat = (uint8_t)curGame().timing.maxRepeat;
+  return maxRepeat < 1 ? 1 : maxRepeat;
+}
+
+// nextCard max = maxRepeat-1, but minimum 1
+static uint8_t curMaxNextCardRepeat() {
+  uint8_t maxRepeat = curMaxRepeat();
+  return (maxRepeat > 1) ? (uint8_t)(maxRepeat - 1) : (uint8_t)1;
+}
+
+// ---- Guards ----
+static bool gIsMasterCard(const GameEventData &e) {
+  return hasTag(*e.card, "master");
+}
+
+static bool gPendingFull(const GameEventData &) {
+  return pendingCount >= curNeed();
+}
+
+static bool gAnswerCompletes(const GameEventData &) {
+  return pendingCount + 1 >= curNeed();
+}
+
+// Multi-card: reject a partial answer early when the card can never be part
+// of a correct combination.
+static bool gAnswerCannotContribute(const GameEventData &e) {
+  const AnswerRule &r = curQuestion().rule;
+  if (r.type == RuleType::REQUIRE_TAGS && r.mode == MatchMode::ALL) {
+    for (uint8_t i = 0; i < r.tagCount; i++) {
+      if (hasTag(*e.card, r.tags[i]))
+        return false;
+    }
+    return true;
+  }
+  if (r.type == RuleType::SUM)
+    return e.card->value < 0;
+  return false;
+}
+
+static bool gHasNextCardAudio(const GameEventData &) {
+  return curGame().audio.nextCardForAnswer.length() > 0;
+}
+
+static bool gHasMusicHint(const GameEventData &) {
+  return curGame().audio.musicHint.length() > 0;
+}
+
+static bool gWaitingNextCard(const GameEventData &) {
+  return pendingCount > 0 && pendingCount < curNeed();
+}
+
+static bool gNextCardExhausted(const GameEventData &e) {
+  return gWaitingNextCard(e) && nextCardRepeatCount >= curMaxNextCardRepeat();
+}
+
+static bool gWaitingNextCardWithAudio(const GameEventData &e) {
+  return gWaitingNextCard(e) && gHasNextCardAudio(e);
+}
+
+// The next repeat of the question would exceed maxRepeat -> stop the game.
+static bool gRepeatLimitReached(const GameEventData &) {
+  return repeatCount + 1 >= curMaxRepeat();
+}
+
+static bool gHasIdleStop(const GameEventData &) {
+  return curGame().audio.idleStop.length() > 0;
+}
+
+static bool gNextCardGiveUp(const GameEventData &e) {
+  return gNextCardExhausted(e) && gRepeatLimitReached(e) && gHasIdleStop(e);
+}
+
+static bool gNextCardGiveUpSilently(const GameEventData &e) {
+  return gNextCardExhausted(e) && gRepeatLimitReached(e);
+}
+
+static bool gNoInputGiveUp(const GameEventData &e) {
+  return pendingCount == 0 && gRepeatLimitReached(e) && gHasIdleStop(e);
+}
+
+static bool gNoInputGiveUpSilently(const GameEventData &e) {
+  return pendingCount == 0 && gRepeatLimitReached(e);
+}
+
+static bool gLastAnswerCorrect(const GameEventData &) {
+  return lastAnswerWasCorrect;
+}
+
+static bool gFinalAnswerCorrect(const GameEventData &) {
+  return lastAnswerWasCorrect && questionIdx + 1 >= curGame().questionCount;
+}
+
+static bool gAllQuestionsDone(const GameEventData &) {
+  return questionIdx >= curGame().questionCount;
+}
+
+// ---- Actions ----
+// Actions never assign gameState; the table already did that.
+
+static void gamePlayCurrentPrompt() {
+  repeatCount = 0;
+  nextCardRepeatCount = 0;
+  nextCardDueAt = 0;
+
+  lastAnswerWasCorrect = false;
+
+  clearPending();
+
+  Serial.print("Prompt q=");
+  Serial.println(questionIdx);
+
+  playPath(curQuestion().prompt);
+}
+
+static void gameConsumeBufferedAnswer(uint32_t now) {
+  if (!hasBufferedAnswerUid)
+    return;
+
+  bool fresh = (uint32_t)(now - bufferedAnswerAt) < BUFFER_TTL_MS;
+  String uid = bufferedAnswerUid;
+  hasBufferedAnswerUid = false;
+  bufferedAnswerUid = "";
+  hal.display->stopCardLedBlink();
+
+  if (!fresh)
+    return;
+  const CardEntry *be = findCardByUid(uid);
+  if (be && be->role == "answer") {
+    gameDispatch(GameEvent::ANSWER_SCANNED, be, now);
+  }
+}
+
+static void actPlayCurrentPrompt(const GameEventData &) {
+  gamePlayCurrentPrompt();
+}
+
+static void actEnterCollect(const GameEventData &e) {
+  clearPending();
+
+  // Do NOT reset repeatCount here; it counts how many times we repeated
+  // prompt due to inactivity.
+  Serial.println("Collecting answers...");
+  uiSetCollectLine3(curGame(), questionIdx, 0, curNeed());
+  statsOnCollectStart(e.now);
+
+  gameConsumeBufferedAnswer(e.now);
+}
+
+static void actResumeCollect(const GameEventData &e) {
+  uiSetCollectLine3(curGame(), questionIdx, pendingCount, curNeed());
+  gameConsumeBufferedAnswer(e.now);
+}
+
+static void actBufferAnswer(const GameEventData &e) {
+  bufferedAnswerUid = e.card->uid;
+  bufferedAnswerAt = e.now;
+  hasBufferedAnswerUid = true;
+  hal.display->blinkCardLed(e.now, 1000);
+}
+
+// -------- MASTER CARD (fail-safe) --------
+// Complete the question right away as correct (regardless of rule)
+static void actMasterAnswer(const GameEventData &) {
+  lastAnswerWasCorrect = true;
+  statsOnAnswer(true, true);
+
+  if (uiMessages.mastercard_used.length() > 0) {
+    playPath(uiMessages.mastercard_used);
+  } else {
+    // fallback hvis ikke sat i JSON
+    playPath(selectCorrectAudio(curGame(), curQuestion()));
+  }
+
+  // ryd pending så vi ikke efterlader state, og stop evt. "next card" flow
+  clearPending();
+}
+
+static void gameStorePending(const CardEntry &card) {
+  PendingCard &p = pending[pendingCount];
+  p.uid = card.uid;
+  p.tagCount = 0;
+  for (uint8_t i = 0; i < card.tagCount && i < MAX_CARD_TAGS; i++) {
+    p.tags[p.tagCount++] = card.tags[i];
+  }
+  p.value = card.value;
+  pendingCount++;
+
+  Serial.print("Collected answer ");
+  Serial.print(pendingCount);
+  Serial.print("/");
+  Serial.println(curNeed());
+}
+
+static void actEvaluateAnswer(const GameEventData &e) {
+  gameStorePending(*e.card);
+
+  const Question &q = curQuestion();
+  lastAnswerWasCorrect = evalRule(q.rule);
+  statsOnAnswer(lastAnswerWasCorrect, false);
+  // correct: advance question after feedback; wrong: repeat same question
+  if (lastAnswerWasCorrect) {
+    playPath(selectCorrectAudio(curGame(), q));
+  } else {
+    playPath(selectWrongAudio(curGame(), q));
+  }
+}
+
+static void actEarlyWrong(const GameEventData &) {
+  lastAnswerWasCorrect = false;
+  statsOnAnswer(false, false);
+  playPath(selectWrongAudio(curGame(), curQuestion()));
+  clearPending();
+}
+
+static void actCollectAndPromptNext(const GameEventData &e) {
+  gameStorePending(*e.card);
+  playPath(curGame().audio.nextCardForAnswer);
+
+  // start timeout for "next card"; the first reminder is the one playing
+  // now, we only count repeats via timeout
+  nextCardDueAt = e.now + curGame().timing.nextCardRepeatMs;
+  nextCardRepeatCount = 0;
+}
+
+static void actCollect(const GameEventData &e) { gameStorePending(*e.card); }
+
+static void actPlayMusicHint(const GameEventData &) {
+  Serial.println("Play music hint");
+  playPath(curGame().audio.musicHint);
+}
+
+static void actReplayPrompt(const GameEventData &) {
+  playPath(curQuestion().prompt);
+}
+
+// Too many "next card" reminders -> repeat the whole question
+static void actRepeatQuestion(const GameEventData &) {
+  repeatCount++;
+  clearPending(); // resets pendingCount, nextCardDueAt, nextCardRepeatCount
+  playPath(curQuestion().prompt);
+}
+
+static void actNextCardReminder(const GameEventData &e) {
+  nextCardRepeatCount++;
+  playPath(curGame().audio.nextCardForAnswer);
+  nextCardDueAt = e.now + curGame().timing.nextCardRepeatMs;
+}
+
+static void actRearmNextCard(const GameEventData &e) {
+  nextCardRepeatCount++;
+  nextCardDueAt = e.now + curGame().timing.nextCardRepeatMs;
+}
+
+// No input -> repeat current question prompt
+static void actRepeatPrompt(const GameEventData &e) {
+  repeatCount++;
+  playPath(curQuestion().prompt);
+  nextCardDueAt = e.now + curGame().timing.answerTimeoutMs;
+}
+
+// Stop game due to inactivity; IDLE_STOP returns to music when it ends
+static void actIdleStop(const GameEventData &) {
+  const GameDef &g = curGame();
+  Serial.print("IdleStop path: ");
+  Serial.println(g.audio.idleStop);
+  Serial.print("Exists: ");
+  PathState known = pathLookup(g.audio.idleStop.c_str());
+  Serial.println(known == PATH_PRESENT   ? "YES"
+                 : known == PATH_MISSING ? "NO"
+                                         : "not checked yet");
+
+  statsOnIdleStop();
+  playPath(g.audio.idleStop);
+}
+
+// Stop game due to inactivity when the game has no idleStop clip
+static void actIdleExit(const GameEventData &) {
+  statsOnIdleStop();
+  gameEnterIdle();
+}
+
+static void actExitGame(const GameEventData &) { gameEnterIdle(); }
+
+static void actNextQuestion(const GameEventData &) {
+  questionIdx++;
+  uiSetGameLine3(curGame(), questionIdx, "");
+  gamePlayCurrentPrompt(); // resets repeatCount for the new question
+}
+
+// Wrong answer: repeat same question. repeatCount is NOT incremented here;
+// it's for inactivity timeouts, not wrong answers
+static void actRetryQuestion(const GameEventData &) {
+  gamePlayCurrentPrompt();
+}
+
+static void actFinishGame(const GameEventData &) {
+  const GameDef &g = curGame();
+  statsOnGameCompleted();
+  questionIdx = g.questionCount;
+  clearPending();
+  repeatCount = 0;
+  uiSet(ui.line2, "");
+  uiSet(ui.line3, "Færdig, vælg nyt spil, eller musik");
+  if (g.audio.done.length() > 0)
+    playPath(g.audio.done);
+}
+
+// Stay in DONE; selector can restart via RFID handler
+static void actDoneWaiting(const GameEventData &) {
+  if (!doneAnnounced) {
+    Serial.println("Game done. Waiting for MUSIC button or a new GAME");
+    doneAnnounced = true;
+  }
+  uiSet(ui.line3, "Vælg nyt spil");
+}
+
+// ---- Transition table ----
+using GS = GameState;
+using GE = GameEvent;
+
+static constexpr GameTransition gameTransitions[] = {
+    // IDLE: the machine is entered through gameStartById()
+    {GS::IDLE, GE::CLIP_ENDED, nullptr, nullptr, GS::IDLE},
+    {GS::IDLE, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::IDLE},
+    {GS::IDLE, GE::MUSIC_SCANNED, nullptr, nullptr, GS::IDLE},
+    {GS::IDLE, GE::TIMEOUT, nullptr, nullptr, GS::IDLE},
+    {GS::IDLE, GE::MUSIC_BUTTON, nullptr, nullptr, GS::IDLE},
+
+    // INTRO: intro clip playing
+    {GS::INTRO, GE::CLIP_ENDED, nullptr, actPlayCurrentPrompt, GS::PROMPT},
+    {GS::INTRO, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::INTRO},
+    {GS::INTRO, GE::MUSIC_SCANNED, gHasMusicHint, actPlayMusicHint, GS::NOTICE},
+    {GS::INTRO, GE::MUSIC_SCANNED, nullptr, nullptr, GS::INTRO},
+    {GS::INTRO, GE::TIMEOUT, nullptr, nullptr, GS::INTRO},
+    {GS::INTRO, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+
+    // PROMPT: question prompt playing
+    {GS::PROMPT, GE::CLIP_ENDED, nullptr, actEnterCollect, GS::COLLECT},
+    {GS::PROMPT, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::PROMPT},
+    {GS::PROMPT, GE::MUSIC_SCANNED, gHasMusicHint, actPlayMusicHint, GS::NOTICE},
+    {GS::PROMPT, GE::MUSIC_SCANNED, nullptr, nullptr, GS::PROMPT},
+    {GS::PROMPT, GE::TIMEOUT, nullptr, nullptr, GS::PROMPT},
+    {GS::PROMPT, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+
+    // COLLECT: waiting for answer cards
+    {GS::COLLECT, GE::CLIP_ENDED, nullptr, nullptr, GS::COLLECT},
+    {GS::COLLECT, GE::ANSWER_SCANNED, gIsMasterCard, actMasterAnswer, GS::FEEDBACK},
+    {GS::COLLECT, GE::ANSWER_SCANNED, gPendingFull, nullptr, GS::COLLECT},
+    {GS::COLLECT, GE::ANSWER_SCANNED, gAnswerCompletes, actEvaluateAnswer, GS::FEEDBACK},
+    {GS::COLLECT, GE::ANSWER_SCANNED, gAnswerCannotContribute, actEarlyWrong, GS::FEEDBACK},
+    {GS::COLLECT, GE::ANSWER_SCANNED, gHasNextCardAudio, actCollectAndPromptNext, GS::NEXT_CARD},
+    {GS::COLLECT, GE::ANSWER_SCANNED, nullptr, actCollect, GS::COLLECT},
+    {GS::COLLECT, GE::MUSIC_SCANNED, gHasMusicHint, actPlayMusicHint, GS::NOTICE},
+    {GS::COLLECT, GE::MUSIC_SCANNED, nullptr, nullptr, GS::COLLECT},
+    {GS::COLLECT, GE::TIMEOUT, gNextCardGiveUp, actIdleStop, GS::IDLE_STOP},
+    {GS::COLLECT, GE::TIMEOUT, gNextCardGiveUpSilently, actIdleExit, GS::IDLE},
+    {GS::COLLECT, GE::TIMEOUT, gNextCardExhausted, actRepeatQuestion, GS::PROMPT},
+    {GS::COLLECT, GE::TIMEOUT, gWaitingNextCardWithAudio, actNextCardReminder, GS::NEXT_CARD},
+    {GS::COLLECT, GE::TIMEOUT, gWaitingNextCard, actRearmNextCard, GS::COLLECT},
+    {GS::COLLECT, GE::TIMEOUT, gNoInputGiveUp, actIdleStop, GS::IDLE_STOP},
+    {GS::COLLECT, GE::TIMEOUT, gNoInputGiveUpSilently, actIdleExit, GS::IDLE},
+    {GS::COLLECT, GE::TIMEOUT, nullptr, actRepeatPrompt, GS::PROMPT},
+    {GS::COLLECT, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+
+    // NEXT_CARD: "scan the next card" reminder playing (multi-card answers)
+    {GS::NEXT_CARD, GE::CLIP_ENDED, nullptr, actResumeCollect, GS::COLLECT},
+    {GS::NEXT_CARD, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::NEXT_CARD},
+    {GS::NEXT_CARD, GE::MUSIC_SCANNED, gHasMusicHint, actPlayMusicHint, GS::NOTICE},
+    {GS::NEXT_CARD, GE::MUSIC_SCANNED, nullptr, nullptr, GS::NEXT_CARD},
+    {GS::NEXT_CARD, GE::TIMEOUT, nullptr, nullptr, GS::NEXT_CARD},
+    {GS::NEXT_CARD, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+
+    // FEEDBACK: correct/wrong clip playing
+    {GS::FEEDBACK, GE::CLIP_ENDED, gFinalAnswerCorrect, actFinishGame, GS::DONE},
+    {GS::FEEDBACK, GE::CLIP_ENDED, gLastAnswerCorrect, actNextQuestion, GS::PROMPT},
+    {GS::FEEDBACK, GE::CLIP_ENDED, nullptr, actRetryQuestion, GS::PROMPT},
+    {GS::FEEDBACK, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::FEEDBACK},
+    {GS::FEEDBACK, GE::MUSIC_SCANNED, gHasMusicHint, actPlayMusicHint, GS::NOTICE},
+    {GS::FEEDBACK, GE::MUSIC_SCANNED, nullptr, nullptr, GS::FEEDBACK},
+    {GS::FEEDBACK, GE::TIMEOUT, nullptr, nullptr, GS::FEEDBACK},
+    {GS::FEEDBACK, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+
+    // NOTICE: music hint playing, then the prompt is replayed
+    {GS::NOTICE, GE::CLIP_ENDED, gAllQuestionsDone, nullptr, GS::DONE},
+    {GS::NOTICE, GE::CLIP_ENDED, nullptr, actReplayPrompt, GS::PROMPT},
+    {GS::NOTICE, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::NOTICE},
+    {GS::NOTICE, GE::MUSIC_SCANNED, gHasMusicHint, actPlayMusicHint, GS::NOTICE},
+    {GS::NOTICE, GE::MUSIC_SCANNED, nullptr, nullptr, GS::NOTICE},
+    {GS::NOTICE, GE::TIMEOUT, nullptr, nullptr, GS::NOTICE},
+    {GS::NOTICE, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+
+    // DONE: all questions answered
+    {GS::DONE, GE::CLIP_ENDED, nullptr, actDoneWaiting, GS::DONE},
+    {GS::DONE, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::DONE},
+    {GS::DONE, GE::MUSIC_SCANNED, gHasMusicHint, actPlayMusicHint, GS::NOTICE},
+    {GS::DONE, GE::MUSIC_SCANNED, nullptr, nullptr, GS::DONE},
+    {GS::DONE, GE::TIMEOUT, nullptr, nullptr, GS::DONE},
+    {GS::DONE, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+
+    // IDLE_STOP: idleStop clip playing, then back to music
+    {GS::IDLE_STOP, GE::CLIP_ENDED, nullptr, actExitGame, GS::IDLE},
+    {GS::IDLE_STOP, GE::ANSWER_SCANNED, nullptr, actBufferAnswer, GS::IDLE_STOP},
+    {GS::IDLE_STOP, GE::MUSIC_SCANNED, nullptr, nullptr, GS::IDLE_STOP},
+    {GS::IDLE_STOP, GE::TIMEOUT, nullptr, nullptr, GS::IDLE_STOP},
+    {GS::IDLE_STOP, GE::MUSIC_BUTTON, nullptr, actExitGame, GS::IDLE},
+};
+
+static constexpr size_t GAME_TRANSITION_COUNT =
+    sizeof(gameTransitions) / sizeof(gameTransitions[0]);
+
+static constexpr size_t gameCellOf(GameState s, GameEvent e) {
+  return (size_t)s * GAME_EVENT_COUNT + (size_t)e;
+}
+
+// First row and row count per state/event cell, built at compile time.
+struct GameCell {
+  uint8_t first;
+  uint8_t count;
+};
+
+struct GameCellTable {
+  GameCell cells[GAME_STATE_COUNT * GAME_EVENT_COUNT];
+};
+
+static constexpr GameCellTable buildGameCells() {
+  GameCellTable t{};
+  for (size_t i = 0; i < GAME_TRANSITION_COUNT; i++) {
+    GameCell &c = t.cells[gameCellOf(gameTransitions[i].from,
+                                     gameTransitions[i].event)];
+    if (c.count == 0)
+      c.first = (uint8_t)i;
+    c.count++;
+  }
+  return t;
+}
+
+static constexpr GameCellTable gameCells = buildGameCells();
+
+static constexpr bool gameTableCoversAllCells() {
+  for (size_t i = 0; i < GAME_STATE_COUNT * GAME_EVENT_COUNT; i++) {
+    if (gameCells.cells[i].count == 0)
+      return false;
+  }
+  return true;
+}
+
+// Rows of one cell must be adjacent, otherwise first/count would skip rows.
+static constexpr bool gameTableCellsContiguous() {
+  for (size_t i = 0; i < GAME_TRANSITION_COUNT; i++) {
+    const GameCell &c = gameCells.cells[gameCellOf(gameTransitions[i].from,
+                                                   gameTransitions[i].event)];
+    if (i < c.first || i >= (size_t)(c.first + c.count))
+      return false;
+  }
+  return true;
+}
+
+// The last row of a cell must be unguarded so every event has an outcome.
+static constexpr bool gameTableCellsEndUnguarded() {
+  for (size_t i = 0; i < GAME_STATE_COUNT * GAME_EVENT_COUNT; i++) {
+    const GameCell &c = gameCells.cells[i];
+    if (c.count > 0 && gameTransitions[c.first + c.count - 1].guard != nullptr)
+      return false;
+  }
+  return true;
+}
+
+static_assert(GAME_TRANSITION_COUNT < 256, "GameCell uses uint8_t indices");
+static_assert(gameTableCoversAllCells(),
+              "gameTransitions: a state is missing a transition for an event");
+static_assert(gameTableCellsContiguous(),
+              "gameTransitions: rows for the same state/event must be adjacent");
+static_assert(gameTableCellsEndUnguarded(),
+              "gameTransitions: last row of each state/event needs no guard");
+
+void gameDispatch(GameEvent ev, const CardEntry *card, uint32_t now) {
+  GameEventData e{ev, card, now};
+  if (ev == GameEvent::ANSWER_SCANNED && gameState == GameState::COLLECT)
+    statsOnScan(now);
+  const GameCell &c = gameCells.cells[gameCellOf(gameState, ev)];
+
+  for (uint8_t i = 0; i < c.count; i++) {
+    const GameTransition &t = gameTransitions[c.first + i];
+    if (t.guard && !t.guard(e))
+      continue;
+    gameState = t.to;
+    if (t.action)
+      t.action(e);
+    return;
+  }
+}
+
+void gameTick(uint32_t now, bool audioIsPlaying) {
+  if (!gameModeActive)
+    return;
+  if (activeGameIdx < 0)
+    return;
+
+  // Only advance when no audio is playing
+  if (audioIsPlaying)
+    return;
+
+  // -------- TIMEOUT HANDLING while COLLECTING --------
+  // We do timeouts only when we are waiting for cards (COLLECT) and no audio is
+  // playing.
+  if (gameState == GameState::COLLECT) {
+    uint32_t t = hal.clock->millis();
+
+    // Arm deadline if not armed yet
+    if (nextCardDueAt == 0) {
+      if (pendingCount == 0) {
+        nextCardDueAt = t + curGame().timing.answerTimeoutMs;
+      } else if (pendingCount < curNeed()) {
+        nextCardDueAt = t + curGame().timing.nextCardRepeatMs;
+      }
+    }
+
+    if (nextCardDueAt != 0 && (int32_t)(t - nextCardDueAt) >= 0) {
+      statsOnTimeout();
+      gameDispatch(GameEvent::TIMEOUT, nullptr, t);
+      return;
+    }
+  }
+
+  gameDispatch(GameEvent::CLIP_ENDED, nullptr, now);
+}
+
+bool gameIsRunning(const String &id) {
+  return gameModeActive && activeGameIdx >= 0 &&
+         games[activeGameIdx].id == id && gameState != GameState::DONE;
+}
+
+// ================= GAME STATE MACHINE END =================
+
+// ---- JSON loading for games[] ----
+// Call this after SD is ready and settings.json exists.
+// It re-opens settings.json and parses only the "games" array.
+// One entry of "games" into a default constructed gd
+static void parseGame(JsonObject g, GameDef &gd) {
+  gd.id = String((const char *)(g["id"] | ""));
+  const char *titel = g["titel"] | "Ingen titel";
+  gd.titel = String(titel);
+  gd.questionCount = 0;
+
+  // audio
+  JsonObject audio = g["audio"].as<JsonObject>();
+  if (!audio.isNull()) {
+    gd.audio.intro = String((const char *)(audio["intro"] | ""));
+    gd.audio.correct = String((const char *)(audio["correct"] | ""));
+    gd.audio.wrong = String((const char *)(audio["wrong"] | ""));
+    gd.audio.done = String((const char *)(audio["done"] | ""));
+    gd.audio.nextCardForAnswer =
+        String((const char *)(audio["nextCardForAnswer"] | ""));
+    gd.audio.musicHint = String((const char *)(audio["musicHint"] | ""));
+    gd.audio.idleStop = String((const char *)(audio["idleStop"] | ""));
+  }
+  /*
+  Serial.print("Game ");
+  Serial.print(gd.id);
+  Serial.print(" idleStop=");
+  Serial.println(gd.audio.idleStop);
+  */
+
+  JsonObject timing = g["timing"].as<JsonObject>();
+  if (!timing.isNull()) {
+    gd.timing.answerTimeoutMs = (uint32_t)(timing["answerTimeoutMs"] | 25000);
+    gd.timing.nextCardRepeatMs =
+        (uint32_t)(timing["nextCardRepeatMs"] | 18000);
+    gd.timing.maxRepeat = (uint32_t)(timing["maxRepeat"] | 3);
+  } else {
+    gd.timing.answerTimeoutMs = 25000;
+    gd.timing.nextCardRepeatMs = 18000;
+    gd.timing.maxRepeat = 3;
+  }
+
+  // questions
+  JsonArray qs = g["questions"].as<JsonArray>();
+  if (!qs.isNull()) {
+    for (JsonObject q : qs) {
+      if (gd.questionCount >= MAX_QUESTIONS)
+        break;
+
+      Question &qq = gd.questions[gd.questionCount];
+      qq.srcIdx = gd.questionCount;
+      qq.prompt = String((const char *)(q["prompt"] | ""));
+
+      // question audio override (optional): audio.correct / audio.wrong
+      JsonObject qa = q["audio"].as<JsonObject>();
+      if (!qa.isNull()) {
+        qq.audio.correct = String((const char *)(qa["correct"] | ""));
+        qq.audio.wrong = String((const char *)(qa["wrong"] | ""));
+      } else {
+        qq.audio.correct = "";
+        qq.audio.wrong = "";
+      }
+
+      // answer rule
+      JsonObject a = q["answer"].as<JsonObject>();
+      AnswerRule &r = qq.rule;
+
+      r.cards = (uint8_t)(a["cards"] | 1);
+
+      const char *type = a["type"] | "requireTags";
+      if (strcmp(type, "requireTags") == 0) {
+        r.type = RuleType::REQUIRE_TAGS;
+        r.mode = parseMode(a["mode"] | "any");
+
+        r.tagCount = 0;
+        JsonArray tags = a["tags"].as<JsonArray>();
+        if (!tags.isNull()) {
+          for (JsonVariant tv : tags) {
+            if (r.tagCount >= MAX_RULE_TAGS)
+              break;
+            r.tags[r.tagCount++] = String(tv.as<const char *>());
+          }
+        }
+      } else if (strcmp(type, "sum") == 0) {
+        r.type = RuleType::SUM;
+        r.equals = (int)(a["equals"] | 0);
+
+        // requireTags for sum (using "tags" field in your schema)
+        r.requireTagCount = 0;
+        JsonArray req = a["tags"].as<JsonArray>();
+        if (!req.isNull()) {
+          for (JsonVariant tv : req) {
+            if (r.requireTagCount >= MAX_RULE_TAGS)
+              break;
+            r.requireTags[r.requireTagCount++] =
+                String(tv.as<const char *>());
+          }
+        }
+      } else {
+        // fallback: treat as requireTags
+        r.type = RuleType::REQUIRE_TAGS;
+        r.mode = MatchMode::ANY;
+        r.tagCount = 0;
+      }
+
+      gd.questionCount++;
+    }
+  }
+
+  Serial.print("Loaded game ");
+  Serial.print(gd.id);
+  Serial.print(" questions=");
+  Serial.println(gd.questionCount);
+}
+
+// ---------------- Reload staging ----------------
+// gamesStage() parses only the games whose JSON changed (or that are new)
+// into PSRAM, gamesCommit() puts them in place. Games that did not change
+// and keep their position are not touched; the counters follow the game id
+// like in analyticsLoad().
+using GameVec = std::vector<GameDef, MemPsramAllocator<GameDef, MEM_GAMES>>;
+
+struct GameStageEntry {
+  int8_t live;   // games[] index with the same id, -1 = new game
+  int8_t def;    // gameStage.defs index, -1 = unchanged (keep games[live])
+  uint32_t hash;
+};
+
+static struct {
+  GameStageEntry e[MAX_GAMES];
+  uint8_t count = 0;
+  GameVec defs;
+  std::vector<GameStats, MemPsramAllocator<GameStats, MEM_GAMES>> stats;
+} gameStage;
+
+static void clearGame(GameDef &g) {
+  g.id = "";
+  g.titel = "";
+  g.audio = GameAudio();
+  g.timing = GameTiming();
+  for (uint8_t q = 0; q < g.questionCount; q++)
+    g.questions[q] = Question();
+  g.questionCount = 0;
+}
+
+void gamesStageFree() {
+  MemScope memScope(MEM_GAMES);
+  gameStage.defs = GameVec();
+  gameStage.stats.clear();
+  gameStage.stats.shrink_to_fit();
+  gameStage.count = 0;
+}
+
+static bool gamesParse(const char *jsonPath, GamesDiff &diff);
+
+bool gamesStage(const char *jsonPath, GamesDiff &diff) {
+  gamesStageFree();
+  try {
+    return gamesParse(jsonPath, diff);
+  } catch (const std::bad_alloc &) {
+    Serial.println("ERROR: out of memory for the games, settings not loaded");
+    gamesStageFree();
+    return false;
+  }
+}
+
+static bool gamesParse(const char *jsonPath, GamesDiff &diff) {
+  MemScope memScope(MEM_GAMES);
+
+  std::unique_ptr<HalFile> f = hal.fs->open(jsonPath, FileMode::READ);
+  if (!f) {
+    Serial.print("Could not open JSON for games: ");
+    Serial.println(jsonPath);
+    return false;
+  }
+
+  // Only "games": the cards (thousands of tracks) are skipped while
+  // parsing, so this document does not grow with the music catalog
+  StaticJsonDocument<32> filter;
+  filter["games"] = true;
+
+  //DynamicJsonDocument doc(16384);
+  BasicJsonDocument<MemJsonAllocator<MEM_JSON>> doc(DOC_SIZE);
+  DeserializationError err =
+      deserializeJson(doc, *f, DeserializationOption::Filter(filter));
+  Serial.println("loadGamesJson");
+  Serial.print("JSON capacity: ");
+  Serial.println(doc.capacity());
+
+  Serial.print("JSON memoryUsage: ");
+  Serial.println(doc.memoryUsage());
+  f.reset();
+  if (err) {
+    Serial.print("Games JSON parse error: ");
+    Serial.println(err.c_str());
+    return false;
+  }
+
+  JsonArray arr = doc["games"].as<JsonArray>();
+  if (arr.isNull()) {
+    Serial.println("JSON missing 'games' array");
+    return false;
+  }
+
+  // Room for every game, so a commit that reorders never allocates
+  gameStage.defs.reserve(MAX_GAMES);
+  gameStage.stats.reserve(MAX_GAMES);
+  diff = GamesDiff{};
+  bool kept[MAX_GAMES] = {};
+  for (JsonObject g : arr) {
+    if (gameStage.count >= MAX_GAMES)
+      break;
+
+    const char *id = g["id"] | "";
+    if (strlen(id) == 0)
+      continue;
+
+    // games[] is only written by gamesCommit(), never while staging
+    GameStageEntry &e = gameStage.e[gameStage.count++];
+    e.hash = jsonHash(g, 0);
+    e.live = -1;
+    e.def = -1;
+    for (uint8_t i = 0; i < gameCount; i++) {
+      if (!kept[i] && games[i].id == id) {
+        e.live = (int8_t)i;
+        kept[i] = true;
+        break;
+      }
+    }
+    if (e.live >= 0 && gameHash[e.live] == e.hash) {
+      diff.unchanged++;
+      continue;
+    }
+    if (e.live >= 0)
+      diff.changed++;
+    else
+      diff.added++;
+    e.def = (int8_t)gameStage.defs.size();
+    gameStage.defs.emplace_back();
+    parseGame(g, gameStage.defs.back());
+  }
+  diff.removed = (uint8_t)(gameCount - diff.changed - diff.unchanged);
+  return true;
+}
+
+static void gamesCommitLocked() {
+  bool inPlace = true;
+  for (uint8_t i = 0; i < gameStage.count; i++) {
+    int8_t live = gameStage.e[i].live;
+    if (live >= 0 && live != i)
+      inPlace = false;
+  }
+
+  if (inPlace) {
+    for (uint8_t i = 0; i < gameStage.count; i++) {
+      const GameStageEntry &e = gameStage.e[i];
+      if (e.def >= 0)
+        games[i] = std::move(gameStage.defs[e.def]);
+      if (e.live < 0)
+        memset(&gameStats[i], 0, sizeof(gameStats[i]));
+    }
+  } else {
+    // Order changed: park the kept games next to the parsed ones, then move
+    // all of them to their new slot
+    for (uint8_t i = 0; i < gameStage.count; i++) {
+      GameStageEntry &e = gameStage.e[i];
+      if (e.def < 0) {
+        e.def = (int8_t)gameStage.defs.size();
+        gameStage.defs.push_back(std::move(games[e.live]));
+      }
+    }
+    gameStage.stats.assign(gameStats, gameStats + gameCount);
+    for (uint8_t i = 0; i < gameStage.count; i++) {
+      const GameStageEntry &e = gameStage.e[i];
+      games[i] = std::move(gameStage.defs[e.def]);
+      if (e.live >= 0)
+        gameStats[i] = gameStage.stats[e.live];
+      else
+        memset(&gameStats[i], 0, sizeof(gameStats[i]));
+    }
+  }
+
+  for (uint8_t i = gameStage.count; i < gameCount; i++) {
+    clearGame(games[i]);
+    memset(&gameStats[i], 0, sizeof(gameStats[i]));
+  }
+  for (uint8_t i = 0; i < gameStage.count; i++)
+    gameHash[i] = gameStage.e[i].hash;
+  gameCount = gameStage.count;
+}
+
+bool gamesCommit() {
+  std::unique_lock<std::mutex> lock(gamesLock, std::try_to_lock);
+  if (!lock.owns_lock())
+    return false;
+  gamesCommitLocked();
+  analyticsDirty = true; // the file follows the new set of games
+  return true;
+}
+
+bool loadGamesJson(const char *jsonPath) {
+  {
+    // A load parses every game (also the ones that did not change)
+    std::lock_guard<std::mutex> lock(gamesLock);
+    for (uint8_t i = 0; i < gameCount; i++)
+      clearGame(games[i]);
+    gameCount = 0;
+  }
+  GamesDiff diff;
+  bool ok = gamesStage(jsonPath, diff);
+  if (ok) {
+    std::lock_guard<std::mutex> lock(gamesLock);
+    gamesCommitLocked();
+  }
+  gamesStageFree();
+  Serial.print("Total games loaded: ");
+  Serial.println(gameCount);
+  return ok;
+}
+
+uint8_t gamesLoaded() { return gameCount; }
+
+void gamesForEachPath(const std::function<void(const char *path)> &fn) {
+  std::lock_guard<std::mutex> lock(gamesLock);
+  for (uint8_t i = 0; i < gameCount; i++) {
+    const GameDef &g = games[i];
+    const GameAudio &a = g.audio;
+    for (const String *s : {&a.intro, &a.correct, &a.wrong, &a.done,
+                            &a.nextCardForAnswer, &a.musicHint, &a.idleStop})
+      fn(s->c_str());
+    for (uint8_t q = 0; q < g.questionCount; q++) {
+      const Question &qq = g.questions[q];
+      fn(qq.prompt.c_str());
+      fn(qq.audio.correct.c_str());
+      fn(qq.audio.wrong.c_str());
+    }
+  }
+}
+
+size_t questionsLoaded() {
+  size_t n = 0;
+  for (uint8_t i = 0; i < gameCount; i++)
+    n += games[i].questionCount;
+  return n;
+}
+
+// ================= GAME ENGINE END ===================
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "hal/Hal.h"
+
+struct CardEntry;
+
+// Question games from settings.json ("games"): loading, the game state
+// machine and per question analytics. Driven from the loop context by
+// gameTick() and gameDispatch().
+
+// NEXT_CARD: "next card" reminder, NOTICE: music hint, IDLE_STOP: idleStop
+// clip before returning to music. See gameTransitions[].
+enum class GameState : uint8_t {
+  IDLE,
+  INTRO,
+  PROMPT,
+  COLLECT,
+  NEXT_CARD,
+  FEEDBACK,
+  NOTICE,
+  DONE,
+  IDLE_STOP
+};
+
+enum class GameEvent : uint8_t {
+  CLIP_ENDED,     // no audio playing (sent every gameTick while idle)
+  ANSWER_SCANNED, // answer card scanned (card set)
+  MUSIC_SCANNED,  // music card scanned while a game is running
+  TIMEOUT,        // nextCardDueAt passed while collecting
+  MUSIC_BUTTON    // music mode button pressed
+};
+
+extern volatile bool gameModeActive;
+extern GameState gameState;
+
+// Parses every game (boot)
+bool loadGamesJson(const char *jsonPath);
+
+// ---- Reload (SettingsReload.h) ----
+// Games compared by id and the hash of their JSON
+struct GamesDiff {
+  uint8_t added;
+  uint8_t changed;
+  uint8_t removed;
+  uint8_t unchanged;
+};
+
+// Parses the changed and new games next to the loaded ones, from any task.
+// False on a parse error (nothing to commit).
+bool gamesStage(const char *jsonPath, GamesDiff &diff);
+// Loop only, while no game runs (gameState IDLE). False while
+// analyticsSave() is writing: try again later.
+bool gamesCommit();
+// Frees the staged games; any task, not while a stage waits for its commit
+void gamesStageFree();
+// Games and questions kept by the last loadGamesJson()
+uint8_t gamesLoaded();
+size_t questionsLoaded();
+// Every clip of the loaded games (also ""), for the path cache (PathCache.h)
+void gamesForEachPath(const std::function<void(const char *path)> &fn);
+
+void gameEnterIdle();
+void gameStartById(const String &id, const String gameTitel);
+void gameDispatch(GameEvent ev, const CardEntry *card = nullptr,
+                  uint32_t now = hal.clock->millis());
+void gameTick(uint32_t now, bool audioIsPlaying);
+
+// The game with this id runs and is not finished yet
+bool gameIsRunning(const String &id);
+
+// ---- Analytics (see GAME ANALYTICS in GameEngine.cpp) ----
+static constexpr const char *ANALYTICS_PATH = "/analytics.bin";
+static constexpr uint32_t ANALYTICS_FLUSH_MS = 30000;
+
+extern volatile bool analyticsDirty;
+
+bool analyticsSave(const char *path);
+void analyticsLoad(const char *path);
@@ -0,0 +1,446 @@
+#include "LibraryIndex.h"
+
+#include <Arduino.h>
+
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "MemTrack.h"
+#include "Mp3Seek.h"
+#include "TextPool.h"
+#include "hal/Hal.h"
+
+static constexpr const char *LIBRARY_TMP_PATH = "/library.tmp";
+static constexpr const char *LIBRARY_MAGIC = "TLI1";
+static constexpr size_t LIBRARY_TEXT_CHUNK = 16 * 1024;
+static constexpr size_t LIBRARY_WALK_CHUNK = 4 * 1024;
+static constexpr size_t LIBRARY_LINE_MAX = 512;
+static constexpr size_t LIBRARY_PATH_MAX = 256;
+// Unchanged files are only a map lookup: compare this many per step
+static constexpr size_t LIBRARY_COMPARE_PER_STEP = 32;
+// Seek table frame scan (VBR without a seek header): bytes per step
+static constexpr size_t LIBRARY_SCAN_STEP_BYTES = 64 * 1024;
+
+// Texts in libText. 'seen' is only used by the indexer.
+struct LibEntry {
+  const char *title;
+  const char *artist;
+  const char *album;
+  uint32_t size;
+  uint32_t mtime;
+  uint32_t durationMs;
+  bool seen; // found in this walk
+};
+
+using LibMap =
+    std::unordered_map<std::string_view, LibEntry, std::hash<std::string_view>,
+                       std::equal_to<std::string_view>,
+                       MemPsramAllocator<std::pair<const std::string_view,
+                                                   LibEntry>,
+                                         MEM_INDEX>>;
+template <class T>
+using LibVec = std::vector<T, MemPsramAllocator<T, MEM_INDEX>>;
+
+// Only the indexer changes libMap and libText. It takes libLock for every
+// change and reads without it; libraryLookup() (loop) always locks.
+static LibMap libMap;
+static TextPool libText(MEM_INDEX, LIBRARY_TEXT_CHUNK);
+static std::mutex libLock;
+
+// ---- Walk state (indexer only) ----
+enum LibState : uint8_t {
+  LIB_LOAD,
+  LIB_LIST,
+  LIB_FILES,
+  LIB_SCAN, // frame scan of the file just read, then back to LIB_FILES
+  LIB_SAVE,
+  LIB_DONE
+};
+
+struct LibPending {
+  const char *path; // libFileText
+  uint32_t size;
+  uint32_t mtime;
+};
+
+static LibState libState = LIB_LOAD;
+static LibVec<const char *> libDirs; // folders still to list (libDirText)
+// Folders whose listing failed or dropped entries: files under them were not
+// seen and must not be pruned
+static LibVec<const char *> libUnlisted;
+static TextPool libDirText(MEM_INDEX, LIBRARY_WALK_CHUNK);
+static LibVec<LibPending> libFiles; // .mp3 files of the listed folder
+static TextPool libFileText(MEM_INDEX, LIBRARY_WALK_CHUNK);
+static size_t libNextFile = 0;
+static bool libRootListed = false;
+static bool libDirty = false;
+static Mp3SeekTable libSeek;
+static Mp3FrameScan libScan;
+static const char *libScanPath = nullptr; // in libFileText
+
+static uint32_t libWalkStartMs = 0;
+static uint32_t libWalkMs = 0;
+static uint32_t libFilesSeen = 0;
+static uint32_t libFilesRead = 0;
+static uint32_t libFilesFailed = 0;
+static uint32_t libFilesRemoved = 0;
+static uint32_t libSeekScans = 0;
+
+// old: the text the entry has now (nullptr for a new entry), kept when the
+// file still has it. libText is append-only: a tag that did change leaves
+// its old text behind until the next boot, which loads the index anew.
+static const char *libKeep(const char *s, const char *old) {
+  if (old && strcmp(old, s) == 0)
+    return old;
+  const char *p = libText.add(s);
+  return p ? p : "";
+}
+
+static void libPut(const char *path, uint32_t size, uint32_t mtime,
+                   uint32_t durationMs, const char *title, const char *artist,
+                   const char *album, bool seen) {
+  auto it = libMap.find(std::string_view(path));
+  // A re-read file (size or date changed) mostly has the same tags
+  const LibEntry *old = it != libMap.end() ? &it->second : nullptr;
+  LibEntry e{libKeep(title, old ? old->title : nullptr),
+             libKeep(artist, old ? old->artist : nullptr),
+             libKeep(album, old ? old->album : nullptr),
+             size,
+             mtime,
+             durationMs,
+             seen};
+  if (old) {
+    std::lock_guard<std::mutex> lock(libLock);
+    it->second = e;
+    return;
+  }
+  const char *key = libText.add(path);
+  if (!key)
+    return;
+  std::lock_guard<std::mutex> lock(libLock);
+  libMap.emplace(std::string_view(key), e);
+}
+
+bool libraryLookup(const char *path, TrackInfo &out) {
+  std::lock_guard<std::mutex> lock(libLock);
+  auto it = libMap.find(std::string_view(path));
+  if (it == libMap.end())
+    return false;
+  const LibEntry &e = it->second;
+  strncpy(out.title, e.title, sizeof(out.title) - 1);
+  out.title[sizeof(out.title) - 1] = '\0';
+  strncpy(out.artist, e.artist, sizeof(out.artist) - 1);
+  out.artist[sizeof(out.artist) - 1] = '\0';
+  strncpy(out.album, e.album, sizeof(out.album) - 1);
+  out.album[sizeof(out.album) - 1] = '\0';
+  out.durationMs = e.durationMs;
+  return true;
+}
+
+// ---------------- Index file ----------------
+// Text, one file per line after the "TLI1" line:
+//   size \t mtime \t duration_ms \t path \t title \t artist \t album
+// Tags never contain tabs or line breaks (TrackTags turns them into spaces).
+
+static void libLoadLine(char *line) {
+  char *field[7];
+  size_t n = 0;
+  field[n++] = line;
+  for (char *p = line; *p && n < 7; p++) {
+    if (*p == '\t') {
+      *p = '\0';
+      field[n++] = p + 1;
+    }
+  }
+  if (n != 7 || field[3][0] != '/')
+    return;
+  libPut(field[3], (uint32_t)strtoul(field[0], nullptr, 10),
+         (uint32_t)strtoul(field[1], nullptr, 10),
+         (uint32_t)strtoul(field[2], nullptr, 10), field[4], field[5],
+         field[6], false);
+}
+
+static void libLoad() {
+  std::unique_ptr<HalFile> f = hal.fs->open(LIBRARY_INDEX_PATH, FileMode::READ);
+  if (!f) {
+    Serial.println("Library: no index yet, reading all tags");
+    return;
+  }
+
+  static char line[LIBRARY_LINE_MAX];
+  uint8_t buf[512];
+  size_t len = 0;
+  bool tooLong = false;
+  bool header = true;
+  size_t n;
+  while ((n = f->read(buf, sizeof(buf))) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      char c = (char)buf[i];
+      if (c != '\n') {
+        if (len < sizeof(line) - 1)
+          line[len++] = c;
+        else
+          tooLong = true;
+        continue;
+      }
+      line[len] = '\0';
+      if (header) {
+        if (strcmp(line, LIBRARY_MAGIC) != 0) {
+          Serial.println("Library: index format changed, reading all tags");
+          return;
+        }
+        header = false;
+      } else if (!tooLong) {
+        libLoadLine(line);
+      }
+      len = 0;
+      tooLong = false;
+    }
+  }
+  Serial.printf("Library: %u files in the index\n", (unsigned)libMap.size());
+}
+
+static bool libSave() {
+  std::unique_ptr<HalFile> f = hal.fs->open(LIBRARY_TMP_PATH, FileMode::WRITE);
+  if (!f) {
+    Serial.println("Library: could not open temp file");
+    return false;
+  }
+
+  char line[LIBRARY_LINE_MAX];
+  int n = snprintf(line, sizeof(line), "%s\n", LIBRARY_MAGIC);
+  f->write((const uint8_t *)line, (size_t)n);
+  for (const auto &kv : libMap) {
+    const LibEntry &e = kv.second;
+    n = snprintf(line, sizeof(line), "%u\t%u\t%u\t%.*s\t%s\t%s\t%s\n",
+                 (unsigned)e.size, (unsigned)e.mtime, (unsigned)e.durationMs,
+                 (int)kv.first.size(), kv.first.data(), e.title, e.artist,
+                 e.album);
+    if (n > 0 && (size_t)n < sizeof(line))
+      f->write((const uint8_t *)line, (size_t)n);
+  }
+  f.reset();
+
+  hal.fs->remove(LIBRARY_INDEX_PATH);
+  if (!hal.fs->rename(LIBRARY_TMP_PATH, LIBRARY_INDEX_PATH)) {
+    Serial.println("Library: rename failed");
+    return false;
+  }
+  return true;
+}
+
+// ---------------- Walk ----------------
+static bool isMp3Name(const char *name) {
+  size_t n = strlen(name);
+  return n > 4 && strcasecmp(name + n - 4, ".mp3") == 0;
+}
+
+static void libListNext() {
+  const char *dir = libDirs.back();
+  libDirs.pop_back();
+  libFiles.clear();
+  libFileText.clear();
+  libNextFile = 0;
+
+  bool complete = true;
+  bool ok = hal.fs->listDir(dir, [&](const DirEntry &e) {
+    if (e.name[0] == '.')
+      return; // hidden, incl. macOS "._x.mp3"
+    char path[LIBRARY_PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/%s", dir, e.name);
+    if (n <= 0 || (size_t)n >= sizeof(path) || strpbrk(path, "\t\n"))
+      return;
+    // Out of memory drops the entry (not thrown through listDir())
+    try {
+      if (e.isDir) {
+        const char *p = libDirText.add(path, (size_t)n);
+        if (p)
+          libDirs.push_back(p);
+        else
+          complete = false;
+      } else if (isMp3Name(e.name)) {
+        const char *p = libFileText.add(path, (size_t)n);
+        if (p)
+          libFiles.push_back(LibPending{p, e.size, e.mtime});
+        else
+          complete = false;
+      }
+    } catch (const std::bad_alloc &) {
+      complete = false;
+    }
+  });
+  if (!ok || !complete) {
+    Serial.printf("Library: could not list %s, keeping its files\n", dir);
+    libUnlisted.push_back(dir);
+  }
+  if (ok && strcmp(dir, LIBRARY_ROOT) == 0)
+    libRootListed = true;
+}
+
+static void libReadFile(const LibPending &p) {
+  std::unique_ptr<HalFile> f = hal.fs->open(p.path, FileMode::READ);
+  if (!f) {
+    libFilesFailed++; // tried again on the next walk
+    return;
+  }
+  TrackTags t;
+  // No tags: stored empty, so not read every boot
+  readTrackTags(*f, p.path, t, &libSeek);
+  f.reset();
+  libFilesRead++;
+  libPut(p.path, p.size, p.mtime, t.durationMs, t.title, t.artist, t.album,
+         true);
+  libDirty = true;
+
+  if (libSeek.source == SEEK_ESTIMATE && libScan.begin(p.path, libSeek)) {
+    libSeekScans++;
+    libScanPath = p.path;
+    libState = LIB_SCAN;
+  }
+}
+
+// The length from the frame count is exact, the one from the first frames of
+// a VBR file was only an estimate
+static void libScanDone() {
+  uint32_t ms = libScan.durationMs();
+  auto it = libMap.find(std::string_view(libScanPath));
+  if (ms && it != libMap.end()) {
+    std::lock_guard<std::mutex> lock(libLock);
+    it->second.durationMs = ms;
+  }
+  libScanPath = nullptr;
+}
+
+static void libFilesStep() {
+  if (libNextFile >= libFiles.size()) {
+    libState = LIB_LIST;
+    return;
+  }
+  for (size_t n = 0;
+       n < LIBRARY_COMPARE_PER_STEP && libNextFile < libFiles.size(); n++) {
+    const LibPending &p = libFiles[libNextFile++];
+    libFilesSeen++;
+    auto it = libMap.find(std::string_view(p.path));
+    if (it != libMap.end() && it->second.size == p.size &&
+        it->second.mtime == p.mtime) {
+      it->second.seen = true;
+      continue;
+    }
+    libReadFile(p); // the only SD read of this step
+    break;
+  }
+}
+
+// Path is in dir or below it
+static bool libUnder(std::string_view path, const char *dir) {
+  size_t n = strlen(dir);
+  return path.size() > n && path[n] == '/' && path.compare(0, n, dir) == 0;
+}
+
+static bool libInUnlisted(std::string_view path) {
+  for (const char *dir : libUnlisted) {
+    if (libUnder(path, dir))
+      return true;
+  }
+  return false;
+}
+
+static void libPrune() {
+  std::lock_guard<std::mutex> lock(libLock);
+  for (auto it = libMap.begin(); it != libMap.end();) {
+    if (it->second.seen || libInUnlisted(it->first)) {
+      ++it;
+      continue;
+    }
+    it = libMap.erase(it);
+    libFilesRemoved++;
+    libDirty = true;
+  }
+}
+
+static bool libStep() {
+  switch (libState) {
+  case LIB_LOAD:
+    libLoad();
+    libWalkStartMs = millis();
+    libDirs.push_back(LIBRARY_ROOT);
+    libState = LIB_LIST;
+    return true;
+
+  case LIB_LIST:
+    if (libDirs.empty()) {
+      libState = LIB_SAVE;
+      return true;
+    }
+    libListNext();
+    libState = LIB_FILES;
+    return true;
+
+  case LIB_FILES:
+    libFilesStep();
+    return true;
+
+  case LIB_SCAN:
+    if (libScan.step(LIBRARY_SCAN_STEP_BYTES))
+      return true;
+    libScanDone();
+    libState = LIB_FILES;
+    return true;
+
+  case LIB_SAVE:
+    // Without /audio (SD trouble) keep the old index as it is
+    if (libRootListed) {
+      libPrune();
+      if (libDirty && libSave())
+        libDirty = false;
+    }
+    libDirs = LibVec<const char *>();
+    libUnlisted = LibVec<const char *>();
+    libFiles = LibVec<LibPending>();
+    libDirText.clear();
+    libFileText.clear();
+    libWalkMs = millis() - libWalkStartMs;
+    libState = LIB_DONE;
+    libraryIndexReport();
+    return false;
+
+  case LIB_DONE:
+  default:
+    return false;
+  }
+}
+
+bool libraryIndexStep() {
+  try {
+    return libStep();
+  } catch (const std::bad_alloc &) {
+    // Lookups keep what is indexed so far; the next boot tries again
+    Serial.println("Library: out of memory, indexing stopped");
+    libScan.cancel();
+    libDirs = LibVec<const char *>();
+    libUnlisted = LibVec<const char *>();
+    libFiles = LibVec<LibPending>();
+    libDirText.clear();
+    libFileText.clear();
+    libState = LIB_DONE;
+    return false;
+  }
+}
+
+void libraryIndexReport() {
+  size_t entries;
+  {
+    std::lock_guard<std::mutex> lock(libLock);
+    entries = libMap.size();
+  }
+  bool done = libState == LIB_DONE;
+  Serial.printf("Library: %s, %u files indexed (%u KB text), walk: %u seen, "
+                "%u read, %u failed, %u removed, %u seek scans, %u ms\n",
+                done ? "up to date" : "indexing", (unsigned)entries,
+                (unsigned)(libText.bytes() / 1024), (unsigned)libFilesSeen,
+                (unsigned)libFilesRead, (unsigned)libFilesFailed,
+                (unsigned)libFilesRemoved, (unsigned)libSeekScans,
+                (unsigned)(done ? libWalkMs : millis() - libWalkStartMs));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "TrackTags.h"
+
+// ================= LIBRARY INDEX =================
+// ID3 title, artist, album and length of every .mp3 under LIBRARY_ROOT. The
+// index lives in PSRAM and in LIBRARY_INDEX_PATH on the SD card; a file is
+// only read again when its size or date changed, files that are gone are
+// dropped. libraryIndexStep() does one small piece of work (load the saved
+// index, list one folder, read the tags of one changed file, scan a piece of
+// a VBR file for its seek table (Mp3Seek.h), save) so the firmware runs it
+// from a low priority task; libraryLookup() is for the loop, never touches
+// the SD card and is O(1).
+static constexpr const char *LIBRARY_ROOT = "/audio";
+static constexpr const char *LIBRARY_INDEX_PATH = "/library.idx";
+
+struct TrackInfo {
+  char title[TRACK_TAG_MAX];
+  char artist[TRACK_TAG_MAX];
+  char album[TRACK_TAG_MAX];
+  uint32_t durationMs; // 0 = unknown
+};
+
+// Copy of the entry for path; false if the file is not (yet) indexed
+bool libraryLookup(const char *path, TrackInfo &out);
+
+// One step of the walk; false once the index is up to date and saved
+bool libraryIndexStep();
+
+// "library" on the serial monitor
+void libraryIndexReport();
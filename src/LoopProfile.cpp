@@ -0,0 +1,139 @@
+#include <Arduino.h>
+
+#include "LoopProfile.h"
+#include "hal/Hal.h"
+
+#if LOOP_PROFILE_ENABLED
+static constexpr uint32_t PROF_BUDGET_US_DEFAULT = 10000;
+static constexpr uint32_t PROF_WARN_GAP_MS = 1000;
+static constexpr uint32_t PROF_EDGES_US[] = {2,    5,    10,   20,    50,
+                                             100,  200,  500,  1000,  2000,
+                                             5000, 10000, 20000, 50000};
+static constexpr size_t PROF_BUCKETS =
+    sizeof(PROF_EDGES_US) / sizeof(PROF_EDGES_US[0]) + 1;
+
+static const char *const PROF_STAGE_NAMES[LS_COUNT] = {
+    "led",  "buttons", "ui",      "game", "advance",
+    "volume", "rfid",  "console", "power"};
+
+// Times in ns: the cycle rate follows the CPU clock (power manager), so
+// every sample is converted with the rate of its own loop
+struct ProfHist {
+  uint32_t count;
+  uint32_t minNs;
+  uint32_t maxNs;
+  uint64_t sumNs;
+  uint16_t buckets[PROF_BUCKETS];
+};
+
+// Row LS_COUNT is the whole loop
+static ProfHist profHist[LS_COUNT + 1];
+static uint32_t profLoopStart = 0;
+static uint32_t profLast = 0;
+static uint32_t profPerUs = 1;
+static bool profActive = false;
+static uint32_t profStageNs[LS_COUNT]; // this iteration, for the warning
+static uint32_t profBudgetUs = PROF_BUDGET_US_DEFAULT;
+static uint32_t profOverBudget = 0;
+static uint32_t profWarnMs = 0;
+static uint32_t profWarnSkipped = 0;
+
+static inline uint32_t profNs(uint32_t cycles) {
+  return (uint32_t)((uint64_t)cycles * 1000 / profPerUs);
+}
+
+static void profAdd(ProfHist &h, uint32_t ns) {
+  size_t b = 0;
+  while (b < PROF_BUCKETS - 1 && ns >= PROF_EDGES_US[b] * 1000)
+    b++;
+  if (h.buckets[b] < 0xFFFF)
+    h.buckets[b]++;
+  if (h.count == 0 || ns < h.minNs)
+    h.minNs = ns;
+  if (ns > h.maxNs)
+    h.maxNs = ns;
+  h.count++;
+  h.sumNs += ns;
+}
+
+void profBegin() {
+  profPerUs = hal.clock->cyclesPerUs();
+  if (profPerUs == 0)
+    profPerUs = 1;
+  for (auto &ns : profStageNs)
+    ns = 0;
+  profActive = true;
+  profLoopStart = profLast = hal.clock->cycles();
+}
+
+void profMark(LoopStage s) {
+  if (!profActive)
+    return;
+  uint32_t c = hal.clock->cycles();
+  uint32_t ns = profNs(c - profLast);
+  profLast = c;
+  profStageNs[s] = ns;
+  profAdd(profHist[s], ns);
+}
+
+void profEnd(uint32_t nowMs) {
+  if (!profActive)
+    return;
+  profActive = false;
+  uint32_t ns = profNs(hal.clock->cycles() - profLoopStart);
+  profAdd(profHist[LS_COUNT], ns);
+  if (ns / 1000 <= profBudgetUs)
+    return;
+
+  profOverBudget++;
+  if (profWarnMs != 0 && nowMs - profWarnMs < PROF_WARN_GAP_MS) {
+    profWarnSkipped++;
+    return;
+  }
+  profWarnMs = nowMs ? nowMs : 1;
+
+  uint8_t worst = 0;
+  for (uint8_t s = 1; s < LS_COUNT; s++) {
+    if (profStageNs[s] > profStageNs[worst])
+      worst = s;
+  }
+  Serial.printf("PROF loop %u us > budget %u us, %s %u us",
+                (unsigned)(ns / 1000), (unsigned)profBudgetUs,
+                PROF_STAGE_NAMES[worst], (unsigned)(profStageNs[worst] / 1000));
+  if (profWarnSkipped)
+    Serial.printf(" (+%u more)", (unsigned)profWarnSkipped);
+  Serial.println();
+  profWarnSkipped = 0;
+}
+
+void profDump() {
+  Serial.printf("Loop profile: budget %u us, over budget %u times (us; "
+                "buckets <2,5,10,20,50,100,200,500us,1,2,5,10,20,50ms,more)\n",
+                (unsigned)profBudgetUs, (unsigned)profOverBudget);
+  for (uint8_t s = 0; s <= LS_COUNT; s++) {
+    const ProfHist &h = profHist[s];
+    if (h.count == 0)
+      continue;
+    Serial.printf("  %-8s n=%-8u min=%-6.1f avg=%-6.1f max=%-8.1f |",
+                  s == LS_COUNT ? "LOOP" : PROF_STAGE_NAMES[s],
+                  (unsigned)h.count, h.minNs / 1000.0f,
+                  (float)(h.sumNs / h.count) / 1000.0f, h.maxNs / 1000.0f);
+    for (auto b : h.buckets)
+      Serial.printf(" %u", (unsigned)b);
+    Serial.println();
+  }
+}
+
+void profReset() {
+  memset(profHist, 0, sizeof(profHist));
+  profOverBudget = 0;
+  profWarnSkipped = 0;
+  Serial.println("Loop profile reset");
+}
+
+void profSetBudgetUs(uint32_t us) {
+  profBudgetUs = us;
+  Serial.printf("Loop budget %u us\n", (unsigned)us);
+}
+
+#endif // LOOP_PROFILE_ENABLED
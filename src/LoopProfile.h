@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================= LOOP PROFILER =================
+// Times every stage of loop() with the CPU cycle counter (hal.clock). A
+// stage is charged the cycles since the previous PROF_MARK (or PROF_BEGIN);
+// PROF_END books the whole iteration and warns on the serial port when it
+// ran longer than the budget (at most one warning per second). The idle
+// wait at the end of loop() is not part of it. Per stage and for the whole
+// loop: count, min/avg/max and a histogram. "prof" on the serial port
+// prints them, "prof reset" clears them, "prof budget <us>" sets the
+// budget. A probe costs one cycle counter read, a divide and a bucket
+// search, so it stays on in normal builds; -DLOOP_PROFILE_ENABLED=0
+// compiles the probes out. Loop context only.
+#ifndef LOOP_PROFILE_ENABLED
+#define LOOP_PROFILE_ENABLED 1
+#endif
+
+enum LoopStage : uint8_t {
+  LS_LED,      // ledTick
+  LS_BUTTONS,  // handleButtonEvents
+  LS_UI,       // uiPublish
+  LS_GAME,     // gameTick
+  LS_ADVANCE,  // auto-advance after a track ended
+  LS_VOLUME,   // maybeSaveVolume
+  LS_RFID,     // settings reload commit, card lookup and actions
+  LS_CONSOLE,  // scan trace, stats, serial commands
+  LS_POWER,    // LED reset, powerTick
+  LS_COUNT
+};
+
+#if LOOP_PROFILE_ENABLED
+void profBegin();
+void profMark(LoopStage s);
+void profEnd(uint32_t nowMs);
+void profDump();
+void profReset();
+void profSetBudgetUs(uint32_t us);
+
+#define PROF_BEGIN() profBegin()
+#define PROF_MARK(stage) profMark(stage)
+#define PROF_END(nowMs) profEnd(nowMs)
+#else
+#define PROF_BEGIN() ((void)0)
+#define PROF_MARK(stage) ((void)0)
+#define PROF_END(nowMs) ((void)0)
+#endif
@@ -0,0 +1,132 @@
+#include "MemTrack.h"
+
+#include <Arduino.h>
+
+#include <atomic>
+
+struct MemSlot {
+  std::atomic<int32_t> current{0};
+  std::atomic<int32_t> peak{0};
+  std::atomic<uint32_t> allocs{0};
+  std::atomic<uint32_t> frees{0};
+};
+
+static MemSlot memSlots[MEM_TAG_COUNT][MEM_REGION_COUNT];
+// Sum of tracked bytes over all tags, so MemScope can leave them out
+static std::atomic<int32_t> memTrackedTotal[MEM_REGION_COUNT];
+
+static const char *const MEM_TAG_NAMES[MEM_TAG_COUNT] = {
+    "catalog", "games", "playlist", "audio", "ui", "json", "index"};
+static const char *const MEM_REGION_NAMES[MEM_REGION_COUNT] = {"internal",
+                                                               "psram"};
+
+const char *memTagName(MemTag tag) {
+  return tag < MEM_TAG_COUNT ? MEM_TAG_NAMES[tag] : "?";
+}
+
+static void memAdd(MemSlot &s, int32_t delta) {
+  int32_t now = s.current.fetch_add(delta) + delta;
+  int32_t peak = s.peak.load();
+  while (now > peak && !s.peak.compare_exchange_weak(peak, now)) {
+  }
+}
+
+void memTrackAlloc(MemTag tag, void *p) {
+  if (!hal.heap || !p)
+    return;
+  MemRegion r = hal.heap->regionOf(p);
+  int32_t size = (int32_t)hal.heap->blockSize(p);
+  MemSlot &s = memSlots[tag][r];
+  s.allocs++;
+  memTrackedTotal[r] += size;
+  memAdd(s, size);
+}
+
+void memTrackFree(MemTag tag, void *p) {
+  if (!hal.heap || !p)
+    return;
+  MemRegion r = hal.heap->regionOf(p);
+  int32_t size = (int32_t)hal.heap->blockSize(p);
+  MemSlot &s = memSlots[tag][r];
+  s.frees++;
+  memTrackedTotal[r] -= size;
+  memAdd(s, -size);
+}
+
+void *memAllocLarge(MemTag tag, size_t bytes) {
+  void *p = hal.heap ? hal.heap->allocLarge(bytes) : malloc(bytes);
+  memTrackAlloc(tag, p);
+  return p;
+}
+
+void memFreeLarge(MemTag tag, void *p) {
+  if (!p)
+    return;
+  memTrackFree(tag, p);
+  free(p);
+}
+
+MemCounters memCounters(MemTag tag, MemRegion region) {
+  const MemSlot &s = memSlots[tag][region];
+  return MemCounters{s.current.load(), s.peak.load(), s.allocs.load(),
+                     s.frees.load()};
+}
+
+void memResetPeaks() {
+  for (auto &tag : memSlots) {
+    for (MemSlot &s : tag)
+      s.peak = s.current.load();
+  }
+}
+
+MemScope::MemScope(MemTag tag) : tag_(tag) {
+  for (uint8_t r = 0; r < MEM_REGION_COUNT; r++) {
+    used_[r] = hal.heap ? hal.heap->region((MemRegion)r).usedBytes : 0;
+    tracked_[r] = memTrackedTotal[r].load();
+  }
+}
+
+MemScope::~MemScope() {
+  if (!hal.heap)
+    return;
+  for (uint8_t r = 0; r < MEM_REGION_COUNT; r++) {
+    int32_t grown =
+        (int32_t)(hal.heap->region((MemRegion)r).usedBytes - used_[r]);
+    int32_t tracked = memTrackedTotal[r].load() - tracked_[r];
+    if (grown != tracked)
+      memAdd(memSlots[tag_][r], grown - tracked);
+  }
+}
+
+void memReport() {
+  Serial.println("MEM tag       region       current      peak  allocs   frees");
+  for (uint8_t t = 0; t < MEM_TAG_COUNT; t++) {
+    for (uint8_t r = 0; r < MEM_REGION_COUNT; r++) {
+      MemCounters c = memCounters((MemTag)t, (MemRegion)r);
+      if (c.current == 0 && c.peak == 0 && c.allocs == 0)
+        continue;
+      Serial.printf("MEM %-9s %-9s %10ld %9ld %7lu %7lu\n",
+                    memTagName((MemTag)t), MEM_REGION_NAMES[r],
+                    (long)c.current, (long)c.peak, (unsigned long)c.allocs,
+                    (unsigned long)c.frees);
+    }
+  }
+
+  if (!hal.heap)
+    return;
+  for (uint8_t r = 0; r < MEM_REGION_COUNT; r++) {
+    HeapRegionInfo h = hal.heap->region((MemRegion)r);
+    if (h.totalBytes == 0)
+      continue;
+    // Fragmentation: share of the free heap outside the largest free block
+    unsigned frag = h.freeBytes
+                        ? (unsigned)(100 - h.largestFreeBlock * 100 / h.freeBytes)
+                        : 0;
+    Serial.printf("MEM heap %-9s total %u used %u free %u min_free %u "
+                  "largest %u frag %u%%\n",
+                  MEM_REGION_NAMES[r], (unsigned)h.totalBytes,
+                  (unsigned)h.usedBytes, (unsigned)h.freeBytes,
+                  (unsigned)h.minFreeBytes, (unsigned)h.largestFreeBlock,
+                  frag);
+  }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <new>
+#include <utility>
+
+#include "hal/Hal.h"
+
+// Heap accounting per subsystem, internal RAM and PSRAM counted apart.
+// "mem" on the serial monitor prints it (memReport), "mem reset" sets the
+// peaks back to the current values.
+//
+// Two kinds of bookings:
+//  - Tracked blocks (MemJsonAllocator, MemStdAllocator, memNew): exact
+//    bytes plus alloc/free counts.
+//  - MemScope: the net heap growth of a piece of code that allocates
+//    through something we cannot tag (String buffers, task stacks, library
+//    buffers). Whatever other tasks allocate meanwhile ends up in it too,
+//    so these bytes are approximate.
+// Nothing is booked until hal.heap is set.
+
+enum MemTag : uint8_t {
+  MEM_CATALOG,  // cards, track pool, meta maps
+  MEM_GAMES,    // games[], analytics
+  MEM_PLAYLIST, // activeTracks
+  MEM_AUDIO,    // decoder, file source, I2S output, audioTask
+  MEM_UI,       // OLED task
+  MEM_JSON,     // settings.json documents while loading
+  MEM_INDEX,    // library index (ID3 tags of /audio)
+  MEM_TAG_COUNT
+};
+
+struct MemCounters {
+  int32_t current; // bytes
+  int32_t peak;
+  uint32_t allocs;
+  uint32_t frees;
+};
+
+const char *memTagName(MemTag tag);
+
+// Book a block right after allocating / right before freeing it
+void memTrackAlloc(MemTag tag, void *p);
+void memTrackFree(MemTag tag, void *p);
+
+// Long-lived bulk blocks from hal.heap->allocLarge (PSRAM when present),
+// booked to tag. nullptr when out of memory.
+void *memAllocLarge(MemTag tag, size_t bytes);
+void memFreeLarge(MemTag tag, void *p);
+
+MemCounters memCounters(MemTag tag, MemRegion region);
+void memResetPeaks();
+void memReport();
+
+class MemScope {
+public:
+  explicit MemScope(MemTag tag);
+  ~MemScope();
+  MemScope(const MemScope &) = delete;
+  MemScope &operator=(const MemScope &) = delete;
+
+private:
+  MemTag tag_;
+  size_t used_[MEM_REGION_COUNT];
+  int32_t tracked_[MEM_REGION_COUNT];
+};
+
+// ArduinoJson allocator: BasicJsonDocument<MemJsonAllocator<MEM_JSON>>
+template <MemTag TAG> struct MemJsonAllocator {
+  void *allocate(size_t n) {
+    void *p = malloc(n);
+    if (p)
+      memTrackAlloc(TAG, p);
+    return p;
+  }
+  void deallocate(void *p) {
+    if (!p)
+      return;
+    memTrackFree(TAG, p);
+    free(p);
+  }
+  void *reallocate(void *p, size_t n) {
+    if (p)
+      memTrackFree(TAG, p);
+    void *q = realloc(p, n);
+    if (q || p)
+      memTrackAlloc(TAG, q ? q : p); // failed: p is still ours
+    return q;
+  }
+};
+
+// Allocator for std containers
+template <class T, MemTag TAG> struct MemStdAllocator {
+  using value_type = T;
+  template <class U> struct rebind {
+    using other = MemStdAllocator<U, TAG>;
+  };
+
+  MemStdAllocator() = default;
+  template <class U> MemStdAllocator(const MemStdAllocator<U, TAG> &) {}
+
+  T *allocate(size_t n) {
+    void *p = ::operator new(n * sizeof(T));
+    memTrackAlloc(TAG, p);
+    return static_cast<T *>(p);
+  }
+  void deallocate(T *p, size_t) {
+    memTrackFree(TAG, p);
+    ::operator delete(p);
+  }
+
+  template <class U> bool operator==(const MemStdAllocator<U, TAG> &) const {
+    return true;
+  }
+  template <class U> bool operator!=(const MemStdAllocator<U, TAG> &) const {
+    return false;
+  }
+};
+
+// Same, for big containers that should live in PSRAM (memAllocLarge). Out of
+// memory throws std::bad_alloc: whoever fills such a container catches it
+// and gives up cleanly (loaders keep the old tables), like a nullptr from
+// TextPool::add().
+template <class T, MemTag TAG> struct MemPsramAllocator {
+  using value_type = T;
+  template <class U> struct rebind {
+    using other = MemPsramAllocator<U, TAG>;
+  };
+
+  MemPsramAllocator() = default;
+  template <class U> MemPsramAllocator(const MemPsramAllocator<U, TAG> &) {}
+
+  T *allocate(size_t n) {
+    void *p = memAllocLarge(TAG, n * sizeof(T));
+    if (!p)
+      throw std::bad_alloc();
+    return static_cast<T *>(p);
+  }
+  void deallocate(T *p, size_t) { memFreeLarge(TAG, p); }
+
+  template <class U> bool operator==(const MemPsramAllocator<U, TAG> &) const {
+    return true;
+  }
+  template <class U> bool operator!=(const MemPsramAllocator<U, TAG> &) const {
+    return false;
+  }
+};
+
+template <MemTag TAG, class T, class... Args> T *memNew(Args &&...args) {
+  T *p = new T(std::forward<Args>(args)...);
+  memTrackAlloc(TAG, p);
+  return p;
+}
+
+template <MemTag TAG, class T> void memDelete(T *p) {
+  if (!p)
+    return;
+  memTrackFree(TAG, p);
+  delete p;
+}
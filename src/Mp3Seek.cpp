@@ -0,0 +1,479 @@
+#include "Mp3Seek.h"
+
+#include <Arduino.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+static constexpr size_t ID3V1_BYTES = 128;
+static constexpr size_t CBR_CHECK_FRAMES = 8; // frames compared for CBR
+// Frame scan: offset of every SEEK_SCAN_MARK_FRAMES-th frame is kept
+static constexpr uint32_t SEEK_SCAN_MARK_FRAMES = 32;
+// Junk passed over before the scan gives up
+static constexpr uint32_t SEEK_SCAN_SKIP_MAX = 64 * 1024;
+static constexpr const char *SEEK_CACHE_MAGIC = "SKT1";
+
+static uint32_t syncsafe32(const uint8_t *b) {
+  return ((uint32_t)(b[0] & 0x7F) << 21) | ((uint32_t)(b[1] & 0x7F) << 14) |
+         ((uint32_t)(b[2] & 0x7F) << 7) | (b[3] & 0x7F);
+}
+
+static uint32_t be32(const uint8_t *b) {
+  return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+         ((uint32_t)b[2] << 8) | b[3];
+}
+
+static uint16_t be16(const uint8_t *b) {
+  return (uint16_t)(((uint16_t)b[0] << 8) | b[1]);
+}
+
+// ---------------- MPEG frames ----------------
+static const uint16_t BITRATES_V1[3][15] = {
+    {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}};
+static const uint16_t BITRATES_V2[3][15] = {
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}};
+static const uint32_t SAMPLE_RATES_V1[3] = {44100, 48000, 32000};
+
+bool parseMp3FrameHeader(const uint8_t *h, Mp3FrameHeader &out) {
+  if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+    return false;
+  uint8_t ver = (h[1] >> 3) & 3;   // 0 = 2.5, 1 = reserved, 2 = 2, 3 = 1
+  uint8_t layer = (h[1] >> 1) & 3; // 1 = III, 2 = II, 3 = I
+  uint8_t brIdx = h[2] >> 4;
+  uint8_t srIdx = (h[2] >> 2) & 3;
+  if (ver == 1 || layer == 0 || brIdx == 0 || brIdx == 15 || srIdx == 3)
+    return false;
+
+  out.version = ver == 3 ? 1 : ver == 2 ? 2 : 25;
+  out.layer = 4 - layer;
+  out.mono = (h[3] >> 6) == 3;
+  out.crc = (h[1] & 1) == 0;
+  const uint16_t(*bitrates)[15] = ver == 3 ? BITRATES_V1 : BITRATES_V2;
+  out.bitrateKbps = bitrates[out.layer - 1][brIdx];
+  out.sampleRate = SAMPLE_RATES_V1[srIdx] >> (ver == 3 ? 0 : ver == 2 ? 1 : 2);
+  uint32_t pad = (h[2] >> 1) & 1;
+  uint32_t br = out.bitrateKbps * 1000u;
+
+  if (out.layer == 1) {
+    out.samplesPerFrame = 384;
+    out.frameBytes = (12 * br / out.sampleRate + pad) * 4;
+  } else if (out.layer == 2 || out.version == 1) {
+    out.samplesPerFrame = 1152;
+    out.frameBytes = 144 * br / out.sampleRate + pad;
+  } else {
+    out.samplesPerFrame = 576;
+    out.frameBytes = 72 * br / out.sampleRate + pad;
+  }
+  return out.frameBytes > 4;
+}
+
+static uint32_t framesToMs(uint32_t frames, const Mp3FrameHeader &h) {
+  return (uint32_t)((uint64_t)frames * h.samplesPerFrame * 1000 /
+                    h.sampleRate);
+}
+
+// ---------------- Table ----------------
+const char *seekSourceName(SeekSource s) {
+  switch (s) {
+  case SEEK_XING:
+    return "xing";
+  case SEEK_VBRI:
+    return "vbri";
+  case SEEK_CBR:
+    return "cbr";
+  case SEEK_ESTIMATE:
+    return "estimate";
+  case SEEK_SCAN:
+    return "scan";
+  case SEEK_NONE:
+  default:
+    return "none";
+  }
+}
+
+static void fillLinear(Mp3SeekTable &t, uint32_t first) {
+  uint64_t bytes = t.audioEnd - first;
+  for (size_t i = 0; i <= SEEK_POINTS; i++)
+    t.offset[i] = first + (uint32_t)(bytes * i / SEEK_POINTS);
+}
+
+// Xing TOC: toc[i] = position at i % of the length, in 1/256 of the bytes
+static void fillXing(Mp3SeekTable &t, uint32_t first, uint32_t bytes,
+                     const uint8_t *toc) {
+  for (size_t i = 0; i < SEEK_POINTS; i++)
+    t.offset[i] = first + (uint32_t)((uint64_t)toc[i] * bytes / 256);
+  t.offset[SEEK_POINTS] = t.audioEnd;
+}
+
+// VBRI: byte size of every framesPerEntry frames from the first frame on
+static bool fillVbri(Mp3SeekTable &t, uint32_t first, uint32_t frames,
+                     const uint8_t *v, const uint8_t *end) {
+  uint16_t entries = be16(v + 18);
+  uint16_t scale = be16(v + 20);
+  uint16_t entryBytes = be16(v + 22);
+  uint16_t perEntry = be16(v + 24);
+  const uint8_t *toc = v + 26;
+  if (!entries || !perEntry || !entryBytes || entryBytes > 4 ||
+      toc + (size_t)entries * entryBytes > end)
+    return false;
+
+  auto entrySize = [&](uint32_t e) {
+    uint32_t n = 0;
+    for (uint16_t b = 0; b < entryBytes; b++)
+      n = (n << 8) | toc[e * entryBytes + b];
+    return n * scale;
+  };
+  uint32_t k = 0;               // entry
+  uint32_t kPos = first;        // offset of frame k * perEntry
+  uint32_t kSize = entrySize(0); // bytes of entry k
+  for (size_t i = 0; i < SEEK_POINTS; i++) {
+    uint32_t f = (uint32_t)((uint64_t)frames * i / SEEK_POINTS);
+    while (k + 1 < entries && f >= (k + 1) * perEntry) {
+      kPos += kSize;
+      kSize = entrySize(++k);
+    }
+    uint32_t in = f - k * perEntry;
+    if (in > perEntry)
+      in = perEntry;
+    t.offset[i] = kPos + (uint32_t)((uint64_t)kSize * in / perEntry);
+  }
+  t.offset[SEEK_POINTS] = t.audioEnd;
+  return true;
+}
+
+static void seekCachePath(const char *path, char *out, size_t size) {
+  // FNV-1a of the path
+  uint32_t h = 2166136261u;
+  for (const char *p = path; *p; p++)
+    h = (h ^ (uint8_t)*p) * 16777619u;
+  snprintf(out, size, "%s/%08x.tbl", SEEK_CACHE_DIR, (unsigned)h);
+}
+
+struct SeekCacheFile {
+  char magic[4];
+  uint32_t fileSize;
+  uint32_t durationMs;
+  uint32_t audioStart;
+  uint32_t audioEnd;
+  uint32_t offset[SEEK_POINTS + 1];
+};
+
+static bool seekCacheLoad(const char *path, uint32_t fileSize,
+                          Mp3SeekTable &t) {
+  if (!path || !hal.fs)
+    return false;
+  char cachePath[40];
+  seekCachePath(path, cachePath, sizeof(cachePath));
+  std::unique_ptr<HalFile> f = hal.fs->open(cachePath, FileMode::READ);
+  SeekCacheFile c;
+  if (!f || f->read((uint8_t *)&c, sizeof(c)) != sizeof(c) ||
+      memcmp(c.magic, SEEK_CACHE_MAGIC, 4) != 0 || c.fileSize != fileSize ||
+      c.audioStart != t.audioStart || c.audioEnd != t.audioEnd)
+    return false;
+  t.source = SEEK_SCAN;
+  t.durationMs = c.durationMs;
+  memcpy(t.offset, c.offset, sizeof(t.offset));
+  return true;
+}
+
+// VBR encoders often start on one bitrate (silence), so also look at a frame
+// in the middle before a file is taken for CBR. Reuses buf.
+static bool midBitrateIs(HalFile &f, uint32_t pos, uint32_t audioEnd,
+                         uint16_t kbps, uint8_t *buf) {
+  if (!f.seek(pos))
+    return true;
+  size_t n = f.read(buf, std::min<size_t>(audioEnd - pos, SEEK_SCRATCH_BYTES));
+  for (size_t i = 0; i + 4 <= n; i++) {
+    Mp3FrameHeader h;
+    Mp3FrameHeader next;
+    if (!parseMp3FrameHeader(buf + i, h) || i + h.frameBytes + 4 > n ||
+        !parseMp3FrameHeader(buf + i + h.frameBytes, next))
+      continue;
+    return h.bitrateKbps == kbps && next.bitrateKbps == kbps;
+  }
+  return true; // no frame found: keep what the start said
+}
+
+bool mp3SeekBuildAt(HalFile &f, const char *path, uint32_t audioStart,
+                    uint32_t audioEnd, Mp3SeekTable &t, uint8_t *buf) {
+  memset(&t, 0, sizeof(t));
+  t.audioStart = audioStart;
+  t.audioEnd = audioEnd;
+  if (audioEnd <= audioStart || !f.seek(audioStart))
+    return false;
+  size_t n = f.read(buf, std::min<size_t>(audioEnd - audioStart,
+                                          SEEK_SCRATCH_BYTES));
+
+  for (size_t i = 0; i + 4 <= n; i++) {
+    Mp3FrameHeader h;
+    if (!parseMp3FrameHeader(buf + i, h))
+      continue;
+    // A second header right after the first, so a stray 0xFF is no sync
+    Mp3FrameHeader next;
+    if (i + h.frameBytes + 4 <= n &&
+        !parseMp3FrameHeader(buf + i + h.frameBytes, next))
+      continue;
+
+    uint32_t first = audioStart + (uint32_t)i;
+    const uint8_t *end = buf + n;
+    size_t side = h.version == 1 ? (h.mono ? 17 : 32) : (h.mono ? 9 : 17);
+    const uint8_t *x = buf + i + 4 + (h.crc ? 2 : 0) + side;
+    const uint8_t *v = buf + i + 4 + 32;
+
+    // Xing ("Info" when the encoder ran CBR)
+    if (x + 8 <= end &&
+        (memcmp(x, "Xing", 4) == 0 || memcmp(x, "Info", 4) == 0)) {
+      uint32_t flags = be32(x + 4);
+      const uint8_t *p = x + 8;
+      uint32_t frames = 0;
+      uint32_t bytes = audioEnd - first;
+      if ((flags & 1) && p + 4 <= end) {
+        frames = be32(p);
+        p += 4;
+      }
+      if ((flags & 2) && p + 4 <= end) {
+        if (be32(p) > 0 && be32(p) <= bytes)
+          bytes = be32(p);
+        p += 4;
+      }
+      if (frames) {
+        t.durationMs = framesToMs(frames, h);
+        if ((flags & 4) && p + SEEK_POINTS <= end) {
+          t.source = SEEK_XING;
+          fillXing(t, first, bytes, p);
+          return true;
+        }
+        // Length known, no TOC: a line is exact for CBR only
+        t.source = memcmp(x, "Info", 4) == 0 ? SEEK_CBR : SEEK_ESTIMATE;
+        fillLinear(t, first);
+        if (t.source == SEEK_ESTIMATE)
+          seekCacheLoad(path, (uint32_t)f.size(), t);
+        return true;
+      }
+    }
+
+    if (v + 26 <= end && memcmp(v, "VBRI", 4) == 0 && be32(v + 14)) {
+      uint32_t frames = be32(v + 14);
+      t.durationMs = framesToMs(frames, h);
+      if (fillVbri(t, first, frames, v, end)) {
+        t.source = SEEK_VBRI;
+        return true;
+      }
+      t.source = SEEK_ESTIMATE;
+      fillLinear(t, first);
+      seekCacheLoad(path, (uint32_t)f.size(), t);
+      return true;
+    }
+
+    // No header: CBR if the frames read agree on the bitrate
+    bool cbr = true;
+    uint32_t seen = 0;
+    uint32_t seenBytes = 0;
+    for (size_t p = i; seen < CBR_CHECK_FRAMES && p + 4 <= n;) {
+      Mp3FrameHeader fh;
+      if (!parseMp3FrameHeader(buf + p, fh))
+        break;
+      if (fh.bitrateKbps != h.bitrateKbps)
+        cbr = false;
+      seen++;
+      seenBytes += fh.frameBytes;
+      p += fh.frameBytes;
+    }
+    if (cbr)
+      cbr = midBitrateIs(f, first + (audioEnd - first) / 2, audioEnd,
+                         h.bitrateKbps, buf);
+    fillLinear(t, first);
+    uint32_t frames = (uint32_t)((uint64_t)(audioEnd - first) * seen /
+                                 (seenBytes ? seenBytes : 1));
+    t.durationMs = framesToMs(frames, h);
+    t.source = cbr ? SEEK_CBR : SEEK_ESTIMATE;
+    if (!cbr)
+      seekCacheLoad(path, (uint32_t)f.size(), t);
+    return true;
+  }
+  return false;
+}
+
+bool mp3SeekBuild(HalFile &f, const char *path, Mp3SeekTable &t,
+                  uint8_t *buf) {
+  uint32_t fileSize = (uint32_t)f.size();
+  uint32_t start = 0;
+  uint8_t h[10];
+  if (f.seek(0) && f.read(h, sizeof(h)) == sizeof(h) &&
+      memcmp(h, "ID3", 3) == 0)
+    start = 10 + syncsafe32(h + 6) + ((h[5] & 0x10) ? 10 : 0);
+
+  uint32_t end = fileSize;
+  if (fileSize >= start + ID3V1_BYTES && f.seek(fileSize - ID3V1_BYTES) &&
+      f.read(h, 3) == 3 && memcmp(h, "TAG", 3) == 0)
+    end -= ID3V1_BYTES;
+  return mp3SeekBuildAt(f, path, start, end, t, buf);
+}
+
+uint32_t mp3SeekOffset(const Mp3SeekTable &t, uint32_t ms) {
+  if (t.durationMs == 0)
+    return t.offset[0];
+  if (ms >= t.durationMs)
+    return t.offset[SEEK_POINTS];
+  uint64_t x = (uint64_t)ms * SEEK_POINTS;
+  uint32_t i = (uint32_t)(x / t.durationMs);
+  uint32_t rem = (uint32_t)(x % t.durationMs);
+  uint32_t span = t.offset[i + 1] - t.offset[i];
+  return t.offset[i] + (uint32_t)((uint64_t)span * rem / t.durationMs);
+}
+
+uint32_t mp3SeekTimeMs(const Mp3SeekTable &t, uint32_t offset) {
+  if (t.durationMs == 0 || offset <= t.offset[0])
+    return 0;
+  if (offset >= t.offset[SEEK_POINTS])
+    return t.durationMs;
+  // Last point at or before offset
+  const uint32_t *p =
+      std::upper_bound(t.offset, t.offset + SEEK_POINTS + 1, offset) - 1;
+  uint32_t i = (uint32_t)(p - t.offset);
+  uint32_t span = p[1] - p[0];
+  uint64_t x = (uint64_t)i * t.durationMs;
+  if (span)
+    x += (uint64_t)(offset - p[0]) * t.durationMs / span;
+  return (uint32_t)(x / SEEK_POINTS);
+}
+
+// ---------------- Frame scan ----------------
+bool Mp3FrameScan::begin(const char *path, const Mp3SeekTable &estimate) {
+  cancel();
+  if (estimate.source != SEEK_ESTIMATE || strlen(path) >= sizeof(path_))
+    return false;
+  file_ = hal.fs->open(path, FileMode::READ);
+  if (!file_)
+    return false;
+  buf_ = (uint8_t *)memAllocLarge(MEM_INDEX, SEEK_SCRATCH_BYTES);
+  if (!buf_) {
+    file_.reset();
+    return false;
+  }
+  strcpy(path_, path);
+  fileSize_ = (uint32_t)file_->size();
+  audioStart_ = estimate.audioStart;
+  audioEnd_ = estimate.audioEnd;
+  pos_ = estimate.offset[0];
+  bufPos_ = 0;
+  bufLen_ = 0;
+  frames_ = 0;
+  skipped_ = 0;
+  samplesPerFrame_ = 0;
+  sampleRate_ = 0;
+  durationMs_ = 0;
+  marks_.clear();
+  return true;
+}
+
+void Mp3FrameScan::cancel() {
+  file_.reset();
+  memFreeLarge(MEM_INDEX, buf_);
+  buf_ = nullptr;
+  marks_ = decltype(marks_)();
+}
+
+// Header at pos from the buffer, refilled when pos is outside it. The
+// first frame sets the format; a header in another format later on is junk
+// that happens to look like sync.
+bool Mp3FrameScan::loadHeader(uint32_t pos, Mp3FrameHeader &h) {
+  if (pos < bufPos_ || pos + 4 > bufPos_ + bufLen_) {
+    bufPos_ = pos;
+    bufLen_ = file_->seek(pos) ? (uint32_t)file_->read(buf_, SEEK_SCRATCH_BYTES)
+                               : 0;
+    if (bufLen_ < 4)
+      return false;
+  }
+  if (!parseMp3FrameHeader(buf_ + (pos - bufPos_), h))
+    return false;
+  if (frames_ == 0) {
+    sampleRate_ = h.sampleRate;
+    samplesPerFrame_ = h.samplesPerFrame;
+  }
+  return h.sampleRate == sampleRate_ && h.samplesPerFrame == samplesPerFrame_;
+}
+
+// Next frame header after a broken one, searched in the buffer
+bool Mp3FrameScan::resync() {
+  if (bufLen_ < 4)
+    return false;
+  uint32_t bufEnd = bufPos_ + bufLen_;
+  uint32_t p = pos_ + 1;
+  for (; p + 4 <= bufEnd; p++) {
+    Mp3FrameHeader h;
+    if (parseMp3FrameHeader(buf_ + (p - bufPos_), h) &&
+        h.sampleRate == sampleRate_ && h.samplesPerFrame == samplesPerFrame_)
+      break;
+  }
+  skipped_ += p - pos_;
+  pos_ = p;
+  return skipped_ <= SEEK_SCAN_SKIP_MAX;
+}
+
+bool Mp3FrameScan::step(size_t maxBytes) {
+  if (!file_)
+    return false;
+  uint32_t until = pos_ + (uint32_t)maxBytes;
+  while (pos_ + 4 <= audioEnd_ && pos_ < until) {
+    Mp3FrameHeader h;
+    if (!loadHeader(pos_, h)) {
+      if (frames_ == 0 || !resync()) {
+        Serial.printf("Seek scan: %s gave up at %u\n", path_,
+                      (unsigned)pos_);
+        cancel();
+        return false;
+      }
+      continue;
+    }
+    if (frames_ % SEEK_SCAN_MARK_FRAMES == 0)
+      marks_.push_back(pos_);
+    frames_++;
+    pos_ += h.frameBytes;
+  }
+  if (pos_ + 4 <= audioEnd_)
+    return true;
+  finish();
+  cancel();
+  return false;
+}
+
+void Mp3FrameScan::finish() {
+  if (frames_ == 0 || marks_.empty())
+    return;
+  SeekCacheFile c;
+  memcpy(c.magic, SEEK_CACHE_MAGIC, 4);
+  c.fileSize = fileSize_;
+  c.audioStart = audioStart_;
+  c.audioEnd = audioEnd_;
+  c.durationMs = (uint32_t)((uint64_t)frames_ * samplesPerFrame_ * 1000 /
+                            sampleRate_);
+  durationMs_ = c.durationMs;
+  for (size_t i = 0; i < SEEK_POINTS; i++) {
+    uint32_t f = (uint32_t)((uint64_t)frames_ * i / SEEK_POINTS);
+    size_t k = f / SEEK_SCAN_MARK_FRAMES;
+    uint32_t a = marks_[k];
+    uint32_t b = k + 1 < marks_.size() ? marks_[k + 1] : audioEnd_;
+    c.offset[i] = a + (uint32_t)((uint64_t)(b - a) *
+                                 (f % SEEK_SCAN_MARK_FRAMES) /
+                                 SEEK_SCAN_MARK_FRAMES);
+  }
+  c.offset[SEEK_POINTS] = audioEnd_;
+
+  char cachePath[40];
+  seekCachePath(path_, cachePath, sizeof(cachePath));
+  hal.fs->mkdir(SEEK_CACHE_DIR);
+  std::unique_ptr<HalFile> f = hal.fs->open(cachePath, FileMode::WRITE);
+  if (!f || f->write((const uint8_t *)&c, sizeof(c)) != sizeof(c)) {
+    Serial.printf("Seek scan: cannot write %s\n", cachePath);
+    return;
+  }
+  Serial.printf("Seek scan: %s, %u frames, %u ms\n", path_,
+                (unsigned)frames_, (unsigned)c.durationMs);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "MemTrack.h"
+#include "hal/Hal.h"
+
+// ================= MP3 SEEK TABLE =================
+// Byte offset of the audio at SEEK_POINTS + 1 evenly spaced times, so a seek
+// is one division and one interpolation wherever the target lies. Built from
+// the first frame: the Xing/Info TOC, the VBRI table, or (no header, same
+// bitrate in every frame read) a straight CBR line. VBR files without a
+// header get an estimate from the first frames until Mp3FrameScan has read
+// every frame header once; its table is cached under SEEK_CACHE_DIR and used
+// from then on.
+
+// ---- MPEG audio frame header ----
+struct Mp3FrameHeader {
+  uint8_t version; // 1, 2 or 25 (MPEG 2.5)
+  uint8_t layer;   // 1..3
+  bool mono;
+  bool crc;        // 16 bit CRC after the header
+  uint16_t bitrateKbps;
+  uint32_t sampleRate;
+  uint16_t samplesPerFrame;
+  uint32_t frameBytes;
+};
+
+// h[0..3] from the file; false for no sync, reserved or free-format values
+bool parseMp3FrameHeader(const uint8_t *h, Mp3FrameHeader &out);
+
+// ---- Seek table ----
+static constexpr size_t SEEK_POINTS = 100;
+static constexpr const char *SEEK_CACHE_DIR = "/.seek";
+static constexpr size_t SEEK_SCRATCH_BYTES = 4096; // buf for mp3SeekBuild
+
+enum SeekSource : uint8_t {
+  SEEK_NONE,     // no MPEG audio found
+  SEEK_XING,     // Xing/Info TOC
+  SEEK_VBRI,     // VBRI table
+  SEEK_CBR,      // constant bitrate
+  SEEK_ESTIMATE, // VBR, no header and no cache yet: needs a scan
+  SEEK_SCAN      // from the frame scan cache
+};
+
+struct Mp3SeekTable {
+  SeekSource source;
+  uint32_t durationMs;
+  uint32_t audioStart; // first byte after the ID3v2 tag
+  uint32_t audioEnd;   // ID3v1 tag left out
+  uint32_t offset[SEEK_POINTS + 1]; // at i * durationMs / SEEK_POINTS
+};
+
+const char *seekSourceName(SeekSource s);
+
+// Table for an open file. buf (SEEK_SCRATCH_BYTES) is scratch for the header
+// read: callers on different tasks pass their own. Reads the cache file for
+// SEEK_ESTIMATE files only. False (source SEEK_NONE) without MPEG audio.
+bool mp3SeekBuild(HalFile &f, const char *path, Mp3SeekTable &t, uint8_t *buf);
+// Same with the tag bounds known (readTrackTags)
+bool mp3SeekBuildAt(HalFile &f, const char *path, uint32_t audioStart,
+                    uint32_t audioEnd, Mp3SeekTable &t, uint8_t *buf);
+
+// O(1): byte offset to continue reading from for time ms
+uint32_t mp3SeekOffset(const Mp3SeekTable &t, uint32_t ms);
+// Inverse (binary search over the SEEK_POINTS + 1 offsets)
+uint32_t mp3SeekTimeMs(const Mp3SeekTable &t, uint32_t offset);
+
+// Reads every frame header of a VBR file without a seek header, a bounded
+// number of bytes per step(), and saves the table to the cache. Used by the
+// library indexer; one scan at a time.
+class Mp3FrameScan {
+public:
+  bool begin(const char *path, const Mp3SeekTable &estimate);
+  // False when done (or failed); then active() is false again
+  bool step(size_t maxBytes);
+  bool active() const { return file_ != nullptr; }
+  void cancel();
+  // Length from the frame count of the last finished scan, 0 = none
+  uint32_t durationMs() const { return durationMs_; }
+
+private:
+  bool loadHeader(uint32_t pos, Mp3FrameHeader &h);
+  bool resync();
+  void finish();
+
+  std::unique_ptr<HalFile> file_;
+  uint8_t *buf_ = nullptr; // SEEK_SCRATCH_BYTES, PSRAM
+  uint32_t bufPos_ = 0;
+  uint32_t bufLen_ = 0;
+  std::vector<uint32_t, MemPsramAllocator<uint32_t, MEM_INDEX>> marks_;
+  char path_[160];
+  uint32_t fileSize_ = 0;
+  uint32_t audioStart_ = 0;
+  uint32_t audioEnd_ = 0;
+  uint32_t pos_ = 0; // next frame header
+  uint32_t frames_ = 0;
+  uint32_t skipped_ = 0; // bytes passed over without a frame
+  uint32_t samplesPerFrame_ = 0;
+  uint32_t sampleRate_ = 0;
+  uint32_t durationMs_ = 0;
+};
@@ -0,0 +1,258 @@
+#include "PathCache.h"
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Catalog.h"
+#include "GameEngine.h"
+#include "MemTrack.h"
+#include "TextPool.h"
+#include "hal/Hal.h"
+
+static constexpr size_t PATH_TEXT_CHUNK = 16 * 1024;
+// stat() or folder listings per step
+static constexpr size_t PATH_RESOLVE_PER_STEP = 8;
+static constexpr size_t PATH_REPORT_MISSING_MAX = 32;
+
+struct PathEntry {
+  uint32_t size;
+  bool present;
+  bool folder;
+};
+
+using PathMap =
+    std::unordered_map<std::string_view, PathEntry,
+                       std::hash<std::string_view>,
+                       std::equal_to<std::string_view>,
+                       MemPsramAllocator<std::pair<const std::string_view,
+                                                   PathEntry>,
+                                         MEM_CATALOG>>;
+
+struct PathTodo {
+  const char *path; // nextText
+  bool folder;
+};
+
+// The live table. Only the publish changes it (under pathLock, a swap);
+// pathLookup() always locks.
+static PathMap pathMap;
+static TextPool pathText(MEM_CATALOG, PATH_TEXT_CHUNK);
+static std::mutex pathLock;
+
+// ---- Next table (settings task only) ----
+static PathMap nextMap;
+static TextPool nextText(MEM_CATALOG, PATH_TEXT_CHUNK);
+static std::vector<PathTodo, MemPsramAllocator<PathTodo, MEM_CATALOG>> todo;
+static size_t todoNext = 0;
+static bool building = false;
+static uint32_t buildStartMs = 0;
+static uint32_t buildSdOps = 0;
+
+// Progress as the report (any task) may read it; set by the settings task
+static std::atomic<bool> progressBuilding{false};
+static std::atomic<uint32_t> progressDone{0};
+static std::atomic<uint32_t> progressTotal{0};
+
+// ---- Last resolution, for the report (under pathLock, with pathMap) ----
+struct PathCounts {
+  uint32_t files, filesMissing, folders, foldersMissing, sdOps, buildMs;
+};
+static PathCounts pathCounts = {};
+
+PathState pathLookup(const char *path, uint32_t *size) {
+  std::lock_guard<std::mutex> lock(pathLock);
+  auto it = pathMap.find(std::string_view(path));
+  if (it == pathMap.end())
+    return PATH_UNKNOWN;
+  if (size)
+    *size = it->second.size;
+  return it->second.present ? PATH_PRESENT : PATH_MISSING;
+}
+
+// A path as the player opens it; known paths are only kept once. A full
+// text pool throws like the containers do: a half table is never published.
+static PathEntry *nextAdd(const char *path, bool folder, bool queue) {
+  auto it = nextMap.find(std::string_view(path));
+  if (it != nextMap.end())
+    return &it->second;
+  const char *key = nextText.add(path);
+  if (!key)
+    throw std::bad_alloc();
+  PathEntry &e = nextMap[std::string_view(key)];
+  e = PathEntry{0, false, folder};
+  if (queue)
+    todo.push_back(PathTodo{key, folder});
+  return &e;
+}
+
+static bool isMp3Name(const char *name) {
+  size_t n = strlen(name);
+  return n >= 4 && strcasecmp(name + n - 4, ".mp3") == 0;
+}
+
+// The .mp3 files of a folder, named like setActiveFromFolder() does. False
+// when out of memory (caught here, not thrown through listDir()).
+static bool resolveFolder(const char *folder, PathEntry &e) {
+  bool oom = false;
+  e.present = hal.fs->listDir(folder, [&](const DirEntry &d) {
+    if (oom || d.isDir || !isMp3Name(d.name))
+      return;
+    String full = folder;
+    if (!full.endsWith("/"))
+      full += "/";
+    full += d.name;
+    try {
+      PathEntry *f = nextAdd(full.c_str(), false, false);
+      f->present = true;
+      f->size = d.size;
+    } catch (const std::bad_alloc &) {
+      oom = true;
+    }
+  });
+  return !oom;
+}
+
+static void nextFree() {
+  MemScope memScope(MEM_CATALOG);
+  nextMap = PathMap();
+  nextText.clear();
+  todo.clear();
+  todo.shrink_to_fit();
+  todoNext = 0;
+  building = false;
+  progressBuilding = false;
+}
+
+// Out of memory while building: the live table stays as it is
+static void nextAbandon() {
+  Serial.println("Paths: out of memory, keeping the old path table");
+  nextFree();
+}
+
+void pathCacheCollect() {
+  nextFree();
+  MemScope memScope(MEM_CATALOG);
+  auto add = [](const char *path, bool folder) {
+    if (*path)
+      nextAdd(path, folder, true);
+  };
+  try {
+    catalogForEachPath(add);
+    gamesForEachPath([&](const char *path) { add(path, false); });
+    // Folders first: their listing covers most files without a stat() each
+    std::stable_partition(todo.begin(), todo.end(),
+                          [](const PathTodo &t) { return t.folder; });
+  } catch (const std::bad_alloc &) {
+    nextAbandon();
+    return;
+  }
+
+  building = true;
+  buildStartMs = hal.clock->millis();
+  buildSdOps = 0;
+  progressDone = 0;
+  progressTotal = (uint32_t)todo.size();
+  progressBuilding = true;
+}
+
+// Swap the resolved table in, report it and free the old one
+static void pathPublish() {
+  PathCounts c = {};
+  for (const auto &kv : nextMap) {
+    const PathEntry &e = kv.second;
+    if (e.folder) {
+      c.folders++;
+      c.foldersMissing += e.present ? 0 : 1;
+    } else {
+      c.files++;
+      c.filesMissing += e.present ? 0 : 1;
+    }
+  }
+  c.sdOps = buildSdOps;
+  c.buildMs = hal.clock->millis() - buildStartMs;
+
+  {
+    std::lock_guard<std::mutex> lock(pathLock);
+    std::swap(pathMap, nextMap);
+    pathText.swap(nextText);
+    pathCounts = c;
+  }
+  nextFree();
+  pathCacheReport();
+}
+
+bool pathCacheStep() {
+  if (!building)
+    return false;
+
+  MemScope memScope(MEM_CATALOG);
+  for (size_t n = 0; n < PATH_RESOLVE_PER_STEP && todoNext < todo.size();
+       n++) {
+    const PathTodo t = todo[todoNext++];
+    PathEntry &e = nextMap.find(std::string_view(t.path))->second;
+    if (t.folder) {
+      if (!resolveFolder(t.path, e)) {
+        nextAbandon();
+        return false;
+      }
+      buildSdOps++;
+    } else if (!e.present) { // not already in a folder listing
+      DirEntry d;
+      e.present = hal.fs->stat(t.path, d) && !d.isDir;
+      e.size = e.present ? d.size : 0;
+      buildSdOps++;
+    }
+  }
+  progressDone = (uint32_t)todoNext;
+  if (todoNext >= todo.size())
+    pathPublish();
+  return true;
+}
+
+void pathCacheReport() {
+  if (progressBuilding.load()) {
+    Serial.printf("Paths: resolving %u/%u\n", (unsigned)progressDone.load(),
+                  (unsigned)progressTotal.load());
+    return;
+  }
+
+  // Copy under the lock, print after: startTrack() waits on pathLock
+  struct Missing {
+    std::string path;
+    bool folder;
+  };
+  std::vector<Missing> missing;
+  missing.reserve(PATH_REPORT_MISSING_MAX);
+  PathCounts c;
+  size_t listed = 0;
+  {
+    std::lock_guard<std::mutex> lock(pathLock);
+    c = pathCounts;
+    for (const auto &kv : pathMap) {
+      if (kv.second.present)
+        continue;
+      if (listed++ < PATH_REPORT_MISSING_MAX)
+        missing.push_back(Missing{std::string(kv.first), kv.second.folder});
+    }
+  }
+
+  Serial.printf("Paths: %u files (%u missing), %u folders (%u missing), "
+                "%u SD lookups in %u ms\n",
+                (unsigned)c.files, (unsigned)c.filesMissing,
+                (unsigned)c.folders, (unsigned)c.foldersMissing,
+                (unsigned)c.sdOps, (unsigned)c.buildMs);
+  for (const Missing &m : missing)
+    Serial.printf("  missing %s: %s\n", m.folder ? "folder" : "file",
+                  m.path.c_str());
+  if (listed > PATH_REPORT_MISSING_MAX)
+    Serial.printf("  ... and %u more\n",
+                  (unsigned)(listed - PATH_REPORT_MISSING_MAX));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// ================= PATH CACHE =================
+// Every file settings.json refers to (card tracks, the .mp3 files of the
+// folders cards play, game clips), with whether it exists and its size.
+// pathCacheCollect() copies the paths from the live catalog and games,
+// pathCacheStep() looks them up on the SD card a few at a time off the loop,
+// then swaps the new table in and prints one report of what is missing.
+// Starting a known present track asks pathLookup() instead of the SD card,
+// so a start is one directory walk (the open) instead of two (exists +
+// open). PATH_MISSING is only a hint: the file may have been copied since.
+
+enum PathState : uint8_t {
+  PATH_UNKNOWN, // not referenced by settings.json, or not resolved yet
+  PATH_PRESENT,
+  PATH_MISSING
+};
+
+// Any task; O(1), never touches the SD card. size may be nullptr.
+PathState pathLookup(const char *path, uint32_t *size = nullptr);
+
+// Settings task only (SettingsReload.cpp), while no reload waits for its
+// commit: start a new resolution of the live paths
+void pathCacheCollect();
+// Settings task: resolve a few paths; false when there is nothing to do
+bool pathCacheStep();
+
+// "paths" on the serial monitor: counts and the missing files. Any task;
+// holds pathLock only to copy, never while printing.
+void pathCacheReport();
@@ -0,0 +1,599 @@
+#include "Player.h"
+
+#include "Catalog.h"
+#include "GameEngine.h"
+#include "LoopProfile.h"
+#include "Playlist.h"
+#include "ScanTrace.h"
+#include "SettingsReload.h"
+#include "UiModel.h"
+#include "hal/Hal.h"
+
+Hal hal;
+
+// ---------------- Volume control ----------------
+static bool volDirty = false;
+static uint32_t volLastChangedAt = 0;
+static constexpr uint32_t VOL_SAVE_DELAY_MS = 800;
+
+float currentVolume = 0.4f; // start-volumen
+
+static bool volumeLocked = false;
+static float lockedVolume = 0.0f;
+
+static bool volumeDirty = false;
+static uint8_t lastVolumeChangeAt = 0;
+
+
+static float getEffectiveVolume() {
+  return volumeLocked ? lockedVolume : currentVolume;
+}
+
+static void setVolume(float v) {
+  v = clampf(v, VOL_MIN, VOL_MAX);
+
+  if (volumeLocked) {
+    lockedVolume = v;
+  } else {
+    currentVolume = v;
+  }
+
+  // hvis du har noget "volumeDirty" / lastChanged timestamp, sæt det her
+  volumeDirty = true;
+  lastVolumeChangeAt = hal.clock->millis();
+}
+
+static void changeVolume(float delta) {
+  currentVolume += delta;
+
+  if (currentVolume < VOL_MIN)
+    currentVolume = VOL_MIN;
+  if (currentVolume > VOL_MAX)
+    currentVolume = VOL_MAX;
+
+  hal.audio->setGain(currentVolume);
+
+  Serial.print("Volume: ");
+  Serial.println(currentVolume, 2);
+
+  volDirty = true;
+  volLastChangedAt = hal.clock->millis();
+}
+
+static void maybeSaveVolume(uint32_t now) {
+  if (!volDirty)
+    return;
+  if (now - volLastChangedAt < VOL_SAVE_DELAY_MS)
+    return;
+
+  float eff = getEffectiveVolume();
+  int v = (int)lroundf(eff * 100.0f);
+  if (v < 0) v = 0;
+  if (v > 100) v = 100;
+
+  hal.kv->putInt(PREF_KEY_VOL, v);
+  volDirty = false;
+
+  Serial.print("Saved volume: ");
+  Serial.println(v);
+  Serial.print(volumeLocked ? " (locked)" : " (free)");
+Serial.println();
+}
+
+// ---- Scan de-duplication + same-card fast path ----
+// A UID accepted within dedup_ms of its last accepted scan is dropped
+// (card picked up twice while being placed). Scanning the card whose content
+// is already running follows the per-role policy from settings.json
+// ("rfid": {"dedup_ms", "same_card": {"music", "game_selector"}}) and
+// never touches SD. Answer and parent cards are only de-duplicated.
+static constexpr size_t SCAN_DEDUP_SLOTS = 8;
+
+struct RecentScan {
+  char uid[21];
+  uint32_t at;
+};
+static RecentScan recentScans[SCAN_DEDUP_SLOTS];
+static uint32_t scansSuppressedDedup = 0;
+static uint32_t scansSuppressedSameCard = 0;
+
+// UI snapshot handed to the display (see uiPublish)
+static constexpr uint32_t UI_PUBLISH_MS = 20; // snapshot check in loop()
+static constexpr uint32_t NOTHING_TO_PLAY_BLINK_MS = 240;
+
+static UiSnapshot uiPublished{false, false, false, false, -1, -1, 0, 0, "", ""};
+static uint32_t uiLastPublishAt = 0;
+
+// Hand the current UI state to the display if it changed
+static void uiPublish(uint32_t now, float currentVol) {
+  if ((uint32_t)(now - uiLastPublishAt) < UI_PUBLISH_MS)
+    return;
+  uiLastPublishAt = now;
+
+  const float volMin = VOL_MIN;
+  const float volMax = VOL_MAX;
+  float vol = clampf(currentVol, volMin, volMax);
+
+  bool gameMode = gameState != GameState::IDLE;
+  int pct = (int)(100.0f * (vol - volMin) / (volMax - volMin) + 0.5f);
+
+  int progress = -1;
+  uint32_t dur = hal.audio->durationMs();
+  if (!gameMode && dur > 0 && hal.audio->isPlaying()) {
+    uint32_t pos = hal.audio->positionMs();
+    progress = pos >= dur ? 100 : (int)((uint64_t)pos * 100 / dur);
+  }
+
+  UiSnapshot &s = uiPublished;
+  if (gameMode == s.gameMode && volumeLocked == s.locked &&
+      parentalAntiRepeatEnabled == s.antiRepeat &&
+      shuffleEnabled == s.shuffle && pct == s.pct &&
+      progress == s.progress && ui.line2.gen == s.line2Gen &&
+      ui.line3.gen == s.line3Gen)
+    return;
+
+  s.gameMode = gameMode;
+  s.locked = volumeLocked;
+  s.antiRepeat = parentalAntiRepeatEnabled;
+  s.shuffle = shuffleEnabled;
+  s.pct = pct;
+  s.progress = progress;
+  if (ui.line2.gen != s.line2Gen) {
+    memcpy(s.line2, ui.line2.text, sizeof(s.line2));
+    s.line2Gen = ui.line2.gen;
+  }
+  if (ui.line3.gen != s.line3Gen) {
+    memcpy(s.line3, ui.line3.text, sizeof(s.line3));
+    s.line3Gen = ui.line3.gen;
+  }
+  hal.display->show(s);
+}
+
+// ---------------- Seeking ----------------
+// NEXT/PREV held: every button repeat jumps SEEK_STEP_MS, doubled every
+// SEEK_ACCEL_REPEATS repeats (at most 4x), so a long audiobook chapter is
+// crossed in seconds while a song can still be stepped through.
+static constexpr int32_t SEEK_STEP_MS = 5000;
+static constexpr uint32_t SEEK_ACCEL_REPEATS = 25; // ~2 s of repeats
+static constexpr uint32_t SEEK_ACCEL_MAX_SHIFT = 2;
+static constexpr uint32_t SEEK_HOLD_GAP_MS = 300; // longer gap = new hold
+
+static uint32_t seekRepeats = 0;
+static uint32_t seekLastAt = 0;
+
+static void seekHold(int32_t dir) {
+  if (gameModeActive || !hal.audio->isPlaying())
+    return;
+  uint32_t now = hal.clock->millis();
+  if ((uint32_t)(now - seekLastAt) > SEEK_HOLD_GAP_MS)
+    seekRepeats = 0;
+  seekLastAt = now;
+
+  uint32_t shift = seekRepeats / SEEK_ACCEL_REPEATS;
+  if (shift > SEEK_ACCEL_MAX_SHIFT)
+    shift = SEEK_ACCEL_MAX_SHIFT;
+  seekRepeats++;
+  hal.audio->seekBy(dir * (SEEK_STEP_MS << shift));
+}
+
+// Hold-to-play: the music card that started the current playback, and
+// whether we paused because it was lifted off the reader
+static String holdMusicUid = "";
+static bool pausedByRemoval = false;
+
+// True if the UID was accepted less than rfidSettings.dedupMs ago; otherwise
+// remembers it (replacing the oldest slot).
+static bool scanIsDuplicate(const char *uid, uint32_t at) {
+  RecentScan *slot = &recentScans[0];
+  for (auto &r : recentScans) {
+    if (strcmp(r.uid, uid) == 0) {
+      if ((uint32_t)(at - r.at) < rfidSettings.dedupMs)
+        return true;
+      slot = &r;
+      break;
+    }
+    if ((int32_t)(r.at - slot->at) < 0)
+      slot = &r;
+  }
+  strncpy(slot->uid, uid, sizeof(slot->uid) - 1);
+  slot->uid[sizeof(slot->uid) - 1] = '\0';
+  slot->at = at;
+  return false;
+}
+
+// The track playing (or paused) now was started by this music card
+static bool musicCardIsCurrent(const String &uid) {
+  if (gameModeActive || holdMusicUid != uid || !hasLastPath)
+    return false;
+  if (!hal.audio->isPlaying() && !hal.audio->isPaused())
+    return false;
+  if (activeIndex < 0 || activeIndex >= (int)activeTracks.size())
+    return false;
+  return strcmp(activeTracks[activeIndex], lastPath) == 0;
+}
+
+// True when the scan was fully handled without restarting anything
+static bool sameCardFastPath(const CardEntry &e, const String &uid) {
+  SameCardPolicy policy = SAME_CARD_RESTART;
+
+  if (e.role == "music" && musicCardIsCurrent(uid)) {
+    policy = rfidSettings.sameCardMusic;
+    if (policy == SAME_CARD_RESUME && hal.audio->isPaused()) {
+      hal.audio->resume();
+    }
+  } else if (e.role == "game_selector" && gameIsRunning(e.gameId)) {
+    policy = rfidSettings.sameCardSelector;
+  }
+
+  if (policy == SAME_CARD_RESTART)
+    return false;
+
+  scansSuppressedSameCard++;
+  Serial.printf("Same card, %s (suppressed same=%u dedup=%u)\n",
+                policy == SAME_CARD_RESUME ? "resume" : "ignore",
+                (unsigned)scansSuppressedSameCard,
+                (unsigned)scansSuppressedDedup);
+  return true;
+}
+
+static void onCardRemoved(const RfidScanEvent &ev) {
+  Serial.print("Card removed: ");
+  Serial.println(ev.uid);
+
+  if (!rfidSettings.pauseOnRemoval || gameModeActive ||
+      holdMusicUid != ev.uid)
+    return;
+  if (hal.audio->isPlaying() && !hal.audio->isPaused()) {
+    hal.audio->pause();
+    pausedByRemoval = true;
+  }
+}
+
+// True when the return was handled (playback resumed)
+static bool onCardReturned(const RfidScanEvent &ev) {
+  Serial.print("Card returned: ");
+  Serial.println(ev.uid);
+
+  if (!pausedByRemoval || holdMusicUid != ev.uid)
+    return false;
+  pausedByRemoval = false;
+  hal.audio->resume();
+  return true;
+}
+
+[[maybe_unused]] static TraceRole traceRoleOf(const CardEntry *e) {
+  if (!e)
+    return TR_UNKNOWN;
+  if (e->role == "music")
+    return TR_MUSIC;
+  if (e->role == "game_selector")
+    return TR_GAME_SELECTOR;
+  if (e->role == "answer")
+    return TR_ANSWER;
+  if (e->role == "parent")
+    return TR_PARENT;
+  return TR_UNKNOWN;
+}
+
+// Control side of RFID: lookup + actions for one scan event from rfidTask
+static void handleCardScan(const RfidScanEvent &ev, uint32_t now) {
+  String uid(ev.uid);
+  pausedByRemoval = false;
+
+  if (scanIsDuplicate(ev.uid, ev.detectedAtMs)) {
+    scansSuppressedDedup++;
+    Serial.printf("Duplicate scan %s (suppressed same=%u dedup=%u)\n", ev.uid,
+                  (unsigned)scansSuppressedSameCard,
+                  (unsigned)scansSuppressedDedup);
+    return;
+  }
+
+  const CardEntry *e = findCardByUid(uid);
+  TRACE_STAMP(ev.traceId, TS_LOOKUP);
+  TRACE_SET_ROLE(ev.traceId, traceRoleOf(e));
+  if (!e) {
+    Serial.print("Unknown UID: ");
+    Serial.println(uid);
+    hal.display->setCardLed(false);
+    // digitalWrite(PIN_LED_CARD, LOW);
+    return;
+  }
+
+  if (sameCardFastPath(*e, uid))
+    return;
+
+  Serial.print("Current role is: ");
+  Serial.println(e->role);
+  Serial.println(uid);
+
+  if (e->role == "parent") {
+    if (e->action == "toggle_anti_repeat") {
+      parentalAntiRepeatEnabled = !parentalAntiRepeatEnabled;
+
+      if (parentalAntiRepeatEnabled &&
+          uiMessages.antiRepeatEnabled.length() > 0) {
+        playPath(uiMessages.antiRepeatEnabled);
+      } else if (!parentalAntiRepeatEnabled &&
+                 uiMessages.antiRepeatDisabled.length() > 0) {
+        playPath(uiMessages.antiRepeatDisabled);
+      }
+    }
+    if (e->action == "toggle_shuffle") {
+      playlistSetShuffle(!shuffleEnabled);
+      Serial.printf("Shuffle %s\n", shuffleEnabled ? "on" : "off");
+
+      const String &msg =
+          shuffleEnabled ? uiMessages.shuffleOn : uiMessages.shuffleOff;
+      if (msg.length() > 0)
+        playPath(msg);
+    }
+    if (e->action == "toggle_volume_lock") {
+      volumeLocked = !volumeLocked;
+
+      if (volumeLocked) {
+        // Lås til nuværende værdi
+        lockedVolume = currentVolume;
+
+        if (uiMessages.volumeLockOn.length() > 0)
+          playPath(uiMessages.volumeLockOn);
+
+      } else {
+        // Når der låses op: fortsæt på den låste værdi
+        currentVolume = lockedVolume;
+
+        if (uiMessages.volumeLockOff.length() > 0)
+          playPath(uiMessages.volumeLockOff);
+      }
+return;
+}
+
+    return;
+  }
+
+  if (e->role == "game_selector") {
+    Serial.println("GAME SELECT: " + e->gameId);
+
+    gameStartById(e->gameId,
+                  e->title); // always abort current + start selected
+    return;
+  }
+
+  if (e->role == "answer") {
+    // Hvis vi IKKE er klar til at modtage svar endnu (prompt/feedback
+    // spiller), buffer'er state machine UID så det tæller når vi går i
+    // COLLECT.
+    gameDispatch(GameEvent::ANSWER_SCANNED, e, now);
+    return;
+  }
+
+  if (e->role == "music") {
+    if (gameModeActive) {
+      gameDispatch(GameEvent::MUSIC_SCANNED, e, now);
+      return;
+    }
+
+    holdMusicUid = uid;
+    if (e->kind == PK_SINGLE) {
+      autoAdvance = false;
+      playlistEnded = false;
+
+      String path = e->file;
+      if (!path.startsWith("/"))
+        path = "/" + path;
+
+      // Byg active-liste for next/prev i samme folder
+      setActiveFromFolder(dirnameOf(path));
+
+      // Find index i activeTracks hvis muligt (kun til navigation)
+      int found = findActiveTrack(path);
+      if (found >= 0)
+        activeIndex = found;
+      else
+        activeIndex = 0; // fallback, men afspilning styres stadig af 'path'
+      playlistAnchor(activeIndex); // shuffle: resten af folderen efter den
+      String album = lookupAlbumTitleForTrackPath(path);
+      uiSet(ui.line2, album.length() > 0 ? album.c_str()
+                                         : e->title); // evt fallback
+      // Anti-repeat gate
+      playTrackDirect(path);
+      return;
+    } else if (e->kind == PK_ALBUM_FOLDER) {
+      autoAdvance = true;
+      playlistEnded = false;
+      String folder = e->folder;
+      if (!folder.startsWith("/"))
+        folder = "/" + folder;
+
+      uiSet(ui.line2, e->title);
+      uiSet(ui.line3, ""); // indtil JSON artist findes
+      setActiveFromFolder(folder);
+      playActiveIndex(playlistFirstIndex());
+    } else if (e->kind == PK_ALBUM_TRACKS) {
+      autoAdvance = true;
+      playlistEnded = false;
+      setActiveFromTrackPool(e->trackStart, e->trackCount);
+      uiSet(ui.line2, e->title);
+      uiSet(ui.line3, ""); // indtil JSON artist findes
+      playActiveIndex(playlistFirstIndex());
+    } else {
+      Serial.println("Music card missing play info");
+    }
+  }
+
+  Serial.print("UID ");
+  Serial.println(uid);
+}
+
+static void handleRfidEvent(const RfidScanEvent &ev, uint32_t now) {
+  if (ev.type != RFID_EV_REMOVED) {
+    // Card read -> LED on; loop() turns it off again after this pass
+    hal.display->setCardLed(true);
+  }
+  switch (ev.type) {
+  case RFID_EV_REMOVED:
+    onCardRemoved(ev);
+    return;
+  case RFID_EV_RETURNED:
+    if (onCardReturned(ev))
+      return;
+    break; // not paused by us -> a normal scan
+  case RFID_EV_SCAN:
+    break;
+  }
+  // Audio started while handling the scan belongs to its trace
+  TRACE_SET_LOOP_ID(ev.traceId);
+  handleCardScan(ev, now);
+  TRACE_SET_LOOP_ID(0);
+}
+
+void handleAction(Action a) {
+  switch (a) {
+  case ACT_PLAY_PAUSE: {
+    if (hal.audio->isPlaying()) {
+      hal.audio->togglePause();
+    } else {
+      if (playlistEnded && !activeTracks.empty()) {
+        playlistEnded = false;
+        autoAdvance = true;
+        playActiveIndex(playlistFirstIndex());
+        break;
+      }
+      if (hasLastPath) {
+        hal.audio->play(lastPath);
+      } else {
+        // Nothing to play: two short blinks (without stalling loop())
+        hal.display->blinkCardLed(hal.clock->millis(),
+                                  NOTHING_TO_PLAY_BLINK_MS);
+      }
+    }
+
+    Serial.println("PLAY/PAUSE");
+    break;
+  }
+
+  case ACT_NEXT:
+    if (activeTracks.empty())
+      break;
+
+    if (playlistEnded) {
+      playlistEnded = false;
+      autoAdvance = true; // restart autoplay
+      playActiveIndex(playlistFirstIndex());
+      break;
+    }
+    if (!activeTracks.empty())
+      playActiveIndex(playlistStep(activeIndex, +1)); // wraps
+    Serial.println("BTN: NEXT");
+    break;
+
+  case ACT_PREV:
+    if (!activeTracks.empty())
+      playActiveIndex(playlistStep(activeIndex, -1)); // wraps
+    Serial.println("BTN: PREV");
+    break;
+  case ACT_VOL_UP:
+    if (!volumeLocked) {
+      changeVolume(+VOL_STEP);
+      Serial.println("BTN: VOL UP");
+    }
+    break;
+  case ACT_VOL_DOWN:
+    if (!volumeLocked) {
+      changeVolume(-VOL_STEP);
+       Serial.println("BTN: VOL DOWN");
+    }
+    break;
+  case ACT_SEEK_FWD:
+    seekHold(+1);
+    break;
+  case ACT_SEEK_BACK:
+    seekHold(-1);
+    break;
+  case ACT_MODE_MUSIC:
+    Serial.println("MODE: MUSIC");
+    // Music button pressed, but no music yet selected
+    uiSet(ui.line2, "");
+    uiSet(ui.line3, "");
+    bool cameFromGame = gameModeActive;
+    gameDispatch(GameEvent::MUSIC_BUTTON); // only music button exits game
+    Serial.println("Came from game: ");
+    Serial.println(cameFromGame ? "YES" :"NO");
+    Serial.print(uiMessages.musicModeInfo.length());
+     if (cameFromGame && uiMessages.musicModeInfo.length() > 0) {
+    playPath(uiMessages.musicModeInfo);
+  }
+    break;
+  }
+}
+
+void playerInit(const char *settingsPath) {
+  if (hal.kv->getString(PREF_KEY_LASTPATH, lastPath, sizeof(lastPath)) > 0) {
+    hasLastPath = true;
+    Serial.print("Loaded last track: ");
+    Serial.println(lastPath);
+  }
+
+  int v = hal.kv->getInt(PREF_KEY_VOL, -1); // -1 = No stored value
+
+  if (v >= 0 && v <= 100) {
+    currentVolume = v / 100.0f;
+  } else {
+    currentVolume = 0.40f; // default
+  }
+
+  Serial.print("Loaded volume: ");
+  Serial.println(currentVolume, 2);
+
+  hal.audio->setGain(currentVolume);
+
+  // Load JSON
+  uint32_t t0 = hal.clock->millis();
+  loadCardsJson(settingsPath);
+  uint32_t cardsMs = hal.clock->millis() - t0;
+  antiRepeatApplySettings();
+  t0 = hal.clock->millis();
+  loadGamesJson(settingsPath); // games[]: rules + prompts + audio
+  // Device side of the settings benchmark (README)
+  Serial.printf("Boot: settings.json cards %u ms, games %u ms\n",
+                (unsigned)cardsMs, (unsigned)(hal.clock->millis() - t0));
+  analyticsLoad(ANALYTICS_PATH);
+  gameEnterIdle();
+  settingsReloadBegin(settingsPath);
+
+  // DEBUG Remove when used
+  Serial.printf("Meta entries: %d\n", (int)trackMetaByPath.size());
+  auto it = trackMetaByPath.find(keyOfPath("/audio/hjulene_paa_bus.mp3"));
+  if (it != trackMetaByPath.end()) {
+    Serial.println(it->second.title);
+    Serial.println(it->second.artist);
+  }
+}
+
+void playerTick(uint32_t now) {
+  uiPublish(now, currentVolume);
+  PROF_MARK(LS_UI);
+
+  gameTick(now, hal.audio->isPlaying() && !hal.audio->isPaused());
+  PROF_MARK(LS_GAME);
+
+  // Auto-advance when a track played to its end
+  if (hal.audio->takeTrackEnded()) {
+    int idx = playlistOnTrackEnded();
+    if (!gameModeActive && idx >= 0) {
+      playActiveIndex(idx);
+    }
+  }
+  PROF_MARK(LS_ADVANCE);
+
+  maybeSaveVolume(now);
+  PROF_MARK(LS_VOLUME);
+
+  // A reloaded settings.json goes live before the scans look cards up
+  settingsReloadApply();
+
+  // RFID scans are read by the card reader; we only do lookup + actions here
+  RfidScanEvent scan;
+  while (hal.cards->poll(scan)) {
+    handleRfidEvent(scan, now);
+  }
+  PROF_MARK(LS_RFID);
+}
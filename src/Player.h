@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Loop-side control of the player: button actions, card scans, volume and
+// publishing the UI state. Hardware is reached through `hal` (hal/Hal.h),
+// so this runs unchanged in the firmware and in the native build.
+
+enum Action {
+  ACT_PLAY_PAUSE,
+  ACT_NEXT,
+  ACT_PREV,
+  ACT_VOL_UP,
+  ACT_VOL_DOWN,
+  ACT_MODE_MUSIC,
+  ACT_MODE_GAME_A,
+  ACT_MODE_GAME_B,
+  ACT_SEEK_FWD, // NEXT held
+  ACT_SEEK_BACK // PREV held
+};
+
+// ---------------- Volume control ----------------
+static constexpr const char *PREF_KEY_VOL = "vol_x100";
+static constexpr float VOL_STEP = 0.05f;
+static constexpr float VOL_MIN = 0.05f;
+static constexpr float VOL_MAX = 0.9f;
+
+extern float currentVolume;
+
+static inline float clampf(float v, float lo, float hi) {
+  if (v < lo)
+    return lo;
+  if (v > hi)
+    return hi;
+  return v;
+}
+
+// setup(): last track, volume, settings.json, analytics. All hal backends
+// must be set.
+void playerInit(const char *settingsPath);
+
+// loop(): UI publish, game tick, auto-advance, volume save, card events
+void playerTick(uint32_t now);
+
+void handleAction(Action a);
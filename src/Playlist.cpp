@@ -0,0 +1,378 @@
+#include "Playlist.h"
+
+#include <algorithm>
+
+#include "Catalog.h"
+#include "LibraryIndex.h"
+#include "MemTrack.h"
+#include "RepeatHistory.h"
+#include "ScanTrace.h"
+#include "ShuffleOrder.h"
+#include "TextPool.h"
+#include "UiModel.h"
+#include "hal/Hal.h"
+
+char lastPath[128] = {0};
+bool hasLastPath = false;
+
+static constexpr size_t PLAYLIST_TEXT_CHUNK = 8 * 1024;
+
+static TextPool playlistText(MEM_PLAYLIST, PLAYLIST_TEXT_CHUNK);
+PlaylistPaths activeTracks;
+int activeIndex = -1;
+
+bool autoAdvance = false;
+bool playlistEnded = false;
+
+bool parentalAntiRepeatEnabled = false;
+// Alle starter huskes, også når spærren er slået fra, så den virker straks
+// når forældre-kortet slår den til
+static RepeatHistory recentStarts;
+
+void antiRepeatApplySettings() {
+  const AntiRepeatSettings &s = antiRepeatSettings;
+  recentStarts.configure(s.windowStarts, s.windowMinutes * 60 * 1000);
+  Serial.printf("Anti-repeat: max %u starts in the last %u starts / %u min\n",
+                (unsigned)s.maxStarts, (unsigned)s.windowStarts,
+                (unsigned)s.windowMinutes);
+}
+
+static bool antiRepeatBlocksThisStart(const String &path) {
+  if (!parentalAntiRepeatEnabled)
+    return false;
+
+  uint8_t n = recentStarts.count(path.c_str(), hal.clock->millis());
+  if (n < antiRepeatSettings.maxStarts)
+    return false;
+  Serial.printf("Anti-repeat: %s started %u times in the window\n",
+                path.c_str(), (unsigned)n);
+  return true;
+}
+
+static void antiRepeatOnTrackStart(const String &path) {
+  recentStarts.add(path.c_str(), hal.clock->millis());
+}
+
+// The warning clip for a blocked start is playing. Its end must not
+// auto-advance: the next track would be the blocked one again, and the
+// warning would repeat until the window lets it through.
+static bool antiRepeatWarningPlaying = false;
+
+static void antiRepeatWarn() {
+  if (uiMessages.antiRepeatWarning.length() > 0) {
+    playPath(uiMessages.antiRepeatWarning);
+    antiRepeatWarningPlaying = true;
+  }
+}
+
+// ---------------- Shuffle ----------------
+// The order is a ShuffleOrder over activeTracks with new keys for every
+// round. The round before (or, after going back into it, the one after) is
+// kept, so PREV on the first track of a round returns to the track that
+// just finished and NEXT from there comes back again.
+bool shuffleEnabled = false;
+
+// New order: keys tried for one that does not start with the track just
+// played (1 in n chance each)
+static constexpr uint8_t SHUFFLE_KEY_TRIES = 8;
+
+static ShuffleOrder shuffleOrder;
+static ShuffleOrder shufflePrev; // valid when shuffleHasPrev
+static ShuffleOrder shuffleNext; // valid when shuffleHasNext
+static bool shuffleHasPrev = false;
+static bool shuffleHasNext = false;
+
+// New keys for the current playlist; avoid >= 0: not as the first track
+static void shuffleNewOrder(int avoid) {
+  shuffleHasPrev = false;
+  shuffleHasNext = false;
+  uint32_t n = (uint32_t)activeTracks.size();
+  uint32_t keys[ShuffleOrder::ROUNDS];
+  for (uint8_t t = 0; t < SHUFFLE_KEY_TRIES; t++) {
+    for (uint32_t &k : keys)
+      k = (uint32_t)random(0x7FFFFFFF);
+    shuffleOrder.reset(n, keys);
+    if (n < 2 || (int)shuffleOrder.trackAt(0) != avoid)
+      return;
+  }
+}
+
+// The list changed under the order (a new folder without
+// playlistFirstIndex()): new keys for its size
+static void shuffleFit() {
+  if (shuffleOrder.size() != activeTracks.size())
+    shuffleNewOrder(-1);
+}
+
+void playlistSetShuffle(bool on) {
+  shuffleEnabled = on;
+  if (!on)
+    return;
+  shuffleNewOrder(-1);
+  playlistAnchor(activeIndex);
+}
+
+void playlistAnchor(int idx) {
+  if (!shuffleEnabled || idx < 0 || idx >= (int)activeTracks.size())
+    return;
+  shuffleFit();
+  shuffleOrder.anchor((uint32_t)idx);
+  // A track picked directly: the neighbouring rounds no longer join on
+  shuffleHasPrev = false;
+  shuffleHasNext = false;
+}
+
+int playlistFirstIndex() {
+  if (!shuffleEnabled || activeTracks.empty())
+    return 0;
+  shuffleNewOrder(activeIndex);
+  return (int)shuffleOrder.trackAt(0);
+}
+
+int playlistStep(int idx, int dir) {
+  int n = (int)activeTracks.size();
+  if (n == 0)
+    return -1;
+  if (idx < 0 || idx >= n)
+    return 0;
+  if (!shuffleEnabled)
+    return (idx + dir + n) % n;
+
+  shuffleFit();
+  uint32_t pos = shuffleOrder.posOf((uint32_t)idx);
+  if (dir > 0 && pos + 1 >= (uint32_t)n) {
+    // Every track played once: the next round (again, if PREV left it)
+    ShuffleOrder done = shuffleOrder;
+    if (shuffleHasNext)
+      shuffleOrder = shuffleNext;
+    else
+      shuffleNewOrder(idx);
+    shufflePrev = done;
+    shuffleHasPrev = true;
+    shuffleHasNext = false;
+    return (int)shuffleOrder.trackAt(0);
+  }
+  if (dir < 0 && pos == 0 && shuffleHasPrev) {
+    // Back into the round before, at its last track
+    shuffleNext = shuffleOrder;
+    shuffleHasNext = true;
+    shuffleOrder = shufflePrev;
+    shuffleHasPrev = false;
+    return (int)shuffleOrder.trackAt((uint32_t)n - 1);
+  }
+  return (int)shuffleOrder.trackAt(dir > 0 ? pos + 1 : (pos + n - 1) % n);
+}
+
+void clearActivePlaylist() {
+  activeTracks.clear();
+  playlistText.clear();
+  activeIndex = -1;
+}
+
+void uiSetNowPlayingFromPath(const String &path) {
+  // DEBUG - Remove Me
+  Serial.print("UI path:   ");
+  Serial.println(path);
+  // 1) JSON meta først
+  auto it = trackMetaByPath.find(keyOfPath(path));
+  char tBuf[UI_LINE3_MAX] = "";
+  char aBuf[UI_LINE3_MAX] = "";
+  const char *t = tBuf;
+  const char *a = aBuf;
+  static TrackInfo libInfo; // loop only
+  if (it != trackMetaByPath.end()) {
+    t = it->second.title;
+    a = it->second.artist;
+  } else if (libraryLookup(path.c_str(), libInfo)) {
+    // 2) ID3-tags fra biblioteks-indexet (ingen SD-læsning her)
+    t = libInfo.title;
+    a = libInfo.artist;
+  }
+  if (!t[0] && !a[0]) {
+    // 3) fallback: filnavn-konvention for album-folder
+    t = tBuf;
+    a = aBuf;
+    parseMetaFromFilename(path.c_str(), tBuf, sizeof(tBuf), aBuf, sizeof(aBuf));
+  }
+
+  if (t[0] && a[0])
+    uiSetf(ui.line3, "%s - %s", t, a);
+  else if (t[0])
+    uiSet(ui.line3, t);
+  else
+    uiSet(ui.line3, a);
+}
+
+// End of Read Song title and artist from file name
+
+static bool pathLess(const char *a, const char *b) { return strcmp(a, b) < 0; }
+
+// Sort alphabetically (used for folder scanning only)
+static void sortActivePlaylist() {
+  std::sort(activeTracks.begin(), activeTracks.end(), pathLess);
+}
+
+int findActiveTrack(const String &path) {
+  if (activeTracks.empty())
+    return -1;
+  // Folder playlists are sorted; card track lists are not
+  auto it = std::lower_bound(activeTracks.begin(), activeTracks.end(),
+                             path.c_str(), pathLess);
+  if (it != activeTracks.end() && path == *it)
+    return (int)(it - activeTracks.begin());
+  for (size_t i = 0; i < activeTracks.size(); i++) {
+    if (path == activeTracks[i])
+      return (int)i;
+  }
+  return -1;
+}
+
+// Out of memory drops the track, like a full playlistText
+static void keepActiveTrack(const char *path) {
+  const char *p = playlistText.add(path);
+  if (!p)
+    return;
+  try {
+    activeTracks.push_back(p);
+  } catch (const std::bad_alloc &) {
+  }
+}
+
+static void addActiveTrack(const String &path) {
+  keepActiveTrack(path.c_str());
+}
+
+static bool isMp3File(const String &name) {
+  String n = name;
+  n.toLowerCase();
+  return n.endsWith(".mp3");
+}
+
+void setActiveFromFolder(const String &folder) {
+  MemScope memScope(MEM_PLAYLIST);
+  clearActivePlaylist();
+
+  bool isDir = hal.fs->listDir(folder.c_str(), [&](const DirEntry &e) {
+    if (e.isDir)
+      return;
+    String name = String(e.name);
+    if (isMp3File(name)) {
+      String full = folder;
+      if (!full.endsWith("/"))
+        full += "/";
+      full += name;
+      if (!full.startsWith("/"))
+        full = "/" + full;
+
+      addActiveTrack(full);
+    }
+  });
+  if (!isDir) {
+    Serial.print("Folder missing/not dir: ");
+    Serial.println(folder);
+    return;
+  }
+
+  sortActivePlaylist();
+  if (shuffleEnabled)
+    shuffleNewOrder(-1);
+  TRACE_STAMP(TRACE_LOOP_ID(), TS_PLAYLIST);
+
+  Serial.print("Active playlist from folder: ");
+  Serial.print(folder);
+  Serial.print(" count=");
+  Serial.println((unsigned)activeTracks.size());
+}
+
+void setActiveFromTrackPool(uint32_t start, uint32_t count) {
+  MemScope memScope(MEM_PLAYLIST);
+  clearActivePlaylist();
+  if (start + count > trackPool.size())
+    count = start < trackPool.size() ? (uint32_t)trackPool.size() - start : 0;
+  try {
+    activeTracks.reserve(count);
+  } catch (const std::bad_alloc &) {
+  }
+  for (uint32_t i = 0; i < count; i++)
+    keepActiveTrack(trackPool[start + i].file);
+  if (shuffleEnabled)
+    shuffleNewOrder(-1);
+  TRACE_STAMP(TRACE_LOOP_ID(), TS_PLAYLIST);
+  Serial.print("Active playlist from tracks list count=");
+  Serial.println((unsigned)activeTracks.size());
+}
+
+// Track info helpers
+void playPath(const String &path) {
+  antiRepeatWarningPlaying = false;
+  hal.audio->play(path.c_str());
+
+  // Persist last track
+  strncpy(lastPath, path.c_str(), sizeof(lastPath) - 1);
+  lastPath[sizeof(lastPath) - 1] = '\0';
+  hasLastPath = true;
+  hal.kv->putString(PREF_KEY_LASTPATH, lastPath);
+
+  Serial.print("Play: ");
+  Serial.println(path);
+}
+
+void playActiveIndex(int idx) {
+  if (activeTracks.empty())
+    return;
+
+  if (idx < 0)
+    idx = 0;
+  if (idx >= (int)activeTracks.size())
+    idx = (int)activeTracks.size() - 1;
+
+  String path = activeTracks[idx];
+
+  // Anti-repeat gate (valgfrit: kun i music mode)
+  if (antiRepeatBlocksThisStart(path)) {
+    antiRepeatWarn();
+    return;
+  }
+
+  // Commit chosen index
+  activeIndex = idx;
+
+  // Update streak + UI + play
+  antiRepeatOnTrackStart(path);
+  uiSetNowPlayingFromPath(path);
+  playPath(path);
+}
+
+// End of Track info helpers
+
+void playTrackDirect(const String& path) {
+  if (antiRepeatBlocksThisStart(path)) {
+    antiRepeatWarn();
+    return;
+  }
+  antiRepeatOnTrackStart(path);
+  uiSetNowPlayingFromPath(path);
+  playPath(path);
+}
+
+int playlistOnTrackEnded() {
+  // A blocked start stops the autoplay: the warning ends in silence
+  if (antiRepeatWarningPlaying) {
+    antiRepeatWarningPlaying = false;
+    return -1;
+  }
+  // Autoplay for album/playlist: Plan next track
+  if (!autoAdvance || activeTracks.empty() || activeIndex < 0)
+    return -1;
+  uint32_t pos = (uint32_t)activeIndex;
+  if (shuffleEnabled) {
+    shuffleFit();
+    pos = shuffleOrder.posOf((uint32_t)activeIndex);
+  }
+  if (pos + 1 < activeTracks.size())
+    return playlistStep(activeIndex, +1);
+  // Last track is done -> stop playlist
+  playlistEnded = true;
+  autoAdvance = false; // stop autoplay until user starts again
+  return -1;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "MemTrack.h"
+
+// The active playlist (tracks next/prev and auto-advance move through), the
+// last started track and the parental anti-repeat gate. Starting a track
+// goes through playPath() -> hal.audio.
+
+// Handle last track for play/pause
+static constexpr const char *PREF_KEY_LASTPATH = "last_path";
+extern char lastPath[128]; // RAM copy
+extern bool hasLastPath;
+
+// Paths of the active playlist. They are copies owned by the playlist
+// (PSRAM when present) and stay valid until the next setActiveFrom* /
+// clearActivePlaylist(). Grows with the folder or card, no upper limit.
+using PlaylistPaths =
+    std::vector<const char *, MemPsramAllocator<const char *, MEM_PLAYLIST>>;
+extern PlaylistPaths activeTracks;
+extern int activeIndex;
+
+extern bool autoAdvance;   // Only true for album/playlist
+extern bool playlistEnded; // Is set when last track is played
+
+extern bool parentalAntiRepeatEnabled;
+// Window of the start history from antiRepeatSettings (after loading JSON)
+void antiRepeatApplySettings();
+
+// Shuffle (parent card "toggle_shuffle"). The play order is a keyed
+// permutation of the indices (ShuffleOrder.h), computed both ways when
+// needed, so no shuffled copy of activeTracks exists. activeIndex stays an
+// index in activeTracks.
+extern bool shuffleEnabled;
+void playlistSetShuffle(bool on);
+// Make idx the first position of the play order (a track picked directly)
+void playlistAnchor(int idx);
+// First track of a new play order (shuffle: new keys, and not activeIndex
+// again when there is a choice)
+int playlistFirstIndex();
+// Track before/after idx in the play order (dir -1/+1), wrapping. In shuffle
+// mode a wrap forward starts a new order; PREV on its first track goes back
+// to the last track of the order before.
+int playlistStep(int idx, int dir);
+
+void clearActivePlaylist();
+void uiSetNowPlayingFromPath(const String &path);
+void setActiveFromFolder(const String &folder);
+void setActiveFromTrackPool(uint32_t start, uint32_t count);
+// Index of path in activeTracks, -1 if it is not there
+int findActiveTrack(const String &path);
+
+void playPath(const String &path);
+void playActiveIndex(int idx);
+void playTrackDirect(const String &path);
+
+// A track played to its end: plan the next one for album/playlist. Returns
+// the index to start, or -1 (also when the playlist just ended, and after
+// the anti-repeat warning clip).
+int playlistOnTrackEnded();
@@ -0,0 +1,70 @@
+#include "RepeatHistory.h"
+
+uint32_t RepeatHistory::hashOf(const char *path) {
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (const char *p = path; *p; p++) {
+    h ^= (uint8_t)*p;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+void RepeatHistory::slots(uint32_t hash, size_t &a, size_t &b) const {
+  a = hash % FILTER_SLOTS;
+  b = (hash >> 16) % FILTER_SLOTS;
+  if (b == a)
+    b = (a + 1) % FILTER_SLOTS;
+}
+
+void RepeatHistory::configure(uint8_t windowStarts, uint32_t windowMs) {
+  if (windowStarts < 1)
+    windowStarts = 1;
+  if (windowStarts > MAX_STARTS)
+    windowStarts = MAX_STARTS;
+  windowStarts_ = windowStarts;
+  windowMs_ = windowMs;
+  while (used_ > windowStarts_)
+    dropOldest();
+}
+
+void RepeatHistory::clear() {
+  while (used_ > 0)
+    dropOldest();
+}
+
+void RepeatHistory::dropOldest() {
+  size_t a, b;
+  slots(ring_[head_].hash, a, b);
+  filter_[a]--;
+  filter_[b]--;
+  head_ = (uint8_t)((head_ + 1) % MAX_STARTS);
+  used_--;
+}
+
+void RepeatHistory::expire(uint32_t now) {
+  while (used_ > 0 && windowMs_ > 0 &&
+         (uint32_t)(now - ring_[head_].atMs) >= windowMs_)
+    dropOldest();
+}
+
+uint8_t RepeatHistory::count(const char *path, uint32_t now) {
+  expire(now);
+  size_t a, b;
+  slots(hashOf(path), a, b);
+  return filter_[a] < filter_[b] ? filter_[a] : filter_[b];
+}
+
+void RepeatHistory::add(const char *path, uint32_t now) {
+  expire(now);
+  if (used_ >= windowStarts_)
+    dropOldest();
+  Start &s = ring_[(head_ + used_) % MAX_STARTS];
+  s.hash = hashOf(path);
+  s.atMs = now;
+  used_++;
+  size_t a, b;
+  slots(s.hash, a, b);
+  filter_[a]++;
+  filter_[b]++;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Recently started tracks for the anti-repeat gate, in constant memory: a
+// ring of the path hashes of the last starts with their start times, and a
+// counting filter over the hashes in the ring (two counters per hash, the
+// smaller one is the count). count() and add() are O(1); entries leave the
+// window when they get too old (checked from the oldest end, each entry
+// once) or when the ring is full. A hash collision on both counters can make
+// count() too high, never too low.
+class RepeatHistory {
+public:
+  static constexpr uint8_t MAX_STARTS = 32;
+  static constexpr size_t FILTER_SLOTS = 256;
+
+  // The window: the last windowStarts starts (1..MAX_STARTS) that are
+  // younger than windowMs (0 = no age limit)
+  void configure(uint8_t windowStarts, uint32_t windowMs);
+  void clear();
+
+  // Starts of path in the window at now
+  uint8_t count(const char *path, uint32_t now);
+  void add(const char *path, uint32_t now);
+
+  uint8_t size() const { return used_; }
+
+private:
+  struct Start {
+    uint32_t hash;
+    uint32_t atMs;
+  };
+
+  static uint32_t hashOf(const char *path);
+  void expire(uint32_t now);
+  void dropOldest();
+  void slots(uint32_t hash, size_t &a, size_t &b) const;
+
+  Start ring_[MAX_STARTS];
+  uint8_t filter_[FILTER_SLOTS] = {};
+  uint8_t head_ = 0; // oldest start
+  uint8_t used_ = 0;
+  uint8_t windowStarts_ = MAX_STARTS;
+  uint32_t windowMs_ = 0;
+};
@@ -0,0 +1,161 @@
+#include <Arduino.h>
+
+#include "ScanTrace.h"
+
+#if SCAN_TRACE_ENABLED
+static constexpr size_t TRACE_RING = 8;
+static constexpr uint32_t TRACE_TIMEOUT_US = 3000000; // give up on sound
+static constexpr uint32_t TRACE_EDGES_US[] = {1000,  2000,   5000,   10000,
+                                              20000, 50000,  100000, 200000,
+                                              500000};
+static constexpr size_t TRACE_BUCKETS =
+    sizeof(TRACE_EDGES_US) / sizeof(TRACE_EDGES_US[0]) + 1;
+
+static const char *const TRACE_STAGE_NAMES[TS_COUNT] = {
+    "detect",  "uid_read", "lookup", "playlist",
+    "enqueue", "open",     "begin",  "first_i2s"};
+static const char *const TRACE_ROLE_NAMES[TR_COUNT] = {
+    "unknown", "music", "game_selector", "answer", "parent"};
+
+struct TraceRecord {
+  volatile uint16_t id; // 0 = free
+  volatile uint8_t role;
+  volatile bool folded;
+  volatile uint32_t at[TS_COUNT]; // micros(), 0 = stage not reached
+};
+
+// Row TS_DETECT holds the detect -> first I2S total
+struct TraceHist {
+  uint32_t count;
+  uint32_t sumUs;
+  uint32_t maxUs;
+  uint16_t buckets[TRACE_BUCKETS];
+};
+
+static TraceRecord traceRing[TRACE_RING];
+static TraceHist traceHist[TR_COUNT][TS_COUNT];
+static uint16_t traceNextId = 1;  // rfidTask only
+uint16_t traceLoopId = 0;
+volatile uint16_t traceAudioId = 0;
+static uint32_t traceCompleted = 0;
+static uint32_t traceAbandoned = 0;
+
+static inline uint32_t traceNow() {
+  uint32_t t = micros();
+  return t ? t : 1;
+}
+
+// rfidTask: new record for a card detected at detectUs
+uint16_t traceBegin(uint32_t detectUs) {
+  uint16_t id = traceNextId++;
+  if (traceNextId == 0)
+    traceNextId = 1;
+  TraceRecord &r = traceRing[id % TRACE_RING];
+  r.id = 0;
+  for (auto &t : r.at)
+    t = 0;
+  r.role = TR_UNKNOWN;
+  r.folded = false;
+  r.at[TS_DETECT] = detectUs ? detectUs : 1;
+  r.id = id;
+  return id;
+}
+
+void traceStamp(uint16_t id, TraceStage s) {
+  if (id == 0)
+    return;
+  TraceRecord &r = traceRing[id % TRACE_RING];
+  if (r.id == id && r.at[s] == 0)
+    r.at[s] = traceNow();
+}
+
+void traceSetRole(uint16_t id, TraceRole role) {
+  if (id == 0)
+    return;
+  TraceRecord &r = traceRing[id % TRACE_RING];
+  if (r.id == id)
+    r.role = role;
+}
+
+static void traceHistAdd(TraceHist &h, uint32_t us) {
+  size_t b = 0;
+  while (b < TRACE_BUCKETS - 1 && us >= TRACE_EDGES_US[b])
+    b++;
+  if (h.buckets[b] < 0xFFFF)
+    h.buckets[b]++;
+  h.count++;
+  h.sumUs += us;
+  if (us > h.maxUs)
+    h.maxUs = us;
+}
+
+static void traceFold(const TraceRecord &r, bool complete) {
+  uint8_t role = r.role < TR_COUNT ? r.role : TR_UNKNOWN;
+  uint32_t prev = r.at[TS_DETECT];
+
+  Serial.printf("TRACE #%u %s:", (unsigned)r.id, TRACE_ROLE_NAMES[role]);
+  for (uint8_t s = TS_DETECT + 1; s < TS_COUNT; s++) {
+    uint32_t t = r.at[s];
+    if (t == 0)
+      continue;
+    uint32_t dt = (int32_t)(t - prev) > 0 ? t - prev : 0;
+    traceHistAdd(traceHist[role][s], dt);
+    Serial.printf(" %s=+%uus", TRACE_STAGE_NAMES[s], (unsigned)dt);
+    prev = t;
+  }
+  if (complete) {
+    uint32_t total = r.at[TS_FIRST_I2S] - r.at[TS_DETECT];
+    traceHistAdd(traceHist[role][TS_DETECT], total);
+    Serial.printf(" total=%uus\n", (unsigned)total);
+  } else {
+    Serial.println(" (no sound)");
+  }
+}
+
+// loop(): fold records that reached the speaker or timed out
+void traceTick() {
+  uint32_t nowUs = micros();
+  for (auto &r : traceRing) {
+    if (r.id == 0 || r.folded)
+      continue;
+    bool complete = r.at[TS_FIRST_I2S] != 0;
+    if (!complete && (uint32_t)(nowUs - r.at[TS_DETECT]) < TRACE_TIMEOUT_US)
+      continue;
+    r.folded = true;
+    traceFold(r, complete);
+    if (complete)
+      traceCompleted++;
+    else
+      traceAbandoned++;
+  }
+}
+
+void traceDump() {
+  Serial.printf("Scan trace: completed=%u no-sound=%u (us, delta from "
+                "previous stage; buckets <1,2,5,10,20,50,100,200,500ms,more)\n",
+                (unsigned)traceCompleted, (unsigned)traceAbandoned);
+  for (uint8_t role = 0; role < TR_COUNT; role++) {
+    for (uint8_t s = 0; s < TS_COUNT; s++) {
+      const TraceHist &h = traceHist[role][s];
+      if (h.count == 0)
+        continue;
+      Serial.printf("  %-13s %-9s n=%-4u avg=%-7u max=%-7u |",
+                    TRACE_ROLE_NAMES[role],
+                    s == TS_DETECT ? "TOTAL" : TRACE_STAGE_NAMES[s],
+                    (unsigned)h.count, (unsigned)(h.sumUs / h.count),
+                    (unsigned)h.maxUs);
+      for (auto b : h.buckets)
+        Serial.printf(" %u", (unsigned)b);
+      Serial.println();
+    }
+  }
+}
+
+void traceReset() {
+  memset(traceHist, 0, sizeof(traceHist));
+  traceCompleted = 0;
+  traceAbandoned = 0;
+  Serial.println("Scan trace reset");
+}
+
+#endif // SCAN_TRACE_ENABLED
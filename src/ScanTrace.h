@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================= SCAN LATENCY TRACE =================
+// Timestamps every stage from a card touching the reader to the first
+// sample reaching I2S. Each scan gets a record in a small ring; every stage
+// is written by exactly one task (rfid: detect/uid, loop: lookup, playlist,
+// enqueue, audio: open/begin/first I2S), so no locks are needed. loop() folds
+// finished records into histograms per card role and stage (delta from the
+// previous stage that was reached). "trace" on the serial port prints them,
+// "trace reset" clears them. Build with -DSCAN_TRACE_ENABLED=0 to compile
+// the probes out.
+#ifndef SCAN_TRACE_ENABLED
+#define SCAN_TRACE_ENABLED 1
+#endif
+
+enum TraceStage : uint8_t {
+  TS_DETECT,     // IRQ edge / poll that saw the card
+  TS_UID_READ,   // PICC_ReadCardSerial done
+  TS_LOOKUP,     // findCardByUid done
+  TS_PLAYLIST,   // setActiveFromFolder / setActiveFromTrackPool done
+  TS_ENQUEUE,    // playPath put the file on audioQ
+  TS_OPEN,       // startTrack opened the file
+  TS_BEGIN,      // mp3->begin returned
+  TS_FIRST_I2S,  // first sample accepted by the I2S output
+  TS_COUNT
+};
+
+enum TraceRole : uint8_t {
+  TR_UNKNOWN,
+  TR_MUSIC,
+  TR_GAME_SELECTOR,
+  TR_ANSWER,
+  TR_PARENT,
+  TR_COUNT
+};
+
+#if SCAN_TRACE_ENABLED
+extern uint16_t traceLoopId;              // scan being handled by loop()
+extern volatile uint16_t traceAudioId;    // audioTask: track being started
+
+uint16_t traceBegin(uint32_t detectUs);   // rfidTask: new record
+void traceStamp(uint16_t id, TraceStage s);
+void traceSetRole(uint16_t id, TraceRole role);
+void traceTick();
+void traceDump();
+void traceReset();
+
+#define TRACE_BEGIN(detectUs) traceBegin(detectUs)
+#define TRACE_STAMP(id, stage) traceStamp((id), (stage))
+#define TRACE_SET_ROLE(id, role) traceSetRole((id), (role))
+#define TRACE_LOOP_ID() traceLoopId
+#define TRACE_SET_LOOP_ID(id) (traceLoopId = (id))
+#define TRACE_SET_AUDIO_ID(id) (traceAudioId = (id))
+#define TRACE_AUDIO_ID() traceAudioId
+#define TRACE_TICK() traceTick()
+#else
+#define TRACE_BEGIN(detectUs) ((uint16_t)0)
+#define TRACE_STAMP(id, stage) ((void)0)
+#define TRACE_SET_ROLE(id, role) ((void)0)
+#define TRACE_LOOP_ID() ((uint16_t)0)
+#define TRACE_SET_LOOP_ID(id) ((void)0)
+#define TRACE_SET_AUDIO_ID(id) ((void)0)
+#define TRACE_AUDIO_ID() ((uint16_t)0)
+#define TRACE_TICK() ((void)0)
+#endif
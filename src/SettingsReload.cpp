@@ -0,0 +1,187 @@
+#include "SettingsReload.h"
+
+#include <Arduino.h>
+
+#include <atomic>
+
+#include "Catalog.h"
+#include "GameEngine.h"
+#include "MemTrack.h"
+#include "PathCache.h"
+#include "Playlist.h"
+#include "hal/Hal.h"
+
+static constexpr uint32_t SETTINGS_POLL_MS = 2000;
+static constexpr size_t SETTINGS_HASH_CHUNK = 512;
+
+// IDLE -> (step) STAGED -> (apply) COMMITTED -> (step frees) IDLE. Each side
+// only touches the staging in its own states.
+enum ReloadState : uint8_t { RELOAD_IDLE, RELOAD_STAGED, RELOAD_COMMITTED };
+
+static std::atomic<uint8_t> reloadState{RELOAD_IDLE};
+static std::atomic<bool> reloadRequested{false};
+static const char *reloadPath = nullptr;
+
+// What the last parse saw; the first step takes it without parsing
+static bool reloadSeen = false;
+static uint32_t reloadSize = 0;
+static uint32_t reloadMtime = 0;
+static uint32_t reloadHash = 0;
+static uint32_t reloadLastPollAt = 0;
+static bool pathsCollected = false;
+
+// Result of the staged reload, for the report in the loop
+static CatalogDiff reloadCards;
+static GamesDiff reloadGames;
+static bool reloadGamesChanged = false;
+static uint32_t reloadParseMs = 0;
+static uint32_t reloadStagedKb = 0; // second catalog next to the live one
+static bool reloadWaitLogged = false;
+
+// FNV-1a of the file; false if it cannot be read
+static bool fileHash(const char *path, uint32_t &out) {
+  auto f = hal.fs->open(path, FileMode::READ);
+  if (!f)
+    return false;
+  static uint8_t buf[SETTINGS_HASH_CHUNK]; // settings task only
+  uint32_t h = 2166136261u;
+  size_t n;
+  while ((n = f->read(buf, sizeof(buf))) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      h ^= buf[i];
+      h *= 16777619u;
+    }
+  }
+  out = h;
+  return true;
+}
+
+static int32_t catalogBytes() {
+  return memCounters(MEM_CATALOG, MEM_INTERNAL).current +
+         memCounters(MEM_CATALOG, MEM_PSRAM).current;
+}
+
+static void stageFree() {
+  catalogStageFree();
+  gamesStageFree();
+}
+
+void settingsReloadBegin(const char *settingsPath) {
+  reloadPath = settingsPath;
+}
+
+void settingsReloadRequest() { reloadRequested = true; }
+
+bool settingsReloadStep(bool busy, uint32_t now) {
+  uint8_t st = reloadState.load();
+  if (st == RELOAD_STAGED || !reloadPath)
+    return false; // the loop has not taken it yet
+  if (st == RELOAD_COMMITTED) {
+    // The replaced tables, freed here and not in the loop; the paths of the
+    // new settings are resolved again
+    stageFree();
+    reloadState = RELOAD_IDLE;
+    pathCacheCollect();
+    return true;
+  }
+  if (!pathsCollected) {
+    pathCacheCollect();
+    pathsCollected = true;
+    return true;
+  }
+  // Resolving paths goes on while a track streams, slowly (see main.cpp)
+  if (pathCacheStep())
+    return true;
+
+  bool forced = reloadRequested.load();
+  if (busy || (!forced && (uint32_t)(now - reloadLastPollAt) <
+                              SETTINGS_POLL_MS))
+    return false;
+  reloadLastPollAt = now;
+
+  DirEntry e;
+  if (!hal.fs->stat(reloadPath, e))
+    return false;
+  if (reloadSeen && !forced && e.size == reloadSize && e.mtime == reloadMtime)
+    return false;
+
+  uint32_t h;
+  if (!fileHash(reloadPath, h))
+    return false;
+  reloadSize = e.size;
+  reloadMtime = e.mtime;
+  if (!reloadSeen) {
+    // Boot loaded this content already
+    reloadSeen = true;
+    reloadHash = h;
+    return false;
+  }
+  reloadRequested = false;
+  if (h == reloadHash && !forced)
+    return false; // written again, same content
+  reloadHash = h;
+
+  uint32_t t0 = hal.clock->millis();
+  int32_t liveBytes = catalogBytes();
+  bool catalogOk = catalogStage(reloadPath, reloadCards);
+  int32_t stagedBytes = catalogBytes() - liveBytes;
+  reloadStagedKb = stagedBytes > 0 ? (uint32_t)(stagedBytes + 1023) / 1024 : 0;
+  if (!catalogOk || !gamesStage(reloadPath, reloadGames)) {
+    // Most likely still being written: the next change of size/date retries
+    Serial.println("Settings reload: parse failed, keeping the old settings");
+    stageFree();
+    return false;
+  }
+  reloadParseMs = hal.clock->millis() - t0;
+
+  const CatalogDiff &c = reloadCards;
+  const GamesDiff &g = reloadGames;
+  reloadGamesChanged = g.added || g.changed || g.removed;
+  if (!c.added && !c.changed && !c.removed && !c.settingsChanged &&
+      !reloadGamesChanged) {
+    Serial.printf("Settings reload: no changes (parse %u ms, %u KB)\n",
+                  (unsigned)reloadParseMs, (unsigned)reloadStagedKb);
+    stageFree();
+    return false;
+  }
+  reloadWaitLogged = false;
+  reloadState = RELOAD_STAGED;
+  return false;
+}
+
+bool settingsReloadApply() {
+  if (reloadState.load() != RELOAD_STAGED)
+    return false;
+
+  // Games are replaced in place: not in the middle of one
+  if (reloadGamesChanged &&
+      (gameModeActive || gameState != GameState::IDLE)) {
+    if (!reloadWaitLogged) {
+      Serial.println("Settings reload: waiting for the game to end");
+      reloadWaitLogged = true;
+    }
+    return false;
+  }
+
+  uint32_t t0 = hal.clock->micros();
+  if (reloadGamesChanged && !gamesCommit())
+    return false; // analytics is saving, next loop
+  catalogCommit();
+  antiRepeatApplySettings();
+  uint32_t commitUs = hal.clock->micros() - t0;
+  reloadState = RELOAD_COMMITTED;
+
+  const CatalogDiff &c = reloadCards;
+  const GamesDiff &g = reloadGames;
+  Serial.printf("Settings reload: parse %u ms, catalog %u KB built next to "
+                "the live one, commit %u us\n",
+                (unsigned)reloadParseMs, (unsigned)reloadStagedKb,
+                (unsigned)commitUs);
+  Serial.printf("  cards +%u ~%u -%u =%u, games +%u ~%u -%u =%u, "
+                "messages/rfid/anti_repeat %s\n",
+                (unsigned)c.added, (unsigned)c.changed, (unsigned)c.removed,
+                (unsigned)c.unchanged, (unsigned)g.added, (unsigned)g.changed,
+                (unsigned)g.removed, (unsigned)g.unchanged,
+                c.settingsChanged ? "changed" : "unchanged");
+  return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+// ================= SETTINGS RELOAD =================
+// settings.json is picked up again without a reboot. settingsReloadStep()
+// runs off the loop (firmware: its own low priority task, sim: every tick):
+// it compares the size and date of the file now and then, hashes the content
+// when they changed, and only on a new hash parses the file next to the live
+// catalog and games (catalogStage(), gamesStage()): games whose JSON did not
+// change are kept, the catalog is built again in full (see Catalog.cpp).
+// settingsReloadApply() in the loop swaps the staged tables in once no game
+// is running; a playing track keeps playing.
+// The same task resolves the paths of the settings (PathCache.h) after boot
+// and after every reload.
+
+// Remember the file playerInit() loaded
+void settingsReloadBegin(const char *settingsPath);
+
+// One poll or a few path lookups; busy = a track is streaming (the SD card
+// belongs to the decoder: no polls then). Parsing happens here. True while
+// paths are being resolved: call again soon.
+bool settingsReloadStep(bool busy, uint32_t now);
+
+// Loop (playerTick): commit a staged reload. True when settings changed.
+bool settingsReloadApply();
+
+// "reload" on the serial monitor: parse on the next step even if the file
+// looks unchanged
+void settingsReloadRequest();
@@ -0,0 +1,61 @@
+#include "ShuffleOrder.h"
+
+void ShuffleOrder::reset(uint32_t n, const uint32_t keys[ROUNDS]) {
+  n_ = n;
+  uint8_t bits = 0;
+  while (bits < 31 && (1u << bits) < n)
+    bits++;
+  halfBits_ = bits < 2 ? 1 : (uint8_t)((bits + 1) / 2);
+  origin_ = 0;
+  for (uint8_t i = 0; i < ROUNDS; i++)
+    keys_[i] = keys[i];
+}
+
+uint32_t ShuffleOrder::round(uint32_t half, uint8_t i) const {
+  // murmur3 finalizer
+  uint32_t h = half ^ keys_[i];
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h & ((1u << halfBits_) - 1);
+}
+
+uint32_t ShuffleOrder::encode(uint32_t x) const {
+  do {
+    uint32_t l = x >> halfBits_;
+    uint32_t r = x & ((1u << halfBits_) - 1);
+    for (uint8_t i = 0; i < ROUNDS; i++) {
+      uint32_t t = l ^ round(r, i);
+      l = r;
+      r = t;
+    }
+    x = (l << halfBits_) | r;
+  } while (x >= n_);
+  return x;
+}
+
+uint32_t ShuffleOrder::decode(uint32_t x) const {
+  do {
+    uint32_t l = x >> halfBits_;
+    uint32_t r = x & ((1u << halfBits_) - 1);
+    for (uint8_t i = ROUNDS; i-- > 0;) {
+      uint32_t t = r ^ round(l, i);
+      r = l;
+      l = t;
+    }
+    x = (l << halfBits_) | r;
+  } while (x >= n_);
+  return x;
+}
+
+uint32_t ShuffleOrder::trackAt(uint32_t pos) const {
+  return encode((origin_ + pos) % n_);
+}
+
+uint32_t ShuffleOrder::posOf(uint32_t idx) const {
+  return (decode(idx) + n_ - origin_) % n_;
+}
+
+void ShuffleOrder::anchor(uint32_t idx) { origin_ = decode(idx); }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+// A shuffled order of n tracks without a table: position p is track
+// encode(origin + p), a 4 round Feistel network over the smallest even power
+// of two that holds n, keyed per order. Values past the end are encoded again
+// (cycle walking), which keeps it a permutation of 0..n-1; the domain is at
+// most 4n, so a step takes a few rounds on average, whatever n is.
+class ShuffleOrder {
+public:
+  static constexpr uint8_t ROUNDS = 4;
+
+  // New order of n tracks; position 0 is encode(0)
+  void reset(uint32_t n, const uint32_t keys[ROUNDS]);
+  uint32_t size() const { return n_; }
+
+  // Track at position pos / position of track idx (both below size())
+  uint32_t trackAt(uint32_t pos) const;
+  uint32_t posOf(uint32_t idx) const;
+  // Same order, shifted so that track idx is at position 0
+  void anchor(uint32_t idx);
+
+private:
+  uint32_t round(uint32_t half, uint8_t i) const;
+  uint32_t encode(uint32_t x) const;
+  uint32_t decode(uint32_t x) const;
+
+  uint32_t keys_[ROUNDS] = {};
+  uint32_t n_ = 0;
+  uint8_t halfBits_ = 1;
+  uint32_t origin_ = 0; // raw position of position 0
+};
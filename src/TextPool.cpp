@@ -0,0 +1,42 @@
+#include "TextPool.h"
+
+#include <utility>
+
+const char *TextPool::add(const char *s, size_t len) {
+  if (len == 0)
+    return "";
+
+  Chunk *c = head_;
+  if (!c || c->size - c->used < len + 1) {
+    // A text longer than a chunk gets a chunk of its own
+    size_t size = len + 1 > chunkBytes_ ? len + 1 : chunkBytes_;
+    c = static_cast<Chunk *>(memAllocLarge(tag_, sizeof(Chunk) + size));
+    if (!c)
+      return nullptr;
+    c->next = head_;
+    c->size = size;
+    c->used = 0;
+    head_ = c;
+  }
+
+  char *p = c->data() + c->used;
+  memcpy(p, s, len);
+  p[len] = '\0';
+  c->used += len + 1;
+  bytes_ += len + 1;
+  return p;
+}
+
+void TextPool::swap(TextPool &o) {
+  std::swap(head_, o.head_);
+  std::swap(bytes_, o.bytes_);
+}
+
+void TextPool::clear() {
+  while (head_) {
+    Chunk *next = head_->next;
+    memFreeLarge(tag_, head_);
+    head_ = next;
+  }
+  bytes_ = 0;
+}
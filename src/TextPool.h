@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include "MemTrack.h"
+
+// Append-only store for many short texts (paths, titles). They are copied
+// into big chunks from memAllocLarge (PSRAM when present), so 10k paths do
+// not cost 10k small internal-RAM blocks, and a stored text never moves:
+// the const char * from add() stays valid until clear(). Not thread safe.
+class TextPool {
+public:
+  TextPool(MemTag tag, size_t chunkBytes)
+      : tag_(tag), chunkBytes_(chunkBytes) {}
+  ~TextPool() { clear(); }
+  TextPool(const TextPool &) = delete;
+  TextPool &operator=(const TextPool &) = delete;
+
+  // Copy of s[0..len) plus '\0'; "" for an empty text, nullptr when out of
+  // memory
+  const char *add(const char *s, size_t len);
+  const char *add(const char *s) { return add(s, strlen(s)); }
+  const char *add(const String &s) { return add(s.c_str(), s.length()); }
+
+  void clear();
+  // Exchanges the texts of two pools of the same tag; pointers stay valid
+  void swap(TextPool &o);
+  size_t bytes() const { return bytes_; } // stored text incl. '\0'
+
+private:
+  struct Chunk {
+    Chunk *next;
+    size_t size;
+    size_t used;
+    char *data() { return reinterpret_cast<char *>(this + 1); }
+  };
+
+  MemTag tag_;
+  size_t chunkBytes_;
+  Chunk *head_ = nullptr;
+  size_t bytes_ = 0;
+};
@@ -0,0 +1,259 @@
+#include "TrackTags.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static constexpr size_t TAG_FRAME_READ_MAX = 256; // of one text frame
+static constexpr size_t ID3V1_BYTES = 128;
+
+static uint32_t syncsafe32(const uint8_t *b) {
+  return ((uint32_t)(b[0] & 0x7F) << 21) | ((uint32_t)(b[1] & 0x7F) << 14) |
+         ((uint32_t)(b[2] & 0x7F) << 7) | (b[3] & 0x7F);
+}
+
+static uint32_t be32(const uint8_t *b) {
+  return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+         ((uint32_t)b[2] << 8) | b[3];
+}
+
+static uint32_t be24(const uint8_t *b) {
+  return ((uint32_t)b[0] << 16) | ((uint32_t)b[1] << 8) | b[2];
+}
+
+// ---------------- Text ----------------
+struct Utf8Out {
+  char *buf;
+  size_t size;
+  size_t len;
+};
+
+static void putCodepoint(Utf8Out &o, uint32_t cp) {
+  if (cp < 0x20 || cp == 0x7F)
+    cp = ' ';
+  char tmp[4];
+  size_t n;
+  if (cp < 0x80) {
+    tmp[0] = (char)cp;
+    n = 1;
+  } else if (cp < 0x800) {
+    tmp[0] = (char)(0xC0 | (cp >> 6));
+    tmp[1] = (char)(0x80 | (cp & 0x3F));
+    n = 2;
+  } else if (cp < 0x10000) {
+    tmp[0] = (char)(0xE0 | (cp >> 12));
+    tmp[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    tmp[2] = (char)(0x80 | (cp & 0x3F));
+    n = 3;
+  } else {
+    tmp[0] = (char)(0xF0 | (cp >> 18));
+    tmp[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    tmp[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    tmp[3] = (char)(0x80 | (cp & 0x3F));
+    n = 4;
+  }
+  if (o.len + n >= o.size)
+    return; // whole characters only
+  memcpy(o.buf + o.len, tmp, n);
+  o.len += n;
+  o.buf[o.len] = '\0';
+}
+
+static void trimText(char *s) {
+  char *b = s;
+  while (*b == ' ')
+    b++;
+  size_t n = strlen(b);
+  while (n > 0 && b[n - 1] == ' ')
+    n--;
+  memmove(s, b, n);
+  s[n] = '\0';
+}
+
+// ID3v2 text frame body: encoding byte + text, first string only
+static void decodeId3Text(const uint8_t *p, size_t n, char *out,
+                          size_t outSize) {
+  Utf8Out o{out, outSize, 0};
+  out[0] = '\0';
+  if (n < 2)
+    return;
+  uint8_t enc = p[0];
+  p++;
+  n--;
+
+  if (enc == 0 || enc == 3) { // ISO-8859-1, UTF-8
+    size_t i = 0;
+    while (i < n && p[i]) {
+      if (enc == 0 || p[i] < 0x80) {
+        putCodepoint(o, p[i++]);
+        continue;
+      }
+      if ((p[i] & 0xC0) == 0x80 || p[i] >= 0xF8) {
+        putCodepoint(o, '?'); // not a lead byte
+        i++;
+        continue;
+      }
+      // UTF-8 sequence: copy it whole (or stop when it does not fit)
+      size_t len = (p[i] & 0xE0) == 0xC0 ? 2 : (p[i] & 0xF0) == 0xE0 ? 3 : 4;
+      if (i + len > n || o.len + len >= o.size)
+        break;
+      memcpy(out + o.len, p + i, len);
+      o.len += len;
+      out[o.len] = '\0';
+      i += len;
+    }
+  } else if (enc == 1 || enc == 2) { // UTF-16 with BOM, UTF-16BE
+    bool le = false;
+    if (enc == 1 && n >= 2) {
+      le = p[0] == 0xFF && p[1] == 0xFE;
+      if ((p[0] == 0xFF && p[1] == 0xFE) || (p[0] == 0xFE && p[1] == 0xFF)) {
+        p += 2;
+        n -= 2;
+      }
+    }
+    for (size_t i = 0; i + 1 < n; i += 2) {
+      uint32_t u = le ? (p[i] | (p[i + 1] << 8)) : ((p[i] << 8) | p[i + 1]);
+      if (u == 0)
+        break;
+      if (u >= 0xD800 && u < 0xDC00 && i + 3 < n) {
+        uint32_t lo = le ? (p[i + 2] | (p[i + 3] << 8))
+                         : ((p[i + 2] << 8) | p[i + 3]);
+        if (lo >= 0xDC00 && lo < 0xE000) {
+          u = 0x10000 + ((u - 0xD800) << 10) + (lo - 0xDC00);
+          i += 2;
+        }
+      }
+      putCodepoint(o, u);
+    }
+  }
+  trimText(out);
+}
+
+// ID3v1 field: ISO-8859-1, padded with zeros or spaces
+static void decodeLatin1(const uint8_t *p, size_t n, char *out,
+                         size_t outSize) {
+  Utf8Out o{out, outSize, 0};
+  out[0] = '\0';
+  for (size_t i = 0; i < n && p[i]; i++)
+    putCodepoint(o, p[i]);
+  trimText(out);
+}
+
+// ---------------- ID3v2 ----------------
+static void readId3v2(HalFile &f, uint8_t ver, uint8_t flags, uint32_t end,
+                      TrackTags &t, uint32_t &tlenMs) {
+  // Tag-wide unsynchronisation (v2.2/2.3) is rare: leave it to ID3v1
+  if ((flags & 0x80) && ver < 4)
+    return;
+
+  uint32_t pos = 10;
+  if ((flags & 0x40) && ver >= 3) { // extended header
+    uint8_t b[4];
+    if (!f.seek(pos) || f.read(b, 4) != 4)
+      return;
+    pos += ver == 3 ? 4 + be32(b) : syncsafe32(b);
+  }
+
+  const size_t hdrLen = ver == 2 ? 6 : 10;
+  uint8_t body[TAG_FRAME_READ_MAX];
+  while (pos + hdrLen <= end) {
+    uint8_t h[10];
+    if (!f.seek(pos) || f.read(h, hdrLen) != hdrLen || h[0] == 0)
+      break; // padding
+    uint32_t size = ver == 2 ? be24(h + 3) : ver == 4 ? syncsafe32(h + 4)
+                                                      : be32(h + 4);
+    pos += hdrLen;
+    if (size == 0 || size > end - pos)
+      break;
+
+    char *dst = nullptr;
+    bool isLen = false;
+    if (ver == 2) {
+      if (memcmp(h, "TT2", 3) == 0)
+        dst = t.title;
+      else if (memcmp(h, "TP1", 3) == 0)
+        dst = t.artist;
+      else if (memcmp(h, "TAL", 3) == 0)
+        dst = t.album;
+      else
+        isLen = memcmp(h, "TLE", 3) == 0;
+    } else {
+      if (memcmp(h, "TIT2", 4) == 0)
+        dst = t.title;
+      else if (memcmp(h, "TPE1", 4) == 0)
+        dst = t.artist;
+      else if (memcmp(h, "TALB", 4) == 0)
+        dst = t.album;
+      else
+        isLen = memcmp(h, "TLEN", 4) == 0;
+    }
+
+    // Compressed / encrypted frames are skipped; v2.4 data length
+    // indicator: 4 extra bytes in front of the text
+    uint32_t skip = 0;
+    bool usable = dst || isLen;
+    if (usable && ver == 3 && (h[9] & 0xC0))
+      usable = false;
+    if (usable && ver == 4) {
+      if (h[9] & 0x0E)
+        usable = false;
+      else if (h[9] & 0x01)
+        skip = 4;
+    }
+
+    if (usable && size > skip) {
+      size_t n = size - skip;
+      if (n > sizeof(body))
+        n = sizeof(body);
+      if (f.seek(pos + skip) && f.read(body, n) == n) {
+        if (dst) {
+          decodeId3Text(body, n, dst, TRACK_TAG_MAX);
+        } else {
+          char num[16];
+          decodeId3Text(body, n, num, sizeof(num));
+          tlenMs = (uint32_t)strtoul(num, nullptr, 10);
+        }
+      }
+    }
+    pos += size;
+  }
+}
+
+// ---------------- Reader ----------------
+static uint8_t seekScratch[SEEK_SCRATCH_BYTES]; // one indexer task only
+
+bool readTrackTags(HalFile &f, const char *path, TrackTags &t,
+                   Mp3SeekTable *seek) {
+  memset(&t, 0, sizeof(t));
+  uint32_t fileSize = (uint32_t)f.size();
+  uint32_t tlenMs = 0;
+
+  uint8_t h[10];
+  if (f.seek(0) && f.read(h, sizeof(h)) == sizeof(h) &&
+      memcmp(h, "ID3", 3) == 0 && h[3] >= 2 && h[3] <= 4) {
+    uint32_t end = 10 + syncsafe32(h + 6);
+    t.audioStart = end + ((h[5] & 0x10) ? 10 : 0); // footer
+    if (end > fileSize)
+      end = fileSize;
+    readId3v2(f, h[3], h[5], end, t, tlenMs);
+  }
+
+  uint32_t audioEnd = fileSize;
+  uint8_t v1[ID3V1_BYTES];
+  if (fileSize >= t.audioStart + ID3V1_BYTES &&
+      f.seek(fileSize - ID3V1_BYTES) &&
+      f.read(v1, sizeof(v1)) == sizeof(v1) && memcmp(v1, "TAG", 3) == 0) {
+    audioEnd -= ID3V1_BYTES;
+    if (!t.title[0])
+      decodeLatin1(v1 + 3, 30, t.title, TRACK_TAG_MAX);
+    if (!t.artist[0])
+      decodeLatin1(v1 + 33, 30, t.artist, TRACK_TAG_MAX);
+    if (!t.album[0])
+      decodeLatin1(v1 + 63, 30, t.album, TRACK_TAG_MAX);
+  }
+
+  static Mp3SeekTable table;
+  Mp3SeekTable &st = seek ? *seek : table;
+  mp3SeekBuildAt(f, path, t.audioStart, audioEnd, st, seekScratch);
+  t.durationMs = tlenMs ? tlenMs : st.durationMs;
+  return t.title[0] || t.artist[0] || t.album[0] || t.durationMs;
+}
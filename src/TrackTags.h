@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Mp3Seek.h"
+#include "hal/Hal.h"
+
+// ID3 tags and length of an MP3 file. ID3v2.2/2.3/2.4 text frames (title,
+// artist, album, TLEN) come first, ID3v1 fills what is still empty. The
+// length is TLEN, else the one of the seek table (Mp3Seek.h). Texts are UTF-8,
+// control characters turned into spaces, cut to TRACK_TAG_MAX - 1 bytes.
+// Only seeks and small reads: cover art and other big frames are skipped.
+static constexpr size_t TRACK_TAG_MAX = 64;
+
+struct TrackTags {
+  char title[TRACK_TAG_MAX];
+  char artist[TRACK_TAG_MAX];
+  char album[TRACK_TAG_MAX];
+  uint32_t durationMs; // 0 = unknown
+  uint32_t audioStart; // first byte after the ID3v2 tag
+};
+
+// False if the file has neither tags nor a readable MPEG frame. The seek
+// table comes with it when seek is given (it is built for the length anyway);
+// path is for its cache and may be nullptr.
+bool readTrackTags(HalFile &f, const char *path, TrackTags &t,
+                   Mp3SeekTable *seek = nullptr);
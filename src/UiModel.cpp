@@ -0,0 +1,66 @@
+#include "UiModel.h"
+
+UiModel ui{};
+
+void copyUtf8(char *dst, size_t dstSize, const char *src) {
+  size_t n = strlen(src);
+  if (n >= dstSize) {
+    n = dstSize - 1;
+    while (n > 0 && ((uint8_t)src[n] & 0xC0) == 0x80)
+      n--;
+  }
+  memcpy(dst, src, n);
+  dst[n] = '\0';
+}
+
+// Read Song title and artist from file name
+// Trims spaces and turns '_' into ' ' in place
+static void uiCleanMetaField(char *s) {
+  for (char *p = s; *p; p++) {
+    if (*p == '_')
+      *p = ' ';
+  }
+  char *b = s;
+  while (*b == ' ')
+    b++;
+  size_t n = strlen(b);
+  while (n > 0 && b[n - 1] == ' ')
+    n--;
+  memmove(s, b, n);
+  s[n] = '\0';
+}
+
+void parseMetaFromFilename(const char *path, char *titleOut, size_t titleSize,
+                           char *artistOut, size_t artistSize) {
+  titleOut[0] = '\0';
+  artistOut[0] = '\0';
+
+  // basename
+  const char *slash = strrchr(path, '/');
+  const char *base = slash ? slash + 1 : path;
+
+  // strip extension
+  const char *dot = strrchr(base, '.');
+  size_t baseLen = (dot && dot > base) ? (size_t)(dot - base) : strlen(base);
+
+  // split by ##
+  const char *sep = strstr(base, "##");
+  if (sep && (size_t)(sep - base) >= baseLen)
+    sep = nullptr;
+  size_t tLen = sep ? (size_t)(sep - base) : baseLen;
+  if (tLen >= titleSize)
+    tLen = titleSize - 1;
+  memcpy(titleOut, base, tLen);
+  titleOut[tLen] = '\0';
+
+  if (sep) {
+    size_t aLen = baseLen - (size_t)(sep + 2 - base);
+    if (aLen >= artistSize)
+      aLen = artistSize - 1;
+    memcpy(artistOut, sep + 2, aLen);
+    artistOut[aLen] = '\0';
+  }
+
+  uiCleanMetaField(titleOut);
+  uiCleanMetaField(artistOut);
+}
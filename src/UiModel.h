@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// UI model for the OLED. Fixed-size text fields (no heap); every change
+// bumps the field's generation, so the display side only compares integers.
+// Line 1 (mode), icons and volume are derived from player state.
+static constexpr size_t UI_LINE2_MAX = 64;
+static constexpr size_t UI_LINE3_MAX = 128;
+
+template <size_t N> struct UiText {
+  char text[N];
+  uint32_t gen;
+};
+
+struct UiModel {
+  UiText<UI_LINE2_MAX> line2; // song titel or game titel
+  UiText<UI_LINE3_MAX> line3; // track, game progress or hint
+};
+
+extern UiModel ui;
+
+// What the display shows: a copy of the UI model plus the player state the
+// top line, icons and volume bar are drawn from. Handed to Display::show().
+struct UiSnapshot {
+  bool gameMode;
+  bool locked;
+  bool antiRepeat;
+  bool shuffle;
+  int pct;
+  int progress; // % of the track played, -1 = no progress bar
+  uint32_t line2Gen;
+  uint32_t line3Gen;
+  char line2[UI_LINE2_MAX];
+  char line3[UI_LINE3_MAX];
+};
+
+// Copies src, cutting at a UTF-8 character boundary if it does not fit
+void copyUtf8(char *dst, size_t dstSize, const char *src);
+
+template <size_t N> static void uiSet(UiText<N> &f, const char *text) {
+  char tmp[N];
+  copyUtf8(tmp, N, text);
+  if (strcmp(tmp, f.text) == 0)
+    return;
+  memcpy(f.text, tmp, N);
+  f.gen++;
+}
+
+template <size_t N>
+static void uiSetf(UiText<N> &f, const char *fmt, ...) {
+  char tmp[N];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(tmp, N, fmt, ap);
+  va_end(ap);
+  uiSet(f, tmp);
+}
+
+// "<title>##<artist>.mp3" -> title/artist, on caller-provided buffers
+void parseMetaFromFilename(const char *path, char *titleOut, size_t titleSize,
+                           char *artistOut, size_t artistSize);
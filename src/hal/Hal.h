@@ -0,0 +1,179 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+
+// Hardware abstraction for the player logic (catalog, playlist, game engine,
+// UI model). The logic only talks to these interfaces; the firmware fills
+// `hal` with SD/Preferences/RC522/I2S/OLED backends in setup(), the native
+// build (env:native) with a local directory as SD card, a WAV file as audio
+// output and a scripted card reader. Everything is called from the loop
+// context, except where a backend says otherwise. The file system is also
+// used by the library indexer (LibraryIndex.h), which the firmware runs in
+// a task of its own.
+
+struct UiSnapshot; // UiModel.h
+
+class Clock {
+public:
+  virtual ~Clock() = default;
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;
+  // CPU cycle counter for short timings (LoopProfile). It wraps, and its
+  // rate follows the CPU clock: take cyclesPerUs() together with it.
+  virtual uint32_t cycles() = 0;
+  virtual uint32_t cyclesPerUs() = 0;
+};
+
+// ---- File system (SD card) ----
+enum class FileMode : uint8_t { READ, WRITE };
+
+class HalFile {
+public:
+  virtual ~HalFile() = default;
+  virtual size_t read(uint8_t *buf, size_t len) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) = 0;
+  virtual size_t size() = 0;
+  virtual bool seek(size_t pos) = 0; // from the start of the file
+
+  // Reader interface for deserializeJson(doc, file)
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  size_t readBytes(char *buf, size_t len) { return read((uint8_t *)buf, len); }
+};
+
+struct DirEntry {
+  const char *name; // without folder
+  bool isDir;
+  uint32_t size;  // bytes, 0 for folders
+  uint32_t mtime; // last write, seconds; 0 if unknown
+};
+
+class FileSystem {
+public:
+  using DirFn = std::function<void(const DirEntry &e)>;
+
+  virtual ~FileSystem() = default;
+  virtual bool exists(const char *path) = 0;
+  // Size and date of path (name = path); false if it does not exist
+  virtual bool stat(const char *path, DirEntry &out) = 0;
+  // nullptr when the file cannot be opened; closed when released
+  virtual std::unique_ptr<HalFile> open(const char *path, FileMode mode) = 0;
+  // Calls fn once per entry; false if no directory
+  virtual bool listDir(const char *path, const DirFn &fn) = 0;
+  virtual bool rename(const char *from, const char *to) = 0;
+  virtual bool remove(const char *path) = 0;
+  virtual bool mkdir(const char *path) = 0; // true if it exists afterwards
+};
+
+// ---- Card reader ----
+enum RfidEventType : uint8_t {
+  RFID_EV_SCAN,     // new card read
+  RFID_EV_REMOVED,  // tracked card no longer answers
+  RFID_EV_RETURNED  // tracked (or last removed) card read again
+};
+
+struct RfidScanEvent {
+  RfidEventType type;
+  char uid[21];          // uppercase hex, max 10 byte UID
+  uint8_t sak;
+  uint8_t attempts;      // read quality: 1 = read on first select
+  uint32_t detectedAtMs; // millis() when the card answered
+  uint32_t readUs;       // read quality: detect -> UID time
+  uint16_t traceId;      // scan latency trace record, 0 = none
+};
+
+class CardReader {
+public:
+  virtual ~CardReader() = default;
+  // Next pending event, false when there is none (never blocks)
+  virtual bool poll(RfidScanEvent &ev) = 0;
+};
+
+// ---- Audio output ----
+// Commands may take effect asynchronously (firmware: audioTask), so state
+// read right after a command can still be the old one.
+static constexpr uint32_t SEEK_END_GUARD_MS = 1000; // seekBy stops before end
+
+class AudioSink {
+public:
+  virtual ~AudioSink() = default;
+  virtual void play(const char *path) = 0; // replaces the current track
+  virtual void pause() = 0;
+  virtual void resume() = 0;
+  virtual void togglePause() = 0;
+  virtual void setGain(float gain) = 0;
+  virtual bool isPlaying() = 0;
+  virtual bool isPaused() = 0;
+  // True once per track that played to its end (not for replaced tracks)
+  virtual bool takeTrackEnded() = 0;
+  // Jump within the current track, clamped to its start and to
+  // SEEK_END_GUARD_MS before its end (holding FF does not skip the track)
+  virtual void seekBy(int32_t deltaMs) = 0;
+  // Of the current track; 0 while not known (e.g. just started)
+  virtual uint32_t positionMs() = 0;
+  virtual uint32_t durationMs() = 0;
+};
+
+// ---- Key/value store (Preferences) ----
+class KvStore {
+public:
+  virtual ~KvStore() = default;
+  virtual int32_t getInt(const char *key, int32_t def) = 0;
+  virtual void putInt(const char *key, int32_t value) = 0;
+  // Copies the value to buf and returns its length; 0 (buf empty) when the
+  // key is missing or the value does not fit
+  virtual size_t getString(const char *key, char *buf, size_t size) = 0;
+  virtual void putString(const char *key, const char *value) = 0;
+};
+
+// ---- Display + card LED ----
+class Display {
+public:
+  virtual ~Display() = default;
+  // Latest UI state; called when something in it changed
+  virtual void show(const UiSnapshot &s) = 0;
+  virtual void setCardLed(bool on) = 0; // ignored while blinking
+  virtual void blinkCardLed(uint32_t now, uint32_t durationMs) = 0;
+  virtual void stopCardLedBlink() = 0;
+};
+
+// ---- Heap (MemTrack.h) ----
+enum MemRegion : uint8_t { MEM_INTERNAL, MEM_PSRAM, MEM_REGION_COUNT };
+
+struct HeapRegionInfo {
+  size_t totalBytes; // 0 = not present or unknown (skipped in reports)
+  size_t usedBytes;
+  size_t freeBytes;
+  size_t minFreeBytes; // low-water mark since boot
+  size_t largestFreeBlock;
+};
+
+// May be called from any task
+class HeapInfo {
+public:
+  virtual ~HeapInfo() = default;
+  virtual MemRegion regionOf(const void *p) = 0;
+  virtual size_t blockSize(const void *p) = 0; // of a malloc'ed block
+  virtual HeapRegionInfo region(MemRegion r) = 0;
+  // Long-lived bulk data (catalog, playlist): PSRAM when there is any,
+  // internal RAM otherwise. nullptr when neither has room; free with free().
+  virtual void *allocLarge(size_t bytes) = 0;
+};
+
+struct Hal {
+  Clock *clock = nullptr;
+  FileSystem *fs = nullptr;
+  CardReader *cards = nullptr;
+  AudioSink *audio = nullptr;
+  KvStore *kv = nullptr;
+  Display *display = nullptr;
+  HeapInfo *heap = nullptr; // set first: MemTrack books from then on
+};
+
+extern Hal hal;
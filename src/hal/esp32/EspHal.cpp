@@ -0,0 +1,127 @@
+#include "EspHal.h"
+
+#include <SD.h>
+#include <esp_heap_caps.h>
+#include <esp_memory_utils.h>
+
+uint32_t ArduinoClock::millis() { return ::millis(); }
+uint32_t ArduinoClock::micros() { return ::micros(); }
+uint32_t ArduinoClock::cycles() { return ESP.getCycleCount(); }
+uint32_t ArduinoClock::cyclesPerUs() { return getCpuFrequencyMhz(); }
+
+MemRegion EspHeapInfo::regionOf(const void *p) {
+  return esp_ptr_external_ram(p) ? MEM_PSRAM : MEM_INTERNAL;
+}
+
+size_t EspHeapInfo::blockSize(const void *p) {
+  return heap_caps_get_allocated_size(const_cast<void *>(p));
+}
+
+HeapRegionInfo EspHeapInfo::region(MemRegion r) {
+  uint32_t caps = r == MEM_PSRAM ? MALLOC_CAP_SPIRAM
+                                 : (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  HeapRegionInfo h;
+  h.totalBytes = heap_caps_get_total_size(caps);
+  h.freeBytes = heap_caps_get_free_size(caps);
+  h.usedBytes = h.totalBytes - h.freeBytes;
+  h.minFreeBytes = heap_caps_get_minimum_free_size(caps);
+  h.largestFreeBlock = heap_caps_get_largest_free_block(caps);
+  return h;
+}
+
+void *EspHeapInfo::allocLarge(size_t bytes) {
+  return heap_caps_malloc_prefer(bytes, 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+                                 MALLOC_CAP_DEFAULT);
+}
+
+namespace {
+
+class SdFile : public HalFile {
+public:
+  explicit SdFile(File f) : f_(f) {}
+  ~SdFile() override { f_.close(); }
+
+  size_t read(uint8_t *buf, size_t len) override { return f_.read(buf, len); }
+  size_t write(const uint8_t *buf, size_t len) override {
+    return f_.write(buf, len);
+  }
+  size_t size() override { return f_.size(); }
+  bool seek(size_t pos) override { return f_.seek(pos); }
+
+private:
+  File f_;
+};
+
+} // namespace
+
+bool SdFileSystem::exists(const char *path) { return SD.exists(path); }
+
+bool SdFileSystem::stat(const char *path, DirEntry &out) {
+  File f = SD.open(path);
+  if (!f)
+    return false;
+  bool isDir = f.isDirectory();
+  out = DirEntry{path, isDir, isDir ? 0u : (uint32_t)f.size(),
+                 (uint32_t)f.getLastWrite()};
+  f.close();
+  return true;
+}
+
+std::unique_ptr<HalFile> SdFileSystem::open(const char *path, FileMode mode) {
+  File f = SD.open(path, mode == FileMode::WRITE ? FILE_WRITE : FILE_READ);
+  if (!f)
+    return nullptr;
+  return std::unique_ptr<HalFile>(new SdFile(f));
+}
+
+bool SdFileSystem::listDir(const char *path, const DirFn &fn) {
+  File dir = SD.open(path);
+  if (!dir || !dir.isDirectory())
+    return false;
+
+  for (;;) {
+    File f = dir.openNextFile();
+    if (!f)
+      break;
+    bool isDir = f.isDirectory();
+    fn(DirEntry{f.name(), isDir, isDir ? 0u : (uint32_t)f.size(),
+                (uint32_t)f.getLastWrite()});
+    f.close();
+  }
+  dir.close();
+  return true;
+}
+
+bool SdFileSystem::rename(const char *from, const char *to) {
+  return SD.rename(from, to);
+}
+
+bool SdFileSystem::remove(const char *path) { return SD.remove(path); }
+
+bool SdFileSystem::mkdir(const char *path) {
+  return SD.exists(path) || SD.mkdir(path);
+}
+
+int32_t PrefsKvStore::getInt(const char *key, int32_t def) {
+  return prefs_.getInt(key, def);
+}
+
+void PrefsKvStore::putInt(const char *key, int32_t value) {
+  prefs_.putInt(key, value);
+}
+
+size_t PrefsKvStore::getString(const char *key, char *buf, size_t size) {
+  buf[0] = '\0';
+  if (!prefs_.isKey(key))
+    return 0;
+  // Returns 0 when the value (plus terminator) does not fit
+  if (prefs_.getString(key, buf, size) == 0) {
+    buf[0] = '\0';
+    return 0;
+  }
+  return strlen(buf);
+}
+
+void PrefsKvStore::putString(const char *key, const char *value) {
+  prefs_.putString(key, value);
+}
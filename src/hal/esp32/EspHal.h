@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Preferences.h>
+
+#include "../Hal.h"
+
+// Firmware backends for the parts of the HAL that only wrap Arduino
+// libraries. Card reader, audio and display backends live next to their
+// tasks in main.cpp.
+
+class ArduinoClock : public Clock {
+public:
+  uint32_t millis() override;
+  uint32_t micros() override;
+  uint32_t cycles() override;
+  uint32_t cyclesPerUs() override;
+};
+
+// heap_caps_* for internal RAM and PSRAM
+class EspHeapInfo : public HeapInfo {
+public:
+  MemRegion regionOf(const void *p) override;
+  size_t blockSize(const void *p) override;
+  HeapRegionInfo region(MemRegion r) override;
+  void *allocLarge(size_t bytes) override;
+};
+
+// SD card (SD.begin() is done by setup())
+class SdFileSystem : public FileSystem {
+public:
+  bool exists(const char *path) override;
+  bool stat(const char *path, DirEntry &out) override;
+  std::unique_ptr<HalFile> open(const char *path, FileMode mode) override;
+  bool listDir(const char *path, const DirFn &fn) override;
+  bool rename(const char *from, const char *to) override;
+  bool remove(const char *path) override;
+  bool mkdir(const char *path) override;
+};
+
+// Preferences namespace, opened by begin()
+class PrefsKvStore : public KvStore {
+public:
+  void begin(const char *ns) { prefs_.begin(ns, false); }
+
+  int32_t getInt(const char *key, int32_t def) override;
+  void putInt(const char *key, int32_t value) override;
+  size_t getString(const char *key, char *buf, size_t size) override;
+  void putString(const char *key, const char *value) override;
+
+private:
+  Preferences prefs_;
+};
@@ -1,8 +1,6 @@
-#include <Preferences.h>
 #include <SD.h>
 #include <SPI.h>
 
-#include <ArduinoJson.h>
 #include <MFRC522.h>
 // Display
 #include <U8g2lib.h>
@@ -12,6 +10,25 @@
 #include "AudioFileSourceSD.h"
 #include "AudioGeneratorMP3.h"
 #include "AudioOutputI2S.h"
+#include <driver/i2s.h>
+#include <esp_pm.h>
+
+#include "ButtonInput.h"
+#include "Buttons.h"
+#include "Catalog.h"
+#include "GameEngine.h"
+#include "LibraryIndex.h"
+#include "LoopProfile.h"
+#include "MemTrack.h"
+#include "Mp3Seek.h"
+#include "PathCache.h"
+#include "Player.h"
+#include "Playlist.h"
+#include "ScanTrace.h"
+#include "SettingsReload.h"
+#include "UiModel.h"
+#include "hal/Hal.h"
+#include "hal/esp32/EspHal.h"
 
 // Display
 static constexpr uint8_t PIN_OLED_SDA = 42;
@@ -26,6 +43,7 @@ static constexpr uint8_t PIN_SD_CS = 10;
 // RC522 (Shared SPI, own CS)
 static constexpr uint8_t PIN_RC522_CS = 21; // RC522 SDA/SS
 static constexpr uint8_t PIN_RC522_RST = 4;
+static constexpr uint8_t PIN_RC522_IRQ = 8;
 
 // UDA1334 (I2S)
 static constexpr int PIN_I2S_BCLK = 6;
@@ -43,118 +61,43 @@ static constexpr uint8_t PIN_BTN_PLAY = 41;
 // LED for RFID Card Detection
 static constexpr uint8_t PIN_LED_CARD = 2;
 
-// ---------------- Volume control ----------------
-static Preferences prefs;
+// Preferences (volume, last track) through hal.kv
 static constexpr const char *PREF_NS = "player";
-static constexpr const char *PREF_KEY_VOL = "vol_x100";
-
-static bool volDirty = false;
-static uint32_t volLastChangedAt = 0;
-static constexpr uint32_t VOL_SAVE_DELAY_MS = 800;
-
-static float currentVolume = 0.4f; // start-volumen
-static constexpr float VOL_STEP = 0.05f;
-static constexpr float VOL_MIN = 0.05f;
-static constexpr float VOL_MAX = 0.9f;
-
-// Save meta data for
-#include <string>
-#include <unordered_map>
-struct TrackMeta {
-  String title;
-  String artist;
-};
-static std::unordered_map<std::string, TrackMeta> trackMetaByPath;
-
-static std::unordered_map<std::string, String> albumTitleByFolder;
-
-static inline std::string keyOfPath(const String &p) {
-  return std::string(p.c_str());
-}
-
-static String normalizeFolder(String f) {
-  f.trim();
-  if (!f.startsWith("/"))
-    f = "/" + f;
-  while (f.indexOf("//") >= 0)
-    f.replace("//", "/");
-  if (f.length() > 1 && f.endsWith("/"))
-    f.remove(f.length() - 1);
-  return f;
-}
-
-static String dirnameOf(const String &fullPath) {
-  int slash = fullPath.lastIndexOf('/');
-  if (slash <= 0)
-    return "/";
-  return fullPath.substring(0, slash);
-}
-
-static String lookupAlbumTitleForTrackPath(const String &trackPath) {
-  String folder = normalizeFolder(dirnameOf(trackPath));
-  auto it = albumTitleByFolder.find(keyOfPath(folder));
-  if (it != albumTitleByFolder.end())
-    return it->second;
-  return "";
-}
-
-// Handle last track for play/pause
-static constexpr const char *PREF_KEY_LASTPATH = "last_path";
-static char lastPath[128] = {0}; // RAM copy
-static bool hasLastPath = false;
-
-static constexpr size_t MAX_ACTIVE = 300;
-static String activeTracks[MAX_ACTIVE];
-static size_t activeCount = 0;
-static int activeIndex = -1;
-
-// Variables for OLED display
-static String oledLine1; // Mode
-static String oledLine2; // song titel or game titel
-static String oledLine3; // Only music
-
-static String activeTitle[MAX_ACTIVE];
-static String activeArtist[MAX_ACTIVE];
-static String activePlaylistTitle; // til linje 2
-
-enum Action {
-  ACT_PLAY_PAUSE,
-  ACT_NEXT,
-  ACT_PREV,
-  ACT_VOL_UP,
-  ACT_VOL_DOWN,
-  ACT_MODE_MUSIC,
-  ACT_MODE_GAME_A,
-  ACT_MODE_GAME_B
-};
-
-struct Button {
-  uint8_t pin;
-  Action action;
-  bool lastState;
-  uint32_t lastChange;
-  // For long-press repeat
-  uint32_t pressedAt;
-  uint32_t lastRepeat;
-};
 
-static constexpr uint32_t DEBOUNCE_MS = 30;
-
-Button buttons[] = {
-    {PIN_BTN_FORWARD, ACT_NEXT, HIGH, 0, 0, 0},
-    {PIN_BTN_PLAY, ACT_PLAY_PAUSE, HIGH, 0, 0, 0},
-    {PIN_BTN_BACK, ACT_PREV, HIGH, 0, 0, 0},
-    {PIN_BTN_VOL_UP, ACT_VOL_UP, HIGH, 0, 0, 0},
-    {PIN_BTN_VOL_DOWN, ACT_VOL_DOWN, HIGH, 0, 0, 0},
-    {PIN_BTN_MODE_MUS, ACT_MODE_MUSIC, HIGH, 0, 0, 0}
-    // {PIN_BTN_MODE_GA, ACT_MODE_GAME_A, HIGH, 0, 0, 0},
-    // {PIN_BTN_MODE_GB, ACT_MODE_GAME_B, HIGH, 0, 0, 0},
+// Pins of the buttons in Buttons.h, in the order of BUTTONS
+static constexpr uint8_t BUTTON_PINS[] = {
+    PIN_BTN_FORWARD, PIN_BTN_PLAY, PIN_BTN_BACK, PIN_BTN_VOL_UP,
+    PIN_BTN_VOL_DOWN, PIN_BTN_MODE_MUS,
+    // PIN_BTN_MODE_GA, PIN_BTN_MODE_GB,
 };
-
-static constexpr size_t BUTTON_COUNT = sizeof(buttons) / sizeof(buttons[0]);
-
-static constexpr uint32_t LONGPRESS_START_MS = 350; // When repeat starts
-static constexpr uint32_t LONGPRESS_REPEAT_MS = 80; // repeat-interval
+static_assert(sizeof(BUTTON_PINS) == BUTTON_COUNT, "a pin for every button");
+
+// Buttons are read by GPIO edge interrupts (both edges) that queue
+// timestamped levels to buttonTask. The task runs debounce + repeat
+// (ButtonInput) and sleeps until the next settle/repeat deadline, so it acts
+// as the software timer. Recognised presses go to loop() over buttonEventQ;
+// a press is never lost while loop() is busy, and its edge time is kept.
+static constexpr BaseType_t BUTTON_TASK_CORE = 0;
+static constexpr UBaseType_t BUTTON_TASK_PRIO = 3;
+static constexpr uint32_t BUTTON_TASK_STACK = 3072;
+static constexpr UBaseType_t BUTTON_EDGE_QUEUE_LEN = 32; // bounces included
+static constexpr UBaseType_t BUTTON_EVENT_QUEUE_LEN = 16;
+static constexpr bool BUTTON_STATS_ENABLED = true;
+static constexpr uint32_t BUTTON_STATS_MS = 10000;
+
+static ButtonInput buttonInput(BUTTON_TIMING, BUTTON_COUNT);
+static QueueHandle_t buttonEdgeQ = nullptr;
+static QueueHandle_t buttonEventQ = nullptr;
+static TaskHandle_t buttonTaskHandle = nullptr;
+static volatile bool buttonEdgeOverflow = false;
+static bool buttonRawDown[BUTTON_COUNT]; // last level seen by buttonTask
+
+static volatile uint32_t buttonStatsEdges = 0;
+static uint32_t buttonStatsPresses = 0;
+static uint32_t buttonStatsRepeats = 0;
+static uint32_t buttonStatsDrops = 0;
+static uint32_t buttonStatsLatencyMaxMs = 0; // edge -> handleAction
+static uint32_t buttonStatsSince = 0;
 
 // LED BLINKING START
 
@@ -204,356 +147,564 @@ static void ledSetNormal(bool on) {
 
 // LED BLINKING END
 
+// ================= POWER MANAGER =================
+// The CPU clock follows the workload: CPU_MHZ_PLAYING while decoding,
+// CPU_MHZ_IDLE otherwise. With nothing playing and no button/card activity
+// for POWER_AWAKE_MS the chip may enter automatic light sleep whenever all
+// tasks are blocked (esp_pm; needs CONFIG_PM_ENABLE, otherwise only the clock
+// is scaled). loop() and audioTask block instead of spinning so idle is
+// actually reached.
+//
+// GPIO wakeup would turn the button and RC522 edge interrupts into level
+// interrupts, so sleep is bounded by task timeouts instead: rfidTask wakes
+// for every REQA kick (RFID_IRQ_KICK_MS) and buttonTask samples the pins
+// every BUTTON_SLEEP_POLL_MS while light sleep is allowed.
+enum PowerState : uint8_t { PWR_PLAYING, PWR_AWAKE, PWR_SLEEP, PWR_STATE_COUNT };
+
+static constexpr uint32_t CPU_MHZ_PLAYING = 240;
+static constexpr uint32_t CPU_MHZ_IDLE = 80;
+static constexpr bool POWER_LIGHT_SLEEP = true;
+static constexpr uint32_t POWER_AWAKE_MS = 10000; // after last button/card
+static constexpr uint32_t LOOP_WAIT_ACTIVE_MS = 10;
+static constexpr uint32_t LOOP_WAIT_SLEEP_MS = 50;
+static constexpr uint32_t BUTTON_SLEEP_POLL_MS = 20;
+static constexpr uint32_t POWER_STATS_MS = 60000;
+
+static TaskHandle_t loopTaskHandle = nullptr;
+static volatile bool powerLightSleepAllowed = false;
+static uint32_t powerLastActivityAt = 0;
+
+// Wake loop() before its timeout: new button/RFID event or audio state change
+static void powerWakeLoop() {
+  if (loopTaskHandle)
+    xTaskNotifyGive(loopTaskHandle);
+}
+
+static void powerNoteActivity(uint32_t now) { powerLastActivityAt = now; }
+
+// ---------------- Runtime stats (serial console "stats") ----------------
+// Counted since boot or the last "reset-stats". Each counter is written by
+// one task (see comment) and read by the console in loop() without locking,
+// so a report can mix values from just before and after an update.
+//
+// An underrun is counted when audioTask comes back to the decoder later
+// than the I2S DMA buffer lasts (ESP8266Audio: 8 x 128 frames, ~23 ms at
+// 44.1 kHz); the buffer was full when it left, so it has run dry by then.
+static constexpr uint32_t AUDIO_UNDERRUN_GAP_US = 23000;
+
+static uint32_t statsSince = 0;
+static uint32_t statsLoops = 0;                   // loop()
+static uint32_t statsLoopGapMaxUs = 0;            // loop()
+static volatile uint32_t statsAudioBusyUs = 0;    // audioTask: in mp3->loop()
+static volatile uint32_t statsAudioLoopMaxUs = 0; // audioTask
+static volatile uint32_t statsAudioUnderruns = 0; // audioTask
+static volatile uint32_t statsTracks = 0;         // audioTask: started OK
+static volatile uint32_t statsStarts = 0;         // audioTask: startTrack()
+static volatile uint32_t statsStartSdLookups = 0; // audioTask: exists + open
+static volatile uint32_t statsSdBytes = 0;        // audioTask: MP3 file reads
+static volatile uint32_t statsSdReads = 0;        // audioTask
+static volatile uint32_t statsSdReadUs = 0;       // audioTask
+static volatile uint32_t statsSdReadMaxUs = 0;    // audioTask
+static volatile uint32_t statsSeeks = 0;          // audioTask
+static volatile uint32_t statsSeekMaxUs = 0;      // audioTask: lookup + seek
+static uint32_t statsScans = 0;         // loop(): events taken from rfidQ
+static uint32_t statsScanWaitSumMs = 0; // loop(): detect -> loop() has it
+static uint32_t statsScanWaitMaxMs = 0;
+static uint32_t statsScanReadSumUs = 0; // loop(): detect -> UID (rfidTask)
+static uint32_t statsScanReadMaxUs = 0;
+
 // ---------------- RC522 ----------------
 MFRC522 mfrc522(PIN_RC522_CS, PIN_RC522_RST);
 
-// ---------------- Audio ----------------
-AudioGeneratorMP3 *mp3 = nullptr;
-AudioFileSourceSD *file = nullptr;
-AudioOutputI2S *out = nullptr;
-
-// Parent Control
-
-struct UiMessages {
-  String antiRepeatWarning;
-  String antiRepeatEnabled;
-  String antiRepeatDisabled;
-
-  String volumeLockOn;
-  String volumeLockOff;
-
-  String mastercard_used;
-
-  String musicModeInfo;
-};
-
-static UiMessages uiMessages;
-
-static bool parentalAntiRepeatEnabled = false;
-static String lastStartedPath = "";
-static uint8_t sameTrackStreak =1; // 0,1,2,... (konsekutive gange samme track startes)
-
-static bool volumeLocked = false;
-static float lockedVolume = 0.0f;
+// Card detection mode. IRQ mode sends a bare REQA every RFID_IRQ_KICK_MS
+// (3 register writes) with only the RX interrupt routed to PIN_RC522_IRQ, so
+// the reader is only read out when a card actually answered. Poll mode is the
+// classic PICC_IsNewCardPresent() every RFID_POLL_MS (~20 SPI transfers).
+// If the IRQ line does not respond at boot we fall back to polling.
+static constexpr bool RFID_USE_IRQ = true;
+static constexpr uint32_t RFID_POLL_MS = 25;
+static constexpr uint32_t RFID_IRQ_KICK_MS = 20;
+
+// Prints SPI transfers/s, detect -> UID latency, queue depth and worst-case
+// handling time every RFID_STATS_MS
+static constexpr bool RFID_STATS_ENABLED = true;
+static constexpr uint32_t RFID_STATS_MS = 10000;
+
+// The reader is serviced by rfidTask, which publishes RfidScanEvents to loop()
+// over rfidQ. Audio and loop() run on core 1.
+static constexpr BaseType_t RFID_TASK_CORE = 0;
+static constexpr UBaseType_t RFID_TASK_PRIO = 2;
+static constexpr uint32_t RFID_TASK_STACK = 4096;
+static constexpr UBaseType_t RFID_QUEUE_LEN = 4;
+static constexpr uint8_t RFID_READ_ATTEMPTS = 2; // WUPA + select retry
+
+// Presence tracking: the last read card is checked every
+// rfidPresenceCheckMs with a WUPA + SELECT of its known UID (no
+// anticollision) and a 1 ms RC522 timeout, then halted again.
+// RFID_PRESENCE_MISSES failed checks in a row report the card as removed.
+// Interval and pause-on-removal come from settings.json ("rfid" object);
+// only pause-on-removal needs the checks, so without it there are none.
+static constexpr uint8_t RFID_PRESENCE_MISSES = 2;
+static constexpr byte RC522_PRESENCE_TIMEOUT_TICKS = 40; // 40 x 25us = 1 ms
+static constexpr byte RC522_DEFAULT_TIMEOUT_TICKS_H = 0x03; // 1000 = 25 ms,
+static constexpr byte RC522_DEFAULT_TIMEOUT_TICKS_L = 0xE8; // as PCD_Init
+// Budget for presence checks on the SPI bus shared with audio; exceeding it
+// is reported in the stats line. ~10 us of bus time per RC522 transfer.
+static constexpr uint32_t RFID_PRESENCE_SPI_BUDGET_PER_SEC = 200;
+static constexpr uint32_t RC522_US_PER_TRANSFER = 10;
+
+static volatile uint32_t rfidPresenceCheckMs = 0;
+
+// Checks cost SPI time next to the audio: 0 (off) unless a lifted card
+// pauses the music
+static uint32_t rfidPresenceInterval() {
+  return rfidSettings.pauseOnRemoval ? rfidSettings.presenceCheckMs : 0;
+}
+
+static QueueHandle_t rfidQ = nullptr;
+static TaskHandle_t rfidTaskHandle = nullptr;
+
+// RC522 register values used for IRQ mode
+static constexpr byte RC522_IRQ_INV = 0x80;     // ComIEnReg: IRQ pin active low
+static constexpr byte RC522_RX_IEN = 0x20;      // ComIEnReg: receiver IRQ
+static constexpr byte RC522_TIMER_IEN = 0x01;   // ComIEnReg: timer IRQ
+static constexpr byte RC522_CLEAR_IRQS = 0x7F;  // ComIrqReg: clear all
+static constexpr byte RC522_START_SEND_7 = 0x87; // BitFramingReg: 7 bit frame
+
+static bool rfidIrqMode = false;
+static volatile bool rfidIrqPending = false;
+static volatile uint32_t rfidIrqAtUs = 0;
+
+// Falling edges on the RC522 CS line = SPI transfers to the reader
+static volatile uint32_t rfidSpiTransfers = 0;
+
+static uint32_t rfidDetectAtUs = 0;
+// The card came into the field between the last kick/poll nobody answered
+// and the detection; that gap is the most a scan waited for detection.
+static uint32_t rfidLastKickUs = 0;  // IRQ mode: last REQA, 0 = none yet
+static uint32_t rfidLastEmptyUs = 0; // last unanswered kick/poll, 0 = unknown
+static uint32_t rfidStatsScans = 0;
+static uint32_t rfidStatsLatencySumUs = 0;
+static uint32_t rfidStatsLatencyMaxUs = 0;
+static uint32_t rfidStatsGapScans = 0;
+static uint32_t rfidStatsGapSumUs = 0;
+static uint32_t rfidStatsGapMaxUs = 0;
+static uint32_t rfidStatsSince = 0;
+static uint32_t rfidStatsSpiBase = 0;
+static uint32_t rfidStatsHandleMaxUs = 0;
+static uint32_t rfidStatsReadFails = 0;
+static uint32_t rfidStatsDrops = 0;
+static UBaseType_t rfidStatsQueueMax = 0;
+static uint32_t rfidStatsPresenceChecks = 0;
+static uint32_t rfidStatsPresenceSpi = 0;
+
+// Presence tracking state (owned by rfidTask)
+static MFRC522::Uid rfidHeldUid;
+static bool rfidHolding = false;
+static uint8_t rfidPresenceMisses = 0;
+static uint32_t rfidLastPresenceAt = 0;
+static MFRC522::Uid rfidRemovedUid;
+static bool rfidHasRemoved = false;
+
+static void IRAM_ATTR rfidIrqIsr() {
+  if (!rfidIrqPending) {
+    rfidIrqAtUs = micros();
+    rfidIrqPending = true;
+  }
+  if (rfidTaskHandle) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(rfidTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+static void IRAM_ATTR rfidCsIsr() { rfidSpiTransfers++; }
+
+static void rfidClearIrq() {
+  mfrc522.PCD_WriteRegister(MFRC522::ComIrqReg, RC522_CLEAR_IRQS);
+}
+
+// Ask any card in the field to answer; the answer raises the RX IRQ
+static void rfidKickReqA() {
+  mfrc522.PCD_WriteRegister(MFRC522::FIFODataReg, MFRC522::PICC_CMD_REQA);
+  mfrc522.PCD_WriteRegister(MFRC522::CommandReg, MFRC522::PCD_Transceive);
+  mfrc522.PCD_WriteRegister(MFRC522::BitFramingReg, RC522_START_SEND_7);
+}
+
+// Call after PCD_Init(). Verifies the IRQ wiring with the reader's timer IRQ
+// (fires ~25 ms after an unanswered REQA), then arms the RX IRQ only.
+static void rfidInitDetection() {
+  if (RFID_STATS_ENABLED) {
+    attachInterrupt(digitalPinToInterrupt(PIN_RC522_CS), rfidCsIsr, FALLING);
+  }
+  rfidStatsSince = millis();
+
+  if (!RFID_USE_IRQ)
+    return;
 
-static bool volumeDirty = false;
-static uint8_t lastVolumeChangeAt = 0;
+  pinMode(PIN_RC522_IRQ, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(PIN_RC522_IRQ), rfidIrqIsr, FALLING);
 
+  mfrc522.PCD_WriteRegister(MFRC522::ComIEnReg,
+                            RC522_IRQ_INV | RC522_TIMER_IEN);
+  rfidClearIrq();
+  rfidIrqPending = false;
+  rfidKickReqA();
+  delay(60);
+  bool wired = rfidIrqPending;
 
-static float getEffectiveVolume() {
-  return volumeLocked ? lockedVolume : currentVolume;
-}
+  mfrc522.PCD_WriteRegister(MFRC522::ComIEnReg, RC522_IRQ_INV | RC522_RX_IEN);
+  rfidClearIrq();
+  rfidIrqPending = false;
 
-static float clampf(float v, float lo, float hi) {
-  if (v < lo)
-    return lo;
-  if (v > hi)
-    return hi;
-  return v;
+  if (!wired) {
+    detachInterrupt(digitalPinToInterrupt(PIN_RC522_IRQ));
+    Serial.println("RC522 IRQ not responding -> polling mode");
+    return;
+  }
+  rfidIrqMode = true;
+  Serial.println("RC522 IRQ mode");
 }
 
-static void setVolume(float v) {
-  v = clampf(v, VOL_MIN, VOL_MAX);
-
-  if (volumeLocked) {
-    lockedVolume = v;
-  } else {
-    currentVolume = v;
+// True when a new card answered. The card is left in READY state for
+// PICC_ReadCardSerial(); call rfidEndRead() when done with it.
+static bool rfidNewCardPresent() {
+  if (rfidIrqMode) {
+    if (!rfidIrqPending && digitalRead(PIN_RC522_IRQ) == LOW) {
+      // Edge missed (light sleep), but the RX IRQ is still asserted
+      rfidIrqAtUs = micros();
+      rfidIrqPending = true;
+    }
+    if (rfidIrqPending) {
+      rfidDetectAtUs = rfidIrqAtUs;
+      return true;
+    }
+    // No RX IRQ since the last kick: nothing answered it
+    if (rfidLastKickUs)
+      rfidLastEmptyUs = rfidLastKickUs;
+    rfidKickReqA();
+    rfidLastKickUs = micros();
+    return false;
   }
 
-  // hvis du har noget "volumeDirty" / lastChanged timestamp, sæt det her
-  volumeDirty = true;
-  lastVolumeChangeAt = millis();
+  uint32_t t = micros();
+  if (!mfrc522.PICC_IsNewCardPresent()) {
+    rfidLastEmptyUs = t;
+    return false;
+  }
+  rfidDetectAtUs = t;
+  return true;
 }
 
-static bool antiRepeatBlocksThisStart(const String &path) {
-  if (!parentalAntiRepeatEnabled)
-    return false;
+static void rfidOnUidRead() {
+  uint32_t dt = micros() - rfidDetectAtUs;
+  rfidStatsScans++;
+  rfidStatsLatencySumUs += dt;
+  if (dt > rfidStatsLatencyMaxUs)
+    rfidStatsLatencyMaxUs = dt;
 
-  // Hvis den samme track startes igen
-  if (path == lastStartedPath) {
-    // sameTrackStreak: 1 = anden gang, 2 = tredje gang, ...
-    if (sameTrackStreak >= 2) {
-      return true; // blokér 3. gang (eller mere)
-    }
+  if (rfidLastEmptyUs) {
+    uint32_t gap = rfidDetectAtUs - rfidLastEmptyUs;
+    rfidStatsGapScans++;
+    rfidStatsGapSumUs += gap;
+    if (gap > rfidStatsGapMaxUs)
+      rfidStatsGapMaxUs = gap;
   }
-  return false;
+  // The answered kick is not an empty one
+  rfidLastEmptyUs = 0;
+  rfidLastKickUs = 0;
 }
 
-static void antiRepeatOnTrackStart(const String &path) {
-  if (path == lastStartedPath) {
-    if (sameTrackStreak < 255)
-      sameTrackStreak++;
-  } else {
-    lastStartedPath = path;
-    sameTrackStreak = 1;
-  }
+// Re-arm IRQ detection; IRQs raised by the read itself are discarded here
+static void rfidEndRead() {
+  if (!rfidIrqMode)
+    return;
+  rfidClearIrq();
+  rfidIrqPending = false;
 }
 
+static void rfidStatsTick(uint32_t now) {
+  if (!RFID_STATS_ENABLED)
+    return;
+  uint32_t elapsed = now - rfidStatsSince;
+  if (elapsed < RFID_STATS_MS)
+    return;
 
+  uint32_t spi = rfidSpiTransfers;
+  float perSec = (spi - rfidStatsSpiBase) * 1000.0f / elapsed;
+
+  Serial.printf("RFID[%s] spi/s=%.1f scans=%u detect->uid avg=%uus max=%uus\n",
+                rfidIrqMode ? "IRQ" : "POLL", perSec, (unsigned)rfidStatsScans,
+                (unsigned)(rfidStatsScans ? rfidStatsLatencySumUs / rfidStatsScans
+                                          : 0),
+                (unsigned)rfidStatsLatencyMaxUs);
+  // Measured per scan; the wait for detection is at most this gap
+  Serial.printf("RFID wait: last empty %s->detect avg=%uus max=%uus (%u scans)"
+                "\n",
+                rfidIrqMode ? "kick" : "poll",
+                (unsigned)(rfidStatsGapScans
+                               ? rfidStatsGapSumUs / rfidStatsGapScans
+                               : 0),
+                (unsigned)rfidStatsGapMaxUs, (unsigned)rfidStatsGapScans);
+  Serial.printf("RFID task: queue=%u/%u (max %u) drops=%u readFails=%u "
+                "handle max=%uus\n",
+                (unsigned)uxQueueMessagesWaiting(rfidQ), (unsigned)RFID_QUEUE_LEN,
+                (unsigned)rfidStatsQueueMax, (unsigned)rfidStatsDrops,
+                (unsigned)rfidStatsReadFails, (unsigned)rfidStatsHandleMaxUs);
+
+  uint32_t presencePerSec = rfidStatsPresenceSpi * 1000 / elapsed;
+  Serial.printf("RFID presence: checks=%u spi/s=%u (~%uus bus/s)%s\n",
+                (unsigned)rfidStatsPresenceChecks, (unsigned)presencePerSec,
+                (unsigned)(presencePerSec * RC522_US_PER_TRANSFER),
+                presencePerSec > RFID_PRESENCE_SPI_BUDGET_PER_SEC
+                    ? " OVER BUDGET"
+                    : "");
+
+  rfidStatsSince = now;
+  rfidStatsSpiBase = spi;
+  rfidStatsScans = 0;
+  rfidStatsLatencySumUs = 0;
+  rfidStatsLatencyMaxUs = 0;
+  rfidStatsGapScans = 0;
+  rfidStatsGapSumUs = 0;
+  rfidStatsGapMaxUs = 0;
+  rfidStatsHandleMaxUs = 0;
+  rfidStatsQueueMax = 0;
+  rfidStatsPresenceChecks = 0;
+  rfidStatsPresenceSpi = 0;
+}
+
+static void uidToHex(const MFRC522::Uid &u, char *out, size_t outSize) {
+  static const char HEXCHARS[] = "0123456789ABCDEF";
+  size_t n = 0;
+  for (byte i = 0; i < u.size && n + 2 < outSize; i++) {
+    out[n++] = HEXCHARS[u.uidByte[i] >> 4];
+    out[n++] = HEXCHARS[u.uidByte[i] & 0x0F];
+  }
+  out[n] = '\0';
+}
+
+static bool rfidSameUid(const MFRC522::Uid &a, const MFRC522::Uid &b) {
+  return a.size == b.size && memcmp(a.uidByte, b.uidByte, a.size) == 0;
+}
+
+static void rfidPublish(RfidScanEvent &ev) {
+  if (xQueueSend(rfidQ, &ev, 0) != pdTRUE) {
+    rfidStatsDrops++;
+    return;
+  }
+  powerWakeLoop();
+  UBaseType_t depth = uxQueueMessagesWaiting(rfidQ);
+  if (depth > rfidStatsQueueMax)
+    rfidStatsQueueMax = depth;
+}
 
-// End of Parent Control
+static void rfidSetTimeout(byte hi, byte lo) {
+  mfrc522.PCD_WriteRegister(MFRC522::TReloadRegH, hi);
+  mfrc522.PCD_WriteRegister(MFRC522::TReloadRegL, lo);
+}
 
-// Card tracking
-enum PlayKind : uint8_t {
-  PK_NONE = 0,
-  PK_SINGLE,
-  PK_ALBUM_FOLDER,
-  PK_ALBUM_TRACKS
-};
+// WUPA wakes the halted card, SELECT with all UID bits known addresses only
+// that card. Leaves it halted again so REQA kicks don't report it as new.
+static bool rfidHeldCardAnswers() {
+  rfidSetTimeout(0, RC522_PRESENCE_TIMEOUT_TICKS);
 
-struct TrackItem {
-  String title;  // optional
-  String artist; // optional
-  String file;   // absolute path
-};
+  bool present = false;
+  byte atqa[2];
+  byte atqaSize = sizeof(atqa);
+  if (mfrc522.PICC_WakeupA(atqa, &atqaSize) == MFRC522::STATUS_OK) {
+    MFRC522::Uid u = rfidHeldUid;
+    present = mfrc522.PICC_Select(&u, u.size * 8) == MFRC522::STATUS_OK;
+    mfrc522.PICC_HaltA();
+  }
 
-// A “pool” with all track-items from all album(track-lists)
-static constexpr size_t MAX_TRACKPOOL = 600; // Adjust if needed
-static TrackItem trackPool[MAX_TRACKPOOL];
-static size_t trackPoolCount = 0;
+  rfidSetTimeout(RC522_DEFAULT_TIMEOUT_TICKS_H, RC522_DEFAULT_TIMEOUT_TICKS_L);
+  rfidEndRead();
+  return present;
+}
 
-// Tune these to your needs / memory budget
-static constexpr uint8_t MAX_CARD_TAGS = 8;
+static void rfidPresenceTick(uint32_t now) {
+  uint32_t interval = rfidPresenceCheckMs;
+  if (!rfidHolding || interval == 0)
+    return;
+  if ((uint32_t)(now - rfidLastPresenceAt) < interval)
+    return;
+  rfidLastPresenceAt = now;
 
-struct CardEntry {
-  // Common
-  String uid;  // uppercase hex
-  String role; // "music", "answer", "game_selector"
-  String title;
-  String artist;
+  uint32_t spiBefore = rfidSpiTransfers;
+  bool present = rfidHeldCardAnswers();
+  rfidStatsPresenceChecks++;
+  rfidStatsPresenceSpi += rfidSpiTransfers - spiBefore;
 
-  // ---------------- MUSIC ----------------
-  PlayKind kind = PK_NONE;
+  if (present) {
+    rfidPresenceMisses = 0;
+    return;
+  }
+  if (++rfidPresenceMisses < RFID_PRESENCE_MISSES)
+    return;
 
-  // single
-  String file;
+  rfidHolding = false;
+  rfidRemovedUid = rfidHeldUid;
+  rfidHasRemoved = true;
 
-  // album-folder
-  String folder;
+  RfidScanEvent ev{};
+  ev.type = RFID_EV_REMOVED;
+  ev.detectedAtMs = now;
+  uidToHex(rfidRemovedUid, ev.uid, sizeof(ev.uid));
+  rfidPublish(ev);
+}
 
-  // album/playlist tracks refer into trackPool
-  uint16_t trackStart = 0;
-  uint16_t trackCount = 0;
+// One detection cycle: kick/poll, and if a card answered read its UID and
+// publish a scan event.
+static void rfidService() {
+  if (!rfidNewCardPresent())
+    return;
 
-  // ---------------- GAME SELECTOR ----------------
-  // Used when role == "game_selector"
-  String gameId;
+  RfidScanEvent ev{};
+  ev.detectedAtMs = millis();
 
-  // ---------------- ANSWER CARD ----------------
-  // Used when role == "answer"
-  String tags[MAX_CARD_TAGS];
-  uint8_t tagCount = 0;
+  bool ok = false;
+  for (uint8_t attempt = 1; attempt <= RFID_READ_ATTEMPTS; attempt++) {
+    ev.attempts = attempt;
+    if (mfrc522.PICC_ReadCardSerial()) {
+      ok = true;
+      break;
+    }
+    // Select failed (card moving/edge of field); wake it again and retry
+    byte atqa[2];
+    byte atqaSize = sizeof(atqa);
+    mfrc522.PICC_WakeupA(atqa, &atqaSize);
+  }
 
-  // Optional numeric value for sum games (role=="answer" with tag "tal" etc.)
-  // Use -1 when not present.
-  int value = -1;
+  if (!ok) {
+    // Card was detected, but could not be read
+    rfidEndRead();
+    rfidStatsReadFails++;
+    return;
+  }
+  rfidOnUidRead();
+  ev.traceId = TRACE_BEGIN(rfidDetectAtUs);
+  TRACE_STAMP(ev.traceId, TS_UID_READ);
+  ev.readUs = micros() - rfidDetectAtUs;
+  ev.sak = mfrc522.uid.sak;
+  uidToHex(mfrc522.uid, ev.uid, sizeof(ev.uid));
 
-  // ---------------- PARENT / ACTION ----------------
-  String action;
-};
+  mfrc522.PICC_HaltA();
+  mfrc522.PCD_StopCrypto1();
+  rfidEndRead();
 
-static constexpr size_t MAX_CARDS = 200;
-CardEntry cards[MAX_CARDS];
-size_t cardCount = 0;
+  // Same card as the tracked or last removed one -> it came back
+  bool returned = (rfidHolding && rfidSameUid(mfrc522.uid, rfidHeldUid)) ||
+                  (rfidHasRemoved && rfidSameUid(mfrc522.uid, rfidRemovedUid));
+  ev.type = returned ? RFID_EV_RETURNED : RFID_EV_SCAN;
 
-// End of Card tracking
+  rfidHeldUid = mfrc522.uid;
+  rfidHolding = true;
+  rfidHasRemoved = false;
+  rfidPresenceMisses = 0;
+  rfidLastPresenceAt = ev.detectedAtMs;
 
-static void clearActivePlaylist() {
-  activeCount = 0;
-  activeIndex = -1;
+  // The card LED is driven by loop() only (handleRfidEvent())
+  rfidPublish(ev);
 }
 
-// Read Song title and artist from file name
-static void parseMetaFromFilename(const String &path, String &titleOut,
-                                  String &artistOut) {
-  titleOut = "";
-  artistOut = "";
-
-  // basename
-  int slash = path.lastIndexOf('/');
-  String base = (slash >= 0) ? path.substring(slash + 1) : path;
-
-  // strip extension
-  int dot = base.lastIndexOf('.');
-  if (dot > 0)
-    base = base.substring(0, dot);
-
-  // split by ##
-  int sep = base.indexOf("##");
-  String t = (sep >= 0) ? base.substring(0, sep) : base;
-  String a = (sep >= 0) ? base.substring(sep + 2) : "";
-
-  t.replace('_', ' ');
-  a.replace('_', ' ');
-  t.trim();
-  a.trim();
+// The SD card and RC522 share SPI; the SPI driver locks the bus per
+// transfer, so this task can run beside audioTask on the other core.
+static void rfidTask(void *pv) {
+  for (;;) {
+    if (rfidIrqMode) {
+      // Woken by the IRQ when a card answers, otherwise kick again
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RFID_IRQ_KICK_MS));
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(RFID_POLL_MS));
+    }
 
-  titleOut = t;
-  artistOut = a;
-}
+    uint32_t t0 = micros();
+    rfidService();
+    rfidPresenceTick(millis());
+    uint32_t dt = micros() - t0;
+    if (dt > rfidStatsHandleMaxUs)
+      rfidStatsHandleMaxUs = dt;
 
-static void uiSetNowPlayingFromPath(const String &path) {
-  // DEBUG - Remove Me
-  Serial.print("UI path:   ");
-  Serial.println(path);
-  // 1) JSON meta først
-  auto it = trackMetaByPath.find(keyOfPath(path));
-  String t, a;
-  if (it != trackMetaByPath.end()) {
-    t = it->second.title;
-    a = it->second.artist;
-  } else {
-    // 2) fallback: filnavn-konvention for album-folder
-    parseMetaFromFilename(path, t, a);
-  }
-
-  if (t.length() > 0 && a.length() > 0)
-    oledLine3 = t + " - " + a;
-  else if (t.length() > 0)
-    oledLine3 = t;
-  else if (a.length() > 0)
-    oledLine3 = a;
-  else
-    oledLine3 = "";
-}
-
-// End of Read Song title and artist from file name
-
-// Sort alphabetically (used for folder scanning only)
-static void sortActivePlaylist() {
-  for (size_t i = 0; i + 1 < activeCount; i++) {
-    for (size_t j = i + 1; j < activeCount; j++) {
-      if (activeTracks[j] < activeTracks[i]) {
-        String t = activeTracks[i];
-        activeTracks[i] = activeTracks[j];
-        activeTracks[j] = t;
-      }
-    }
+    rfidStatsTick(millis());
   }
 }
 
-static bool isMp3File(const String &name) {
-  String n = name;
-  n.toLowerCase();
-  return n.endsWith(".mp3");
-}
-
-static void setActiveFromFolder(const String &folder) {
-  clearActivePlaylist();
+// ---------------- Audio ----------------
+// Counts what the decoder reads from the SD card (stats: SD throughput)
+class PlayerFileSourceSD : public AudioFileSourceSD {
+public:
+  using AudioFileSourceSD::AudioFileSourceSD;
+
+  uint32_t read(void *data, uint32_t len) override {
+    uint32_t t0 = micros();
+    uint32_t n = AudioFileSourceSD::read(data, len);
+    uint32_t dt = micros() - t0;
+    statsSdBytes += n;
+    statsSdReads++;
+    statsSdReadUs += dt;
+    if (dt > statsSdReadMaxUs)
+      statsSdReadMaxUs = dt;
+    return n;
+  }
+};
 
-  File dir = SD.open(folder.c_str());
-  if (!dir || !dir.isDirectory()) {
-    Serial.print("Folder missing/not dir: ");
-    Serial.println(folder);
-    return;
+AudioGeneratorMP3 *mp3 = nullptr;
+PlayerFileSourceSD *file = nullptr;
+static TaskHandle_t audioTaskHandle = nullptr;
+
+// The library's stop() only zeroes the DMA buffer and leaves the I2S driver
+// (clocks + DMA) running, and the next begin() then fails to install it
+// again. Here stop() uninstalls the driver; begin() installs it fresh. stop()
+// runs at the end of every track (mp3->stop()) and on pause.
+class PlayerOutputI2S : public AudioOutputI2S {
+public:
+  bool stop() override {
+    if (!i2sOn)
+      return false;
+    i2s_zero_dma_buffer((i2s_port_t)portNo);
+    i2s_driver_uninstall((i2s_port_t)portNo);
+    i2sOn = false;
+    return true;
   }
 
-  for (;;) {
-    File f = dir.openNextFile();
-    if (!f)
-      break;
+  bool isOn() const { return i2sOn; }
 
-    if (!f.isDirectory()) {
-      String name = String(f.name());
-      if (isMp3File(name)) {
-        String full = folder;
-        if (!full.endsWith("/"))
-          full += "/";
-        full += name;
-        if (!full.startsWith("/"))
-          full = "/" + full;
-
-        if (activeCount < MAX_ACTIVE) {
-          activeTracks[activeCount++] = full;
-        }
-      }
+#if SCAN_TRACE_ENABLED
+  // Stamps TS_FIRST_I2S for the traced track being started. ConsumeSample()
+  // writes straight into the I2S DMA buffer, so the first accepted sample is
+  // the first one on its way to the speaker.
+  bool ConsumeSample(int16_t sample[2]) override {
+    bool ok = AudioOutputI2S::ConsumeSample(sample);
+    uint16_t id = traceAudioId;
+    if (ok && id) {
+      traceStamp(id, TS_FIRST_I2S);
+      traceAudioId = 0;
     }
-    f.close();
+    return ok;
   }
-  dir.close();
-
-  sortActivePlaylist();
-
-  Serial.print("Active playlist from folder: ");
-  Serial.print(folder);
-  Serial.print(" count=");
-  Serial.println(activeCount);
-}
+#endif
+};
 
-static void setActiveFromTrackPool(uint16_t start, uint16_t count) {
-  clearActivePlaylist();
-  for (uint16_t i = 0; i < count && activeCount < MAX_ACTIVE; i++) {
-    activeTracks[activeCount++] = trackPool[start + i].file;
-  }
-  Serial.print("Active playlist from tracks list count=");
-  Serial.println(activeCount);
-}
+PlayerOutputI2S *out = nullptr;
 
-enum CmdType : uint8_t { CMD_PLAY_FILE, CMD_TOGGLE_PAUSE };
+enum CmdType : uint8_t {
+  CMD_PLAY_FILE,
+  CMD_TOGGLE_PAUSE,
+  CMD_PAUSE,
+  CMD_RESUME,
+  CMD_SEEK_BY
+};
 
 struct AudioCmd {
   CmdType type;
   char path[128]; // Only used when CMD_PLAY_FILE
+  uint16_t traceId; // scan latency trace record, 0 = none
+  int32_t seekMs;   // Only used when CMD_SEEK_BY
 };
 
 static QueueHandle_t audioQ = nullptr;
 
-// ---------- Helpers ----------
-
-// Track info helpers
-static void playPath(const String &path) {
-
-  if (!audioQ) {
-    Serial.println("audioQ not ready");
-    return;
-  }
-
-  AudioCmd c{};
-  c.type = CMD_PLAY_FILE;
-  strncpy(c.path, path.c_str(), sizeof(c.path) - 1);
-  c.path[sizeof(c.path) - 1] = '\0';
-  xQueueSend(audioQ, &c, 0);
-
-  // Persist last track
-  strncpy(lastPath, c.path, sizeof(lastPath) - 1);
-  lastPath[sizeof(lastPath) - 1] = '\0';
-  hasLastPath = true;
-  prefs.putString(PREF_KEY_LASTPATH, lastPath);
-
-  Serial.print("Play: ");
-  Serial.println(path);
-}
-
-static void playActiveIndex(int idx) {
-  if (activeCount == 0)
-    return;
-
-  if (idx < 0)
-    idx = 0;
-  if (idx >= (int)activeCount)
-    idx = (int)activeCount - 1;
-
-  String path = activeTracks[idx];
-
-  // Anti-repeat gate (valgfrit: kun i music mode)
-  if (antiRepeatBlocksThisStart(path)) {
-    if (uiMessages.antiRepeatWarning.length() > 0) {
-      playPath(uiMessages.antiRepeatWarning);
-    }
-    return;
-  }
-
-  // Commit chosen index
-  activeIndex = idx;
-
-  // Update streak + UI + play
-  antiRepeatOnTrackStart(path);
-  uiSetNowPlayingFromPath(path);
-  playPath(path);
-}
-
-// End of Track info helpers
 static String uidToHexUpper(const MFRC522::Uid &u) {
   String s;
   s.reserve(u.size * 2);
@@ -566,1445 +717,429 @@ static String uidToHexUpper(const MFRC522::Uid &u) {
   return s;
 }
 
-static void playTrackDirect(const String& path) {
-  if (antiRepeatBlocksThisStart(path)) {
-    if (uiMessages.antiRepeatWarning.length() > 0) playPath(uiMessages.antiRepeatWarning);
-    return;
-  }
-  antiRepeatOnTrackStart(path);
-  uiSetNowPlayingFromPath(path);
-  playPath(path);
-}
-
-static const CardEntry *findCardByUid(const String &uid) {
-  for (size_t i = 0; i < cardCount; i++) {
-    if (cards[i].uid == uid)
-      return &cards[i];
-  }
-  return nullptr;
-}
-
-constexpr size_t DOC_SIZE = 120 * 1024;
-static bool loadCardsJson(const char *jsonPath) {
-  trackPoolCount = 0;
-  cardCount = 0;
-
-  Serial.println("****** loadCardsJson **********");
-
-  File f = SD.open(jsonPath, FILE_READ);
-  if (!f) {
-    Serial.print("Could not open JSON: ");
-    Serial.println(jsonPath);
-    return false;
-  }
-
-  // Increase if JSON grows
-  //DynamicJsonDocument doc(16384);
-  DynamicJsonDocument doc(DOC_SIZE);
-
-  DeserializationError err = deserializeJson(doc, f);
-  f.close();
-   Serial.println("loadCardsJson");
-  Serial.print("JSON capacity: ");
-  Serial.println(doc.capacity());
-
-  Serial.print("JSON memoryUsage: ");
-  Serial.println(doc.memoryUsage());
-
-  if (err) {
-    Serial.print("JSON parse error: ");
-    Serial.println(err.c_str());
-    return false;
-  }
-
-  JsonObject msgs = doc["messages"].as<JsonObject>();
-  if (!msgs.isNull()) {
-    uiMessages.antiRepeatWarning = String((const char *)(msgs["anti_repeat_warning"] | ""));
-    uiMessages.antiRepeatEnabled = String((const char *)(msgs["anti_repeat_enabled"] | ""));
-    uiMessages.antiRepeatDisabled = String((const char *)(msgs["anti_repeat_disabled"] | ""));
-
-    uiMessages.volumeLockOn  = String((const char*)(msgs["volume_lock_on"]  | ""));
-    uiMessages.volumeLockOff = String((const char*)(msgs["volume_lock_off"] | ""));
-
-    uiMessages.mastercard_used = String((const char*)(msgs["mastercard_used"] | ""));
+static volatile bool isPaused = false;
+static volatile bool isPlaying = false;
 
-    uiMessages.musicModeInfo =   String((const char*)(msgs["music_mode_info"] | ""));
+static volatile bool trackEnded = false; // audioTask -> loop (auto-advance)
 
-  }
+// ---- Seeking (see Mp3Seek.h) ----
+// The seek table is built SEEK_TABLE_DELAY_MS into a track, or at the first
+// seek, through the decoder's own file: starting a track costs no extra SD
+// work. The position for the progress bar is the decoder's file offset
+// mapped back through the table.
+static constexpr uint32_t SEEK_TABLE_DELAY_MS = 1000;
 
-  JsonArray arr = doc["cards"].as<JsonArray>();
-  if (arr.isNull()) {
-    Serial.println("JSON missing 'cards' array");
-    return false;
+// The decoder's file source as HalFile, for mp3SeekBuild
+class DecoderFileView : public HalFile {
+public:
+  explicit DecoderFileView(AudioFileSource &src) : src_(src) {}
+  size_t read(uint8_t *buf, size_t len) override {
+    return src_.read(buf, len);
   }
+  size_t write(const uint8_t *, size_t) override { return 0; }
+  size_t size() override { return src_.getSize(); }
+  bool seek(size_t pos) override { return src_.seek(pos, SEEK_SET); }
 
-  for (JsonObject c : arr) {
-    if (cardCount >= MAX_CARDS){
-      Serial.println("WARNING: MAX_CARDS reached – some cards ignored");
-      break;
-    }
-
-    const char *uid = c["uid"] | "";
-    const char *role = c["role"] | "";
-    const char *title = c["title"] | "";
-    const char *artist = c["artist"] | "---";
-    const char* action = c["action"] | "";
-
-    String suid(uid);
-    suid.toUpperCase();
-    if (suid.length() == 0)
-      continue;
-
-    // -------- common fields --------
-    CardEntry &ce = cards[cardCount];
-    ce.uid = suid;
-    ce.role = String(role);
-    ce.title = String(title);
-    ce.artist = String(artist);
-    ce.action = String(action);
-
-
-    // -------- defaults (important!) --------
-    ce.gameId = "";
-    ce.tagCount = 0;
-    ce.value = -1;
-
-    ce.kind = PK_NONE;
-    ce.file = "";
-    ce.folder = "";
-    ce.trackStart = 0;
-    ce.trackCount = 0;
-
-    // -------- role-specific parsing --------
-    if (ce.role == "game_selector") {
-      Serial.println("***** game_selector *****");
-      const char *gid = c["gameId"] | "";
-      ce.gameId = String(gid);
-
-
-    } else if (ce.role == "answer") {
-      // tags[]
-      JsonArray tags = c["tags"].as<JsonArray>();
-      if (!tags.isNull()) {
-        for (JsonVariant tv : tags) {
-          if (ce.tagCount >= MAX_CARD_TAGS)
-            break;
-          if (tv.is<const char *>()) {
-            ce.tags[ce.tagCount++] = String(tv.as<const char *>());
-          }
-        }
-      }
-
-      // optional value (for sum games)
-      if (c.containsKey("value")) {
-        ce.value = (int)(c["value"] | -1);
-      }
-    }
-    // music (and any other roles that have play object)
-    // we only parse play for music cards to avoid accidental parsing on other
-    // roles
-    if (ce.role == "music") {
-      JsonObject play = c["play"].as<JsonObject>();
-      if (!play.isNull()) {
-        const char *kind = play["kind"] | "";
-
-        if (strcmp(kind, "single") == 0) {
-          const char *file = play["file"] | "";
-          if (strlen(file) > 0) {
-            ce.kind = PK_SINGLE;
-
-            // --- normaliser path (samme format overalt) ---
-            String path(file);
-            if (!path.startsWith("/"))
-              path = "/" + path;
-
-            ce.file = path;
-
-            // --- metadata-opslag: path -> {title, artist} ---
-            trackMetaByPath[keyOfPath(path)] = TrackMeta{ce.title, ce.artist};
-          }
-        } else if (strcmp(kind, "album") == 0 ||
-                   strcmp(kind, "playlist") == 0) {
-          const char *folder = play["folder"] | "";
-          JsonArray tracks = play["tracks"].as<JsonArray>();
-
-          if (strlen(folder) > 0) {
-            ce.kind = PK_ALBUM_FOLDER;
-
-            // normaliser og gem folder
-            String f = normalizeFolder(String(folder));
-            ce.folder = f;
-
-            // album lookup: folder -> album title (fra card)
-            // (kun for "album", ikke "playlist")
-            if (strcmp(kind, "album") == 0 || strcmp(kind, "playlist") == 0) {
-              albumTitleByFolder[keyOfPath(f)] = ce.title;
-            }
-          } else if (!tracks.isNull()) {
-            // tracks[] playlist/album
-            uint16_t start = (uint16_t)trackPoolCount;
-            uint16_t cnt = 0;
-
-            for (JsonVariant tv : tracks) {
-              if (trackPoolCount >= MAX_TRACKPOOL)
-                break;
-
-              String ttitle = "";
-              String tartist = "";
-              String tfile = "";
-
-              if (tv.is<const char *>()) {
-                tfile = String(tv.as<const char *>());
-              } else if (tv.is<JsonObject>()) {
-                JsonObject to = tv.as<JsonObject>();
-                ttitle = String((const char *)(to["title"] | ""));
-                tartist = String((const char *)(to["artist"] | "---"));
-                tfile = String((const char *)(to["file"] | ""));
-              }
-
-              if (tfile.length() == 0)
-                continue;
-              if (!tfile.startsWith("/"))
-                tfile = "/" + tfile;
-              // Map folder -> title for playlists too (even when play.folder is
-              // missing)
-              if (strcmp(kind, "playlist") == 0) {
-                String fldr = normalizeFolder(dirnameOf(tfile));
-                albumTitleByFolder[keyOfPath(fldr)] =
-                    ce.title; // "/audio/mix" -> "mix"
-              }
-
-              if (ttitle.length() > 0 || tartist.length() > 0) {
-                trackMetaByPath[keyOfPath(tfile)] = TrackMeta{ttitle, tartist};
-              }
-
-              trackPool[trackPoolCount].title = ttitle;
-              trackPool[trackPoolCount].artist = tartist;
-              trackPool[trackPoolCount].file = tfile;
-              trackPoolCount++;
-              cnt++;
-            }
-
-            if (cnt > 0) {
-              ce.kind = PK_ALBUM_TRACKS;
-              ce.trackStart = start;
-              ce.trackCount = cnt;
-            }
-          }
-        }
-      }
-    }
-
-    cardCount++;
-  }
+private:
+  AudioFileSource &src_;
+};
 
-  Serial.print("Loaded cards: ");
-  Serial.println(cardCount);
+static Mp3SeekTable seekTable; // audioTask
+static bool seekTableReady = false;
+static uint32_t seekTableDueAt = 0;
+static char audioPath[sizeof(AudioCmd::path)];
+static volatile uint32_t audioPositionMs = 0; // audioTask -> loop
+static volatile uint32_t audioDurationMs = 0; // 0 = no table (yet)
+
+static void seekTableBuild() {
+  seekTableReady = true; // once per track, also when it fails
+  uint8_t *buf = (uint8_t *)memAllocLarge(MEM_AUDIO, SEEK_SCRATCH_BYTES);
+  if (!buf)
+    return;
+  uint32_t t0 = micros();
+  uint32_t pos = file->getPos();
+  DecoderFileView view(*file);
+  bool ok = mp3SeekBuild(view, audioPath, seekTable, buf);
+  file->seek(pos, SEEK_SET);
+  memFreeLarge(MEM_AUDIO, buf);
+  audioDurationMs = ok ? seekTable.durationMs : 0;
+  Serial.printf("Seek table: %s %u ms (%s) in %u us\n", audioPath,
+                (unsigned)seekTable.durationMs,
+                seekSourceName(seekTable.source), (unsigned)(micros() - t0));
+}
+
+// One table lookup and one file seek, wherever the target is. What is left
+// in the decoder's buffer plays first (a few ms); it then finds the next
+// frame sync by itself.
+static void audioSeekBy(int32_t deltaMs) {
+  if (!mp3 || !file || !isPlaying)
+    return;
+  if (!seekTableReady)
+    seekTableBuild();
+  uint32_t dur = audioDurationMs;
+  if (!dur)
+    return;
 
-  // Optional: quick sanity print for selectors
-  for (size_t i = 0; i < cardCount; i++) {
-    if (cards[i].role == "game_selector") {
-      Serial.print("Selector UID ");
-      Serial.print(cards[i].uid);
-      Serial.print(" -> gameId=");
-      Serial.println(cards[i].gameId);
-    }
-  }
+  uint32_t t0 = micros();
+  int64_t to = (int64_t)audioPositionMs + deltaMs;
+  int64_t last = dur > SEEK_END_GUARD_MS ? dur - SEEK_END_GUARD_MS : 0;
+  uint32_t ms = (uint32_t)(to < 0 ? 0 : to > last ? last : to);
+  file->seek(mp3SeekOffset(seekTable, ms), SEEK_SET);
+  audioPositionMs = ms;
 
-  return true;
+  uint32_t dt = micros() - t0;
+  statsSeeks++;
+  if (dt > statsSeekMaxUs)
+    statsSeekMaxUs = dt;
 }
 
-static volatile bool isPaused = false;
-static volatile bool isPlaying = false;
-
-static volatile bool autoAdvance = false;   // Only true for album/playlist
-static volatile bool playlistEnded = false; // Is set when last track is played
-
-static volatile bool advanceNeeded = false; // signal from audioTask -> loop
-static volatile int advanceIndex = -1;      // index used when starting
-
 static void startTrack(const char *path) {
-  if (!SD.exists(path)) {
+  // The path cache knows every file of settings.json. Only a file it has
+  // seen skips the extra directory walk: a missing one may have been copied
+  // to the card since (or its lookup failed once), so the SD card decides
+  statsStarts++;
+  bool present = pathLookup(path) == PATH_PRESENT;
+  if (!present) {
+    present = SD.exists(path);
+    statsStartSdLookups++;
+  }
+  if (!present) {
     Serial.print("Missing file: ");
     Serial.println(path);
+    TRACE_SET_AUDIO_ID(0);
     return;
   }
 
+  // Decoder buffers are allocated by the library, so the scope books them
+  MemScope memScope(MEM_AUDIO);
   if (mp3) {
     mp3->stop();
-    delete mp3;
+    memDelete<MEM_AUDIO>(mp3);
     mp3 = nullptr;
   }
   if (file) {
-    delete file;
+    memDelete<MEM_AUDIO>(file);
     file = nullptr;
   }
 
-  file = new AudioFileSourceSD(path);
-  mp3 = new AudioGeneratorMP3();
+  file = memNew<MEM_AUDIO, PlayerFileSourceSD>(path);
+  statsStartSdLookups++;
+  TRACE_STAMP(TRACE_AUDIO_ID(), TS_OPEN);
+  mp3 = memNew<MEM_AUDIO, AudioGeneratorMP3>();
 
   bool ok = mp3->begin(file, out);
+  TRACE_STAMP(TRACE_AUDIO_ID(), TS_BEGIN);
+  if (!ok)
+    TRACE_SET_AUDIO_ID(0);
   isPlaying = ok;
   isPaused = false;
+  if (ok)
+    statsTracks++;
+
+  strncpy(audioPath, path, sizeof(audioPath) - 1);
+  audioPath[sizeof(audioPath) - 1] = '\0';
+  seekTableReady = false;
+  seekTableDueAt = millis() + SEEK_TABLE_DELAY_MS;
+  audioPositionMs = 0;
+  audioDurationMs = 0;
 
   Serial.print("Playing ");
   Serial.print(path);
   Serial.print(" begin=");
   Serial.println(ok ? "OK" : "FAIL");
 }
-
-// Audio task on core 1 (Ensures the loop runs smooth)
-static void audioTask(void *pv) {
-  AudioCmd cmd{};
-
-  for (;;) {
-    while (xQueueReceive(audioQ, &cmd, 0) == pdTRUE) {
-      if (cmd.type == CMD_PLAY_FILE) {
-        isPaused = false;
-        startTrack(cmd.path);
-      } else if (cmd.type == CMD_TOGGLE_PAUSE) {
-        isPaused = !isPaused;
-      }
-    }
-
-    if (mp3 && !isPaused) {
-      if (!mp3->loop()) {
-        mp3->stop();
-        isPlaying = false;
-
-        // Autoplay for album/playlist: Plan next track
-        if (autoAdvance && activeCount > 0 && activeIndex >= 0) {
-          int next = activeIndex + 1;
-          if (next < (int)activeCount) {
-            advanceIndex = next;
-            advanceNeeded = true;
-          } else {
-            // Last track is done -> stop playlist
-            playlistEnded = true;
-            autoAdvance = false; // stop autoplay until user starts again
-          }
-        }
-      }
-    }
-
-    vTaskDelay(1);
-  }
-}
-
-static void changeVolume(float delta) {
-  currentVolume += delta;
-
-  if (currentVolume < VOL_MIN)
-    currentVolume = VOL_MIN;
-  if (currentVolume > VOL_MAX)
-    currentVolume = VOL_MAX;
-
-  out->SetGain(currentVolume);
-
-  Serial.print("Volume: ");
-  Serial.println(currentVolume, 2);
-
-  volDirty = true;
-  volLastChangedAt = millis();
-}
-
-static void maybeSaveVolume(uint32_t now) {
-  if (!volDirty)
-    return;
-  if (now - volLastChangedAt < VOL_SAVE_DELAY_MS)
-    return;
-
-  float eff = getEffectiveVolume();
-  int v = (int)lroundf(eff * 100.0f);
-  if (v < 0) v = 0;
-  if (v > 100) v = 100;
-
-  prefs.putInt(PREF_KEY_VOL, v);
-  volDirty = false;
-
-  Serial.print("Saved volume: ");
-  Serial.println(v);
-  Serial.print(volumeLocked ? " (locked)" : " (free)");
-Serial.println();
-}
-
-
-// ================= GAME ENGINE START =================
-
-// ---- Game data limits ----
-static constexpr size_t MAX_GAMES = 10;
-static constexpr size_t MAX_QUESTIONS = 40;
-static constexpr size_t MAX_RULE_TAGS = 6; // max tags in a rule
-static constexpr size_t MAX_PENDING = 2;   // you want 1 or 2 cards
-// static constexpr size_t MAX_CARD_TAGS = 8;      // max tags on an answer card
-static uint32_t nextCardDueAt = 0;
-static uint8_t repeatCount =
-    0; // antal gange vi har gentaget spørgsmålet pga. inaktivitet
-static uint8_t nextCardRepeatCount =
-    0; // antal nextCard reminders i nuværende forsøg
-static bool stopToMusicAfterAudio =
-    false; // når idleStop er afspillet, går vi til music
-
-static bool doneAnnounced = false;
-
-static bool gameNoticeActive = false;
-static bool replayPromptAfterNotice = false;
-
-enum class GameState : uint8_t { IDLE, INTRO, PROMPT, COLLECT, FEEDBACK, DONE };
-
-enum class RuleType : uint8_t { REQUIRE_TAGS, SUM };
-
-enum class MatchMode : uint8_t { ANY, ALL };
-
-struct GameAudio {
-  String intro;
-  String correct;
-  String wrong;
-  String done;
-  String nextCardForAnswer;
-  String musicHint;
-  String idleStop;
-};
-
-struct QuestionAudioOverride {
-  String correct; // optional
-  String wrong;   // optional
-};
-
-struct AnswerRule {
-  RuleType type = RuleType::REQUIRE_TAGS;
-
-  // requireTags
-  MatchMode mode = MatchMode::ANY;
-  String tags[MAX_RULE_TAGS];
-  uint8_t tagCount = 0;
-
-  // sum
-  int equals = 0;                    // target
-  uint8_t cards = 1;                 // required cards (default 1)
-  String requireTags[MAX_RULE_TAGS]; // e.g. ["tal"]
-  uint8_t requireTagCount = 0;
-};
-
-struct Question {
-  String prompt;
-  QuestionAudioOverride audio; // optional overrides
-  AnswerRule rule;
-};
-
-struct GameTiming {
-  uint32_t nextCardRepeatMs = 8000;
-  uint32_t answerTimeoutMs = 25000;
-  uint32_t maxRepeat = 3;
-};
-
-struct GameDef {
-  String id;
-  String titel;
-  GameAudio audio;
-  GameTiming timing;
-  Question questions[MAX_QUESTIONS];
-  uint8_t questionCount = 0;
-};
-
-// ---- Loaded games ----
-static GameDef games[MAX_GAMES];
-static uint8_t gameCount = 0;
-
-// ---- Runtime state ----
-static volatile bool gameModeActive = false;
-static int activeGameIdx = -1;
-static GameState gameState = GameState::IDLE;
-static uint8_t questionIdx = 0;
-
-// pending answer cards (store minimal extracted data)
-struct PendingCard {
-  String uid;
-  String tags[MAX_CARD_TAGS];
-  uint8_t tagCount = 0;
-  int value = -1;
-};
-
-static PendingCard pending[MAX_PENDING];
-static uint8_t pendingCount = 0;
-
-/// @brief Randomize question ordr
-/// @param g Array to sort
-static void shuffleQuestions(GameDef &g) {
-  if (g.questionCount <= 1)
-    return;
-
-  for (int i = g.questionCount - 1; i > 0; i--) {
-    int j = random(i + 1); // 0..i
-    if (i != j) {
-      Question tmp = g.questions[i];
-      g.questions[i] = g.questions[j];
-      g.questions[j] = tmp;
-    }
-  }
-}
-
-static void uiSetGameProgress(int qIndex0, int total) {
-  if (total <= 0) {
-    oledLine2 = "Spil klar";
-    return;
-  }
-  char buf[32];
-  snprintf(buf, sizeof(buf), "Spg %d/%d", qIndex0 + 1, total);
-  oledLine3 = String(buf);
-}
-
-// Forward declarations (you already have these helpers somewhere)
-static void
-playPath(const String &path); // your existing function that enqueues
-                              // CMD_PLAY_FILE + persists lastPath
-static const CardEntry *findCardByUid(const String &uid); // you already have
-static String uidToHexUpper(const MFRC522::Uid &u);       // you already have
-
-// ---- Utility ----
-static MatchMode parseMode(const char *s) {
-  if (!s)
-    return MatchMode::ANY;
-  if (strcmp(s, "all") == 0)
-    return MatchMode::ALL;
-  return MatchMode::ANY;
-}
-
-static bool hasTag(const PendingCard &c, const String &tag) {
-  for (uint8_t i = 0; i < c.tagCount; i++) {
-    if (c.tags[i] == tag)
-      return true;
-  }
-  return false;
-}
-
-static bool hasTag(const CardEntry &c, const String &tag) {
-  for (uint8_t i = 0; i < c.tagCount; i++) {
-    if (c.tags[i] == tag)
-      return true;
-  }
-  return false;
-}
-
-static bool unionHasTag(const String &unionTags, const String &tag) {
-  // simple contains with delimiters; we use "|tag|" encoding in buildUnionTags
-  String needle = "|" + tag + "|";
-  return unionTags.indexOf(needle) >= 0;
-}
-
-static String buildUnionTags() {
-  // Encode as |tag1||tag2|... to avoid partial matches
-  String u = "";
-  for (uint8_t i = 0; i < pendingCount; i++) {
-    for (uint8_t t = 0; t < pending[i].tagCount; t++) {
-      String enc = "|" + pending[i].tags[t] + "|";
-      if (u.indexOf(enc) < 0)
-        u += enc;
-    }
-  }
-  return u;
-}
-
-static bool allPendingHaveRequiredTags(const AnswerRule &r) {
-  if (r.requireTagCount == 0)
-    return true;
-  for (uint8_t i = 0; i < pendingCount; i++) {
-    for (uint8_t k = 0; k < r.requireTagCount; k++) {
-      if (!hasTag(pending[i], r.requireTags[k]))
-        return false;
-    }
-  }
-  return true;
-}
-
-static bool evalRule(const AnswerRule &r) {
-  if (pendingCount == 0)
-    return false;
-
-  if (r.type == RuleType::REQUIRE_TAGS) {
-    // cards default 1
-    uint8_t need = r.cards ? r.cards : 1;
-    if (pendingCount < need)
-      return false;
-
-    String ut = buildUnionTags();
-
-    if (r.mode == MatchMode::ANY) {
-      for (uint8_t i = 0; i < r.tagCount; i++) {
-        if (unionHasTag(ut, r.tags[i]))
-          return true;
-      }
-      return false;
-    } else { // ALL
-      for (uint8_t i = 0; i < r.tagCount; i++) {
-        if (!unionHasTag(ut, r.tags[i]))
-          return false;
-      }
-      return true;
-    }
-  }
-
-  if (r.type == RuleType::SUM) {
-    uint8_t need = r.cards ? r.cards : 1;
-    if (pendingCount < need)
-      return false;
-
-    if (!allPendingHaveRequiredTags(r))
-      return false;
-
-    int s = 0;
-    for (uint8_t i = 0; i < need; i++) {
-      if (pending[i].value < 0)
-        return false;
-      s += pending[i].value;
-    }
-    return s == r.equals;
-  }
-
-  return false;
-}
-
-static const String &selectCorrectAudio(const GameDef &g, const Question &q) {
-  if (q.audio.correct.length() > 0)
-    return q.audio.correct;
-  return g.audio.correct;
-}
-
-static const String &selectWrongAudio(const GameDef &g, const Question &q) {
-  if (q.audio.wrong.length() > 0)
-    return q.audio.wrong;
-  return g.audio.wrong;
-}
-
-static void clearPending() {
-  pendingCount = 0;
-  nextCardDueAt = 0;
-  nextCardRepeatCount = 0;
-  for (uint8_t i = 0; i < MAX_PENDING; i++) {
-    pending[i].uid = "";
-    pending[i].tagCount = 0;
-    pending[i].value = -1;
-  }
-}
-
-static void gameEnterIdle() {
-  gameModeActive = false;
-  activeGameIdx = -1;
-  gameState = GameState::IDLE;
-  questionIdx = 0;
-  doneAnnounced = false;
-  nextCardDueAt = 0; // clearPending() will do this
-
-  gameNoticeActive = false;
-  replayPromptAfterNotice = false;
-  clearPending();
-}
-
-static void uiSetGameLine3(const GameDef &g, int qIdx, const char *suffix) {
-  char buf[32];
-  snprintf(buf, sizeof(buf), "Spg %d/%d %s", qIdx + 1, g.questionCount, suffix);
-  oledLine3 = String(buf);
-}
-
-static void uiSetCollectLine3(const GameDef &g, int qIdx, int pending,
-                              int needed) {
-  char buf[32];
-  if (needed <= 1) {
-    snprintf(buf, sizeof(buf), "Spg %d/%d - venter", qIdx + 1, g.questionCount);
-  } else {
-    snprintf(buf, sizeof(buf), "Spg %d/%d - %d/%d kort", qIdx + 1,
-             g.questionCount, pending, needed);
-  }
-  oledLine3 = String(buf);
-}
-
-static void gameStartById(const String &id, const String gameTitel) {
-
-  oledLine2 = gameTitel;
-  oledLine3 = "";
-  // ---------- Stop music / playlist state ----------
-  autoAdvance = false;
-  playlistEnded = false;
-  advanceNeeded = false;
-  advanceIndex = -1;
-  clearActivePlaylist(); // or: activeCount = 0; activeIndex = -1;
-
-  repeatCount = 0;
-  nextCardRepeatCount = 0;
-  nextCardDueAt = 0;
-  stopToMusicAfterAudio = false;
-
-  // ---------- Hard reset of game runtime ----------
-  gameNoticeActive = false;
-  replayPromptAfterNotice = false;
-
-  doneAnnounced = false; // if you use it
-  nextCardDueAt = 0;
-  clearPending();
-
-  gameModeActive = false;
-  activeGameIdx = -1;
-  questionIdx = 0;
-  gameState = GameState::IDLE;
-
-  // ---------- Find game ----------
-  int idx = -1;
-  for (uint8_t i = 0; i < gameCount; i++) {
-    if (games[i].id == id) {
-      idx = (int)i;
-      break;
-    }
-  }
-
-  if (idx < 0) {
-    Serial.print("Game not found: ");
-    Serial.println(id);
-    return;
-  }
-
-  // ---------- Activate selected game ----------
-  gameModeActive = true;
-  activeGameIdx = idx;
-  shuffleQuestions(games[activeGameIdx]);
-  questionIdx = 0;
-  clearPending();
-
-  const GameDef &g = games[activeGameIdx];
-  uiSetGameLine3(g, questionIdx, ""); // <-- viser "Spg 1/X"
-
-  // ---------- No questions? ----------
-  if (g.questionCount == 0) {
-    Serial.print("Game has no questions: ");
-    Serial.println(g.id);
-    gameState = GameState::DONE;
-    if (g.audio.done.length() > 0) {
-      playPath(g.audio.done);
-    }
-    return;
-  }
-
-  // ---------- Start intro or first prompt ----------
-  if (g.audio.intro.length() > 0) {
-    gameState = GameState::INTRO;
-    Serial.print("Game start (intro): ");
-    Serial.println(g.id);
-    playPath(g.audio.intro);
-  } else {
-    gameState = GameState::PROMPT;
-    Serial.print("Game start (no intro): ");
-    Serial.println(g.id);
-    playPath(g.questions[0].prompt);
-  }
-}
-
-static void gamePlayMusicHint(bool alsoReplayPrompt) {
-  if (!gameModeActive || activeGameIdx < 0)
-    return;
-
-  const GameDef &g = games[activeGameIdx];
-  Serial.print("Play Music Hint 1");
-  if (g.audio.musicHint.length() == 0)
-    return;
-  Serial.print("Play Music Hint 2");
-
-  gameNoticeActive = true;
-  replayPromptAfterNotice = alsoReplayPrompt;
-
-  // Vi bruger FEEDBACK state for at "blokere" scanning mens beskeden spiller,
-  // men vi rører ikke pendingCount osv.
-  gameState = GameState::FEEDBACK;
-
-  playPath(g.audio.musicHint);
-}
-
-bool lastAnswerWasCorrect = false;
-static void gamePlayCurrentPrompt() {
-  repeatCount = 0;
-  nextCardRepeatCount = 0;
-  nextCardDueAt = 0;
-
-  lastAnswerWasCorrect = false;
-
-  if (activeGameIdx < 0)
-    return;
-  GameDef &g = games[activeGameIdx];
-  if (questionIdx >= g.questionCount) {
-    gameState = GameState::DONE;
-    return;
-  }
-
-  clearPending();
-  gameState = GameState::PROMPT;
-
-  const Question &q = g.questions[questionIdx];
-  Serial.print("Prompt q=");
-  Serial.println(questionIdx);
-
-  playPath(q.prompt);
-}
-
-static void gameOnAnswerScanned(const CardEntry &card) {
-  // Accept answer cards only while collecting
-  if (!gameModeActive)
-    return;
-  if (gameState != GameState::COLLECT)
-    return;
-  if (activeGameIdx < 0)
-    return;
-
-  GameDef &g = games[activeGameIdx];
-  const Question &q = g.questions[questionIdx];
-  const AnswerRule &r = q.rule;
-
-  uint8_t need = r.cards ? r.cards : 1;
-  if (need > MAX_PENDING)
-    need = MAX_PENDING;
-
-    // -------- MASTER CARD (fail-safe) --------
-  if (hasTag(card, "master")) {
-    // Fuldfør spørgsmålet straks som korrekt (uanset rule)
-    lastAnswerWasCorrect = true;
-
-    
-    gameState = GameState::FEEDBACK; // vi "springer" direkte til feedback + korrekt lyd
-    if (uiMessages.mastercard_used.length() > 0) {
-    playPath(uiMessages.mastercard_used);
-  } else {
-    playPath(selectCorrectAudio(g, q)); // fallback hvis ikke sat i JSON
-  }
-
-    // ryd pending så vi ikke efterlader state
-    clearPending();
-
-    // stop evt. "next card" reminder flow
-    nextCardDueAt = 0;
-    nextCardRepeatCount = 0;
-
-    return;
-  }
-  if (pendingCount >= need)
-    return; // already have enough
-
-  // store
-  PendingCard &p = pending[pendingCount];
-  p.uid = card.uid;
-  p.tagCount = 0;
-
-  // Copy tags
-  for (uint8_t i = 0; i < card.tagCount && i < MAX_CARD_TAGS; i++) {
-    p.tags[p.tagCount++] = card.tags[i];
-  }
-  p.value = card.value;
-
-  pendingCount++;
-
-  Serial.print("Collected answer ");
-  Serial.print(pendingCount);
-  Serial.print("/");
-  Serial.println(need);
-
-  // -------- MULTI-CARD UX FIX --------
-  if (need > 1 && pendingCount < need) {
-
-    bool possible = true;
-
-    // --- rule-specific early rejection ---
-    if (r.type == RuleType::REQUIRE_TAGS && r.mode == MatchMode::ALL) {
-      // card must contribute at least one required tag
-      bool contributes = false;
-      for (uint8_t i = 0; i < r.tagCount; i++) {
-        if (hasTag(pending[pendingCount - 1], r.tags[i])) {
-          contributes = true;
-          break;
-        }
-      }
-      if (!contributes)
-        possible = false;
-    }
-
-    if (r.type == RuleType::SUM) {
-      // must be a valid number card
-      if (pending[pendingCount - 1].value < 0) {
-        possible = false;
-      }
-    }
-
-    if (!possible) {
-      // early wrong
-      gameState = GameState::FEEDBACK;
-      playPath(selectWrongAudio(g, q));
-      clearPending();
-      return;
-    }
-
-    // valid first card → prompt for next
-    if (g.audio.nextCardForAnswer.length() > 0) {
-      gameState = GameState::FEEDBACK; // temporarily block scans
-      playPath(g.audio.nextCardForAnswer);
-
-      // start timeout for "next card"
-      nextCardDueAt = millis() + g.timing.nextCardRepeatMs;
-      nextCardRepeatCount = 0; // første reminder er lige spillet "nu" (vi
-                               // tæller kun gentagelser via timeout)
-    }
-
-    return;
-  }
-
-  if (pendingCount >= need) {
-    // Evaluate immediately (no extra state needed)
-    lastAnswerWasCorrect = evalRule(r);
-
-    if (lastAnswerWasCorrect) {
-      gameState = GameState::FEEDBACK;
-      playPath(selectCorrectAudio(g, q));
-      // advance question after feedback completes
-    } else {
-      gameState = GameState::FEEDBACK;
-      playPath(selectWrongAudio(g, q));
-      // repeat same question after feedback completes
-    }
-  }
-}
-
-// xxxx1
-static bool hasBufferedAnswerUid = false;
-static String bufferedAnswerUid = "";
-static uint32_t bufferedAnswerAt = 0;
-static const uint32_t BUFFER_TTL_MS = 5000; // discard efter 5s
-
-static void gameTick(uint32_t now, bool audioIsPlaying) {
-  if (!gameModeActive)
-    return;
-  if (activeGameIdx < 0)
-    return;
-
-  GameDef &g = games[activeGameIdx];
-
-  // Only advance when no audio is playing
-  if (audioIsPlaying)
-    return;
-
-  // If we played idleStop and are supposed to return to music afterwards
-  if (stopToMusicAfterAudio) {
-    stopToMusicAfterAudio = false;
-    gameEnterIdle();
-    return;
-  }
-
-  // -------- TIMEOUT HANDLING while COLLECTING --------
-  // We do timeouts only when we are waiting for cards (COLLECT) and no audio is
-  // playing.
-  if (gameState == GameState::COLLECT && questionIdx < g.questionCount) {
-    const Question &q = g.questions[questionIdx];
-    uint8_t need = q.rule.cards ? q.rule.cards : 1;
-
-    // Ensure sane maxRepeat
-    uint8_t maxRepeat = (uint8_t)g.timing.maxRepeat;
-    if (maxRepeat < 1)
-      maxRepeat = 1;
-
-    // nextCard max = maxRepeat-1, but minimum 1
-    uint8_t maxNextCardRepeat =
-        (maxRepeat > 1) ? (uint8_t)(maxRepeat - 1) : (uint8_t)1;
-
-    // Arm deadline if not armed yet
-    if (nextCardDueAt == 0) {
-      if (pendingCount == 0) {
-        nextCardDueAt = millis() + g.timing.answerTimeoutMs;
-      } else if (need > 1 && pendingCount < need) {
-        nextCardDueAt = millis() + g.timing.nextCardRepeatMs;
-      }
-    }
-
-    uint32_t now = millis();
-    if (nextCardDueAt != 0 && (int32_t)(now - nextCardDueAt) >= 0) {
-
-      // ---- Case A: waiting for 2nd card (multi-card) ----
-      if (need > 1 && pendingCount > 0 && pendingCount < need) {
-
-        if (nextCardRepeatCount >= maxNextCardRepeat) {
-          // Too many "next card" reminders -> repeat the whole question
-          repeatCount++;
-
-          clearPending(); // resets pendingCount, nextCardDueAt,
-                          // nextCardRepeatCount
-          gameState = GameState::PROMPT;
-          playPath(q.prompt);
-
-          // If the question itself has been repeated too many times -> stop
-          // game to music
-          if (repeatCount >= maxRepeat) {
-            if (g.audio.idleStop.length() > 0) {
-              stopToMusicAfterAudio = true;
-              gameState = GameState::FEEDBACK;
-
-              Serial.print("IdleStop path  (3): ");
-              Serial.println(g.audio.idleStop);
-              Serial.print("Exists: ");
-              Serial.println(SD.exists(g.audio.idleStop) ? "YES" : "NO");
-
-              playPath(g.audio.idleStop);
-            } else {
-              gameEnterIdle();
-            }
-          }
-          return;
-        }
-
-        // Otherwise play nextCard reminder again
-        nextCardRepeatCount++;
-
-        if (g.audio.nextCardForAnswer.length() > 0) {
-          gameState = GameState::FEEDBACK; // block scans while prompt plays
-          playPath(g.audio.nextCardForAnswer);
-        }
-
-        nextCardDueAt = now + g.timing.nextCardRepeatMs;
-        return;
-      }
-
-      // ---- Case B: waiting for 1st card (no input) ----
-      if (pendingCount == 0) {
-        repeatCount++;
-
-        if (repeatCount >= maxRepeat) {
-          // Stop game due to inactivity
-          if (g.audio.idleStop.length() > 0) {
-            stopToMusicAfterAudio = true;
-            gameState = GameState::FEEDBACK;
-            playPath(g.audio.idleStop);
-          } else {
-            gameEnterIdle();
-          }
-          return;
-        }
-        // Repeat current question prompt
-        gameState = GameState::PROMPT;
-        playPath(q.prompt);
-        nextCardDueAt = now + g.timing.answerTimeoutMs;
-        return;
-      }
-    }
+
+// Audio task on core 1 (Ensures the loop runs smooth)
+static void audioSetPaused(bool paused) {
+  isPaused = paused;
+  // No I2S clocks/DMA while paused (lets the chip sleep)
+  if (paused) {
+    out->stop();
+  } else if (mp3 && isPlaying && !out->isOn()) {
+    out->begin();
   }
+  powerWakeLoop();
+}
 
-  // -------- NORMAL STATE MACHINE --------
-  switch (gameState) {
-  case GameState::INTRO:
-    // intro finished -> play first question prompt
-    gamePlayCurrentPrompt(); // should set PROMPT state + play prompt + reset
-                             // repeatCount
-    break;
-
-  case GameState::PROMPT:
-    // prompt finished -> collect answers
-    gameState = GameState::COLLECT;
-    clearPending();
-
-    if (hasBufferedAnswerUid &&
-        (uint32_t)(now - bufferedAnswerAt) < BUFFER_TTL_MS) {
-      const CardEntry *be = findCardByUid(bufferedAnswerUid);
-      hasBufferedAnswerUid = false;
-      bufferedAnswerUid = "";
-      ledStopBlink();
-      if (be && be->role == "answer") {
-        gameOnAnswerScanned(*be);
-      }
-    }
+static void audioTask(void *pv) {
+  AudioCmd cmd{};
+  uint32_t lastFillUs = 0; // end of the last mp3->loop(), 0 = new start
 
-    // Do NOT reset repeatCount here; it counts how many times we repeated
-    // prompt due to inactivity.
-    Serial.println("Collecting answers...");
-    // uiSetGameLine3(g, questionIdx,"Venter");
-    {
-      const Question &q = g.questions[questionIdx];
-      int needed = q.rule.cards ? q.rule.cards : 1;
-      uiSetCollectLine3(g, questionIdx, 0, needed);
-    }
-    break;
-
-  case GameState::FEEDBACK: {
-
-    // 1) Notice overlay (music hint etc.)
-    if (gameNoticeActive) {
-      gameNoticeActive = false;
-
-      if (replayPromptAfterNotice) {
-        replayPromptAfterNotice = false;
-        gameState = GameState::PROMPT;
-        const Question &q = g.questions[questionIdx];
-        playPath(q.prompt);
-      } else {
-        gameState = GameState::COLLECT;
-        const Question &q = g.questions[questionIdx];
-        int needed = q.rule.cards ? q.rule.cards : 1;
-        uiSetCollectLine3(g, questionIdx, pendingCount, needed);
+  for (;;) {
+    // Nothing to decode: block until the next command
+    TickType_t wait = (mp3 && isPlaying && !isPaused) ? 0 : portMAX_DELAY;
+    while (xQueueReceive(audioQ, &cmd, wait) == pdTRUE) {
+      wait = 0;
+      lastFillUs = 0; // no underrun across a (re)start
+      if (cmd.type == CMD_PLAY_FILE) {
+        isPaused = false;
+        TRACE_SET_AUDIO_ID(cmd.traceId);
+        startTrack(cmd.path);
+        powerWakeLoop();
+      } else if (cmd.type == CMD_TOGGLE_PAUSE) {
+        audioSetPaused(!isPaused);
+      } else if (cmd.type == CMD_PAUSE) {
+        audioSetPaused(true);
+      } else if (cmd.type == CMD_RESUME) {
+        audioSetPaused(false);
+      } else if (cmd.type == CMD_SEEK_BY) {
+        audioSeekBy(cmd.seekMs);
       }
-      return;
     }
 
-    // 2) If we were waiting for more cards, resume collecting after the short
-    // prompt ends
-    if (questionIdx < g.questionCount) {
-      const Question &q = g.questions[questionIdx];
-      int needed = q.rule.cards ? q.rule.cards : 1;
-
-      if (pendingCount > 0 && pendingCount < needed) {
-        gameState = GameState::COLLECT;
-        uiSetCollectLine3(g, questionIdx, pendingCount, needed);
-        return;
+    if (mp3 && isPlaying && !isPaused) {
+      uint32_t t0 = micros();
+      if (lastFillUs && t0 - lastFillUs > AUDIO_UNDERRUN_GAP_US)
+        statsAudioUnderruns++;
+      bool more = mp3->loop();
+      lastFillUs = micros();
+      uint32_t dt = lastFillUs - t0;
+      statsAudioBusyUs += dt;
+      if (dt > statsAudioLoopMaxUs)
+        statsAudioLoopMaxUs = dt;
+      if (!seekTableReady && (int32_t)(millis() - seekTableDueAt) >= 0)
+        seekTableBuild();
+      else if (audioDurationMs)
+        audioPositionMs = mp3SeekTimeMs(seekTable, file->getPos());
+      if (!more) {
+        mp3->stop();
+        isPlaying = false;
+        trackEnded = true;
+        powerWakeLoop();
       }
     }
 
-    // 3) Normal correct/wrong feedback just finished -> advance or repeat
-    const Question &q = g.questions[questionIdx];
-    // bool ok = evalRule(q.rule);
-
-    if (lastAnswerWasCorrect) { // Was set by gameOnAnswerScanned()
-      questionIdx++;
-      uiSetGameLine3(g, questionIdx, "");
-      clearPending();
-      nextCardDueAt = 0;
-      nextCardRepeatCount = 0;
-      repeatCount = 0; // new question starts fresh
-
-      if (questionIdx >= g.questionCount) {
-        gameState = GameState::DONE;
-        oledLine2 = "";
-        oledLine3 = "Færdig, vælg nyt spil, eller musik";
-        if (g.audio.done.length() > 0)
-          playPath(g.audio.done);
-      } else {
-        uiSetGameLine3(g, questionIdx, "");
-        gamePlayCurrentPrompt(); // should reset repeatCount for new question
-      }
-    } else {
-      // repeat same question (wrong)
-      clearPending();
-      nextCardDueAt = 0;
-      nextCardRepeatCount = 0;
-      // repeatCount NOT incremented here; it's for inactivity timeouts, not
-      // wrong answers
-      gamePlayCurrentPrompt();
-    }
-    break;
+    vTaskDelay(1);
   }
+}
 
-  case GameState::DONE:
-    if (!doneAnnounced) {
-      Serial.println("Game done. Waiting for MUSIC button or a new GAME");
-      doneAnnounced = true;
-    }
-    oledLine3 = "Vælg nyt spil";
-    // Stay in DONE; selector can restart via RFID handler
-    break;
-
-  default:
-    break;
+// ---- Power manager state (see POWER MANAGER above) ----
+static const char *const POWER_STATE_NAMES[PWR_STATE_COUNT] = {
+    "playing", "awake", "sleep"};
+
+static PowerState powerState = PWR_AWAKE;
+static bool powerPmEnabled = false;
+static esp_pm_lock_handle_t pmLockCpuMax = nullptr;
+static esp_pm_lock_handle_t pmLockNoSleep = nullptr;
+static uint32_t powerStateSince = 0;
+static uint32_t powerTimeMs[PWR_STATE_COUNT] = {};
+static uint32_t powerTransitions = 0;
+static uint32_t powerStatsAt = 0;
+
+static void powerInit() {
+  esp_pm_config_t cfg{};
+  cfg.max_freq_mhz = CPU_MHZ_PLAYING;
+  cfg.min_freq_mhz = CPU_MHZ_IDLE;
+  cfg.light_sleep_enable = POWER_LIGHT_SLEEP;
+  esp_err_t err = esp_pm_configure(&cfg);
+  if (err == ESP_OK &&
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "decode", &pmLockCpuMax) ==
+          ESP_OK &&
+      esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awake", &pmLockNoSleep) ==
+          ESP_OK) {
+    powerPmEnabled = true;
+    esp_pm_lock_acquire(pmLockNoSleep); // start in PWR_AWAKE
+    Serial.printf("Power: esp_pm %u-%u MHz, light sleep %s\n",
+                  (unsigned)CPU_MHZ_IDLE, (unsigned)CPU_MHZ_PLAYING,
+                  POWER_LIGHT_SLEEP ? "on" : "off");
+  } else {
+    Serial.printf("Power: esp_pm not available (%s) -> CPU clock only\n",
+                  esp_err_to_name(err));
+    setCpuFrequencyMhz(CPU_MHZ_IDLE);
+  }
+  uint32_t now = millis();
+  powerState = PWR_AWAKE;
+  powerStateSince = now;
+  powerStatsAt = now;
+  powerLastActivityAt = now;
+}
+
+static void powerApply(PowerState from, PowerState to) {
+  if (powerPmEnabled) {
+    // PLAYING holds both locks, AWAKE only the no-sleep lock, SLEEP none
+    bool hadCpu = from == PWR_PLAYING, wantCpu = to == PWR_PLAYING;
+    bool hadAwake = from != PWR_SLEEP, wantAwake = to != PWR_SLEEP;
+    if (wantAwake && !hadAwake)
+      esp_pm_lock_acquire(pmLockNoSleep);
+    if (wantCpu && !hadCpu)
+      esp_pm_lock_acquire(pmLockCpuMax);
+    if (!wantCpu && hadCpu)
+      esp_pm_lock_release(pmLockCpuMax);
+    if (!wantAwake && hadAwake)
+      esp_pm_lock_release(pmLockNoSleep);
+  } else {
+    setCpuFrequencyMhz(to == PWR_PLAYING ? CPU_MHZ_PLAYING : CPU_MHZ_IDLE);
   }
+  powerLightSleepAllowed = powerPmEnabled && POWER_LIGHT_SLEEP &&
+                           to == PWR_SLEEP;
 }
 
-// ---- JSON loading for games[] ----
-// Call this after SD is ready and settings.json exists.
-// It re-opens settings.json and parses only the "games" array.
-static bool loadGamesJson(const char *jsonPath) {
-  gameCount = 0;
-
-  File f = SD.open(jsonPath, FILE_READ);
-  if (!f) {
-    Serial.print("Could not open JSON for games: ");
-    Serial.println(jsonPath);
-    return false;
+static void powerReport(uint32_t now) {
+  uint32_t t[PWR_STATE_COUNT];
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < PWR_STATE_COUNT; i++) {
+    t[i] = powerTimeMs[i] + (i == powerState ? now - powerStateSince : 0);
+    total += t[i];
   }
+  Serial.printf("PWR[%s %uMHz]:", powerPmEnabled ? "pm" : "clk",
+                (unsigned)getCpuFrequencyMhz());
+  for (uint8_t i = 0; i < PWR_STATE_COUNT; i++) {
+    Serial.printf(" %s=%us (%u%%)", POWER_STATE_NAMES[i],
+                  (unsigned)(t[i] / 1000),
+                  (unsigned)(total ? (uint64_t)t[i] * 100 / total : 0));
+  }
+  Serial.printf(" now=%s transitions=%u\n", POWER_STATE_NAMES[powerState],
+                (unsigned)powerTransitions);
+}
 
-  //DynamicJsonDocument doc(16384);
-  DynamicJsonDocument doc(DOC_SIZE);
-  DeserializationError err = deserializeJson(doc, f);
-  Serial.println("loadGamesJson");
-  Serial.print("JSON capacity: ");
-  Serial.println(doc.capacity());
+static void powerTick(uint32_t now) {
+  PowerState s = PWR_SLEEP;
+  if (isPlaying && !isPaused)
+    s = PWR_PLAYING;
+  else if ((uint32_t)(now - powerLastActivityAt) < POWER_AWAKE_MS)
+    s = PWR_AWAKE;
 
-  Serial.print("JSON memoryUsage: ");
-  Serial.println(doc.memoryUsage());
-  f.close();
-  if (err) {
-    Serial.print("Games JSON parse error: ");
-    Serial.println(err.c_str());
-    return false;
+  if (s != powerState) {
+    powerTimeMs[powerState] += now - powerStateSince;
+    powerStateSince = now;
+    powerApply(powerState, s);
+    powerState = s;
+    powerTransitions++;
   }
 
-  JsonArray arr = doc["games"].as<JsonArray>();
-  if (arr.isNull()) {
-    Serial.println("JSON missing 'games' array");
-    return false;
+  if ((uint32_t)(now - powerStatsAt) >= POWER_STATS_MS) {
+    powerStatsAt = now;
+    powerReport(now);
   }
+}
 
-  for (JsonObject g : arr) {
-    if (gameCount >= MAX_GAMES)
-      break;
-
-    const char *id = g["id"] | "";
-    if (strlen(id) == 0)
-      continue;
-
-    GameDef &gd = games[gameCount];
-    gd.id = String(id);
-    const char *titel = g["titel"] | "Ingen titel";
-    gd.titel = String(titel);
-    gd.questionCount = 0;
-
-    // audio
-    JsonObject audio = g["audio"].as<JsonObject>();
-    if (!audio.isNull()) {
-      gd.audio.intro = String((const char *)(audio["intro"] | ""));
-      gd.audio.correct = String((const char *)(audio["correct"] | ""));
-      gd.audio.wrong = String((const char *)(audio["wrong"] | ""));
-      gd.audio.done = String((const char *)(audio["done"] | ""));
-      gd.audio.nextCardForAnswer =
-          String((const char *)(audio["nextCardForAnswer"] | ""));
-      gd.audio.musicHint = String((const char *)(audio["musicHint"] | ""));
-      gd.audio.idleStop = String((const char *)(audio["idleStop"] | ""));
-    }
-    /*
-    Serial.print("Game ");
-    Serial.print(gd.id);
-    Serial.print(" idleStop=");
-    Serial.println(gd.audio.idleStop);
-    */
-
-    JsonObject timing = g["timing"].as<JsonObject>();
-    if (!timing.isNull()) {
-      gd.timing.answerTimeoutMs = (uint32_t)(timing["answerTimeoutMs"] | 25000);
-      gd.timing.nextCardRepeatMs =
-          (uint32_t)(timing["nextCardRepeatMs"] | 18000);
-      gd.timing.maxRepeat = (uint32_t)(timing["maxRepeat"] | 3);
-    } else {
-      gd.timing.answerTimeoutMs = 25000;
-      gd.timing.nextCardRepeatMs = 18000;
-      gd.timing.maxRepeat = 3;
-    }
-
-    // questions
-    JsonArray qs = g["questions"].as<JsonArray>();
-    if (!qs.isNull()) {
-      for (JsonObject q : qs) {
-        if (gd.questionCount >= MAX_QUESTIONS)
-          break;
-
-        Question &qq = gd.questions[gd.questionCount];
-        qq.prompt = String((const char *)(q["prompt"] | ""));
-
-        // question audio override (optional): audio.correct / audio.wrong
-        JsonObject qa = q["audio"].as<JsonObject>();
-        if (!qa.isNull()) {
-          qq.audio.correct = String((const char *)(qa["correct"] | ""));
-          qq.audio.wrong = String((const char *)(qa["wrong"] | ""));
-        } else {
-          qq.audio.correct = "";
-          qq.audio.wrong = "";
-        }
-
-        // answer rule
-        JsonObject a = q["answer"].as<JsonObject>();
-        AnswerRule &r = qq.rule;
-
-        r.cards = (uint8_t)(a["cards"] | 1);
-
-        const char *type = a["type"] | "requireTags";
-        if (strcmp(type, "requireTags") == 0) {
-          r.type = RuleType::REQUIRE_TAGS;
-          r.mode = parseMode(a["mode"] | "any");
-
-          r.tagCount = 0;
-          JsonArray tags = a["tags"].as<JsonArray>();
-          if (!tags.isNull()) {
-            for (JsonVariant tv : tags) {
-              if (r.tagCount >= MAX_RULE_TAGS)
-                break;
-              r.tags[r.tagCount++] = String(tv.as<const char *>());
-            }
-          }
-        } else if (strcmp(type, "sum") == 0) {
-          r.type = RuleType::SUM;
-          r.equals = (int)(a["equals"] | 0);
-
-          // requireTags for sum (using "tags" field in your schema)
-          r.requireTagCount = 0;
-          JsonArray req = a["tags"].as<JsonArray>();
-          if (!req.isNull()) {
-            for (JsonVariant tv : req) {
-              if (r.requireTagCount >= MAX_RULE_TAGS)
-                break;
-              r.requireTags[r.requireTagCount++] =
-                  String(tv.as<const char *>());
-            }
-          }
-        } else {
-          // fallback: treat as requireTags
-          r.type = RuleType::REQUIRE_TAGS;
-          r.mode = MatchMode::ANY;
-          r.tagCount = 0;
-        }
-
-        gd.questionCount++;
-      }
-    }
+// End of loop(): sleep until the next event or the state's tick interval
+static void powerLoopWait() {
+  uint32_t ms =
+      powerState == PWR_SLEEP ? LOOP_WAIT_SLEEP_MS : LOOP_WAIT_ACTIVE_MS;
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+}
 
-    Serial.print("Loaded game ");
-    Serial.print(gd.id);
-    Serial.print(" questions=");
-    Serial.println(gd.questionCount);
+static void IRAM_ATTR buttonIsr(void *arg) {
+  uint8_t idx = (uint8_t)(uintptr_t)arg;
+  ButtonEdge e{idx, digitalRead(BUTTON_PINS[idx]) == LOW,
+               (uint32_t)millis()};
+  buttonStatsEdges++;
+  BaseType_t woken = pdFALSE;
+  if (xQueueSendFromISR(buttonEdgeQ, &e, &woken) != pdTRUE)
+    buttonEdgeOverflow = true;
+  portYIELD_FROM_ISR(woken);
+}
 
-    gameCount++;
+// Lost edges (queue full during heavy bouncing) could leave a wrong level
+// behind; re-read all pins as fresh edges instead.
+static void buttonResync(uint32_t now) {
+  buttonEdgeOverflow = false;
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    bool down = digitalRead(BUTTON_PINS[i]) == LOW;
+    buttonRawDown[i] = down;
+    buttonInput.onEdge({i, down, now});
   }
-
-  Serial.print("Total games loaded: ");
-  Serial.println(gameCount);
-  return true;
 }
 
-// ================= GAME ENGINE END ===================
-
-static void handleAction(Action a) {
-  switch (a) {
-  case ACT_PLAY_PAUSE: {
-    if (isPlaying) {
-      AudioCmd c{};
-      c.type = CMD_TOGGLE_PAUSE;
-      if (xQueueSend(audioQ, &c, 0) != pdTRUE) {
-        Serial.println("audioQ full (toggle pause)");
-      }
-    } else {
-      if (playlistEnded && activeCount > 0) {
-        playlistEnded = false;
-        autoAdvance = true;
-        playActiveIndex(0);
-        break;
-      }
-      if (hasLastPath) {
-        AudioCmd c{};
-        c.type = CMD_PLAY_FILE;
-        strncpy(c.path, lastPath, sizeof(c.path) - 1);
-        c.path[sizeof(c.path) - 1] = '\0';
-        if (xQueueSend(audioQ, &c, 0) != pdTRUE) {
-          Serial.println("audioQ full (play last)");
-        }
-      } else {
-        for (int i = 0; i < 2; i++) {
-          // digitalWrite(PIN_LED_CARD, HIGH);
-          ledSetNormal(true);
-          delay(60);
-          // digitalWrite(PIN_LED_CARD, LOW);
-          ledSetNormal(false);
-          delay(60);
-        }
-      }
+// Light sleep: edges may be missed, so compare the pins with the last level
+static void buttonSampleLevels(uint32_t now) {
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    bool down = digitalRead(BUTTON_PINS[i]) == LOW;
+    if (down != buttonRawDown[i]) {
+      buttonRawDown[i] = down;
+      buttonInput.onEdge({i, down, now});
     }
-
-    Serial.println("PLAY/PAUSE");
-    break;
   }
+}
 
-  case ACT_NEXT:
-    if (activeCount == 0)
-      break;
-
-    if (playlistEnded) {
-      playlistEnded = false;
-      autoAdvance = true; // restart autoplay
-      playActiveIndex(0);
-      break;
-    }
-    if (activeCount > 0) {
-      int next = activeIndex + 1;
-      if (next >= (int)activeCount)
-        next = 0; // wrap
-      playActiveIndex(next);
-    }
-    Serial.println("BTN: NEXT");
-    break;
-
-  case ACT_PREV:
-    if (activeCount > 0) {
-      int prev = activeIndex - 1;
-      if (prev < 0)
-        prev = (int)activeCount - 1; // wrap
-      playActiveIndex(prev);
-    }
-    Serial.println("BTN: PREV");
-    break;
-  case ACT_VOL_UP:
-    if (!volumeLocked) {
-      changeVolume(+VOL_STEP);
-      Serial.println("BTN: VOL UP");
-    }
-    break;
-  case ACT_VOL_DOWN:
-    if (!volumeLocked) {
-      changeVolume(-VOL_STEP);
-       Serial.println("BTN: VOL DOWN");
+static void buttonTask(void *pv) {
+  ButtonEvent events[BUTTON_COUNT * 2];
+  for (;;) {
+    uint32_t wait = buttonInput.msUntilNext(millis());
+    if (powerLightSleepAllowed && wait > BUTTON_SLEEP_POLL_MS)
+      wait = BUTTON_SLEEP_POLL_MS;
+    TickType_t ticks = wait == ButtonInput::NO_DEADLINE
+                           ? portMAX_DELAY
+                           : pdMS_TO_TICKS(wait) + 1;
+
+    ButtonEdge e;
+    if (xQueueReceive(buttonEdgeQ, &e, ticks) == pdTRUE) {
+      do {
+        buttonRawDown[e.button] = e.down;
+        buttonInput.onEdge(e);
+      } while (xQueueReceive(buttonEdgeQ, &e, 0) == pdTRUE);
     }
-    break;
-  case ACT_MODE_MUSIC:
-    Serial.println("MODE: MUSIC");
-    // Music button pressed, but no music yet selected
-    oledLine2 = "";
-    oledLine3 = "";
-    bool cameFromGame = gameModeActive;
-    gameEnterIdle(); // THIS is your rule: only music button exits game
-    Serial.println("Came from game: ");
-    Serial.println(cameFromGame ? "YES" :"NO");
-    Serial.print(uiMessages.musicModeInfo.length());
-     if (cameFromGame && uiMessages.musicModeInfo.length() > 0) {
-    playPath(uiMessages.musicModeInfo);
-  }
-    break;
-  }
-}
-
-static void pollButtons(uint32_t now) {
-  // Active LOW (INPUT_PULLUP): push = LOW
-  for (auto &b : buttons) {
-    bool reading = digitalRead(b.pin);
-
-    // --- Debounce + edge detection ---
-    if (reading != b.lastState) {
-      if (b.lastChange == 0)
-        b.lastChange = now;
-
-      if (now - b.lastChange >= DEBOUNCE_MS) {
-        b.lastState = reading;
-        b.lastChange = 0;
-
-        if (b.lastState == LOW) {
-          // Button pushed down: registrér time + make single action
-          b.pressedAt = now;
-          b.lastRepeat = now;
-          handleAction(b.action); // Short push = 1 step (Also for VOL)
-        } else {
-          // Slipped
-          b.pressedAt = 0;
-          b.lastRepeat = 0;
-        }
+    if (buttonEdgeOverflow)
+      buttonResync(millis());
+    else if (powerLightSleepAllowed)
+      buttonSampleLevels(millis());
+
+    size_t n;
+    while ((n = buttonInput.poll(millis(), events, BUTTON_COUNT * 2)) > 0) {
+      for (size_t i = 0; i < n; i++) {
+        if (!buttonEventWanted(events[i]))
+          continue;
+        if (xQueueSend(buttonEventQ, &events[i], 0) != pdTRUE)
+          buttonStatsDrops++;
+        else
+          powerWakeLoop();
       }
-    } else {
-      b.lastChange = 0;
     }
+  }
+}
 
-    // --- Long-press repeat only for VOL_UP / VOL_DOWN ---
-    if (b.lastState == LOW && b.pressedAt != 0) {
-      if (b.action == ACT_VOL_UP || b.action == ACT_VOL_DOWN) {
-        uint32_t heldMs = now - b.pressedAt;
-
-        if (heldMs >= LONGPRESS_START_MS) {
-          if (now - b.lastRepeat >= LONGPRESS_REPEAT_MS) {
-            b.lastRepeat = now;
-            handleAction(b.action); // Repeat volume-step
-          }
-        }
-      }
+static void buttonsInit() {
+  buttonEdgeQ = xQueueCreate(BUTTON_EDGE_QUEUE_LEN, sizeof(ButtonEdge));
+  buttonEventQ = xQueueCreate(BUTTON_EVENT_QUEUE_LEN, sizeof(ButtonEvent));
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    pinMode(BUTTON_PINS[i], INPUT_PULLUP);
+    buttonInput.setRepeat(i, BUTTONS[i].repeat);
+    attachInterruptArg(digitalPinToInterrupt(BUTTON_PINS[i]), buttonIsr,
+                       (void *)(uintptr_t)i, CHANGE);
+  }
+  buttonStatsSince = millis();
+  xTaskCreatePinnedToCore(buttonTask, "buttons", BUTTON_TASK_STACK, nullptr,
+                          BUTTON_TASK_PRIO, &buttonTaskHandle,
+                          BUTTON_TASK_CORE);
+}
+
+static void buttonStatsTick(uint32_t now) {
+  if (!BUTTON_STATS_ENABLED)
+    return;
+  if (now - buttonStatsSince < BUTTON_STATS_MS)
+    return;
+  if (buttonStatsPresses || buttonStatsRepeats || buttonStatsDrops) {
+    Serial.printf("BTN: edges=%u presses=%u repeats=%u drops=%u "
+                  "edge->action max=%ums\n",
+                  (unsigned)buttonStatsEdges, (unsigned)buttonStatsPresses,
+                  (unsigned)buttonStatsRepeats, (unsigned)buttonStatsDrops,
+                  (unsigned)buttonStatsLatencyMaxMs);
+  }
+  buttonStatsSince = now;
+  buttonStatsEdges = 0;
+  buttonStatsPresses = 0;
+  buttonStatsRepeats = 0;
+  buttonStatsDrops = 0;
+  buttonStatsLatencyMaxMs = 0;
+}
+
+// loop(): run the actions for presses and volume repeats from buttonTask
+static void handleButtonEvents(uint32_t now) {
+  ButtonEvent ev;
+  while (buttonEventQ && xQueueReceive(buttonEventQ, &ev, 0) == pdTRUE) {
+    powerNoteActivity(now);
+    uint32_t latency = millis() - ev.edgeAtMs;
+    if (ev.kind == BTN_PRESS) {
+      buttonStatsPresses++;
+      if (latency > buttonStatsLatencyMaxMs)
+        buttonStatsLatencyMaxMs = latency;
+    } else if (ev.kind == BTN_REPEAT) {
+      buttonStatsRepeats++;
     }
+    buttonHandleEvent(ev);
   }
+  buttonStatsTick(now);
 }
 
 // Display
@@ -2057,6 +1192,20 @@ static void drawVolumeBar(float vol, float volMin, float volMax) {
   }
 }
 
+// Track progress: thin bar over the volume bar (y 48..49), with a dot at
+// the right end so an empty bar still shows that a track is loaded
+static void drawProgressBar(int progress) {
+  if (progress < 0)
+    return;
+  const int y = 48;
+  const int w = 128;
+  int fillW = progress * w / 100;
+  if (fillW > 0)
+    u8g2.drawBox(0, y, fillW, 2);
+  u8g2.drawPixel(w - 1, y);
+  u8g2.drawPixel(w - 1, y + 1);
+}
+
 void oledShowStatus(const String &line1, const String &line2, float vol,
                     float volMax) {
   u8g2.clearBuffer();
@@ -2139,30 +1288,40 @@ static void drawScrollWithPauses(int x, int y, const String &text,
 }
 */
 
-static void drawScrollWithPauses(int x, int y, const String &text, uint32_t now)
+static constexpr int OLED_SCROLL_VIEW_W = 120; // samme som du fandt virker
+
+// Scroll state of one line; set restart when its text changes
+struct ScrollState {
+  bool restart = true;
+  int offset = 0;
+  uint32_t lastStepAt = 0;
+  uint32_t pauseUntil = 0;
+  // dir: +1 = mod venstre (offset øges), -1 = mod højre (offset mindskes)
+  int8_t dir = +1;
+  bool paused = true;
+};
+
+// Scroll position for a text of width w. 0 when it fits; the caller draws
+// the text at x - offset, so the line is only redrawn when this changes.
+static int scrollOffsetWithPauses(ScrollState &st, int w, uint32_t now)
 {
-  const int viewW = 120;           // samme som du fandt virker
+  const int viewW = OLED_SCROLL_VIEW_W;
   const uint32_t pauseMs = 1400;    // pause i enderne
   const uint32_t stepMs  = 35;     // ms pr pixel (lavere = hurtigere)
 
-  int w = u8g2.getStrWidth(text.c_str());
   if (w <= viewW) {
-    u8g2.drawUTF8(x, y, text.c_str());
-    return;
+    return 0;
   }
 
-  static String lastText = "";
-  static int offset = 0;
-  static uint32_t lastStepAt = 0;
-  static uint32_t pauseUntil = 0;
-
-  // dir: +1 = mod venstre (offset øges), -1 = mod højre (offset mindskes)
-  static int8_t dir = +1;
-  static bool paused = true;
+  int &offset = st.offset;
+  uint32_t &lastStepAt = st.lastStepAt;
+  uint32_t &pauseUntil = st.pauseUntil;
+  int8_t &dir = st.dir;
+  bool &paused = st.paused;
 
   // reset hvis teksten ændres
-  if (text != lastText) {
-    lastText = text;
+  if (st.restart) {
+    st.restart = false;
     offset = 0;
     dir = +1;
     paused = true;
@@ -2198,7 +1357,7 @@ static void drawScrollWithPauses(int x, int y, const String &text, uint32_t now)
     }
   }
 
-  u8g2.drawUTF8(x - offset, y, text.c_str());
+  return offset;
 }
 
 
@@ -2213,6 +1372,19 @@ static void drawLockIcon(uint8_t x, uint8_t y)
   u8g2.drawBox(x + 3, y + 6, 2, 2);
 }
 
+static void drawShuffleIcon(uint8_t x, uint8_t y)
+{
+  // To krydsende spor
+  u8g2.drawLine(x, y + 1, x + 7, y + 8);
+  u8g2.drawLine(x, y + 8, x + 7, y + 1);
+
+  // pil-hoveder til højre
+  u8g2.drawLine(x + 5, y + 1, x + 7, y + 1);
+  u8g2.drawLine(x + 7, y + 1, x + 7, y + 3);
+  u8g2.drawLine(x + 5, y + 8, x + 7, y + 8);
+  u8g2.drawLine(x + 7, y + 8, x + 7, y + 6);
+}
+
 static void drawNoRepeatIcon(uint8_t x, uint8_t y)
 {
   // En lille cirkel som "repeat"
@@ -2228,66 +1400,778 @@ static void drawNoRepeatIcon(uint8_t x, uint8_t y)
 }
 
 
-static uint32_t lastOledMs = 0;
-static String last1, last2, last3;
-static int lastPct = -1;
-static bool lastLocked = false;
-static bool lastAntiRepeat = false;
+// Screen regions in 8x8 tiles (128x64 = 16x8 tiles). Each widget owns whole
+// tiles, so a changed widget is cleared, redrawn inside its clip window and
+// sent with updateDisplayArea() instead of the full 1 KB sendBuffer().
+enum OledRegion : uint8_t {
+  REG_LINE1,  // "Mode: ..."
+  REG_ICONS,  // anti-repeat + volume lock + shuffle
+  REG_LINE2,
+  REG_LINE3,  // scrolls when too long
+  REG_VOLUME, // track progress + volume bar
+  REG_COUNT
+};
+
+struct OledArea {
+  uint8_t tx, ty, tw, th;
+};
 
-static void oledDraw3LinesIfChanged(uint32_t now, float currentVol) {
-  if ((uint32_t)(now - lastOledMs) < 100) return;
+static constexpr OledArea OLED_AREAS[REG_COUNT] = {
+    {0, 0, 12, 2}, // y 0..15,  x 0..95
+    {12, 0, 4, 2}, // y 0..15,  x 96..127
+    {0, 2, 16, 2}, // y 16..31
+    {0, 4, 16, 2}, // y 32..47
+    {0, 6, 16, 2}, // y 48..63
+};
+static constexpr uint8_t OLED_ALL_REGIONS = (1 << REG_COUNT) - 1;
+
+// Prints frames/s, I2C bytes/s and draw time every OLED_STATS_MS
+static constexpr bool OLED_STATS_ENABLED = true;
+static constexpr uint32_t OLED_STATS_MS = 10000;
+// Per tile row: I2C address + control bytes and the page/column commands
+static constexpr uint32_t OLED_I2C_ROW_OVERHEAD = 6;
+static constexpr uint32_t OLED_FULL_FRAME_BYTES =
+    8 * (16 * 8 + OLED_I2C_ROW_OVERHEAD);
+
+// Rendering runs in oledTask. loop() only publishes a UiSnapshot (a copy of
+// the UI state, see Player.cpp) into oledQ (length 1, overwritten) through
+// OledDisplay::show(), so neither it nor
+// button/RFID handling ever waits on I2C. The task renders the dirty regions
+// into the u8g2 RAM buffer (back buffer) and sends them to the display once
+// the frame is complete. While line 3 scrolls it renders every
+// OLED_ANIM_FRAME_MS; otherwise it sleeps until a new snapshot arrives.
+static constexpr BaseType_t OLED_TASK_CORE = 0;
+static constexpr UBaseType_t OLED_TASK_PRIO = 1;
+static constexpr uint32_t OLED_TASK_STACK = 4096;
+static constexpr uint32_t OLED_ANIM_FRAME_MS = 35;  // 1 px scroll step
+
+static QueueHandle_t oledQ = nullptr;
+static TaskHandle_t oledTaskHandle = nullptr;
+
+// Render task state
+static UiSnapshot oledDrawn{};
+static int lastScroll2 = -1;
+static int lastScroll3 = -1;
+static bool oledFullRedraw = true; // after init: screen still shows "OLED OK"
+
+static void oledClearArea(const OledArea &a) {
+  u8g2.setDrawColor(0);
+  u8g2.drawBox(a.tx * 8, a.ty * 8, a.tw * 8, a.th * 8);
+  u8g2.setDrawColor(1);
+}
+
+// Lines 2 and 3 are rasterized once per text change into a 1-bit strip in
+// the u8g2 buffer layout (one byte = 8 vertical pixels, one row of bytes per
+// tile row). A frame is then a clipped memcpy at the scroll offset: the cost
+// is the 128 visible columns, independent of the length of the text.
+static constexpr int OLED_STRIP_MAX_W = UI_LINE3_MAX * 6; // 6x12 font
+
+struct OledStripLine {
+  uint8_t region;
+  int baseline;
+  const char *name;
+  int w;          // rasterized width in px
+  ScrollState scroll;
+  uint8_t strip[2 * OLED_STRIP_MAX_W]; // 2 tile rows
+  // stats
+  uint32_t blits;
+  uint32_t blitUsSum;
+  uint32_t blitUsMax;
+  uint32_t rasterUs;
+};
 
-  const float volMin = VOL_MIN;
-  const float volMax = VOL_MAX;
-  float vol = clampf(currentVol, volMin, volMax);
-  int pct = (int)(100.0f * (vol - volMin) / (volMax - volMin) + 0.5f);
+static OledStripLine oledStrip2{REG_LINE2, 28, "line2"};
+static OledStripLine oledStrip3{REG_LINE3, 44, "line3"};
+
+// Draws the text in 128 px chunks into the line's own screen region and
+// copies each chunk out of the u8g2 buffer. Leaves that region dirty.
+static void oledStripBuild(OledStripLine &l, const char *text) {
+  uint32_t t0 = micros();
+  const OledArea &a = OLED_AREAS[l.region];
+  uint8_t *buf = u8g2.getBufferPtr();
+  const int stride = u8g2.getBufferTileWidth() * 8;
+  const int viewW = a.tw * 8;
+
+  int w = u8g2.getUTF8Width(text);
+  l.w = w < OLED_STRIP_MAX_W ? w : OLED_STRIP_MAX_W;
+  l.scroll.restart = true;
+
+  u8g2.setClipWindow(a.tx * 8, a.ty * 8, (a.tx + a.tw) * 8, (a.ty + a.th) * 8);
+  for (int c = 0; c < l.w; c += viewW) {
+    oledClearArea(a);
+    u8g2.drawUTF8(a.tx * 8 - c, l.baseline, text);
+    int n = l.w - c < viewW ? l.w - c : viewW;
+    for (uint8_t p = 0; p < a.th; p++) {
+      memcpy(l.strip + p * OLED_STRIP_MAX_W + c,
+             buf + (a.ty + p) * stride + a.tx * 8, n);
+    }
+  }
+  u8g2.setMaxClipWindow();
+  l.rasterUs = micros() - t0;
+}
+
+static void oledStripBlit(OledStripLine &l, int offset) {
+  uint32_t t0 = micros();
+  const OledArea &a = OLED_AREAS[l.region];
+  uint8_t *buf = u8g2.getBufferPtr();
+  const int stride = u8g2.getBufferTileWidth() * 8;
+  const int viewW = a.tw * 8;
+
+  int n = l.w - offset;
+  if (n < 0)
+    n = 0;
+  if (n > viewW)
+    n = viewW;
+  for (uint8_t p = 0; p < a.th; p++) {
+    uint8_t *dst = buf + (a.ty + p) * stride + a.tx * 8;
+    memcpy(dst, l.strip + p * OLED_STRIP_MAX_W + offset, n);
+    memset(dst + n, 0, viewW - n);
+  }
+
+  uint32_t dt = micros() - t0;
+  l.blits++;
+  l.blitUsSum += dt;
+  if (dt > l.blitUsMax)
+    l.blitUsMax = dt;
+}
+
+static void oledStripStats(OledStripLine &l) {
+  Serial.printf("OLED %s: w=%dpx raster=%uus blits=%u avg=%uus max=%uus\n",
+                l.name, l.w, (unsigned)l.rasterUs, (unsigned)l.blits,
+                (unsigned)(l.blits ? l.blitUsSum / l.blits : 0),
+                (unsigned)l.blitUsMax);
+  l.blits = 0;
+  l.blitUsSum = 0;
+  l.blitUsMax = 0;
+}
+
+static uint32_t oledStatsSince = 0;
+static uint32_t oledStatsFrames = 0;
+static uint32_t oledStatsSnapshots = 0;
+static uint32_t oledStatsBytes = 0;
+static uint32_t oledStatsRenderUsSum = 0;
+static uint32_t oledStatsSendUsSum = 0;
+static uint32_t oledStatsDrawUsMax = 0;
+
+static void oledStatsTick(uint32_t now) {
+  if (!OLED_STATS_ENABLED)
+    return;
+  uint32_t elapsed = now - oledStatsSince;
+  if (elapsed < OLED_STATS_MS)
+    return;
 
-  String l1 = String("Mode: ") + (gameState != GameState::IDLE ? "Game" : "Music");
-  const String &l2 = oledLine2;
-  const String &l3 = oledLine3;
+  uint32_t frames = oledStatsFrames;
+  Serial.printf("OLED: frames/s=%.1f snapshots=%u i2c=%u B/s (full frame "
+                "%u B) render avg=%uus send avg=%uus draw max=%uus\n",
+                frames * 1000.0f / elapsed, (unsigned)oledStatsSnapshots,
+                (unsigned)((uint64_t)oledStatsBytes * 1000 / elapsed),
+                (unsigned)OLED_FULL_FRAME_BYTES,
+                (unsigned)(frames ? oledStatsRenderUsSum / frames : 0),
+                (unsigned)(frames ? oledStatsSendUsSum / frames : 0),
+                (unsigned)oledStatsDrawUsMax);
+  oledStripStats(oledStrip2);
+  oledStripStats(oledStrip3);
+
+  oledStatsSince = now;
+  oledStatsFrames = 0;
+  oledStatsSnapshots = 0;
+  oledStatsBytes = 0;
+  oledStatsRenderUsSum = 0;
+  oledStatsSendUsSum = 0;
+  oledStatsDrawUsMax = 0;
+}
+
+// oledTask: draws what changed since the last frame. Returns true while
+// line 3 is scrolling (needs more frames without new snapshots).
+static bool oledRender(const UiSnapshot &s, uint32_t now) {
+  const char *l1 = s.gameMode ? "Mode: Game" : "Mode: Music";
+  const UiSnapshot &d = oledDrawn;
 
-  // VIGTIGT: needScroll skal beregnes før change detection
-  // (vi bruger den aktuelle font, så sørg for at font er sat inden getStrWidth)
   u8g2.setFont(u8g2_font_6x12_tf);
-  const int viewW = 120; // = 128;
-  bool needScroll = (u8g2.getStrWidth(l3.c_str()) > viewW);
-
-  // Change detection:    hvis der skal scrolles, må vi IKKE returnere,
-  // ellers får vi aldrig animationen.
-  if (!needScroll &&
-      l1 == last1 && l2 == last2 && l3 == last3 &&
-      pct == lastPct &&
-      volumeLocked == lastLocked &&
-      parentalAntiRepeatEnabled == lastAntiRepeat) {
-    return;
+  bool new2 = oledFullRedraw || s.line2Gen != d.line2Gen;
+  bool new3 = oledFullRedraw || s.line3Gen != d.line3Gen;
+  if (new2)
+    oledStripBuild(oledStrip2, s.line2);
+  if (new3)
+    oledStripBuild(oledStrip3, s.line3);
+
+  // Scroll-positionen er en del af change detection: en linje tegnes kun
+  // igen når offset flytter sig (ikke i pauserne i enderne)
+  int scroll2 = scrollOffsetWithPauses(oledStrip2.scroll, oledStrip2.w, now);
+  int scroll3 = scrollOffsetWithPauses(oledStrip3.scroll, oledStrip3.w, now);
+  bool animating = oledStrip2.w > OLED_SCROLL_VIEW_W ||
+                   oledStrip3.w > OLED_SCROLL_VIEW_W;
+
+  uint8_t dirty = oledFullRedraw ? OLED_ALL_REGIONS : 0;
+  if (s.gameMode != d.gameMode)
+    dirty |= 1 << REG_LINE1;
+  if (s.locked != d.locked || s.antiRepeat != d.antiRepeat ||
+      s.shuffle != d.shuffle)
+    dirty |= 1 << REG_ICONS;
+  if (new2 || scroll2 != lastScroll2)
+    dirty |= 1 << REG_LINE2;
+  if (new3 || scroll3 != lastScroll3)
+    dirty |= 1 << REG_LINE3;
+  if (s.pct != d.pct || s.progress != d.progress)
+    dirty |= 1 << REG_VOLUME;
+  if (!dirty)
+    return animating;
+
+  oledDrawn = s;
+  lastScroll2 = scroll2;
+  lastScroll3 = scroll3;
+  oledFullRedraw = false;
+
+  uint32_t t0 = micros();
+  for (uint8_t r = 0; r < REG_COUNT; r++) {
+    if (!(dirty & (1 << r)))
+      continue;
+    const OledArea &a = OLED_AREAS[r];
+    oledClearArea(a);
+    u8g2.setClipWindow(a.tx * 8, a.ty * 8, (a.tx + a.tw) * 8,
+                       (a.ty + a.th) * 8);
+    switch (r) {
+    case REG_LINE1:
+      u8g2.drawStr(0, 12, l1);
+      break;
+    case REG_ICONS:
+      if (s.antiRepeat) drawNoRepeatIcon(96, 2);
+      if (s.locked) drawLockIcon(110, 2);
+      if (s.shuffle) drawShuffleIcon(120, 2);
+      break;
+    case REG_LINE2:
+      oledStripBlit(oledStrip2, scroll2);
+      break;
+    case REG_LINE3:
+      oledStripBlit(oledStrip3, scroll3);
+      break;
+    case REG_VOLUME:
+      drawProgressBar(s.progress);
+      drawVolumeBar(VOL_MIN + (VOL_MAX - VOL_MIN) * s.pct / 100.0f, VOL_MIN,
+                    VOL_MAX);
+      break;
+    }
   }
+  u8g2.setMaxClipWindow();
 
-  lastOledMs = now;
-  last1 = l1; last2 = l2; last3 = l3;
-  lastPct = pct;
-  lastLocked = volumeLocked;
-  lastAntiRepeat = parentalAntiRepeatEnabled;
+  // Frame complete in RAM -> flip the changed regions to the display
+  uint32_t t1 = micros();
+  uint32_t bytes = 0;
+  for (uint8_t r = 0; r < REG_COUNT; r++) {
+    if (!(dirty & (1 << r)))
+      continue;
+    const OledArea &a = OLED_AREAS[r];
+    u8g2.updateDisplayArea(a.tx, a.ty, a.tw, a.th);
+    bytes += a.th * (a.tw * 8 + OLED_I2C_ROW_OVERHEAD);
+  }
+  uint32_t t2 = micros();
 
-  u8g2.clearBuffer();
-  u8g2.setFont(u8g2_font_6x12_tf);
+  oledStatsFrames++;
+  oledStatsBytes += bytes;
+  oledStatsRenderUsSum += t1 - t0;
+  oledStatsSendUsSum += t2 - t1;
+  if (t2 - t0 > oledStatsDrawUsMax)
+    oledStatsDrawUsMax = t2 - t0;
+  return animating;
+}
 
-  u8g2.drawStr(0, 12, l1.c_str());
-  u8g2.drawUTF8(0, 28, l2.c_str());
+// Owns u8g2 after setup(); nothing else may draw once it runs
+static void oledTask(void *pv) {
+  UiSnapshot snap{};
+  bool haveSnap = false;
+  bool animating = false;
+  uint32_t lastFrameAt = 0;
 
-  if (needScroll) {
-    drawScrollWithPauses(0, 44, l3, now);
-  } else {
-    u8g2.drawUTF8(0, 44, l3.c_str());
+  for (;;) {
+    // Idle: sleep until the UI changes (wake up for the stats line only)
+    TickType_t wait = animating ? pdMS_TO_TICKS(OLED_ANIM_FRAME_MS)
+                      : OLED_STATS_ENABLED ? pdMS_TO_TICKS(OLED_STATS_MS)
+                                           : portMAX_DELAY;
+    if (xQueueReceive(oledQ, &snap, wait) == pdTRUE) {
+      oledStatsSnapshots++;
+      haveSnap = true;
+      // Bursts (held volume button) are coalesced to the frame rate;
+      // the queue keeps only the newest snapshot
+      uint32_t since = millis() - lastFrameAt;
+      if (since < OLED_ANIM_FRAME_MS) {
+        vTaskDelay(pdMS_TO_TICKS(OLED_ANIM_FRAME_MS - since));
+        xQueueReceive(oledQ, &snap, 0);
+      }
+    }
+
+    uint32_t now = millis();
+    if (haveSnap) {
+      animating = oledRender(snap, now);
+      lastFrameAt = now;
+    }
+    oledStatsTick(now);
   }
+}
 
-  if (parentalAntiRepeatEnabled) drawNoRepeatIcon(96, 2);
-  if (volumeLocked) drawLockIcon(110, 2);
+// ---- Analytics flush (counters: GAME ANALYTICS in GameEngine.cpp) ----
+static TaskHandle_t analyticsTaskHandle = nullptr;
 
-  drawVolumeBar(vol, volMin, volMax);
-  u8g2.sendBuffer();
+static void analyticsTask(void *pv) {
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(ANALYTICS_FLUSH_MS));
+    if (!analyticsDirty)
+      continue;
+    // Leave the shared SPI bus to the decoder while a track streams
+    if (isPlaying && !isPaused)
+      continue;
+    analyticsDirty = false;
+    analyticsSave(ANALYTICS_PATH);
+  }
+}
+
+// ---- Library index (ID3 tags of /audio, see LibraryIndex.h) ----
+// One step at a time so the SD card is never busy for long. While a track
+// streams the decoder gets the bus almost to itself; the walk continues
+// slowly instead of stopping, since a box may play for hours.
+static constexpr UBaseType_t LIBRARY_TASK_PRIO = 1;
+static constexpr uint32_t LIBRARY_TASK_STACK = 6144;
+static constexpr uint32_t LIBRARY_STEP_IDLE_MS = 5;
+static constexpr uint32_t LIBRARY_STEP_PLAYING_MS = 200;
+static TaskHandle_t libraryTaskHandle = nullptr;
+
+static void libraryTask(void *pv) {
+  while (libraryIndexStep()) {
+    vTaskDelay(pdMS_TO_TICKS((isPlaying && !isPaused) ? LIBRARY_STEP_PLAYING_MS
+                                                      : LIBRARY_STEP_IDLE_MS));
+  }
+  libraryTaskHandle = nullptr;
+  vTaskDelete(nullptr);
+}
+
+// ---- Settings reload (settings.json changed, see SettingsReload.h) ----
+// Polls and parses here; the loop only swaps the result in. The JSON parse
+// nests, hence the larger stack. Resolving the paths (PathCache.h) steps
+// like the library index.
+static constexpr UBaseType_t SETTINGS_TASK_PRIO = 1;
+static constexpr uint32_t SETTINGS_TASK_STACK = 8192;
+static constexpr uint32_t SETTINGS_STEP_MS = 250;
+static TaskHandle_t settingsTaskHandle = nullptr;
+
+static void settingsTask(void *pv) {
+  for (;;) {
+    bool playing = isPlaying && !isPaused;
+    bool more = settingsReloadStep(playing, millis());
+    vTaskDelay(pdMS_TO_TICKS(!more     ? SETTINGS_STEP_MS
+                             : playing ? LIBRARY_STEP_PLAYING_MS
+                                       : LIBRARY_STEP_IDLE_MS));
+  }
+}
+
+// ---------------- HAL backends (see hal/Hal.h) ----------------
+// The player logic reaches the reader, audio and display through these
+// wrappers around rfidQ, audioQ and oledQ. Clock, SD card and Preferences
+// are in hal/esp32/EspHal.cpp.
+
+class RfidQueueReader : public CardReader {
+public:
+  bool poll(RfidScanEvent &ev) override {
+    if (!rfidQ || xQueueReceive(rfidQ, &ev, 0) != pdTRUE)
+      return false;
+    uint32_t now = millis();
+    powerNoteActivity(now);
+
+    uint32_t waitMs = now - ev.detectedAtMs;
+    statsScans++;
+    statsScanWaitSumMs += waitMs;
+    if (waitMs > statsScanWaitMaxMs)
+      statsScanWaitMaxMs = waitMs;
+    statsScanReadSumUs += ev.readUs;
+    if (ev.readUs > statsScanReadMaxUs)
+      statsScanReadMaxUs = ev.readUs;
+    return true;
+  }
+};
+
+class AudioTaskSink : public AudioSink {
+public:
+  void play(const char *path) override {
+    if (!audioQ) {
+      Serial.println("audioQ not ready");
+      return;
+    }
+
+    AudioCmd c{};
+    c.type = CMD_PLAY_FILE;
+    strncpy(c.path, path, sizeof(c.path) - 1);
+    c.path[sizeof(c.path) - 1] = '\0';
+    c.traceId = TRACE_LOOP_ID();
+    if (xQueueSend(audioQ, &c, 0) == pdTRUE) {
+      TRACE_STAMP(c.traceId, TS_ENQUEUE);
+    } else {
+      Serial.println("audioQ full (play)");
+    }
+  }
+
+  void pause() override { send(CMD_PAUSE); }
+  void resume() override { send(CMD_RESUME); }
+  void togglePause() override { send(CMD_TOGGLE_PAUSE); }
+  void setGain(float gain) override { out->SetGain(gain); }
+  bool isPlaying() override { return ::isPlaying; }
+  bool isPaused() override { return ::isPaused; }
+
+  bool takeTrackEnded() override {
+    if (!trackEnded)
+      return false;
+    trackEnded = false;
+    return true;
+  }
+
+  void seekBy(int32_t deltaMs) override { send(CMD_SEEK_BY, deltaMs); }
+  uint32_t positionMs() override { return audioPositionMs; }
+  uint32_t durationMs() override { return audioDurationMs; }
+
+private:
+  static void send(CmdType type, int32_t seekMs = 0) {
+    AudioCmd c{};
+    c.type = type;
+    c.seekMs = seekMs;
+    if (xQueueSend(audioQ, &c, 0) != pdTRUE) {
+      Serial.println("audioQ full");
+    }
+  }
+};
+
+class OledDisplay : public Display {
+public:
+  void show(const UiSnapshot &s) override {
+    if (oledQ)
+      xQueueOverwrite(oledQ, &s);
+  }
+  void setCardLed(bool on) override { ledSetNormal(on); }
+  void blinkCardLed(uint32_t now, uint32_t durationMs) override {
+    ledStartBlink(now, durationMs);
+  }
+  void stopCardLedBlink() override { ledStopBlink(); }
+};
+
+static EspHeapInfo halHeap;
+static ArduinoClock halClock;
+static SdFileSystem halFs;
+static PrefsKvStore halKv;
+static RfidQueueReader halCards;
+static AudioTaskSink halAudio;
+static OledDisplay halDisplay;
+
+// ---------------- Serial console ----------------
+// Commands typed on the serial monitor, one per line ("help" lists them).
+// serialPollCommands() only takes the bytes that have arrived and runs at
+// most one command per call, so it never waits. Reports go out through
+// Serial's TX buffer from loop(), which runs below audioTask's priority,
+// so printing them does not hold up decoding.
+static constexpr size_t CONSOLE_LINE_MAX = 48;
+static constexpr UBaseType_t CONSOLE_TASKS_MAX = 24;
+
+// Queue depth high-water marks, sampled once per loop()
+enum StatsQueue : uint8_t {
+  SQ_AUDIO,
+  SQ_RFID,
+  SQ_BTN_EDGE,
+  SQ_BTN_EVENT,
+  SQ_COUNT
+};
+static const char *const STATS_QUEUE_NAMES[SQ_COUNT] = {
+    "audio", "rfid", "btn_edge", "btn_event"};
+static UBaseType_t statsQueueMax[SQ_COUNT] = {};
+
+static QueueHandle_t statsQueue(uint8_t i) {
+  switch (i) {
+  case SQ_AUDIO:
+    return audioQ;
+  case SQ_RFID:
+    return rfidQ;
+  case SQ_BTN_EDGE:
+    return buttonEdgeQ;
+  default:
+    return buttonEventQ;
+  }
+}
+
+// loop(): loop rate, longest gap between two loops, queue depths
+static void statsLoopTick() {
+  static uint32_t lastUs = 0;
+  uint32_t nowUs = micros();
+  if (statsLoops > 0 && nowUs - lastUs > statsLoopGapMaxUs)
+    statsLoopGapMaxUs = nowUs - lastUs;
+  lastUs = nowUs;
+  statsLoops++;
+
+  for (uint8_t i = 0; i < SQ_COUNT; i++) {
+    QueueHandle_t q = statsQueue(i);
+    UBaseType_t n = q ? uxQueueMessagesWaiting(q) : 0;
+    if (n > statsQueueMax[i])
+      statsQueueMax[i] = n;
+  }
+}
+
+static void consoleStats(uint32_t now) {
+  uint32_t elapsed = now - statsSince;
+  if (elapsed == 0)
+    elapsed = 1;
+
+  Serial.printf("STATS %us: loop %u/s (max gap %u us)\n",
+                (unsigned)(elapsed / 1000),
+                (unsigned)((uint64_t)statsLoops * 1000 / elapsed),
+                (unsigned)statsLoopGapMaxUs);
+
+  Serial.printf("STATS audio: %s, tracks %u, decode %.1f%% CPU (max %u us), "
+                "underruns %u, seeks %u (max %u us)\n",
+                !isPlaying ? "stopped" : (isPaused ? "paused" : "playing"),
+                (unsigned)statsTracks, statsAudioBusyUs / (elapsed * 10.0f),
+                (unsigned)statsAudioLoopMaxUs, (unsigned)statsAudioUnderruns,
+                (unsigned)statsSeeks, (unsigned)statsSeekMaxUs);
+  if (isPlaying && audioDurationMs)
+    Serial.printf("STATS track: %u / %u s, seek table %s\n",
+                  (unsigned)(audioPositionMs / 1000),
+                  (unsigned)(audioDurationMs / 1000),
+                  seekSourceName(seekTable.source));
+
+  Serial.print("STATS queues:");
+  for (uint8_t i = 0; i < SQ_COUNT; i++) {
+    QueueHandle_t q = statsQueue(i);
+    if (!q)
+      continue;
+    UBaseType_t used = uxQueueMessagesWaiting(q);
+    Serial.printf(" %s %u/%u (max %u)", STATS_QUEUE_NAMES[i], (unsigned)used,
+                  (unsigned)(used + uxQueueSpacesAvailable(q)),
+                  (unsigned)statsQueueMax[i]);
+  }
+  Serial.println();
+
+  uint32_t sdUs = statsSdReadUs;
+  uint32_t sdBytes = statsSdBytes;
+  uint32_t sdKbps = sdUs ? (uint32_t)((uint64_t)sdBytes * 1000000 / 1024 / sdUs)
+                         : 0;
+  Serial.printf("STATS sd: %u KB in %u reads, %u KB/s while reading "
+                "(max read %u us), %u KB/s average\n",
+                (unsigned)(sdBytes / 1024), (unsigned)statsSdReads,
+                (unsigned)sdKbps,
+                (unsigned)statsSdReadMaxUs,
+                (unsigned)((uint64_t)sdBytes * 1000 / 1024 / elapsed));
+  uint32_t starts = statsStarts;
+  Serial.printf("STATS starts: %u, %.2f SD directory lookups per start "
+                "(2 without the path cache)\n",
+                (unsigned)starts,
+                starts ? (float)statsStartSdLookups / starts : 0.0f);
+
+  Serial.printf("STATS scan: %u events, detect->loop avg %u ms max %u ms, "
+                "uid read avg %u us max %u us\n",
+                (unsigned)statsScans,
+                (unsigned)(statsScans ? statsScanWaitSumMs / statsScans : 0),
+                (unsigned)statsScanWaitMaxMs,
+                (unsigned)(statsScans ? statsScanReadSumUs / statsScans : 0),
+                (unsigned)statsScanReadMaxUs);
+
+  Serial.printf("STATS playlist: %u tracks, index %d%s%s\n",
+                (unsigned)activeTracks.size(), (int)activeIndex,
+                shuffleEnabled ? ", shuffle" : "",
+                gameModeActive ? " (game mode)" : "");
+}
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+// Run time of every task at the last reset, for CPU use since then
+static TaskHandle_t tasksBaseHandle[CONSOLE_TASKS_MAX];
+static uint32_t tasksBaseRun[CONSOLE_TASKS_MAX];
+static UBaseType_t tasksBaseCount = 0;
+static uint32_t tasksBaseTotal = 0;
+static TaskStatus_t tasksStatus[CONSOLE_TASKS_MAX];
+
+static void consoleTasksReset() {
+  uint32_t total = 0;
+  UBaseType_t n = uxTaskGetSystemState(tasksStatus, CONSOLE_TASKS_MAX, &total);
+  for (UBaseType_t i = 0; i < n; i++) {
+    tasksBaseHandle[i] = tasksStatus[i].xHandle;
+    tasksBaseRun[i] = tasksStatus[i].ulRunTimeCounter;
+  }
+  tasksBaseCount = n;
+  tasksBaseTotal = total;
+}
+
+static void consoleTasks() {
+  uint32_t total = 0;
+  UBaseType_t n = uxTaskGetSystemState(tasksStatus, CONSOLE_TASKS_MAX, &total);
+  if (n == 0) {
+    Serial.println("TASK more than CONSOLE_TASKS_MAX tasks");
+    return;
+  }
+  uint32_t span = total - tasksBaseTotal;
+  for (UBaseType_t i = 0; i < n; i++) {
+    const TaskStatus_t &t = tasksStatus[i];
+    uint32_t base = 0;
+    for (UBaseType_t k = 0; k < tasksBaseCount; k++) {
+      if (tasksBaseHandle[k] == t.xHandle)
+        base = tasksBaseRun[k];
+    }
+    Serial.printf("TASK %-16s prio %2u stack free %5u cpu %5.1f%%\n",
+                  t.pcTaskName, (unsigned)t.uxCurrentPriority,
+                  (unsigned)t.usStackHighWaterMark,
+                  span ? (t.ulRunTimeCounter - base) * 100.0f / span : 0.0f);
+  }
+}
+#else
+// No FreeRTOS run time stats in this build: stacks of our own tasks, CPU
+// only for the decoder (audio line of "stats")
+static void consoleTasksReset() {}
+
+static void consoleTasks() {
+  const struct {
+    const char *name;
+    TaskHandle_t handle;
+  } tasks[] = {{"loop", loopTaskHandle},
+               {"audio", audioTaskHandle},
+               {"rfid", rfidTaskHandle},
+               {"buttons", buttonTaskHandle},
+               {"oled", oledTaskHandle},
+               {"analytics", analyticsTaskHandle},
+               {"library", libraryTaskHandle},
+               {"settings", settingsTaskHandle}};
+  for (const auto &t : tasks) {
+    if (!t.handle)
+      continue;
+    Serial.printf("TASK %-16s prio %2u stack free %5u\n", t.name,
+                  (unsigned)uxTaskPriorityGet(t.handle),
+                  (unsigned)uxTaskGetStackHighWaterMark(t.handle));
+  }
+  Serial.println("TASK cpu per task needs configGENERATE_RUN_TIME_STATS");
+}
+#endif
+
+static void statsReset(uint32_t now) {
+  statsSince = now;
+  statsLoops = 0;
+  statsLoopGapMaxUs = 0;
+  statsAudioBusyUs = 0;
+  statsAudioLoopMaxUs = 0;
+  statsAudioUnderruns = 0;
+  statsTracks = 0;
+  statsStarts = 0;
+  statsStartSdLookups = 0;
+  statsSdBytes = 0;
+  statsSdReads = 0;
+  statsSdReadUs = 0;
+  statsSdReadMaxUs = 0;
+  statsSeeks = 0;
+  statsSeekMaxUs = 0;
+  statsScans = 0;
+  statsScanWaitSumMs = 0;
+  statsScanWaitMaxMs = 0;
+  statsScanReadSumUs = 0;
+  statsScanReadMaxUs = 0;
+  for (uint8_t i = 0; i < SQ_COUNT; i++)
+    statsQueueMax[i] = 0;
+  consoleTasksReset();
+  memResetPeaks();
+#if SCAN_TRACE_ENABLED
+  traceReset();
+#endif
+#if LOOP_PROFILE_ENABLED
+  profReset();
+#endif
+}
+
+// "card <UID>" / "card-remove <UID>": as if rfidTask had read the card
+static void consoleSimulateCard(RfidEventType type, const char *uid) {
+  size_t n = strlen(uid);
+  if (n == 0 || n >= sizeof(RfidScanEvent::uid)) {
+    Serial.println("usage: card <UID hex>");
+    return;
+  }
+  RfidScanEvent ev{};
+  ev.type = type;
+  for (size_t i = 0; i < n; i++)
+    ev.uid[i] = (char)toupper((unsigned char)uid[i]);
+  ev.attempts = 1;
+  ev.detectedAtMs = millis();
+  if (!rfidQ || xQueueSend(rfidQ, &ev, 0) != pdTRUE) {
+    Serial.println("rfidQ full");
+    return;
+  }
+  powerWakeLoop();
+}
+
+static void consoleHelp() {
+  Serial.println("stats | reset-stats | mem | mem reset | tasks | power | "
+                 "library | paths | reload | card <UID> | card-remove <UID>"
+#if SCAN_TRACE_ENABLED
+                 " | trace | trace reset"
+#endif
+#if LOOP_PROFILE_ENABLED
+                 " | prof | prof reset | prof budget <us>"
+#endif
+  );
+}
+
+static void consoleRun(char *line) {
+  uint32_t now = millis();
+  if (strcmp(line, "stats") == 0) {
+    consoleStats(now);
+  } else if (strcmp(line, "reset-stats") == 0) {
+    statsReset(now);
+    Serial.println("stats cleared");
+  } else if (strcmp(line, "mem") == 0) {
+    memReport();
+  } else if (strcmp(line, "mem reset") == 0) {
+    memResetPeaks();
+  } else if (strcmp(line, "tasks") == 0) {
+    consoleTasks();
+  } else if (strcmp(line, "power") == 0) {
+    powerReport(now);
+  } else if (strcmp(line, "library") == 0) {
+    libraryIndexReport();
+  } else if (strcmp(line, "paths") == 0) {
+    pathCacheReport();
+  } else if (strcmp(line, "reload") == 0) {
+    settingsReloadRequest();
+    Serial.println("settings.json is parsed on the next poll");
+  } else if (strncmp(line, "card ", 5) == 0) {
+    consoleSimulateCard(RFID_EV_SCAN, line + 5);
+  } else if (strncmp(line, "card-remove ", 12) == 0) {
+    consoleSimulateCard(RFID_EV_REMOVED, line + 12);
+#if SCAN_TRACE_ENABLED
+  } else if (strcmp(line, "trace") == 0) {
+    traceDump();
+  } else if (strcmp(line, "trace reset") == 0) {
+    traceReset();
+#endif
+#if LOOP_PROFILE_ENABLED
+  } else if (strcmp(line, "prof") == 0) {
+    profDump();
+  } else if (strcmp(line, "prof reset") == 0) {
+    profReset();
+  } else if (strncmp(line, "prof budget ", 12) == 0) {
+    profSetBudgetUs((uint32_t)strtoul(line + 12, nullptr, 10));
+#endif
+  } else if (line[0] != '\0') {
+    consoleHelp();
+  }
+}
+
+static void serialPollCommands() {
+  static char line[CONSOLE_LINE_MAX];
+  static uint8_t len = 0;
+  while (Serial.available() > 0) {
+    char c = (char)Serial.read();
+    if (c == '\r')
+      continue;
+    if (c != '\n') {
+      if (len < sizeof(line) - 1)
+        line[len++] = c;
+      continue;
+    }
+    line[len] = '\0';
+    len = 0;
+    consoleRun(line);
+    return; // rest on the next loop()
+  }
 }
 
 void setup() {
+  hal.heap = &halHeap; // before anything allocates
+  loopTaskHandle = xTaskGetCurrentTaskHandle(); // setup() runs in loopTask
   Serial.begin(115200);
   delay(200);
   randomSeed(esp_random());
@@ -2300,9 +2184,7 @@ void setup() {
   // One shared SPI for both SD og RC522 (important!)
   SPI.begin(PIN_SCK, PIN_MISO, PIN_MOSI);
 
-  for (auto &b : buttons) {
-    pinMode(b.pin, INPUT_PULLUP);
-  }
+  buttonsInit();
 
   pinMode(PIN_LED_CARD, OUTPUT);
   // digitalWrite(PIN_LED_CARD, LOW);
@@ -2326,257 +2208,96 @@ void setup() {
   Serial.println("SD OK");
 
   // I2S out (UDA1334)
-  out = new AudioOutputI2S();
+  out = memNew<MEM_AUDIO, PlayerOutputI2S>();
   out->SetPinout(PIN_I2S_BCLK, PIN_I2S_WSEL, PIN_I2S_DIN);
   out->SetOutputModeMono(true);
-  prefs.begin(PREF_NS, false);
-
-  String lp = prefs.getString(PREF_KEY_LASTPATH, "");
-  if (lp.length() > 0 && lp.length() < sizeof(lastPath)) {
-    strncpy(lastPath, lp.c_str(), sizeof(lastPath) - 1);
-    hasLastPath = true;
-    Serial.print("Loaded last track: ");
-    Serial.println(lastPath);
-  }
-
-  int v = prefs.getInt(PREF_KEY_VOL, -1); // -1 = No stored value
-
-  if (v >= 0 && v <= 100) {
-    currentVolume = v / 100.0f;
-  } else {
-    currentVolume = 0.40f; // default
-  }
-
-  Serial.print("Loaded volume: ");
-  Serial.println(currentVolume, 2);
-
-  out->SetGain(currentVolume);
+  halKv.begin(PREF_NS);
 
   // RC522 init
   mfrc522.PCD_Init();
   mfrc522.PCD_AntennaOn();
   mfrc522.PCD_SetAntennaGain(mfrc522.RxGain_max);
   mfrc522.PCD_DumpVersionToSerial();
+  rfidInitDetection();
   Serial.println("RC522 OK");
 
-  audioQ = xQueueCreate(8, sizeof(AudioCmd));
-  xTaskCreatePinnedToCore(audioTask, "audio", 8192, nullptr, 3, nullptr, 1);
-
-  // Load JSON
-  loadCardsJson("/settings.json");
-  loadGamesJson("/settings.json"); // games[]: rules + prompts + audio
-  gameEnterIdle();
-  oledInit();
-
-  // DEBUG Remove when used
-  Serial.printf("Meta entries: %d\n", (int)trackMetaByPath.size());
-  auto it = trackMetaByPath.find(keyOfPath("/audio/hjulene_paa_bus.mp3"));
-  if (it != trackMetaByPath.end()) {
-    Serial.println(it->second.title);
-    Serial.println(it->second.artist);
-  }
-}
-
-void loop() {
+  rfidQ = xQueueCreate(RFID_QUEUE_LEN, sizeof(RfidScanEvent));
+  xTaskCreatePinnedToCore(rfidTask, "rfid", RFID_TASK_STACK, nullptr,
+                          RFID_TASK_PRIO, &rfidTaskHandle, RFID_TASK_CORE);
 
-  uint32_t now = millis();
-  ledTick(now);
-  // 1) Button must run continuesly (no early returns)
-  pollButtons(now);
-
-  oledDraw3LinesIfChanged(now, currentVolume);
-
-  static uint32_t lastPoll = 0;
-  gameTick(lastPoll, isPlaying && !isPaused);
-  //Try this 
-  //gameTick(now, isPlaying && !isPaused);
-
-  // Handle auto-advance from audioTask
-  if (!gameModeActive && advanceNeeded) {
-    advanceNeeded = false;
-    int idx = advanceIndex;
-    advanceIndex = -1;
-    if (idx >= 0 && idx < (int)activeCount) {
-      playActiveIndex(idx);
-    }
+  {
+    MemScope memScope(MEM_AUDIO); // queue + task stack
+    audioQ = xQueueCreate(8, sizeof(AudioCmd));
+    xTaskCreatePinnedToCore(audioTask, "audio", 8192, nullptr, 3,
+                            &audioTaskHandle, 1);
   }
 
-  maybeSaveVolume(now);
-
- 
-  if ((uint32_t)(now - lastPoll) >= 25) {
-
-    lastPoll = now;
-
-    // Make sure SD is not choosen , while we communicate with RC522
-    digitalWrite(PIN_SD_CS, HIGH);
-
-    // If no new card -> turn off LED and leave
-    if (!mfrc522.PICC_IsNewCardPresent()) {
-      // digitalWrite(PIN_LED_CARD, LOW);
-      ledSetNormal(false);
-      return;
-    }
-
-    // New card detected -> LED on instantly
-    // digitalWrite(PIN_LED_CARD, HIGH);
-    ledSetNormal(true);
-
-    if (!mfrc522.PICC_ReadCardSerial()) {
-      // Card was detected, buth could not be read – Turn off LED again
-      // digitalWrite(PIN_LED_CARD, LOW);
-      ledSetNormal(false);
-      return;
-    }
-
-    String uid = uidToHexUpper(mfrc522.uid);
-
-    mfrc522.PICC_HaltA();
-    mfrc522.PCD_StopCrypto1();
-
-    const CardEntry *e = findCardByUid(uid);
-    if (!e) {
-      Serial.print("Unknown UID: ");
-      Serial.println(uid);
-      ledSetNormal(false);
-      // digitalWrite(PIN_LED_CARD, LOW);
-      return;
-    }
-
-    Serial.print("Current role is: ");
-    Serial.println(e->role);
-    Serial.println(uid);
-
-    if (e->role == "parent") {
-      if (e->action == "toggle_anti_repeat") {
-        parentalAntiRepeatEnabled = !parentalAntiRepeatEnabled;
-
-        if (parentalAntiRepeatEnabled &&
-            uiMessages.antiRepeatEnabled.length() > 0) {
-          playPath(uiMessages.antiRepeatEnabled);
-        } else if (!parentalAntiRepeatEnabled &&
-                   uiMessages.antiRepeatDisabled.length() > 0) {
-          playPath(uiMessages.antiRepeatDisabled);
-        }
-      }
-      if (e->action == "toggle_volume_lock") {
-        volumeLocked = !volumeLocked;
-
-        if (volumeLocked) {
-          // Lås til nuværende værdi
-          lockedVolume = currentVolume;
+  hal.clock = &halClock;
+  hal.fs = &halFs;
+  hal.kv = &halKv;
+  hal.cards = &halCards;
+  hal.audio = &halAudio;
+  hal.display = &halDisplay;
 
-          if (uiMessages.volumeLockOn.length() > 0)
-            playPath(uiMessages.volumeLockOn);
+  // Last track + volume, settings.json, analytics
+  playerInit("/settings.json");
+  rfidPresenceCheckMs = rfidPresenceInterval();
 
-        } else {
-          // Når der låses op: fortsæt på den låste værdi
-          currentVolume = lockedVolume;
+  {
+    MemScope memScope(MEM_GAMES);
+    xTaskCreatePinnedToCore(analyticsTask, "analytics", 4096, nullptr, 1,
+                            &analyticsTaskHandle, 0);
+  }
+  {
+    MemScope memScope(MEM_INDEX);
+    xTaskCreatePinnedToCore(libraryTask, "library", LIBRARY_TASK_STACK, nullptr,
+                            LIBRARY_TASK_PRIO, &libraryTaskHandle, 0);
+  }
+  {
+    MemScope memScope(MEM_CATALOG);
+    xTaskCreatePinnedToCore(settingsTask, "settings", SETTINGS_TASK_STACK,
+                            nullptr, SETTINGS_TASK_PRIO, &settingsTaskHandle,
+                            0);
+  }
+  {
+    MemScope memScope(MEM_UI);
+    oledInit();
+    oledQ = xQueueCreate(1, sizeof(UiSnapshot));
+    xTaskCreatePinnedToCore(oledTask, "oled", OLED_TASK_STACK, nullptr,
+                            OLED_TASK_PRIO, &oledTaskHandle, OLED_TASK_CORE);
+  }
 
-          if (uiMessages.volumeLockOff.length() > 0)
-            playPath(uiMessages.volumeLockOff);
-        }
-  return;
+  powerInit();
+  statsReset(millis());
+  Serial.printf("Boot: ready %u ms after reset\n", (unsigned)millis());
 }
 
-      return;
-    }
-
-    if (e->role == "game_selector") {
-      Serial.println("GAME SELECT: " + e->gameId);
-
-      gameStartById(e->gameId,
-                    e->title); // always abort current + start selected
-      return;
-    }
-
-    if (e->role == "answer") {
-      // Hvis vi IKKE er klar til at modtage svar endnu (prompt/feedback
-      // spiller),
-      // så buffer UID så det tæller når vi går i COLLECT.
-      if (!gameModeActive || gameState != GameState::COLLECT) {
-        bufferedAnswerUid = uid;
-        bufferedAnswerAt = now;
-        hasBufferedAnswerUid = true;
-        ledStartBlink(now, 1000);
-        return;
-      }
-      gameOnAnswerScanned(*e);
-      return;
-    }
-
-    if (e->role == "music") {
-      if (gameModeActive) {
-        gamePlayMusicHint(true);
-        return;
-      }
-
-      if (e->kind == PK_SINGLE) {
-        autoAdvance = false;
-        playlistEnded = false;
-
-        String path = e->file;
-        if (!path.startsWith("/"))
-          path = "/" + path;
-
-        // Byg active-liste for next/prev i samme folder
-        setActiveFromFolder(dirnameOf(path));
-
-        // Find index i activeTracks hvis muligt (kun til navigation)
-        int found = -1;
-        for (size_t i = 0; i < activeCount; i++) {
-          if (activeTracks[i] == path) {
-            found = (int)i;
-            break;
-          }
-        }
-        if (found >= 0)
-          activeIndex = found;
-        else
-          activeIndex = 0; // fallback, men afspilning styres stadig af 'path'
-        oledLine2 = lookupAlbumTitleForTrackPath(path);
-        if (oledLine2.length() == 0) oledLine2 = e->title; // evt fallback
-        // Anti-repeat gate
-        playTrackDirect(path);
-        return;
-      } else if (e->kind == PK_ALBUM_FOLDER) {
-        autoAdvance = true;
-        playlistEnded = false;
-        String folder = e->folder;
-        if (!folder.startsWith("/"))
-          folder = "/" + folder;
-
-        oledLine2 = e->title;
-        oledLine3 = ""; // indtil JSON artist findes
-        setActiveFromFolder(folder);
-        playActiveIndex(0);
-      } else if (e->kind == PK_ALBUM_TRACKS) {
-        autoAdvance = true;
-        playlistEnded = false;
-        setActiveFromTrackPool(e->trackStart, e->trackCount);
-        oledLine2 = e->title;
-        oledLine3 = ""; // indtil JSON artist findes
-        playActiveIndex(0);
-      } else {
-        Serial.println("Music card missing play info");
-      }
-    }
+void loop() {
 
-    Serial.print("UID ");
-    Serial.print(uid);
-  }
+  uint32_t now = millis();
+  PROF_BEGIN();
+  ledTick(now);
+  PROF_MARK(LS_LED);
+  // 1) Button presses from buttonTask (no early returns before this)
+  handleButtonEvents(now);
+  PROF_MARK(LS_BUTTONS);
 
-  static uint32_t lastDbg = 0;
-if (now - lastDbg > 500) {
-  lastDbg = now;
-  Serial.print("activeCount: "); Serial.print(activeCount);
-  Serial.print(" activeIndex: "); Serial.print(activeIndex);
-  if (activeCount > 0) { Serial.print(" activeTracks[0]: "); Serial.print(activeTracks[0]); }
-  Serial.println();
-}
+  // 2) UI publish, game tick, auto-advance, volume save, RFID events
+  playerTick(now);
+  // settings.json may have been reloaded
+  rfidPresenceCheckMs = rfidPresenceInterval();
 
+  TRACE_TICK();
+  statsLoopTick();
+  serialPollCommands();
+  PROF_MARK(LS_CONSOLE);
 
   // Turn off LED after play was queded
   // digitalWrite(PIN_LED_CARD, LOW);
   ledSetNormal(false);
+
+  powerTick(now);
+  PROF_MARK(LS_POWER);
+  PROF_END(now);
+  powerLoopWait();
 }
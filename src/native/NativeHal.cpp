@@ -0,0 +1,372 @@
+#include "NativeHal.h"
+
+#include <dirent.h>
+#include <errno.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <math.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <random>
+
+#include <Arduino.h>
+
+// ---------------- Arduino core glue ----------------
+NativeSerial Serial;
+
+uint32_t millis() { return hal.clock ? hal.clock->millis() : 0; }
+uint32_t micros() { return hal.clock ? hal.clock->micros() : 0; }
+
+static std::mt19937 rng(1);
+
+void randomSeed(unsigned long seed) { rng.seed((uint32_t)seed); }
+
+long random(long max) { return max > 0 ? (long)(rng() % (uint32_t)max) : 0; }
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+// ---------------- SimClock ----------------
+uint32_t SimClock::cycles() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// ---------------- NativeHeapInfo ----------------
+size_t NativeHeapInfo::blockSize(const void *p) {
+#if defined(__GLIBC__)
+  return malloc_usable_size(const_cast<void *>(p));
+#else
+  (void)p;
+  return 0;
+#endif
+}
+
+HeapRegionInfo NativeHeapInfo::region(MemRegion r) {
+  HeapRegionInfo h{0, 0, 0, 0, 0};
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  if (r == MEM_INTERNAL)
+    h.usedBytes = mallinfo2().uordblks;
+#else
+  (void)r;
+#endif
+  return h;
+}
+
+// ---------------- DirFileSystem ----------------
+namespace {
+
+class StdioFile : public HalFile {
+public:
+  explicit StdioFile(FILE *f) : f_(f) {}
+  ~StdioFile() override { fclose(f_); }
+
+  size_t read(uint8_t *buf, size_t len) override {
+    return fread(buf, 1, len, f_);
+  }
+  size_t write(const uint8_t *buf, size_t len) override {
+    return fwrite(buf, 1, len, f_);
+  }
+  size_t size() override {
+    struct stat st;
+    return fstat(fileno(f_), &st) == 0 ? (size_t)st.st_size : 0;
+  }
+  bool seek(size_t pos) override { return fseek(f_, (long)pos, SEEK_SET) == 0; }
+
+private:
+  FILE *f_;
+};
+
+} // namespace
+
+std::string DirFileSystem::full(const char *path) const {
+  std::string p = root_;
+  if (path[0] != '/')
+    p += '/';
+  return p + path;
+}
+
+bool DirFileSystem::exists(const char *path) {
+  struct stat st;
+  return ::stat(full(path).c_str(), &st) == 0;
+}
+
+bool DirFileSystem::stat(const char *path, DirEntry &out) {
+  struct stat st;
+  if (::stat(full(path).c_str(), &st) != 0)
+    return false;
+  bool isDir = S_ISDIR(st.st_mode);
+  out = DirEntry{path, isDir, isDir ? 0u : (uint32_t)st.st_size,
+                 (uint32_t)st.st_mtime};
+  return true;
+}
+
+std::unique_ptr<HalFile> DirFileSystem::open(const char *path,
+                                             FileMode mode) {
+  FILE *f = fopen(full(path).c_str(), mode == FileMode::WRITE ? "wb" : "rb");
+  if (!f)
+    return nullptr;
+  return std::unique_ptr<HalFile>(new StdioFile(f));
+}
+
+bool DirFileSystem::listDir(const char *path, const DirFn &fn) {
+  std::string dirPath = full(path);
+  DIR *d = opendir(dirPath.c_str());
+  if (!d)
+    return false;
+
+  while (struct dirent *e = readdir(d)) {
+    if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0)
+      continue;
+    struct stat st;
+    std::string p = dirPath + "/" + e->d_name;
+    if (::stat(p.c_str(), &st) != 0)
+      continue;
+    bool isDir = S_ISDIR(st.st_mode);
+    fn(DirEntry{e->d_name, isDir, isDir ? 0u : (uint32_t)st.st_size,
+                (uint32_t)st.st_mtime});
+  }
+  closedir(d);
+  return true;
+}
+
+bool DirFileSystem::rename(const char *from, const char *to) {
+  return ::rename(full(from).c_str(), full(to).c_str()) == 0;
+}
+
+bool DirFileSystem::remove(const char *path) {
+  return ::remove(full(path).c_str()) == 0;
+}
+
+bool DirFileSystem::mkdir(const char *path) {
+  return ::mkdir(full(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+// ---------------- MemKvStore ----------------
+int32_t MemKvStore::getInt(const char *key, int32_t def) {
+  auto it = ints_.find(key);
+  return it == ints_.end() ? def : it->second;
+}
+
+void MemKvStore::putInt(const char *key, int32_t value) { ints_[key] = value; }
+
+size_t MemKvStore::getString(const char *key, char *buf, size_t size) {
+  buf[0] = '\0';
+  auto it = strings_.find(key);
+  if (it == strings_.end() || it->second.size() + 1 > size)
+    return 0;
+  memcpy(buf, it->second.c_str(), it->second.size() + 1);
+  return it->second.size();
+}
+
+void MemKvStore::putString(const char *key, const char *value) {
+  strings_[key] = value;
+}
+
+// ---------------- ScriptCardReader ----------------
+void ScriptCardReader::add(RfidEventType type, const char *uid,
+                           uint32_t atMs) {
+  RfidScanEvent ev{};
+  ev.type = type;
+  strncpy(ev.uid, uid, sizeof(ev.uid) - 1);
+  ev.sak = 0x08;
+  ev.attempts = 1;
+  ev.detectedAtMs = atMs;
+  pending_.push_back(ev);
+}
+
+bool ScriptCardReader::poll(RfidScanEvent &ev) {
+  if (pending_.empty() ||
+      (int32_t)(hal.clock->millis() - pending_.front().detectedAtMs) < 0)
+    return false;
+  ev = pending_.front();
+  pending_.pop_front();
+  return true;
+}
+
+// ---------------- WavAudioSink ----------------
+static void putLe16(FILE *f, uint16_t v) {
+  uint8_t b[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+  fwrite(b, 1, 2, f);
+}
+
+static void putLe32(FILE *f, uint32_t v) {
+  uint8_t b[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16),
+                  (uint8_t)(v >> 24)};
+  fwrite(b, 1, 4, f);
+}
+
+// RIFF header; sizes are patched by close()
+static void writeWavHeader(FILE *f, uint32_t dataBytes) {
+  fwrite("RIFF", 1, 4, f);
+  putLe32(f, 36 + dataBytes);
+  fwrite("WAVEfmt ", 1, 8, f);
+  putLe32(f, 16);
+  putLe16(f, 1); // PCM
+  putLe16(f, 1); // mono
+  putLe32(f, WavAudioSink::SAMPLE_RATE);
+  putLe32(f, WavAudioSink::SAMPLE_RATE * 2);
+  putLe16(f, 2);
+  putLe16(f, 16);
+  fwrite("data", 1, 4, f);
+  putLe32(f, dataBytes);
+}
+
+bool WavAudioSink::open(const char *wavPath) {
+  close();
+  renderedUntil_ = clock_.millis();
+  if (!wavPath)
+    return true;
+  wav_ = fopen(wavPath, "wb");
+  if (!wav_)
+    return false;
+  writeWavHeader(wav_, 0);
+  samplesWritten_ = 0;
+  return true;
+}
+
+void WavAudioSink::close() {
+  if (!wav_)
+    return;
+  fseek(wav_, 0, SEEK_SET);
+  writeWavHeader(wav_, samplesWritten_ * 2);
+  fclose(wav_);
+  wav_ = nullptr;
+}
+
+void WavAudioSink::writeSamples(uint32_t count) {
+  bool audible = playing_ && !paused_;
+  double step = 2.0 * M_PI * toneHz_ / SAMPLE_RATE;
+  for (uint32_t i = 0; i < count; i++) {
+    int16_t v = 0;
+    if (audible) {
+      v = (int16_t)(sin(phase_) * gain_ * 32767.0);
+      phase_ += step;
+    }
+    if (wav_)
+      putLe16(wav_, (uint16_t)v);
+  }
+  samplesWritten_ += count;
+}
+
+void WavAudioSink::tick(uint32_t now) {
+  while ((int32_t)(now - renderedUntil_) > 0) {
+    uint32_t ms = now - renderedUntil_;
+    if (playing_ && !paused_ && trackMs_ - playedMs_ < ms)
+      ms = trackMs_ - playedMs_;
+
+    writeSamples(ms * SAMPLE_RATE / 1000);
+    renderedUntil_ += ms;
+
+    if (playing_ && !paused_) {
+      playedMs_ += ms;
+      if (playedMs_ >= trackMs_) {
+        playing_ = false;
+        ended_ = true;
+        Serial.println("[audio] track ended");
+      }
+    }
+  }
+}
+
+void WavAudioSink::play(const char *path) {
+  // Same as the firmware: a new command stops what is playing first
+  playing_ = false;
+  paused_ = false;
+
+  std::unique_ptr<HalFile> f = fs_.open(path, FileMode::READ);
+  if (!f) {
+    Serial.printf("[audio] cannot open %s\n", path);
+    return;
+  }
+
+  size_t bytes = f->size();
+  trackMs_ = bytes ? (uint32_t)((uint64_t)bytes * 8000 / ASSUMED_BITRATE)
+                   : EMPTY_FILE_MS;
+  if (trackMs_ == 0)
+    trackMs_ = 1;
+
+  // FNV-1a of the path -> a tone between 220 and 880 Hz
+  uint32_t h = 2166136261u;
+  for (const char *p = path; *p; p++)
+    h = (h ^ (uint8_t)*p) * 16777619u;
+  toneHz_ = 220.0f + (float)(h % 661);
+
+  playedMs_ = 0;
+  phase_ = 0.0;
+  playing_ = true;
+  tracksStarted_++;
+  Serial.printf("[audio] play %s (%u ms, %.0f Hz)\n", path,
+                (unsigned)trackMs_, toneHz_);
+}
+
+void WavAudioSink::pause() {
+  if (playing_)
+    paused_ = true;
+}
+
+void WavAudioSink::resume() { paused_ = false; }
+
+void WavAudioSink::togglePause() {
+  if (playing_)
+    paused_ = !paused_;
+}
+
+bool WavAudioSink::takeTrackEnded() {
+  if (!ended_)
+    return false;
+  ended_ = false;
+  return true;
+}
+
+void WavAudioSink::seekBy(int32_t deltaMs) {
+  if (!playing_)
+    return;
+  int64_t to = (int64_t)playedMs_ + deltaMs;
+  int64_t last =
+      trackMs_ > SEEK_END_GUARD_MS ? trackMs_ - SEEK_END_GUARD_MS : 0;
+  playedMs_ = (uint32_t)(to < 0 ? 0 : to > last ? last : to);
+  Serial.printf("[audio] seek %+d ms -> %u ms\n", (int)deltaMs,
+                (unsigned)playedMs_);
+}
+
+// ---------------- ConsoleDisplay ----------------
+void ConsoleDisplay::show(const UiSnapshot &s) {
+  uint32_t now = hal.clock->millis();
+  if (s.gameMode != last_.gameMode || s.locked != last_.locked ||
+      s.antiRepeat != last_.antiRepeat || s.shuffle != last_.shuffle ||
+      s.pct != last_.pct) {
+    Serial.printf("%8u [oled] %s vol %d%%%s%s%s\n", (unsigned)now,
+                  s.gameMode ? "GAME" : "MUSIC", s.pct,
+                  s.locked ? " locked" : "", s.antiRepeat ? " anti-repeat" : "",
+                  s.shuffle ? " shuffle" : "");
+  }
+  // Progress in 10 % steps, the bar itself moves every 1 %
+  if (s.progress / 10 != last_.progress / 10 ||
+      (s.progress < 0) != (last_.progress < 0))
+    Serial.printf("%8u [oled] progress %d%%\n", (unsigned)now, s.progress);
+  if (s.line2Gen != last_.line2Gen)
+    Serial.printf("%8u [oled] 2: %s\n", (unsigned)now, s.line2);
+  if (s.line3Gen != last_.line3Gen)
+    Serial.printf("%8u [oled] 3: %s\n", (unsigned)now, s.line3);
+  last_ = s;
+}
+
+void ConsoleDisplay::setCardLed(bool on) {
+  if (on == led_)
+    return;
+  led_ = on;
+  Serial.printf("%8u [led] %s\n", (unsigned)hal.clock->millis(),
+                on ? "on" : "off");
+}
+
+void ConsoleDisplay::blinkCardLed(uint32_t now, uint32_t durationMs) {
+  Serial.printf("%8u [led] blink %u ms\n", (unsigned)now,
+                (unsigned)durationMs);
+}
+
+void ConsoleDisplay::stopCardLedBlink() {}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "../hal/Hal.h"
+#include "../UiModel.h"
+
+// Host backends for env:native. Time only moves when the simulator says so,
+// so a script run gives the same output every time.
+
+class SimClock : public Clock {
+public:
+  uint32_t millis() override { return nowMs_; }
+  uint32_t micros() override { return nowMs_ * 1000u; }
+  // Host time in ns, not simulated time: the profiler measures real work
+  uint32_t cycles() override;
+  uint32_t cyclesPerUs() override { return 1000; }
+  void set(uint32_t nowMs) { nowMs_ = nowMs; }
+
+private:
+  uint32_t nowMs_ = 0;
+};
+
+// Host heap: all of it counts as internal RAM. Only usedBytes is known
+// (glibc); free/largest block do not mean much on a PC.
+class NativeHeapInfo : public HeapInfo {
+public:
+  MemRegion regionOf(const void *) override { return MEM_INTERNAL; }
+  size_t blockSize(const void *p) override;
+  HeapRegionInfo region(MemRegion r) override;
+  void *allocLarge(size_t bytes) override { return malloc(bytes); }
+};
+
+// A local directory as SD card: "/audio/x.mp3" -> <root>/audio/x.mp3
+class DirFileSystem : public FileSystem {
+public:
+  explicit DirFileSystem(const char *root) : root_(root) {}
+
+  bool exists(const char *path) override;
+  bool stat(const char *path, DirEntry &out) override;
+  std::unique_ptr<HalFile> open(const char *path, FileMode mode) override;
+  bool listDir(const char *path, const DirFn &fn) override;
+  bool rename(const char *from, const char *to) override;
+  bool remove(const char *path) override;
+  bool mkdir(const char *path) override;
+
+private:
+  std::string full(const char *path) const;
+
+  std::string root_;
+};
+
+class MemKvStore : public KvStore {
+public:
+  int32_t getInt(const char *key, int32_t def) override;
+  void putInt(const char *key, int32_t value) override;
+  size_t getString(const char *key, char *buf, size_t size) override;
+  void putString(const char *key, const char *value) override;
+
+private:
+  std::map<std::string, int32_t> ints_;
+  std::map<std::string, std::string> strings_;
+};
+
+// Card events from the script, handed out once hal.clock reaches them
+class ScriptCardReader : public CardReader {
+public:
+  // Events must be added in time order
+  void add(RfidEventType type, const char *uid, uint32_t atMs);
+  bool poll(RfidScanEvent &ev) override;
+
+private:
+  std::deque<RfidScanEvent> pending_;
+};
+
+// Writes what would have been played to a 16 bit mono WAV. There is no MP3
+// decoder on the host, so each track becomes a tone (pitch from the path,
+// length from the file size at 128 kbit/s); pauses are silence.
+class WavAudioSink : public AudioSink {
+public:
+  static constexpr uint32_t SAMPLE_RATE = 16000;
+  static constexpr uint32_t ASSUMED_BITRATE = 128000;
+  static constexpr uint32_t EMPTY_FILE_MS = 3000; // tracks of size 0
+
+  WavAudioSink(FileSystem &fs, Clock &clock) : fs_(fs), clock_(clock) {}
+  ~WavAudioSink() override { close(); }
+
+  bool open(const char *wavPath); // nullptr = no output file, state only
+  void close();
+  // Renders audio up to now; call once per simulated tick
+  void tick(uint32_t now);
+
+  void play(const char *path) override;
+  void pause() override;
+  void resume() override;
+  void togglePause() override;
+  void setGain(float gain) override { gain_ = gain; }
+  bool isPlaying() override { return playing_; }
+  bool isPaused() override { return paused_; }
+  bool takeTrackEnded() override;
+  void seekBy(int32_t deltaMs) override;
+  uint32_t positionMs() override { return playing_ ? playedMs_ : 0; }
+  uint32_t durationMs() override { return playing_ ? trackMs_ : 0; }
+
+  uint32_t tracksStarted() const { return tracksStarted_; }
+
+private:
+  void writeSamples(uint32_t count);
+
+  FileSystem &fs_;
+  Clock &clock_;
+  FILE *wav_ = nullptr;
+  uint32_t samplesWritten_ = 0;
+  uint32_t renderedUntil_ = 0; // ms
+  double phase_ = 0.0;
+
+  bool playing_ = false;
+  bool paused_ = false;
+  bool ended_ = false;
+  float gain_ = 0.4f;
+  float toneHz_ = 440.0f;
+  uint32_t trackMs_ = 0;
+  uint32_t playedMs_ = 0;
+  uint32_t tracksStarted_ = 0;
+};
+
+// Prints the OLED lines and the card LED when they change
+class ConsoleDisplay : public Display {
+public:
+  void show(const UiSnapshot &s) override;
+  void setCardLed(bool on) override;
+  void blinkCardLed(uint32_t now, uint32_t durationMs) override;
+  void stopCardLedBlink() override;
+
+private:
+  UiSnapshot last_{false, false, false, false, -1, -1, 0, 0, "", ""};
+  bool led_ = false;
+};
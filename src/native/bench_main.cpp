@@ -0,0 +1,331 @@
+// Settings loader benchmark (env:native-bench): runs loadCardsJson() and
+// loadGamesJson() on one or more SD-card folders, e.g. the ones written by
+// tools/gen_settings.py, and prints one JSON line per folder.
+//
+//   python3 tools/gen_settings.py bench --all
+//   pio run -e native-bench
+//   .pio/build/native-bench/program bench/small bench/medium --runs 5
+//
+// Per loader: parse_us_min/median over the runs (wall clock on the host),
+// and from the first run peak_heap (highest live heap above the start),
+// final_heap (still allocated afterwards), final_blocks (the same as a block
+// count, a fragmentation hint) and alloc_calls. Heap figures come from
+// counting malloc/free (glibc only, otherwise 0). Host pointers are 8 bytes,
+// so absolute sizes are above the ESP32's; compare runs with each other.
+//
+// After loading, the player runs on the catalog: "scan" times playerTick()
+// for up to BENCH_SCANS music cards spread over settings.json (lookup,
+// folder listing or track list, first play), "next"/"prev" time the buttons
+// on the biggest playlist that was seen. Times are min/median/max in us.
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "../Catalog.h"
+#include "../GameEngine.h"
+#include "../Player.h"
+#include "../Playlist.h"
+#include "NativeHal.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define BENCH_HEAP_COUNTING 1
+#else
+#define BENCH_HEAP_COUNTING 0
+#endif
+
+static constexpr const char *SETTINGS_PATH = "/settings.json";
+static constexpr size_t BENCH_SCANS = 50;
+static constexpr size_t BENCH_STEPS = 50;    // next and prev presses each
+static constexpr uint32_t BENCH_SCAN_GAP_MS = 2000; // past the scan dedup
+
+// ---------------- Heap counting ----------------
+struct HeapCounters {
+  size_t live;   // bytes
+  size_t peak;   // highest live since measure() started
+  size_t blocks; // live allocations
+  size_t calls;  // malloc/calloc/realloc calls
+};
+
+static HeapCounters heap{0, 0, 0, 0};
+
+#if BENCH_HEAP_COUNTING
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void __libc_free(void *);
+
+static void heapNoteAlloc(void *p) {
+  heap.live += malloc_usable_size(p);
+  heap.blocks++;
+  heap.calls++;
+  if (heap.live > heap.peak)
+    heap.peak = heap.live;
+}
+
+void *malloc(size_t n) {
+  void *p = __libc_malloc(n);
+  if (p)
+    heapNoteAlloc(p);
+  return p;
+}
+
+void *calloc(size_t n, size_t size) {
+  void *p = __libc_calloc(n, size);
+  if (p)
+    heapNoteAlloc(p);
+  return p;
+}
+
+void *realloc(void *old, size_t n) {
+  size_t oldSize = old ? malloc_usable_size(old) : 0;
+  void *p = __libc_realloc(old, n);
+  if (!p)
+    return p; // old block untouched (or freed for n == 0)
+  if (old) {
+    heap.live -= oldSize;
+    heap.blocks--;
+  }
+  heapNoteAlloc(p);
+  return p;
+}
+
+void free(void *p) {
+  if (!p)
+    return;
+  heap.live -= malloc_usable_size(p);
+  heap.blocks--;
+  __libc_free(p);
+}
+}
+#endif
+
+// ---------------- Benchmark ----------------
+struct LoaderResult {
+  bool ok = true;
+  std::vector<uint32_t> us;
+  size_t peakHeap = 0;
+  size_t finalHeap = 0;
+  long finalBlocks = 0;
+  size_t allocCalls = 0;
+};
+
+template <typename F>
+static void measure(LoaderResult &r, bool firstRun, F load) {
+  HeapCounters start = heap;
+  heap.peak = heap.live;
+
+  auto t0 = std::chrono::steady_clock::now();
+  bool ok = load();
+  auto t1 = std::chrono::steady_clock::now();
+
+  r.ok = r.ok && ok;
+  r.us.push_back((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                     t1 - t0)
+                     .count());
+  if (firstRun) {
+    r.peakHeap = heap.peak - start.live;
+    r.finalHeap = heap.live > start.live ? heap.live - start.live : 0;
+    r.finalBlocks = (long)heap.blocks - (long)start.blocks;
+    r.allocCalls = heap.calls - start.calls;
+  }
+}
+
+static void printLoader(FILE *out, const char *name, LoaderResult &r) {
+  std::sort(r.us.begin(), r.us.end());
+  fprintf(out,
+          "\"%s\":{\"ok\":%s,\"parse_us_min\":%u,\"parse_us_median\":%u,"
+          "\"peak_heap\":%zu,\"final_heap\":%zu,\"final_blocks\":%ld,"
+          "\"alloc_calls\":%zu}",
+          name, r.ok ? "true" : "false", (unsigned)r.us.front(),
+          (unsigned)r.us[r.us.size() / 2], r.peakHeap, r.finalHeap,
+          r.finalBlocks, r.allocCalls);
+}
+
+// ---------------- Player latency ----------------
+struct Latency {
+  std::vector<uint32_t> us;
+};
+
+template <typename F> static void timeUs(Latency &l, F step) {
+  auto t0 = std::chrono::steady_clock::now();
+  step();
+  auto t1 = std::chrono::steady_clock::now();
+  l.us.push_back((uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                     t1 - t0)
+                     .count());
+}
+
+static void printLatency(FILE *out, const char *name, Latency &l) {
+  std::sort(l.us.begin(), l.us.end());
+  if (l.us.empty()) {
+    fprintf(out, "\"%s\":{\"n\":0}", name);
+    return;
+  }
+  fprintf(out, "\"%s\":{\"n\":%zu,\"us_min\":%u,\"us_median\":%u,"
+               "\"us_max\":%u}",
+          name, l.us.size(), (unsigned)l.us.front(),
+          (unsigned)l.us[l.us.size() / 2], (unsigned)l.us.back());
+}
+
+struct PlayerResult {
+  Latency scan, next, prev;
+  size_t biggestPlaylist = 0;
+};
+
+static void benchPlayer(PlayerResult &r, SimClock &clock,
+                        ScriptCardReader &reader) {
+  gameEnterIdle();
+  std::vector<size_t> music;
+  for (size_t i = 0; i < cards.size(); i++) {
+    if (cards[i].role == "music")
+      music.push_back(i);
+  }
+  size_t step = music.size() > BENCH_SCANS ? music.size() / BENCH_SCANS : 1;
+
+  uint32_t now = clock.millis();
+  String lastUid, biggestUid;
+  for (size_t k = 0; k < music.size() && r.scan.us.size() < BENCH_SCANS;
+       k += step) {
+    const String uid = cards[music[k]].uid;
+    now += BENCH_SCAN_GAP_MS;
+    clock.set(now);
+    reader.add(RFID_EV_SCAN, uid.c_str(), now);
+    timeUs(r.scan, [now] { playerTick(now); });
+    lastUid = uid;
+    if (activeTracks.size() > r.biggestPlaylist) {
+      r.biggestPlaylist = activeTracks.size();
+      biggestUid = uid;
+    }
+  }
+  if (r.biggestPlaylist == 0)
+    return;
+
+  if (biggestUid != lastUid) {
+    now += BENCH_SCAN_GAP_MS;
+    clock.set(now);
+    reader.add(RFID_EV_SCAN, biggestUid.c_str(), now);
+    playerTick(now);
+  }
+  for (size_t i = 0; i < BENCH_STEPS; i++)
+    timeUs(r.next, [] { handleAction(ACT_NEXT); });
+  for (size_t i = 0; i < BENCH_STEPS; i++)
+    timeUs(r.prev, [] { handleAction(ACT_PREV); });
+}
+
+static void jsonString(FILE *out, const char *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fputc('\\', out);
+    fputc(*s, out);
+  }
+  fputc('"', out);
+}
+
+int main(int argc, char **argv) {
+  std::vector<const char *> dirs;
+  unsigned runs = 5;
+  const char *outPath = nullptr;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = (unsigned)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else {
+      dirs.push_back(argv[i]);
+    }
+  }
+  if (dirs.empty() || runs == 0) {
+    fprintf(stderr,
+            "usage: %s <sd-dir>... [--runs N] [--out results.jsonl] [-v]\n",
+            argv[0]);
+    return 2;
+  }
+
+  FILE *out = outPath ? fopen(outPath, "w") : stdout;
+  if (!out) {
+    fprintf(stderr, "cannot write %s\n", outPath);
+    return 2;
+  }
+  // Loader logs only with -v (to stderr, stdout is the JSON)
+  Serial.setStream(verbose ? stderr : nullptr);
+
+  // Never destroyed: the global text pools give their memory back at exit
+  static NativeHeapInfo &heapInfo = *new NativeHeapInfo;
+  static SimClock clock;
+  static MemKvStore kv;
+  static ScriptCardReader reader;
+  static ConsoleDisplay display;
+  hal.heap = &heapInfo;
+  hal.clock = &clock;
+  hal.kv = &kv;
+  hal.cards = &reader;
+  hal.display = &display;
+
+  bool allOk = true;
+  for (const char *dir : dirs) {
+    DirFileSystem fs(dir);
+    hal.fs = &fs;
+
+    std::unique_ptr<HalFile> f = fs.open(SETTINGS_PATH, FileMode::READ);
+    if (!f) {
+      fprintf(stderr, "%s: no settings.json\n", dir);
+      allOk = false;
+      continue;
+    }
+    size_t bytes = f->size();
+    f.reset();
+
+    LoaderResult cardsRes, gamesRes;
+    for (unsigned run = 0; run < runs; run++) {
+      measure(cardsRes, run == 0, [] { return loadCardsJson(SETTINGS_PATH); });
+      measure(gamesRes, run == 0, [] { return loadGamesJson(SETTINGS_PATH); });
+    }
+    allOk = allOk && cardsRes.ok && gamesRes.ok;
+
+    // The audio sink only opens the files (for their length), no WAV
+    WavAudioSink audio(fs, clock);
+    audio.open(nullptr);
+    hal.audio = &audio;
+    PlayerResult playerRes;
+    benchPlayer(playerRes, clock, reader);
+    hal.audio = nullptr;
+
+    fprintf(out, "{\"bench\":\"settings_load\",\"corpus\":");
+    jsonString(out, dir);
+    fprintf(out,
+            ",\"settings_bytes\":%zu,\"doc_capacity\":%zu,\"runs\":%u,"
+            "\"cards\":%zu,\"tracks\":%zu,\"games\":%u,\"questions\":%zu,"
+            "\"heap_counting\":%s,",
+            bytes, docSizeFor(bytes), runs, cards.size(), trackPool.size(),
+            (unsigned)gamesLoaded(), questionsLoaded(),
+            BENCH_HEAP_COUNTING ? "true" : "false");
+    printLoader(out, "load_cards", cardsRes);
+    fputc(',', out);
+    printLoader(out, "load_games", gamesRes);
+    fprintf(out, ",\"biggest_playlist\":%zu,", playerRes.biggestPlaylist);
+    printLatency(out, "scan", playerRes.scan);
+    fputc(',', out);
+    printLatency(out, "next", playerRes.next);
+    fputc(',', out);
+    printLatency(out, "prev", playerRes.prev);
+    fprintf(out, "}\n");
+    fflush(out);
+
+    hal.fs = nullptr;
+  }
+
+  if (outPath)
+    fclose(out);
+  // Non-zero when a loader failed (e.g. settings.json larger than DOC_SIZE)
+  return allOk ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+// Minimal Arduino core for the native build (env:native): the subset of
+// String, Serial, millis() and random() the player logic uses. Not a
+// general replacement; add members here when shared code needs them.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#define DEC 10
+#define HEX 16
+
+// millis()/micros() come from hal.clock, random() is seeded by randomSeed()
+uint32_t millis();
+uint32_t micros();
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+class String {
+public:
+  String() = default;
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(int v, unsigned char base = DEC) : s_(fmtLong(v, base)) {}
+  explicit String(unsigned int v, unsigned char base = DEC)
+      : s_(fmtULong(v, base)) {}
+  explicit String(long v, unsigned char base = DEC) : s_(fmtLong(v, base)) {}
+  explicit String(unsigned long v, unsigned char base = DEC)
+      : s_(fmtULong(v, base)) {}
+  explicit String(double v, unsigned int digits = 2) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", (int)digits, v);
+    s_ = buf;
+  }
+
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool isEmpty() const { return s_.empty(); }
+  const char *c_str() const { return s_.c_str(); }
+  void reserve(unsigned int n) { s_.reserve(n); }
+
+  char charAt(unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  void setCharAt(unsigned int i, char c) {
+    if (i < s_.size())
+      s_[i] = c;
+  }
+
+  String &operator=(const char *s) {
+    s_ = s ? s : "";
+    return *this;
+  }
+  String &operator+=(const String &o) {
+    s_ += o.s_;
+    return *this;
+  }
+  String &operator+=(const char *s) {
+    if (s)
+      s_ += s;
+    return *this;
+  }
+  String &operator+=(char c) {
+    s_ += c;
+    return *this;
+  }
+  bool concat(const String &o) {
+    s_ += o.s_;
+    return true;
+  }
+  bool concat(const char *s) {
+    *this += s;
+    return true;
+  }
+  bool concat(char c) {
+    s_ += c;
+    return true;
+  }
+
+  bool equals(const String &o) const { return s_ == o.s_; }
+  bool equalsIgnoreCase(const String &o) const {
+    return strcasecmp(c_str(), o.c_str()) == 0;
+  }
+  int compareTo(const String &o) const { return s_.compare(o.s_); }
+  bool startsWith(const String &p) const {
+    return s_.compare(0, p.s_.size(), p.s_) == 0;
+  }
+  bool endsWith(const String &p) const {
+    return s_.size() >= p.s_.size() &&
+           s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return pos(s_.find(c, from)); }
+  int indexOf(const String &n, unsigned int from = 0) const {
+    return pos(s_.find(n.s_, from));
+  }
+  int lastIndexOf(char c) const { return pos(s_.rfind(c)); }
+  int lastIndexOf(const String &n) const { return pos(s_.rfind(n.s_)); }
+
+  String substring(unsigned int from) const {
+    return from < s_.size() ? String(s_.substr(from)) : String();
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) {
+      unsigned int t = from;
+      from = to;
+      to = t;
+    }
+    if (from >= s_.size())
+      return String();
+    return String(s_.substr(from, to - from));
+  }
+
+  void replace(const String &find, const String &with) {
+    if (find.s_.empty())
+      return;
+    size_t at = 0;
+    while ((at = s_.find(find.s_, at)) != std::string::npos) {
+      s_.replace(at, find.s_.size(), with.s_);
+      at += with.s_.size();
+    }
+  }
+  void remove(unsigned int index) {
+    if (index < s_.size())
+      s_.erase(index);
+  }
+  void remove(unsigned int index, unsigned int count) {
+    if (index < s_.size())
+      s_.erase(index, count);
+  }
+  void toUpperCase() {
+    for (char &c : s_)
+      c = (char)toupper((unsigned char)c);
+  }
+  void toLowerCase() {
+    for (char &c : s_)
+      c = (char)tolower((unsigned char)c);
+  }
+  void trim() {
+    size_t b = 0, e = s_.size();
+    while (b < e && isspace((unsigned char)s_[b]))
+      b++;
+    while (e > b && isspace((unsigned char)s_[e - 1]))
+      e--;
+    s_ = s_.substr(b, e - b);
+  }
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return (float)atof(c_str()); }
+
+  friend bool operator==(const String &a, const String &b) { return a.s_ == b.s_; }
+  friend bool operator==(const String &a, const char *b) { return a.s_ == (b ? b : ""); }
+  friend bool operator!=(const String &a, const String &b) { return a.s_ != b.s_; }
+  friend bool operator!=(const String &a, const char *b) { return !(a == b); }
+  friend bool operator<(const String &a, const String &b) { return a.s_ < b.s_; }
+  friend bool operator>(const String &a, const String &b) { return a.s_ > b.s_; }
+
+  friend String operator+(const String &a, const String &b) { return String(a.s_ + b.s_); }
+  friend String operator+(const String &a, const char *b) { return String(a.s_ + (b ? b : "")); }
+  friend String operator+(const char *a, const String &b) { return String((a ? a : "") + b.s_); }
+  friend String operator+(const String &a, char c) { return String(a.s_ + c); }
+
+private:
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  static std::string fmtULong(unsigned long v, unsigned char base) {
+    if (base == HEX) {
+      char buf[24];
+      snprintf(buf, sizeof(buf), "%lX", v);
+      return buf;
+    }
+    return std::to_string(v);
+  }
+  static std::string fmtLong(long v, unsigned char base) {
+    if (base == HEX)
+      return fmtULong((unsigned long)v, base);
+    return std::to_string(v);
+  }
+
+  std::string s_;
+};
+
+// Serial monitor -> stdout (setStream(nullptr) drops the output)
+class NativeSerial {
+public:
+  void begin(unsigned long) {}
+  void setStream(FILE *f) { out_ = f; }
+
+  size_t print(const char *s) {
+    if (out_)
+      fputs(s, out_);
+    return strlen(s);
+  }
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(char c) {
+    char s[2] = {c, 0};
+    return print(s);
+  }
+  size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(unsigned long v, int base = DEC) {
+    return print(String(v, (unsigned char)base));
+  }
+  size_t print(double v, int digits = 2) { return print(String(v, digits)); }
+
+  size_t println() { return print("\n"); }
+  template <typename T> size_t println(const T &v) { return print(v) + println(); }
+  template <typename T> size_t println(const T &v, int fmt) {
+    return print(v, fmt) + println();
+  }
+
+  int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = out_ ? vfprintf(out_, fmt, ap) : vsnprintf(nullptr, 0, fmt, ap);
+    va_end(ap);
+    return n;
+  }
+
+  void flush() {
+    if (out_)
+      fflush(out_);
+  }
+
+private:
+  FILE *out_ = stdout;
+};
+
+extern NativeSerial Serial;
@@ -0,0 +1,162 @@
+// Native simulator (env:native): runs the player logic against a local
+// directory as SD card, a scripted card reader and buttons, and writes the
+// audio to a WAV file.
+//
+//   pio run -e native
+//   .pio/build/native/program <sd-dir> <script> [out.wav]
+//
+// Script, one event per line ('#' starts a comment), times in ms:
+//   <ms> scan <UID>            card put on the reader
+//   <ms> remove <UID>          card taken away
+//   <ms> return <UID>          same card put back
+//   <ms> press <button> [ms]   push and release (default held 80 ms); next
+//                              and prev held over 350 ms seek instead
+//   <ms> end                   stop (default: 5 s after the last event)
+// Buttons: play, next, prev, volup, voldown, music
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../ButtonInput.h"
+#include "../Buttons.h"
+#include "../LibraryIndex.h"
+#include "../Player.h"
+#include "../SettingsReload.h"
+#include "NativeHal.h"
+
+static constexpr uint32_t SIM_TICK_MS = 10;
+static constexpr uint32_t SIM_TAIL_MS = 5000;
+static constexpr uint32_t PRESS_DEFAULT_MS = 80;
+
+static bool loadScript(const char *path, ScriptCardReader &cards,
+                       std::vector<ButtonEdge> &edges, uint32_t &endMs) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "cannot open script %s\n", path);
+    return false;
+  }
+
+  char line[256];
+  int lineNo = 0;
+  bool haveEnd = false;
+  uint32_t lastMs = 0;
+  bool ok = true;
+  while (fgets(line, sizeof(line), f)) {
+    lineNo++;
+    char *hash = strchr(line, '#');
+    if (hash)
+      *hash = '\0';
+
+    unsigned long at = 0;
+    char cmd[16] = "", arg[32] = "";
+    unsigned long holdMs = PRESS_DEFAULT_MS;
+    int n = sscanf(line, "%lu %15s %31s %lu", &at, cmd, arg, &holdMs);
+    if (n <= 0)
+      continue; // blank line
+
+    if (n >= 2 && strcmp(cmd, "end") == 0) {
+      endMs = at;
+      haveEnd = true;
+    } else if (n >= 3 && strcmp(cmd, "scan") == 0) {
+      cards.add(RFID_EV_SCAN, arg, at);
+    } else if (n >= 3 && strcmp(cmd, "remove") == 0) {
+      cards.add(RFID_EV_REMOVED, arg, at);
+    } else if (n >= 3 && strcmp(cmd, "return") == 0) {
+      cards.add(RFID_EV_RETURNED, arg, at);
+    } else if (n >= 3 && strcmp(cmd, "press") == 0 && buttonByName(arg) >= 0) {
+      uint8_t b = (uint8_t)buttonByName(arg);
+      edges.push_back({b, true, (uint32_t)at});
+      edges.push_back({b, false, (uint32_t)(at + holdMs)});
+      at += holdMs;
+    } else {
+      fprintf(stderr, "%s:%d: cannot parse '%s'\n", path, lineNo, line);
+      ok = false;
+      continue;
+    }
+    if (at < lastMs) {
+      fprintf(stderr, "%s:%d: events must be in time order\n", path, lineNo);
+      ok = false;
+    }
+    lastMs = at;
+  }
+  fclose(f);
+
+  if (!haveEnd)
+    endMs = lastMs + SIM_TAIL_MS;
+  std::stable_sort(edges.begin(), edges.end(),
+                   [](const ButtonEdge &a, const ButtonEdge &b) {
+                     return a.atMs < b.atMs;
+                   });
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <sd-dir> <script> [out.wav]\n", argv[0]);
+    return 2;
+  }
+
+  // Never destroyed: the global text pools give their memory back at exit
+  static NativeHeapInfo &heap = *new NativeHeapInfo;
+  static SimClock clock;
+  static DirFileSystem fs(argv[1]);
+  static MemKvStore kv;
+  static ScriptCardReader cards;
+  static WavAudioSink audio(fs, clock);
+  static ConsoleDisplay display;
+
+  hal.heap = &heap;
+  hal.clock = &clock;
+  hal.fs = &fs;
+  hal.kv = &kv;
+  hal.cards = &cards;
+  hal.audio = &audio;
+  hal.display = &display;
+
+  std::vector<ButtonEdge> edges;
+  uint32_t endMs = 0;
+  if (!loadScript(argv[2], cards, edges, endMs))
+    return 2;
+
+  if (!audio.open(argc > 3 ? argv[3] : nullptr)) {
+    fprintf(stderr, "cannot write %s\n", argv[3]);
+    return 2;
+  }
+
+  // Same table, timing and actions as the firmware (Buttons.h)
+  ButtonInput buttons(BUTTON_TIMING, BUTTON_COUNT);
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++)
+    buttons.setRepeat(i, BUTTONS[i].repeat);
+
+  randomSeed(1);
+  playerInit("/settings.json");
+
+  size_t nextEdge = 0;
+  for (uint32_t now = 0; now <= endMs; now += SIM_TICK_MS) {
+    clock.set(now);
+
+    while (nextEdge < edges.size() && edges[nextEdge].atMs <= now)
+      buttons.onEdge(edges[nextEdge++]);
+
+    ButtonEvent ev[4];
+    size_t n;
+    while ((n = buttons.poll(now, ev, 4)) > 0) {
+      for (size_t i = 0; i < n; i++) {
+        if (buttonEventWanted(ev[i]))
+          buttonHandleEvent(ev[i]);
+      }
+    }
+
+    playerTick(now);
+    libraryIndexStep(); // the firmware runs these in their own tasks
+    settingsReloadStep(audio.isPlaying() && !audio.isPaused(), now);
+    audio.tick(now);
+  }
+
+  audio.close();
+  Serial.printf("sim: %u ms, %u tracks started\n", (unsigned)endMs,
+                (unsigned)audio.tracksStarted());
+  return 0;
+}
@@ -0,0 +1,92 @@
+// ButtonInput (pio test -e native-test): debounce of bouncing edges and the
+// long-press repeat cadence, with the firmware's timing from Buttons.h.
+
+#include <unity.h>
+
+#include "ButtonInput.h"
+#include "Buttons.h"
+
+static constexpr uint8_t B = 0;
+
+static ButtonInput in(BUTTON_TIMING, 1);
+static ButtonEvent ev[8];
+
+void setUp() {
+  in = ButtonInput(BUTTON_TIMING, 1);
+  in.setRepeat(B, true);
+}
+void tearDown() {}
+
+// A press that bounces for a while counts once, DEBOUNCE_MS after the
+// last bounce; so does the release
+static void test_debounce_bouncing_edge() {
+  in.onEdge({B, true, 1000});
+  in.onEdge({B, false, 1003});
+  in.onEdge({B, true, 1007});
+  in.onEdge({B, false, 1012});
+  in.onEdge({B, true, 1020});
+  TEST_ASSERT_EQUAL(0, in.poll(1020 + DEBOUNCE_MS - 1, ev, 8));
+  TEST_ASSERT_FALSE(in.isDown(B));
+
+  TEST_ASSERT_EQUAL(1, in.poll(1020 + DEBOUNCE_MS, ev, 8));
+  TEST_ASSERT_EQUAL(BTN_PRESS, ev[0].kind);
+  TEST_ASSERT_EQUAL_UINT32(1020, ev[0].edgeAtMs);
+  TEST_ASSERT_TRUE(in.isDown(B));
+
+  // Release bounces back to down and settles there: no events
+  in.onEdge({B, false, 1100});
+  in.onEdge({B, true, 1105});
+  TEST_ASSERT_EQUAL(0, in.poll(1105 + DEBOUNCE_MS, ev, 8));
+  TEST_ASSERT_TRUE(in.isDown(B));
+
+  in.onEdge({B, false, 1200});
+  in.onEdge({B, true, 1204});
+  in.onEdge({B, false, 1209});
+  TEST_ASSERT_EQUAL(1, in.poll(1209 + DEBOUNCE_MS, ev, 8));
+  TEST_ASSERT_EQUAL(BTN_RELEASE, ev[0].kind);
+  TEST_ASSERT_FALSE(in.isDown(B));
+}
+
+// The first repeat comes LONGPRESS_START_MS after the press was accepted,
+// then one every LONGPRESS_REPEAT_MS
+static void test_first_repeat_at_longpress_start() {
+  const uint32_t pressed = 2000 + DEBOUNCE_MS;
+  in.onEdge({B, true, 2000});
+  TEST_ASSERT_EQUAL(1, in.poll(pressed, ev, 8));
+  TEST_ASSERT_EQUAL(BTN_PRESS, ev[0].kind);
+
+  TEST_ASSERT_EQUAL_UINT32(LONGPRESS_START_MS, in.msUntilNext(pressed));
+  TEST_ASSERT_EQUAL(0, in.poll(pressed + LONGPRESS_START_MS - 1, ev, 8));
+  TEST_ASSERT_EQUAL(1, in.poll(pressed + LONGPRESS_START_MS, ev, 8));
+  TEST_ASSERT_EQUAL(BTN_REPEAT, ev[0].kind);
+  TEST_ASSERT_EQUAL_UINT32(2000, ev[0].edgeAtMs);
+  TEST_ASSERT_EQUAL_UINT32(pressed + LONGPRESS_START_MS, ev[0].atMs);
+
+  const uint32_t second = pressed + LONGPRESS_START_MS + LONGPRESS_REPEAT_MS;
+  TEST_ASSERT_EQUAL(0, in.poll(second - 1, ev, 8));
+  TEST_ASSERT_EQUAL(1, in.poll(second, ev, 8));
+  TEST_ASSERT_EQUAL(BTN_REPEAT, ev[0].kind);
+}
+
+// A poll long overdue (loop or task stalled) gives one repeat, not one for
+// every interval missed, and the cadence restarts from then
+static void test_no_repeat_burst_after_stall() {
+  const uint32_t pressed = 3000 + DEBOUNCE_MS;
+  in.onEdge({B, true, 3000});
+  TEST_ASSERT_EQUAL(1, in.poll(pressed, ev, 8));
+
+  const uint32_t late = pressed + LONGPRESS_START_MS + 10 * LONGPRESS_REPEAT_MS;
+  TEST_ASSERT_EQUAL(1, in.poll(late, ev, 8));
+  TEST_ASSERT_EQUAL(BTN_REPEAT, ev[0].kind);
+  TEST_ASSERT_EQUAL(0, in.poll(late, ev, 8));
+  TEST_ASSERT_EQUAL_UINT32(LONGPRESS_REPEAT_MS, in.msUntilNext(late));
+  TEST_ASSERT_EQUAL(1, in.poll(late + LONGPRESS_REPEAT_MS, ev, 8));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_debounce_bouncing_edge);
+  RUN_TEST(test_first_repeat_at_longpress_start);
+  RUN_TEST(test_no_repeat_burst_after_stall);
+  return UNITY_END();
+}
@@ -0,0 +1,151 @@
+// Playlist on the native HAL (pio test -e native-test): next/prev in shuffle
+// mode and auto-advance around the anti-repeat warning.
+
+#include <unity.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Catalog.h"
+#include "Playlist.h"
+#include "native/NativeHal.h"
+
+static constexpr const char *WARNING_PATH = "/warning.mp3";
+
+static std::vector<std::string> names;
+
+// activeTracks as setActiveFromFolder() would leave it, n tracks "/t<i>.mp3"
+static void makePlaylist(size_t n) {
+  clearActivePlaylist();
+  names.clear();
+  for (size_t i = 0; i < n; i++)
+    names.push_back("/t" + std::to_string(i) + ".mp3");
+  for (const std::string &s : names)
+    activeTracks.push_back(s.c_str());
+}
+
+void setUp() {
+  // Never destroyed: the sink may still use them at exit
+  static NativeHeapInfo &heap = *new NativeHeapInfo;
+  static SimClock &clock = *new SimClock;
+  static DirFileSystem &fs = *new DirFileSystem(".");
+  static MemKvStore &kv = *new MemKvStore;
+  static WavAudioSink &audio = *new WavAudioSink(fs, clock);
+  static bool opened = audio.open(nullptr);
+  (void)opened;
+  hal.heap = &heap;
+  hal.clock = &clock;
+  hal.fs = &fs;
+  hal.kv = &kv;
+  hal.audio = &audio;
+
+  randomSeed(1);
+  playlistSetShuffle(false);
+  parentalAntiRepeatEnabled = false;
+  autoAdvance = false;
+  playlistEnded = false;
+}
+void tearDown() {}
+
+// NEXT then PREV (and PREV then NEXT) comes back to the same track, and one
+// round of NEXT plays every track once
+static void test_shuffle_next_prev_inverse() {
+  for (size_t n = 1; n <= 64; n++) {
+    makePlaylist(n);
+    activeIndex = 0;
+    playlistSetShuffle(true);
+    int idx = playlistFirstIndex();
+    std::set<int> seen{idx};
+    for (size_t p = 0; p + 1 < n; p++) {
+      int next = playlistStep(idx, +1);
+      TEST_ASSERT_EQUAL_INT(idx, playlistStep(next, -1));
+      TEST_ASSERT_EQUAL_INT(next, playlistStep(playlistStep(next, -1), +1));
+      seen.insert(next);
+      idx = next;
+    }
+    TEST_ASSERT_EQUAL_INT(n, seen.size());
+  }
+}
+
+// NEXT past the last track starts a new order; PREV from there returns to
+// the track that just finished and on through the old order, and NEXT
+// comes back into the same new order
+static void test_shuffle_prev_across_rounds() {
+  for (size_t n = 2; n <= 32; n++) {
+    makePlaylist(n);
+    activeIndex = 0;
+    playlistSetShuffle(true);
+    std::vector<int> round{playlistFirstIndex()};
+    while (round.size() < n)
+      round.push_back(playlistStep(round.back(), +1));
+
+    int last = round.back();
+    int first = playlistStep(last, +1); // new round
+    TEST_ASSERT_NOT_EQUAL(last, first);
+    TEST_ASSERT_EQUAL_INT(last, playlistStep(first, -1));
+    TEST_ASSERT_EQUAL_INT(round[n - 2], playlistStep(last, -1));
+    TEST_ASSERT_EQUAL_INT(first, playlistStep(last, +1));
+    TEST_ASSERT_EQUAL_INT(last, playlistStep(first, -1));
+  }
+}
+
+// A single card's folder replaces the list without playlistFirstIndex():
+// the order must cover the new list, not the size of the old one
+static void test_shuffle_follows_new_list() {
+  makePlaylist(3);
+  activeIndex = 0;
+  playlistSetShuffle(true);
+  playlistStep(playlistFirstIndex(), +1);
+
+  const size_t n = 100;
+  makePlaylist(n);
+  activeIndex = 50;
+  playlistAnchor(activeIndex);
+  int idx = activeIndex;
+  std::set<int> seen{idx};
+  for (size_t p = 0; p + 1 < n; p++) {
+    idx = playlistStep(idx, +1);
+    TEST_ASSERT_TRUE(idx >= 0 && idx < (int)n);
+    seen.insert(idx);
+  }
+  TEST_ASSERT_EQUAL_INT(n, seen.size());
+}
+
+// Auto-advance onto a blocked track plays the warning once, then stops:
+// it must not start the blocked track (and the warning) again and again
+static void test_warning_stops_auto_advance() {
+  antiRepeatSettings = AntiRepeatSettings();
+  antiRepeatSettings.maxStarts = 1;
+  antiRepeatApplySettings();
+  uiMessages.antiRepeatWarning = WARNING_PATH;
+  parentalAntiRepeatEnabled = true;
+
+  makePlaylist(4);
+  autoAdvance = true;
+  playActiveIndex(1);
+  playActiveIndex(0);
+  TEST_ASSERT_EQUAL_INT(0, activeIndex);
+
+  int next = playlistOnTrackEnded();
+  TEST_ASSERT_EQUAL_INT(1, next);
+  playActiveIndex(next); // blocked: the warning plays instead
+  TEST_ASSERT_EQUAL_INT(0, activeIndex);
+  TEST_ASSERT_EQUAL_STRING(WARNING_PATH, lastPath);
+
+  TEST_ASSERT_EQUAL_INT(-1, playlistOnTrackEnded());
+
+  // A track the child picks afterwards auto-advances as before
+  playActiveIndex(2);
+  TEST_ASSERT_EQUAL_INT(3, playlistOnTrackEnded());
+  uiMessages.antiRepeatWarning = "";
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_shuffle_next_prev_inverse);
+  RUN_TEST(test_shuffle_prev_across_rounds);
+  RUN_TEST(test_shuffle_follows_new_list);
+  RUN_TEST(test_warning_stops_auto_advance);
+  return UNITY_END();
+}
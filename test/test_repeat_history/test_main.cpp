@@ -0,0 +1,107 @@
+// RepeatHistory (pio test -e native-test): the window of the last starts,
+// expiry by age and shrinking the window.
+
+#include <unity.h>
+
+#include <stdio.h>
+
+#include "RepeatHistory.h"
+
+static RepeatHistory h;
+
+void setUp() {
+  h.clear();
+  h.configure(RepeatHistory::MAX_STARTS, 0);
+}
+void tearDown() {}
+
+static void test_counts_starts_in_window() {
+  h.configure(8, 0);
+  h.add("/a.mp3", 0);
+  h.add("/b.mp3", 0);
+  h.add("/a.mp3", 0);
+  TEST_ASSERT_EQUAL_UINT8(2, h.count("/a.mp3", 0));
+  TEST_ASSERT_EQUAL_UINT8(1, h.count("/b.mp3", 0));
+  TEST_ASSERT_EQUAL_UINT8(0, h.count("/c.mp3", 0));
+}
+
+// Only the last windowStarts starts count, however young
+static void test_old_starts_leave_the_window() {
+  h.configure(4, 0);
+  h.add("/a.mp3", 0);
+  h.add("/a.mp3", 0);
+  h.add("/b.mp3", 0);
+  h.add("/c.mp3", 0);
+  TEST_ASSERT_EQUAL_UINT8(2, h.count("/a.mp3", 0));
+  h.add("/d.mp3", 0);
+  TEST_ASSERT_EQUAL_UINT8(1, h.count("/a.mp3", 0));
+  h.add("/e.mp3", 0);
+  TEST_ASSERT_EQUAL_UINT8(0, h.count("/a.mp3", 0));
+  TEST_ASSERT_EQUAL_UINT8(4, h.size());
+}
+
+static void test_expiry_by_age() {
+  h.configure(8, 1000);
+  h.add("/a.mp3", 0);
+  h.add("/a.mp3", 500);
+  TEST_ASSERT_EQUAL_UINT8(2, h.count("/a.mp3", 999));
+  TEST_ASSERT_EQUAL_UINT8(1, h.count("/a.mp3", 1000));
+  TEST_ASSERT_EQUAL_UINT8(0, h.count("/a.mp3", 1500));
+  TEST_ASSERT_EQUAL_UINT8(0, h.size());
+}
+
+// millis() wraps after 49 days
+static void test_expiry_across_millis_wrap() {
+  h.configure(8, 1000);
+  h.add("/a.mp3", 0xFFFFFF00u);
+  TEST_ASSERT_EQUAL_UINT8(1, h.count("/a.mp3", 0x100u)); // 512 ms later
+  TEST_ASSERT_EQUAL_UINT8(0, h.count("/a.mp3", 0x300u)); // 1024 ms later
+}
+
+// A smaller window (settings reload) keeps the newest starts
+static void test_shrink_keeps_newest() {
+  h.configure(8, 0);
+  h.add("/a.mp3", 0);
+  h.add("/b.mp3", 0);
+  h.add("/a.mp3", 0);
+  h.add("/b.mp3", 0);
+  h.add("/c.mp3", 0);
+  h.configure(2, 0);
+  TEST_ASSERT_EQUAL_UINT8(2, h.size());
+  TEST_ASSERT_EQUAL_UINT8(0, h.count("/a.mp3", 0));
+  TEST_ASSERT_EQUAL_UINT8(1, h.count("/b.mp3", 0));
+  TEST_ASSERT_EQUAL_UINT8(1, h.count("/c.mp3", 0));
+
+  h.add("/d.mp3", 0);
+  TEST_ASSERT_EQUAL_UINT8(2, h.size());
+  TEST_ASSERT_EQUAL_UINT8(0, h.count("/b.mp3", 0));
+}
+
+// The ring wraps many times; the filter must count down to zero again
+static void test_ring_wraps() {
+  h.configure(RepeatHistory::MAX_STARTS, 0);
+  char path[16];
+  for (int i = 0; i < 10 * RepeatHistory::MAX_STARTS; i++) {
+    snprintf(path, sizeof(path), "/%d.mp3", i);
+    h.add(path, (uint32_t)i);
+  }
+  TEST_ASSERT_EQUAL_UINT8(RepeatHistory::MAX_STARTS, h.size());
+  TEST_ASSERT_EQUAL_UINT8(0, h.count("/0.mp3", 0));
+  h.clear();
+  TEST_ASSERT_EQUAL_UINT8(0, h.size());
+  for (int i = 0; i < 10 * RepeatHistory::MAX_STARTS; i++) {
+    snprintf(path, sizeof(path), "/%d.mp3", i);
+    TEST_ASSERT_EQUAL_UINT8(0, h.count(path, 0));
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_starts_in_window);
+  RUN_TEST(test_old_starts_leave_the_window);
+  RUN_TEST(test_expiry_by_age);
+  RUN_TEST(test_expiry_across_millis_wrap);
+  RUN_TEST(test_shrink_keeps_newest);
+  RUN_TEST(test_ring_wraps);
+  return UNITY_END();
+}
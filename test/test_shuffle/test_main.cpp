@@ -0,0 +1,78 @@
+// ShuffleOrder (pio test -e native-test): every order is a permutation, and
+// position <-> track goes both ways.
+
+#include <unity.h>
+
+#include <vector>
+
+#include "ShuffleOrder.h"
+
+static constexpr uint32_t MAX_TRACKS = 600;
+static constexpr uint32_t KEY_SETS = 4;
+
+static void keysFor(uint32_t n, uint32_t set, uint32_t keys[]) {
+  for (uint8_t i = 0; i < ShuffleOrder::ROUNDS; i++)
+    keys[i] = n * 2654435761u + set * 40503u + i * 0x9e3779b9u;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_every_track_once() {
+  std::vector<bool> seen;
+  for (uint32_t n = 1; n <= MAX_TRACKS; n++) {
+    for (uint32_t set = 0; set < KEY_SETS; set++) {
+      uint32_t keys[ShuffleOrder::ROUNDS];
+      keysFor(n, set, keys);
+      ShuffleOrder o;
+      o.reset(n, keys);
+      seen.assign(n, false);
+      for (uint32_t p = 0; p < n; p++) {
+        uint32_t t = o.trackAt(p);
+        TEST_ASSERT_LESS_THAN_UINT32(n, t);
+        TEST_ASSERT_FALSE(seen[t]);
+        seen[t] = true;
+      }
+    }
+  }
+}
+
+static void test_pos_of_inverts_track_at() {
+  for (uint32_t n = 1; n <= MAX_TRACKS; n++) {
+    uint32_t keys[ShuffleOrder::ROUNDS];
+    keysFor(n, 0, keys);
+    ShuffleOrder o;
+    o.reset(n, keys);
+    for (uint32_t p = 0; p < n; p++)
+      TEST_ASSERT_EQUAL_UINT32(p, o.posOf(o.trackAt(p)));
+    for (uint32_t t = 0; t < n; t++)
+      TEST_ASSERT_EQUAL_UINT32(t, o.trackAt(o.posOf(t)));
+  }
+}
+
+// anchor() rotates the same order: the picked track first, the rest behind
+// it in the old sequence
+static void test_anchor_rotates() {
+  const uint32_t n = 37;
+  uint32_t keys[ShuffleOrder::ROUNDS];
+  keysFor(n, 1, keys);
+  ShuffleOrder o;
+  o.reset(n, keys);
+  std::vector<uint32_t> before;
+  for (uint32_t p = 0; p < n; p++)
+    before.push_back(o.trackAt(p));
+
+  const uint32_t k = 11;
+  o.anchor(before[k]);
+  TEST_ASSERT_EQUAL_UINT32(before[k], o.trackAt(0));
+  for (uint32_t p = 0; p < n; p++)
+    TEST_ASSERT_EQUAL_UINT32(before[(k + p) % n], o.trackAt(p));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_track_once);
+  RUN_TEST(test_pos_of_inverts_track_at);
+  RUN_TEST(test_anchor_rotates);
+  return UNITY_END();
+}
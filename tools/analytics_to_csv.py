@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Convert the game analytics file (analytics.bin on the SD card) to CSV.
+
+One row per game question. Pass --settings to add the prompt path of each
+question from settings.json (questions are stored in settings.json order).
+
+    python3 tools/analytics_to_csv.py analytics.bin > analytics.csv
+    python3 tools/analytics_to_csv.py analytics.bin --settings settings.json
+"""
+import argparse
+import csv
+import json
+import struct
+import sys
+
+MAGIC = b"TGA1"
+VERSION = 1
+GAME_HEAD = struct.Struct("<3H")  # starts, completions, idleStops
+QUESTION_FIELDS = ["attempts", "correct", "wrong", "master", "timeouts",
+                   "idle_stops"]
+
+
+def read_analytics(data):
+    if data[:4] != MAGIC:
+        raise ValueError("not an analytics file (bad magic)")
+    version, buckets, game_count = data[4], data[5], data[6]
+    if version != VERSION:
+        raise ValueError("unsupported analytics version %d" % version)
+    pos = 8
+    edges = list(struct.unpack_from("<%dH" % (buckets - 1), data, pos))
+    pos += 2 * (buckets - 1)
+    question = struct.Struct("<%dH" % (len(QUESTION_FIELDS) + buckets))
+
+    games = []
+    for _ in range(game_count):
+        id_len = data[pos]
+        pos += 1
+        game_id = data[pos:pos + id_len].decode("utf-8", "replace")
+        pos += id_len
+        q_count = data[pos]
+        pos += 1
+        head = GAME_HEAD.unpack_from(data, pos)
+        pos += GAME_HEAD.size
+        questions = []
+        for _ in range(q_count):
+            questions.append(question.unpack_from(data, pos))
+            pos += question.size
+        games.append((game_id, head, questions))
+    return edges, games
+
+
+def bucket_names(edges):
+    names, lo = [], 0
+    for hi in edges:
+        names.append("scan_%d_%dms" % (lo, hi))
+        lo = hi
+    names.append("scan_ge_%dms" % lo)
+    return names
+
+
+def load_prompts(path):
+    with open(path, encoding="utf-8") as f:
+        doc = json.load(f)
+    return {g.get("id", ""): [q.get("prompt", "") for q in g.get("questions", [])]
+            for g in doc.get("games", [])}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file", help="analytics.bin copied from the SD card")
+    ap.add_argument("--settings", help="settings.json, adds prompt column")
+    ap.add_argument("-o", "--output", help="CSV file (default: stdout)")
+    args = ap.parse_args()
+
+    with open(args.file, "rb") as f:
+        edges, games = read_analytics(f.read())
+    prompts = load_prompts(args.settings) if args.settings else {}
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    w = csv.writer(out)
+    w.writerow(["game", "game_starts", "game_completions", "game_idle_stops",
+                "question", "prompt"] + QUESTION_FIELDS + bucket_names(edges))
+    for game_id, head, questions in games:
+        game_prompts = prompts.get(game_id, [])
+        for i, q in enumerate(questions):
+            prompt = game_prompts[i] if i < len(game_prompts) else ""
+            w.writerow([game_id] + list(head) + [i, prompt] + list(q))
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
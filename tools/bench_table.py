@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Turn a settings benchmark run into the Markdown table of the README.
+
+Reads the JSON lines of the native-bench program and, optionally, a serial
+monitor log of the device booting with the same settings.json (the "Boot:"
+lines), and prints one table row per corpus.
+
+    .pio/build/native-bench/program bench/xxl --runs 5 --out results.jsonl
+    python3 tools/bench_table.py results.jsonl --boot-log boot.txt
+"""
+import argparse
+import json
+import re
+import sys
+
+BOOT_LOAD = re.compile(r"Boot: settings\.json cards (\d+) ms, games (\d+) ms")
+BOOT_READY = re.compile(r"Boot: ready (\d+) ms after reset")
+
+COLUMNS = ["corpus", "cards", "tracks", "settings.json", "cards load (host)",
+           "games load (host)", "scan (host)", "next (host)", "prev (host)",
+           "cards load (device)", "games load (device)", "ready (device)"]
+
+
+def read_boot(path):
+    """Last Boot: lines of the log, None where missing"""
+    load = ready = None
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            m = BOOT_LOAD.search(line)
+            if m:
+                load = (int(m.group(1)), int(m.group(2)))
+            m = BOOT_READY.search(line)
+            if m:
+                ready = int(m.group(1))
+    return load, ready
+
+
+def ms(us):
+    return "%.1f ms" % (us / 1000.0)
+
+
+def latency(r):
+    if not r.get("n"):
+        return "-"
+    return "%d / %d us" % (r["us_median"], r["us_max"])
+
+
+def row(result, boot):
+    load, ready = boot
+    return [
+        result["corpus"],
+        str(result["cards"]),
+        str(result["tracks"]),
+        "%d KB" % (result["settings_bytes"] // 1024),
+        ms(result["load_cards"]["parse_us_median"]),
+        ms(result["load_games"]["parse_us_median"]),
+        latency(result["scan"]),
+        latency(result["next"]),
+        latency(result["prev"]),
+        "%d ms" % load[0] if load else "-",
+        "%d ms" % load[1] if load else "-",
+        "%d ms" % ready if ready is not None else "-",
+    ]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("results", help="JSON lines written by native-bench")
+    ap.add_argument("--boot-log",
+                    help="serial log of the device, for the last corpus")
+    args = ap.parse_args()
+
+    with open(args.results, encoding="utf-8") as f:
+        results = [json.loads(line) for line in f if line.strip()]
+    if not results:
+        sys.exit("no results in %s" % args.results)
+    boot = read_boot(args.boot_log) if args.boot_log else (None, None)
+
+    print("| " + " | ".join(COLUMNS) + " |")
+    print("|" + "---|" * len(COLUMNS))
+    for i, r in enumerate(results):
+        # The device boots one settings.json: the last corpus of the run
+        b = boot if i == len(results) - 1 else (None, None)
+        print("| " + " | ".join(row(r, b)) + " |")
+    print()
+    print("Host times are medians; scan/next/prev are median / max.")
+
+
+if __name__ == "__main__":
+    main()
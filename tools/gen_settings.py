@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+"""Generate a synthetic settings.json plus a matching fake /audio tree.
+
+Used to see how loading grows with the size of settings.json (see the
+native-bench env). The files look like real ones: music cards with single
+files, folders and tracks[] playlists, answer cards with tags, parent
+cards and games with requireTags/sum questions. The .mp3 files are empty
+unless --mp3-bytes is given.
+
+    python3 tools/gen_settings.py bench/medium --scale medium
+    python3 tools/gen_settings.py bench --all
+    python3 tools/gen_settings.py sd --cards 300 --tracks 900 --games 10
+    python3 tools/gen_settings.py sd --cards 2000 --tracks 10000 --big-folder 1200
+"""
+import argparse
+import json
+import os
+import random
+import sys
+
+# Firmware limits (Catalog.h, GameEngine.cpp). Cards and tracks have none.
+MAX_CARD_TAGS = 8
+MAX_GAMES = 10
+MAX_QUESTIONS = 40
+MAX_RULE_TAGS = 6
+
+# cards, playlist tracks, games, questions per game, distinct tags, files in
+# one extra album folder. "medium" is the size of the old fixed tables (200
+# cards, 600 tracks), "xxl" the catalog the firmware is sized for.
+SCALES = {
+    "small": dict(cards=60, tracks=60, games=3, questions=10, tags=20,
+                  big_folder=0),
+    "medium": dict(cards=200, tracks=600, games=MAX_GAMES,
+                   questions=MAX_QUESTIONS, tags=60, big_folder=0),
+    "large": dict(cards=400, tracks=1200, games=MAX_GAMES,
+                  questions=MAX_QUESTIONS, tags=120, big_folder=0),
+    "xl": dict(cards=1000, tracks=5000, games=MAX_GAMES,
+               questions=MAX_QUESTIONS, tags=250, big_folder=0),
+    "xxl": dict(cards=2000, tracks=10000, games=MAX_GAMES,
+                questions=MAX_QUESTIONS, tags=250, big_folder=1200),
+}
+
+WORDS = ["hjulene", "på", "bussen", "lille", "peter", "edderkop", "bjørnen",
+         "sover", "mormor", "elefant", "tiger", "skoven", "bondegård", "sø",
+         "land", "papegøje", "amerika", "guitar", "sang", "dans", "regn",
+         "sol", "måne", "stjerne", "æble", "kat", "hund", "ko", "gris", "hest"]
+ARTISTS = ["Minisjang", "Popsi og Guitar-Krelle", "Sanne Salomonsen",
+           "Sherif Haps", "Unknown", "Børnekoret", "Ælle Bælle"]
+MESSAGES = ["anti_repeat_warning", "anti_repeat_enabled",
+            "anti_repeat_disabled", "volume_lock_on", "volume_lock_off",
+            "mastercard_used", "music_mode_info"]
+GAME_CLIPS = ["intro", "correct", "wrong", "done", "nextCardForAnswer",
+              "musicHint", "idleStop"]
+
+
+class Corpus:
+    def __init__(self, rng):
+        self.rng = rng
+        self.files = set()
+        self.uids = set()
+
+    def uid(self):
+        while True:
+            u = "%08X" % self.rng.getrandbits(32)
+            if u not in self.uids:
+                self.uids.add(u)
+                return u
+
+    def title(self):
+        return " ".join(self.rng.sample(WORDS, self.rng.randint(1, 4))).capitalize()
+
+    def track(self, folder):
+        title, artist = self.title(), self.rng.choice(ARTISTS)
+        path = "/audio/%s/%s##%s.mp3" % (folder, title, artist)
+        self.files.add(path)
+        return title, artist, path
+
+
+def split(total, parts):
+    """total spread over parts as evenly as possible"""
+    return [total // parts + (1 if i < total % parts else 0)
+            for i in range(parts)]
+
+
+def generate(counts, seed):
+    rng = random.Random(seed)
+    corpus = Corpus(rng)
+    tags = ["tag%03d" % i for i in range(counts["tags"])]
+
+    messages = {}
+    for m in MESSAGES:
+        messages[m] = "/audio/messages/%s.mp3" % m
+        corpus.files.add(messages[m])
+
+    games = []
+    for g in range(counts["games"]):
+        gid = "game%02d" % g
+        audio = {}
+        for clip in GAME_CLIPS:
+            audio[clip] = "/audio/games/common/%s.mp3" % clip
+            corpus.files.add(audio[clip])
+        questions = []
+        for q in range(counts["questions"]):
+            prompt = "/audio/games/%s/q%02d.mp3" % (gid, q)
+            corpus.files.add(prompt)
+            if q % 4 == 3:
+                answer = {"type": "sum", "equals": rng.randint(2, 10),
+                          "cards": 2, "tags": ["tal"]}
+            else:
+                n = rng.randint(1, min(MAX_RULE_TAGS, 3))
+                answer = {"type": "requireTags",
+                          "mode": rng.choice(["any", "all"]),
+                          "tags": rng.sample(tags, min(n, len(tags)))}
+                if answer["mode"] == "all" and n > 1:
+                    answer["cards"] = 2
+            questions.append({"prompt": prompt, "answer": answer})
+        games.append({
+            "id": gid,
+            "titel": "Spil %d" % (g + 1),
+            "audio": audio,
+            "timing": {"answerTimeoutMs": 25000, "nextCardRepeatMs": 18000,
+                       "maxRepeat": 3},
+            "questions": questions,
+        })
+
+    # Card mix like the shipped settings.json: ~half answers, a few parent
+    # cards and selectors, the rest music split over single/folder/tracks
+    cards = [
+        {"uid": corpus.uid(), "role": "parent", "action": "toggle_anti_repeat"},
+        {"uid": corpus.uid(), "role": "parent", "action": "toggle_volume_lock"},
+        {"uid": corpus.uid(), "role": "answer", "tags": ["master"]},
+    ]
+    for g in games:
+        cards.append({"uid": corpus.uid(), "role": "game_selector",
+                      "title": g["titel"], "gameId": g["id"]})
+
+    remaining = max(0, counts["cards"] - len(cards))
+    answers = remaining // 2
+    music = remaining - answers
+    for i in range(answers):
+        if i % 5 == 4:
+            card = {"uid": corpus.uid(), "role": "answer", "tags": ["tal"],
+                    "value": rng.randint(0, 9)}
+        else:
+            n = rng.randint(1, min(MAX_CARD_TAGS, 3))
+            card = {"uid": corpus.uid(), "role": "answer",
+                    "tags": rng.sample(tags, min(n, len(tags)))}
+        cards.append(card)
+
+    if counts["big_folder"]:
+        # Numbered, so random titles cannot collide
+        for n in range(counts["big_folder"]):
+            corpus.files.add("/audio/bigalbum/%04d %s##%s.mp3"
+                             % (n + 1, corpus.title(), rng.choice(ARTISTS)))
+        cards.append({"uid": corpus.uid(), "role": "music",
+                      "title": "Big album",
+                      "play": {"kind": "album", "folder": "/audio/bigalbum"}})
+        music = max(0, music - 1)
+
+    playlists = max(1, music // 4) if counts["tracks"] else 0
+    folders = max(1, music // 4) if music > 1 else 0
+    singles = max(0, music - playlists - folders)
+
+    for i in range(singles):
+        title, artist, path = corpus.track("single%02d" % (i % 20))
+        cards.append({"uid": corpus.uid(), "role": "music", "title": title,
+                      "artist": artist,
+                      "play": {"kind": "single", "file": path}})
+
+    for i in range(folders):
+        folder = "album%03d" % i
+        for _ in range(rng.randint(5, 15)):
+            corpus.track(folder)
+        cards.append({"uid": corpus.uid(), "role": "music",
+                      "title": "Album %d" % (i + 1),
+                      "play": {"kind": "album",
+                               "folder": "/audio/%s" % folder}})
+
+    for i, n in enumerate(split(counts["tracks"], playlists) if playlists else []):
+        tracks = []
+        for _ in range(n):
+            title, artist, path = corpus.track("mix%03d" % (i % 50))
+            tracks.append({"title": title, "artist": artist, "file": path})
+        cards.append({"uid": corpus.uid(), "role": "music",
+                      "title": "Mix %d" % (i + 1),
+                      "play": {"kind": "playlist", "tracks": tracks}})
+
+    settings = {
+        "version": 1,
+        "messages": messages,
+        "rfid": {"presence_check_ms": 500, "pause_on_removal": False,
+                 "dedup_ms": 1500,
+                 "same_card": {"music": "resume", "game_selector": "ignore"}},
+        "cards": cards,
+        "games": games,
+    }
+    return settings, corpus.files
+
+
+def write_tree(out_dir, settings, files, mp3_bytes):
+    os.makedirs(out_dir, exist_ok=True)
+    with open(os.path.join(out_dir, "settings.json"), "w",
+              encoding="utf-8") as f:
+        json.dump(settings, f, ensure_ascii=False, indent=2)
+    payload = b"\0" * mp3_bytes
+    for path in sorted(files):
+        full = os.path.join(out_dir, path.lstrip("/"))
+        os.makedirs(os.path.dirname(full), exist_ok=True)
+        with open(full, "wb") as f:
+            f.write(payload)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("out_dir", help="SD-card root to write (or parent with --all)")
+    ap.add_argument("--scale", choices=sorted(SCALES), default="small")
+    ap.add_argument("--all", action="store_true",
+                    help="write every scale to out_dir/<scale>")
+    for key in ("cards", "tracks", "games", "questions", "tags", "big_folder"):
+        ap.add_argument("--" + key.replace("_", "-"), type=int, dest=key,
+                        help="override the scale")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--mp3-bytes", type=int, default=0,
+                    help="size of each fake .mp3 (default empty)")
+    args = ap.parse_args()
+
+    jobs = []
+    if args.all:
+        jobs = [(os.path.join(args.out_dir, s), s) for s in SCALES]
+    else:
+        jobs = [(args.out_dir, args.scale)]
+
+    for out_dir, scale in jobs:
+        counts = dict(SCALES[scale])
+        for key in counts:
+            if getattr(args, key) is not None:
+                counts[key] = getattr(args, key)
+        settings, files = generate(counts, args.seed)
+        write_tree(out_dir, settings, files, args.mp3_bytes)
+        size = os.path.getsize(os.path.join(out_dir, "settings.json"))
+        print("%s: %d cards, %d games, %d files, settings.json %d bytes"
+              % (out_dir, len(settings["cards"]), len(settings["games"]),
+                 len(files), size), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()